@@ -0,0 +1,120 @@
+// bench/bench.c - microbenchmarks for protocol, terminal and parsing hot paths
+//
+//   bench [--json] [--filter <substr>] [--time <seconds per case>]
+//
+// --json prints one machine-readable document so results can be diffed or
+// tracked from release to release.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "bench.h"
+#include "../common/protocol.h"
+#include "../common/timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CASES 64
+#define REPEATS   5
+
+typedef struct {
+    const char* name;
+    BenchFn fn;
+} BenchCase;
+
+typedef struct {
+    uint64_t iters;
+    double nsMin;
+    double nsMedian;
+} BenchResult;
+
+volatile uint64_t bench_sink = 0;
+
+static BenchCase g_cases[MAX_CASES];
+static int g_caseCount = 0;
+
+void bench_add(const char* name, BenchFn fn) {
+    if (g_caseCount < MAX_CASES) {
+        g_cases[g_caseCount].name = name;
+        g_cases[g_caseCount].fn = fn;
+        g_caseCount++;
+    }
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static BenchResult bench_run(const BenchCase* bc, double secs) {
+    // grow iters until one run takes ~10 ms, then size runs to fill secs
+    uint64_t iters = 1;
+    double took = 0.0;
+    for (;;) {
+        uint64_t t0 = time_now_ns();
+        bc->fn(iters);
+        took = (double)(time_now_ns() - t0);
+        if (took >= 1e7 || iters >= (1ull << 40)) break;
+        iters *= 2;
+    }
+    double perRun = secs / REPEATS * 1e9;
+    if (took < perRun) iters = (uint64_t)((double)iters * perRun / (took > 0 ? took : 1.0));
+    if (iters == 0) iters = 1;
+
+    double ns[REPEATS];
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t t0 = time_now_ns();
+        bc->fn(iters);
+        ns[r] = (double)(time_now_ns() - t0) / (double)iters;
+    }
+    qsort(ns, REPEATS, sizeof(double), cmp_double);
+
+    BenchResult res;
+    res.iters = iters;
+    res.nsMin = ns[0];
+    res.nsMedian = ns[REPEATS / 2];
+    return res;
+}
+
+int main(int argc, char** argv) {
+    int json = 0;
+    const char* filter = NULL;
+    double secs = 0.5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) json = 1;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) secs = atof(argv[++i]);
+    }
+
+    bench_register_server();
+    bench_register_term();
+    bench_register_client();
+    bench_register_common();
+
+    if (json) printf("{\"protocol\":\"%s\",\"results\":[", PROTO_VERSION);
+    else printf("%-36s %14s %12s %12s %14s\n", "case", "iters", "ns/op min", "ns/op med", "ops/s");
+
+    int first = 1;
+    for (int i = 0; i < g_caseCount; i++) {
+        const BenchCase* bc = &g_cases[i];
+        if (filter && !strstr(bc->name, filter)) continue;
+
+        BenchResult r = bench_run(bc, secs);
+        double opsPerSec = r.nsMedian > 0 ? 1e9 / r.nsMedian : 0.0;
+        if (json) {
+            printf("%s\n{\"name\":\"%s\",\"iters\":%llu,\"ns_per_op_min\":%.3f,"
+                   "\"ns_per_op_median\":%.3f,\"ops_per_sec\":%.0f}",
+                   first ? "" : ",", bc->name, (unsigned long long)r.iters,
+                   r.nsMin, r.nsMedian, opsPerSec);
+        } else {
+            printf("%-36s %14llu %12.1f %12.1f %14.0f\n", bc->name,
+                   (unsigned long long)r.iters, r.nsMin, r.nsMedian, opsPerSec);
+        }
+        fflush(stdout);
+        first = 0;
+    }
+    if (json) printf("\n]}\n");
+    return 0;
+}
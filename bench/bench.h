@@ -0,0 +1,22 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Tiny microbenchmark harness. A case runs its hot path iters times; the
+// harness calibrates iters, repeats, and reports ns/op as text or JSON.
+
+typedef void (*BenchFn)(uint64_t iters);
+
+void bench_add(const char* name, BenchFn fn);
+
+// Fold results in here so the optimizer can't drop the work.
+extern volatile uint64_t bench_sink;
+
+// One per suite file.
+void bench_register_server(void);
+void bench_register_term(void);
+void bench_register_client(void);
+void bench_register_common(void);
+
+#endif
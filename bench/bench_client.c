@@ -0,0 +1,413 @@
+// bench/bench_client.c - client-side protocol parsing into the world replica.
+
+#include "../client/world.h"
+#include "../client/net.h"
+#include "../client/frame_prof.h"
+#include "../client/glyph_grid.h"
+#include "../client/scene_batch.h"
+#include "../client/cull.h"
+#include "../common/spsc_ring.h"
+#include "../client/input_batch.h"
+#include "../common/netchan.h"
+#include "../common/shm_link.h"
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ClientWorld g_world;
+
+static void bench_on_state(uint64_t iters) {
+    world_init(&g_world);
+    for (uint64_t i = 0; i < iters; i++) {
+        world_on_line("STATE 1.250000 1.600000 -3.500000 0.785398 -0.120000", &g_world);
+    }
+    bench_sink += (uint64_t)g_world.ps.x;
+}
+
+static void bench_on_obj_add(uint64_t iters) {
+    char lines[MAX_OBJS][96];
+    for (int i = 0; i < MAX_OBJS; i++) {
+        snprintf(lines[i], sizeof(lines[i]), "OBJ_ADD %d %.3f 0.500 %.3f 1.000 200 200 255",
+                 i + 1, (float)i * 0.5f, -(float)i * 0.25f);
+    }
+    world_init(&g_world);
+    // ids cycle through a full store, so lookups see every fill level
+    for (uint64_t i = 0; i < iters; i++) world_on_line(lines[i % MAX_OBJS], &g_world);
+    bench_sink += (uint64_t)g_world.objs[0].id;
+}
+
+static void bench_on_line(uint64_t iters) {
+    world_init(&g_world);
+    for (uint64_t i = 0; i < iters; i++) {
+        world_on_line("LINE > Spawning three cubes in a row.", &g_world);
+    }
+    bench_sink += (uint64_t)g_world.term.histCount;
+}
+
+// A full 10k-object resync as it arrives off the socket: framing plus
+// parsing, one op = the whole burst. Only the first MAX_OBJS fit the store;
+// the rest are still parsed.
+#define RESYNC_OBJS 10000
+
+static void bench_resync_10k(uint64_t iters) {
+    static char burst[RESYNC_OBJS * 64];
+    static char scratch[sizeof(burst)];
+    int len = 0;
+    for (int i = 0; i < RESYNC_OBJS; i++) {
+        len += snprintf(burst + len, sizeof(burst) - (size_t)len,
+                        "OBJ_ADD %d %.6f 0.500000 %.6f 1.000000 200 200 255\n",
+                        i + 1, (float)i * 0.5f, -(float)i * 0.25f);
+    }
+    for (uint64_t i = 0; i < iters; i++) {
+        world_init(&g_world);
+        memcpy(scratch, burst, (size_t)len);   // framing writes NULs in place
+        int used = 0;
+        bench_sink += (uint64_t)net_split_lines(scratch, len, &used, world_on_line, &g_world);
+    }
+    bench_sink += (uint64_t)g_world.objCount;
+}
+
+// One 20 Hz snapshot of 32 other players through the parser, plus the three
+// frames drawn until the next one: one op = one snapshot.
+#define SNAP_REMOTES 32
+
+static void bench_snapshot_32(uint64_t iters) {
+    // eight snapshots' worth of lines, cycled; players walk along x
+    static char lines[8][SNAP_REMOTES][64];
+    for (int k = 0; k < 8; k++) {
+        for (int e = 0; e < SNAP_REMOTES; e++) {
+            snprintf(lines[k][e], sizeof(lines[k][e]), "ENT %d %.3f 1.600 %.3f 0.7854",
+                     e, (float)e + (float)k * 0.225f, -(float)e);
+        }
+    }
+    world_init(&g_world);
+    double now = 0.0;
+    for (uint64_t i = 0; i < iters; i++) {
+        char snap[48];
+        snprintf(snap, sizeof(snap), "SNAP %u %u %d", (unsigned)i, (unsigned)(i * 50), SNAP_REMOTES);
+        g_world.clock = now;
+        world_on_line(snap, &g_world);
+        for (int e = 0; e < SNAP_REMOTES; e++) world_on_line(lines[i & 7][e], &g_world);
+        for (int f = 0; f < 3; f++) {
+            now += 1.0 / 60.0;
+            interp_update(&g_world.remotes, now);
+        }
+    }
+    bench_sink += (uint64_t)g_world.remotes.count + (uint64_t)g_world.remotes.ents[0].x;
+}
+
+static void bench_termui_push_full(uint64_t iters) {
+    TerminalUI* t = &g_world.term;
+    termui_init(t);
+    for (int i = 0; i < HISTORY_MAX_LINES; i++) termui_push_line(t, "warming up");
+    for (uint64_t i = 0; i < iters; i++) termui_push_line(t, "OBJ_ADD 12 1.000 0.500 4.000 1.000 200 10 10");
+    bench_sink += termui_next_seq(t);
+}
+
+static void bench_find_obj(uint64_t iters) {
+    world_init(&g_world);
+    for (int i = 0; i < MAX_OBJS; i++) world_alloc_obj(&g_world, i + 1);
+    unsigned rng = 12345u;
+    for (uint64_t i = 0; i < iters; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        ObjCube* o = world_find_obj(&g_world, (int)(rng >> 24) + 1);
+        bench_sink += o ? (uint64_t)o->id : 0;
+    }
+}
+
+static void bench_prof_frame(uint64_t iters) {
+    static FrameProf prof;
+    prof_init(&prof);
+    for (uint64_t i = 0; i < iters; i++) {
+        prof_frame_begin(&prof);
+        for (int p = 0; p < PROF_PASS_COUNT; p++) prof_mark(&prof, (ProfPass)p);
+        prof_frame_end(&prof, i * 3, i, i * 90, i * 40);
+    }
+    bench_sink += prof.frames;
+}
+
+// One server line through the network thread's inbound ring, both ends on
+// this thread: the hand-off cost without the cross-core traffic.
+static void bench_spsc_line(uint64_t iters) {
+    static const char line[] = "OBJ_ADD 12 1.000000 0.500000 4.000000 1.000000 200 10 10";
+    SpscRing r;
+    spsc_init(&r, 1u << 16);
+    for (uint64_t i = 0; i < iters; i++) {
+        spsc_push(&r, line, sizeof(line));
+        uint32_t len;
+        const void* p = spsc_peek(&r, &len);
+        bench_sink += len + (uint64_t)(p != NULL);
+        spsc_pop(&r);
+    }
+    spsc_free(&r);
+}
+
+// INPUT up and STATE back through a shared-memory link, both ends mapped
+// by this process: what a same-host round trip costs without the kernel.
+static void bench_shm_round_trip(uint64_t iters) {
+    static const char input[] = "INPUT 1.000 0.000 0.000 0.012000 -0.001000 0.016667\n";
+    static const char state[] = "STATE 1.250000 1.600000 -3.500000 0.785398 -0.120000\n";
+    char name[SHM_LINK_NAME_MAX];
+    ShmLink srv, cli;
+    shmlink_make_name(name, (int)sizeof(name), 0xbe7c4u);
+    if (!shmlink_create(&srv, name)) return;
+    if (!shmlink_open(&cli, name)) {
+        shmlink_close(&srv);
+        return;
+    }
+    shmlink_unlink(&cli);
+    for (uint64_t i = 0; i < iters; i++) {
+        int len;
+        shmlink_send(&cli, input, (int)sizeof(input) - 1);
+        char* rec = shmlink_peek(&srv, &len);
+        bench_sink += (uint64_t)len + (uint64_t)(rec != NULL);
+        shmlink_pop(&srv);
+        shmlink_send(&srv, state, (int)sizeof(state) - 1);
+        rec = shmlink_peek(&cli, &len);
+        bench_sink += (uint64_t)len + (uint64_t)(rec != NULL);
+        shmlink_pop(&cli);
+    }
+    shmlink_close(&cli);
+    shmlink_close(&srv);
+}
+
+// A second of 60 FPS play at the default 30 Hz input rate: walking with the
+// mouse moving on most frames, a few idle frames, one op = one frame.
+static void bench_input_batch(uint64_t iters) {
+    InputBatch b;
+    inputbatch_init(&b, 30.0f);
+    char line[512];
+    double now = 0.0;
+    for (uint64_t i = 0; i < iters; i++) {
+        InputSample s = { 1.0f, (i & 64) ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f, 1.0f / 60.0f };
+        if (i % 3 != 0) {
+            s.yawDelta = 0.0025f * (float)(i & 7);
+            s.pitchDelta = -0.001f;
+        }
+        if ((i & 31) == 31) s.fwd = s.right = s.yawDelta = s.pitchDelta = 0.0f;
+        inputbatch_add(&b, &s);
+        now += 1.0 / 60.0;
+        bench_sink += (uint64_t)inputbatch_flush(&b, now, line, sizeof(line));
+    }
+    bench_sink += b.messages;
+}
+
+// Datagram channel, both ends in memory. One op = one INPUT queued, packed,
+// received and delivered, with the ack coming back.
+static int g_chanLines;
+
+static void chan_count(int lane, const char* data, int len, void* ud) {
+    (void)lane; (void)data; (void)ud;
+    g_chanLines += len > 0;
+}
+
+static void bench_netchan_input(uint64_t iters) {
+    static NetChan a, b;
+    static const char line[] = "INPUT 1.000 0.000 0.000 0.012000 -0.001000 0.016667\n";
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    netchan_init(&a, 7, 0.0);
+    netchan_init(&b, 7, 0.0);
+    netchan_set_redundancy(&a, NETCHAN_LANE_INPUT, 3);
+    double now = 0.0;
+    for (uint64_t i = 0; i < iters; i++) {
+        now += 1.0 / 60.0;
+        netchan_queue(&a, NETCHAN_LANE_INPUT, line, (int)sizeof(line) - 1);
+        int n;
+        while ((n = netchan_flush(&a, now, pkt)) > 0) netchan_receive(&b, pkt, n, now, chan_count, NULL);
+        while ((n = netchan_flush(&b, now + NETCHAN_ACK_DELAY, pkt)) > 0) netchan_receive(&a, pkt, n, now, chan_count, NULL);
+    }
+    bench_sink += (uint64_t)g_chanLines;
+}
+
+// 1000 reliable terminal lines over a link that loses one packet in ten at
+// random, in both directions; one op = all of them delivered in order.
+static int g_relNext, g_relErrors;
+static uint32_t g_lossRng = 12345;
+
+static int lose_packet(void) {
+    g_lossRng = g_lossRng * 1664525u + 1013904223u;
+    return (g_lossRng >> 16) % 10 == 0;
+}
+
+static void chan_check(int lane, const char* data, int len, void* ud) {
+    (void)ud;
+    if (lane != NETCHAN_RELIABLE) return;
+    for (const char* p = data; p < data + len; ) {
+        int v = atoi(p + 5);
+        if (v != g_relNext) g_relErrors++;
+        g_relNext = v + 1;
+        p = (const char*)memchr(p, '\n', (size_t)(data + len - p)) + 1;
+    }
+}
+
+static void bench_netchan_reliable_lossy(uint64_t iters) {
+    static NetChan a, b;
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    for (uint64_t i = 0; i < iters; i++) {
+        netchan_init(&a, 9, 0.0);
+        netchan_init(&b, 9, 0.0);
+        g_relNext = 0;
+        int queued = 0;
+        double now = 0.0;
+        while (g_relNext < 1000 && now < 60.0) {
+            while (queued < 1000) {
+                char line[64];
+                int n = snprintf(line, sizeof(line), "LINE %d > spawned cube at 1.0 0.5 4.0\n", queued);
+                if (!netchan_queue(&a, NETCHAN_RELIABLE, line, n)) break;
+                queued++;
+            }
+            int n;
+            while ((n = netchan_flush(&a, now, pkt)) > 0) {
+                if (!lose_packet()) netchan_receive(&b, pkt, n, now, chan_check, NULL);
+            }
+            while ((n = netchan_flush(&b, now, pkt)) > 0) {
+                if (!lose_packet()) netchan_receive(&a, pkt, n, now, chan_check, NULL);
+            }
+            now += 0.005;
+        }
+        if (g_relNext != 1000 || g_relErrors) {
+            fprintf(stderr, "netchan: %d of 1000 reliable lines delivered, %d out of order\n", g_relNext, g_relErrors);
+        }
+        bench_sink += (uint64_t)a.resends;
+    }
+}
+
+// Same geometry as the in-world monitor: 50 columns x 12 rows.
+static void glyph_screen(GlyphGrid* g) {
+    glyphgrid_init(g, 50, VISIBLE_LINES, 10.0f, 8.0f, 10.0f, 18.0f, 20.0f, 16);
+    for (int r = 0; r < VISIBLE_LINES; r++) {
+        glyphgrid_set_row(g, r, "> OBJ_ADD 12 1.000 0.500 4.000 1.000 200 10 10", NULL);
+    }
+    glyphgrid_build(g);
+}
+
+static void bench_glyph_full(uint64_t iters) {
+    GlyphGrid g;
+    glyph_screen(&g);
+    for (uint64_t i = 0; i < iters; i++) {
+        // every row changes: worst case, e.g. after scrolling
+        for (int r = 0; r < g.rows; r++) g.rowDirty[r] = 1;
+        bench_sink += (uint64_t)glyphgrid_build(&g);
+    }
+    bench_sink += (uint64_t)glyphgrid_quad_count(&g);
+    glyphgrid_free(&g);
+}
+
+static void bench_glyph_keystroke(uint64_t iters) {
+    static const char* cmds[2] = { "spawn a cub", "spawn a cube" };
+    GlyphGrid g;
+    glyph_screen(&g);
+    for (uint64_t i = 0; i < iters; i++) {
+        // the usual case: only the prompt row differs
+        for (int r = 0; r < g.rows - 1; r++) {
+            glyphgrid_set_row(&g, r, "> OBJ_ADD 12 1.000 0.500 4.000 1.000 200 10 10", NULL);
+        }
+        glyphgrid_set_row(&g, g.rows - 1, "> ", cmds[i & 1]);
+        bench_sink += (uint64_t)glyphgrid_build(&g);
+    }
+    glyphgrid_free(&g);
+}
+
+// Cubes scattered over a square floor around a camera at the origin looking
+// down +z; with a 100 m draw distance roughly a sixth survive.
+static ObjCube* scatter_cubes(int n, float extent) {
+    ObjCube* objs = (ObjCube*)calloc((size_t)n, sizeof(ObjCube));
+    unsigned rng = 777u;
+    for (int i = 0; i < n; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        objs[i].x = ((float)(rng >> 8) / 16777216.0f - 0.5f) * extent;
+        rng = rng * 1664525u + 1013904223u;
+        objs[i].z = ((float)(rng >> 8) / 16777216.0f - 0.5f) * extent;
+        objs[i].y = 0.5f;
+        objs[i].size = 0.5f;
+        objs[i].r = (unsigned char)i;
+        objs[i].id = i + 1;
+        objs[i].alive = 1;
+    }
+    return objs;
+}
+
+static void bench_camera(Frustum* f, float eye[3]) {
+    float tgt[3] = { 0, 1.6f, 1 }, up[3] = { 0, 1, 0 };
+    eye[0] = 0; eye[1] = 1.6f; eye[2] = 0;
+    frustum_from_camera(f, eye, tgt, up, 70.0f, 16.0f / 9.0f, 0.01f, 1000.0f);
+}
+
+static void bench_scene_build(uint64_t iters, int n) {
+    ObjCube* objs = scatter_cubes(n, 64.0f);
+    Frustum f;
+    float eye[3];
+    bench_camera(&f, eye);
+
+    CullSet cs;
+    SceneBatch b;
+    cullset_init(&cs, n);
+    scenebatch_init(&b, n);
+    for (uint64_t i = 0; i < iters; i++) {
+        cullset_load(&cs, objs, n);
+        int vis = cull_run(&cs, &f, eye, 100.0f);
+        bench_sink += (uint64_t)scene_build(&b, objs, cs.visible, vis);
+    }
+    scenebatch_free(&b);
+    cullset_free(&cs);
+    free(objs);
+}
+
+static void bench_scene_build_256(uint64_t iters) { bench_scene_build(iters, MAX_OBJS); }
+static void bench_scene_build_4k(uint64_t iters)  { bench_scene_build(iters, 4096); }
+
+// 100k cubes already in SoA form: the cost of the cull pass itself.
+#define CULL_BENCH_OBJS 100000
+
+static CullSet g_cull100k;
+static Frustum g_cullFrustum;
+static float g_cullEye[3];
+
+static void cull_bench_setup(void) {
+    if (g_cull100k.cap) return;
+    ObjCube* objs = scatter_cubes(CULL_BENCH_OBJS, 400.0f);
+    cullset_init(&g_cull100k, CULL_BENCH_OBJS);
+    cullset_load(&g_cull100k, objs, CULL_BENCH_OBJS);
+    free(objs);
+    bench_camera(&g_cullFrustum, g_cullEye);
+    // check/check_client.c asserts both paths agree on this same field
+}
+
+static void bench_cull_simd(uint64_t iters) {
+    cull_bench_setup();
+    for (uint64_t i = 0; i < iters; i++) {
+        bench_sink += (uint64_t)cull_run(&g_cull100k, &g_cullFrustum, g_cullEye, 100.0f);
+    }
+}
+
+static void bench_cull_scalar(uint64_t iters) {
+    cull_bench_setup();
+    for (uint64_t i = 0; i < iters; i++) {
+        bench_sink += (uint64_t)cull_run_scalar(&g_cull100k, &g_cullFrustum, g_cullEye, 100.0f);
+    }
+}
+
+void bench_register_client(void) {
+    bench_add("client/on_line STATE", bench_on_state);
+    bench_add("client/on_line OBJ_ADD", bench_on_obj_add);
+    bench_add("client/on_line LINE", bench_on_line);
+    bench_add("client/resync 10k OBJ_ADD (frame+parse)", bench_resync_10k);
+    bench_add("client/snapshot 32 remotes (parse+3 frames)", bench_snapshot_32);
+    bench_add("client/spsc push+pop (line)", bench_spsc_line);
+    bench_add("client/shm link INPUT/STATE round trip", bench_shm_round_trip);
+    bench_add("client/input_batch add+flush (per frame)", bench_input_batch);
+    bench_add("client/netchan INPUT round trip", bench_netchan_input);
+    bench_add("client/netchan 1k reliable lines (10% loss)", bench_netchan_reliable_lossy);
+    bench_add("client/termui_push_line (full)", bench_termui_push_full);
+    bench_add("client/find_obj (256 live)", bench_find_obj);
+    bench_add("client/prof_frame (all passes)", bench_prof_frame);
+    bench_add("client/glyphgrid rebuild all", bench_glyph_full);
+    bench_add("client/glyphgrid keystroke", bench_glyph_keystroke);
+    bench_add("client/scene_build (256 cubes)", bench_scene_build_256);
+    bench_add("client/scene_build (4096 cubes)", bench_scene_build_4k);
+    bench_add("client/cull (100k, SIMD)", bench_cull_simd);
+    bench_add("client/cull (100k, scalar)", bench_cull_scalar);
+}
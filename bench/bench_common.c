@@ -0,0 +1,98 @@
+// bench/bench_common.c - shared code in common/ against the libc calls it
+// replaces: numeric fields of the ASCII protocol, scratch allocation.
+
+#include "../common/numcodec.h"
+#include "../common/arena.h"
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A STATE line's worth of values: positions, angles, and the small and
+// negative cases the rounding has to get right.
+static const float kStateVals[5] = { 12.345678f, 1.6f, -3.5f, 0.785398f, -0.000001f };
+
+static const char kInputArgs[] = "1.000 -1.000 0.000 0.012000 -0.001000 0.016667";
+
+static void bench_format_snprintf(uint64_t iters) {
+    char buf[256];
+    for (uint64_t i = 0; i < iters; i++) {
+        int n = snprintf(buf, sizeof(buf), "STATE %.6f %.6f %.6f %.6f %.6f\n", kStateVals[0],
+                         kStateVals[1], kStateVals[2], kStateVals[3], kStateVals[4]);
+        bench_sink += (uint64_t)n;
+    }
+}
+
+static void bench_format_numcodec(uint64_t iters) {
+    char buf[16 + 5 * (NUM_FORMAT_MAX + 1)];
+    for (uint64_t i = 0; i < iters; i++) {
+        int n = 5;
+        memcpy(buf, "STATE", 5);
+        for (int k = 0; k < 5; k++) {
+            buf[n++] = ' ';
+            n += num_format_float(buf + n, kStateVals[k], 6);
+        }
+        buf[n++] = '\n';
+        buf[n] = '\0';
+        bench_sink += (uint64_t)n;
+    }
+}
+
+static void bench_parse_sscanf(uint64_t iters) {
+    float v[6];
+    for (uint64_t i = 0; i < iters; i++) {
+        int n = sscanf(kInputArgs, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        bench_sink += (uint64_t)n + (uint64_t)(v[5] > 0.0f);
+    }
+}
+
+static void bench_parse_numcodec(uint64_t iters) {
+    float v[6];
+    for (uint64_t i = 0; i < iters; i++) {
+        const char* p = kInputArgs;
+        int n = 0;
+        while (n < 6 && num_parse_float(&p, &v[n])) n++;
+        bench_sink += (uint64_t)n + (uint64_t)(v[5] > 0.0f);
+    }
+}
+
+// The buffers of one chat command (request, response, content, HTTP receive
+// and request), taken and dropped the way term_run does it.
+static const size_t kLlmBufs[] = { 16 * 1024, 128 * 1024, 8 * 1024, 256 * 1024, 17 * 1024 };
+
+static void bench_llm_buffers_malloc(uint64_t iters) {
+    void* p[5];
+    for (uint64_t i = 0; i < iters; i++) {
+        for (int k = 0; k < 5; k++) {
+            p[k] = malloc(kLlmBufs[k]);
+            ((char*)p[k])[0] = (char)k;
+        }
+        for (int k = 0; k < 5; k++) {
+            bench_sink += (uint64_t)((char*)p[k])[0];
+            free(p[k]);
+        }
+    }
+}
+
+static void bench_llm_buffers_arena(uint64_t iters) {
+    static Arena a;
+    for (uint64_t i = 0; i < iters; i++) {
+        for (int k = 0; k < 5; k++) {
+            char* p = (char*)arena_alloc(&a, kLlmBufs[k]);
+            p[0] = (char)k;
+            bench_sink += (uint64_t)p[0];
+        }
+        arena_reset(&a);
+    }
+}
+
+void bench_register_common(void) {
+    bench_add("common/STATE line, snprintf %.6f", bench_format_snprintf);
+    bench_add("common/STATE line, num_format_float", bench_format_numcodec);
+    bench_add("common/INPUT sample, sscanf %f", bench_parse_sscanf);
+    bench_add("common/INPUT sample, num_parse_float", bench_parse_numcodec);
+    bench_add("common/LLM command buffers, malloc+free", bench_llm_buffers_malloc);
+    bench_add("common/LLM command buffers, arena", bench_llm_buffers_arena);
+}
@@ -0,0 +1,183 @@
+// bench/bench_server.c - server line framing, dispatch and reply formatting.
+//
+// Compiles server.c into this translation unit so its static hot paths can be
+// driven directly. Sends run in the replay ("headless") mode, so every case
+// measures parsing and formatting without socket I/O.
+
+#define main server_main
+#include "../server/server.c"
+#undef main
+
+#include "bench.h"
+
+static JournalReader g_headless;
+static Conn* g_benchConn = NULL;
+
+static void server_setup(void) {
+    if (g_benchConn) return;
+    for (int i = 0; i < MAX_CLIENTS; i++) g_conns[i].sock = INVALID_SOCKET;
+
+    // session_add before going headless: a fresh id is not replayed here
+    Session* sess = session_add(term_create(), 1);
+    sess->attached = 1;
+
+    g_benchConn = &g_conns[0];
+    memset(g_benchConn, 0, sizeof(*g_benchConn));
+    g_benchConn->sess = sess;
+    g_replay = &g_headless;
+}
+
+// A TCP read's worth of typical client traffic: several INPUTs per packet.
+static const char kInputBurst[] =
+    "INPUT 1.000 0.000 0.000 0.012000 -0.001000 0.016667\n"
+    "INPUT 1.000 -1.000 0.000 0.011000 0.000500 0.016667\n"
+    "INPUT 0.000 1.000 0.000 -0.004000 0.000000 0.016667\r\n"
+    "INPUT -1.000 0.000 0.000 0.000000 0.002000 0.016667\n";
+
+static void bench_conn_feed_unbound(uint64_t iters) {
+    server_setup();
+    // no session: lines are framed and dispatched, then dropped
+    Conn c;
+    memset(&c, 0, sizeof(c));
+    c.sock = INVALID_SOCKET;
+    for (uint64_t i = 0; i < iters; i++) conn_feed(&c, kInputBurst, (int)sizeof(kInputBurst) - 1);
+    bench_sink += (uint64_t)c.inLen;
+}
+
+static void bench_conn_feed_input(uint64_t iters) {
+    server_setup();
+    for (uint64_t i = 0; i < iters; i++) {
+        conn_feed(g_benchConn, kInputBurst, (int)sizeof(kInputBurst) - 1);
+    }
+    bench_sink += (uint64_t)g_benchConn->sess->ps.x;
+}
+
+static void bench_handle_input(uint64_t iters) {
+    server_setup();
+    for (uint64_t i = 0; i < iters; i++) {
+        handle_input(g_benchConn, "1.000 0.000 0.000 0.012000 -0.001000 0.016667");
+    }
+    bench_sink += (uint64_t)g_benchConn->sess->ps.z;
+}
+
+// The same four frames batched by the client into one message: one parse
+// loop and one STATE instead of four.
+static void bench_handle_input_batched(uint64_t iters) {
+    server_setup();
+    for (uint64_t i = 0; i < iters; i++) {
+        handle_input(g_benchConn,
+            "1.000 0.000 0.000 0.012000 -0.001000 0.016667"
+            " 1.000 -1.000 0.000 0.011000 0.000500 0.016667"
+            " 0.000 1.000 0.000 -0.004000 0.000000 0.016667"
+            " -1.000 0.000 0.000 0.000000 0.002000 0.016667");
+    }
+    bench_sink += (uint64_t)g_benchConn->sess->ps.z;
+}
+
+static void bench_send_state(uint64_t iters) {
+    server_setup();
+    PlayerState ps = g_benchConn->sess->ps;
+    for (uint64_t i = 0; i < iters; i++) {
+        ps.yaw += 0.001f;
+        send_state(g_benchConn, &ps);
+    }
+    bench_sink += (uint64_t)ps.yaw;
+}
+
+static void bench_send_all_objs(uint64_t iters) {
+    server_setup();
+    memset(g_objs, 0, sizeof(g_objs));
+    for (int i = 0; i < MAX_OBJS; i++) {
+        ObjCube* o = obj_alloc();
+        o->x = (float)i; o->y = 0.5f; o->z = -(float)i;
+        o->s = 1.0f;
+        o->r = 200; o->g = 200; o->b = 255;
+    }
+    // one full world sync (HELLO path), reported per object
+    for (uint64_t i = 0; i < iters; i += MAX_OBJS) send_all_objs(g_benchConn);
+    memset(g_objs, 0, sizeof(g_objs));
+}
+
+static void bench_obj_alloc(uint64_t iters) {
+    server_setup();
+    memset(g_objs, 0, sizeof(g_objs));
+    for (uint64_t i = 0; i < iters; i++) {
+        ObjCube* o = obj_alloc();
+        if (!o) {
+            memset(g_objs, 0, sizeof(g_objs));
+            continue;
+        }
+        bench_sink += (uint64_t)o->id;
+    }
+    memset(g_objs, 0, sizeof(g_objs));
+}
+
+static void bench_cmd_spawn(uint64_t iters) {
+    server_setup();
+    memset(g_objs, 0, sizeof(g_objs));
+    for (uint64_t i = 0; i < iters; i++) {
+        handle_cmd(g_benchConn, "spawn 1.5 0.5 -2.25");
+        // keep the store from filling so every iteration takes the same path
+        for (int k = 0; k < MAX_OBJS; k++) g_objs[k].alive = 0;
+    }
+}
+
+// Verb lookup and typed argument parsing alone, without the handler.
+static void bench_cmd_route(uint64_t iters) {
+    if (!g_routersReady) init_routers();
+    for (uint64_t i = 0; i < iters; i++) {
+        const char* args;
+        CmdArgs a;
+        const CmdDef* d = cmd_find(&g_termRouter, "spawn 1.5 0.5 -2.25", &args);
+        bench_sink += (uint64_t)(d && cmd_parse(d, args, &a)) + (uint64_t)a.count;
+    }
+}
+
+// Admission for one expensive command: its token bucket, then a push and
+// the pop that later schedules it, with 64 connections' worth of flows
+// taking turns.
+static void bench_cmd_admit(uint64_t iters) {
+    static FairQueue* q;
+    static RateBucket buckets[64];
+    if (!q) q = fair_create(64, CMD_QUEUE_DEPTH, CMD_QUANTUM);
+    double now = 1.0;
+    int flow;
+    FairJob job;
+    for (uint64_t i = 0; i < iters; i++) {
+        int f = (int)(i & 63);
+        now += 0.01;
+        if (rate_take(&buckets[f], now, 4.0f, 10.0f, 1.0f)) {
+            fair_push(q, f, (i & 7) ? 1 : CMD_QUANTUM, "CMD spawn 1 0.5 4");
+        }
+        if ((i & 3) == 3) {
+            for (int k = 0; k < 4 && fair_pop(q, &flow, &job); k++) bench_sink += (uint64_t)job.cost;
+        }
+    }
+}
+
+#ifdef KSPACE_TRACE
+static void bench_trace_scope(uint64_t iters) {
+    // one begin/end pair = two events
+    for (uint64_t i = 0; i < iters; i++) {
+        TRACE_BEGIN("bench");
+        TRACE_END("bench");
+    }
+    bench_sink += g_traceHead;
+}
+#endif
+
+void bench_register_server(void) {
+    bench_add("server/conn_feed_unbound (4 lines)", bench_conn_feed_unbound);
+    bench_add("server/conn_feed_input (4 lines)", bench_conn_feed_input);
+    bench_add("server/handle_input", bench_handle_input);
+    bench_add("server/handle_input (4 samples)", bench_handle_input_batched);
+    bench_add("server/send_state", bench_send_state);
+    bench_add("server/send_all_objs (per obj)", bench_send_all_objs);
+    bench_add("server/obj_alloc", bench_obj_alloc);
+    bench_add("server/cmd_spawn", bench_cmd_spawn);
+    bench_add("server/cmd route+parse (spawn x y z)", bench_cmd_route);
+    bench_add("server/cmd rate limit + fair queue", bench_cmd_admit);
+#ifdef KSPACE_TRACE
+    bench_add("server/trace_scope (2 events)", bench_trace_scope);
+#endif
+}
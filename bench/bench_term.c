@@ -0,0 +1,97 @@
+// bench/bench_term.c - terminal history, JSON escaping and LLM request/response
+// handling. Compiles toy_term.c into this translation unit for its statics;
+// the bench binary links no other copy of it.
+
+#include "../server/toy_term.c"
+
+#include "bench.h"
+
+// Mixed text with quotes, escapes and a non-ASCII byte, ~1 KB.
+static char g_escSrc[1024];
+
+static const char kModelJson[] =
+    "{\"say\":\"Spawning three cubes in a row.\",\"actions\":["
+    "{\"type\":\"spawn_cube\",\"x\":-2.0,\"y\":0.5,\"z\":6.0,\"size\":1.0,\"r\":255,\"g\":80,\"b\":80},"
+    "{\"type\":\"spawn_cube\",\"x\":0.0,\"y\":0.5,\"z\":6.0,\"size\":1.0,\"r\":80,\"g\":255,\"b\":80},"
+    "{\"type\":\"spawn_cube\",\"x\":2.0,\"y\":0.5,\"z\":6.0,\"size\":1.0,\"r\":80,\"g\":80,\"b\":255}"
+    "]}";
+
+// Canned OpenAI-style reply so term_run runs its full local pipeline.
+static int canned_llm(LlmEndpoint ep, const char* body, char* out, int outCap, char* err, int errCap) {
+    (void)ep; (void)body; (void)err; (void)errCap;
+    snprintf(out, outCap,
+        "{\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":"
+        "\"{\\\"say\\\":\\\"ok\\\",\\\"actions\\\":[{\\\"type\\\":\\\"spawn_cube\\\","
+        "\\\"x\\\":1,\\\"y\\\":0.5,\\\"z\\\":4,\\\"size\\\":1,\\\"r\\\":200,\\\"g\\\":10,\\\"b\\\":10}]}\"}}]}");
+    return 1;
+}
+
+static void bench_hist_push_full(uint64_t iters) {
+    ToyTerm* t = term_create();
+    for (int i = 0; i < TERM_HISTORY_MAX; i++) hist_push(t, "warming up the ring with a line");
+    for (uint64_t i = 0; i < iters; i++) {
+        hist_push(t, (i & 1) ? "OBJ_ADD 12 1.000 0.500 4.000 1.000 200 10 10" : ">>> spawn 1 0.5 4");
+    }
+    bench_sink += term_history_next_seq(t);
+    term_destroy(t);
+}
+
+static void bench_replace_last(uint64_t iters) {
+    ToyTerm* t = term_create();
+    for (uint64_t i = 0; i < iters; i++) {
+        replace_last(t, (i & 1) ? ">>> make a red cube" : ">>> ");
+    }
+    bench_sink += (uint64_t)term_history_count(t);
+    term_destroy(t);
+}
+
+static void bench_json_escape_1k(uint64_t iters) {
+    char dst[2048];
+    for (uint64_t i = 0; i < iters; i++) {
+        json_escape(g_escSrc, dst, (int)sizeof(dst));
+        bench_sink += (uint8_t)dst[i & 511];
+    }
+}
+
+static void bench_apply_model_json(uint64_t iters) {
+    ToyTerm* t = term_create();
+    for (uint64_t i = 0; i < iters; i++) apply_model_json(t, kModelJson);
+    bench_sink += term_history_next_seq(t);
+    term_destroy(t);
+}
+
+static void bench_build_request(uint64_t iters) {
+    static char req[16384];
+    ToyTerm* t = term_create();
+    // steady state: chat memory full, every request carries MAX_CHAT_MSGS turns
+    for (int i = 0; i < MAX_CHAT_MSGS; i++) build_llm_request_json(t, "make a red cube", req, (int)sizeof(req));
+    for (uint64_t i = 0; i < iters; i++) {
+        build_llm_request_json(t, "put a blue cube next to it", req, (int)sizeof(req));
+        bench_sink += (uint8_t)req[i & 1023];
+    }
+    term_destroy(t);
+}
+
+static void bench_term_run_canned(uint64_t iters) {
+    ToyTerm* t = term_create();
+    llm_set_backend(canned_llm);
+    for (uint64_t i = 0; i < iters; i++) term_run(t, "spawn a red cube");
+    llm_set_backend(NULL);
+    bench_sink += term_history_next_seq(t);
+    term_destroy(t);
+}
+
+void bench_register_term(void) {
+    for (int i = 0; i < (int)sizeof(g_escSrc) - 1; i++) {
+        static const char mix[] = "say \"hi\" to the cube\\path\tand\nmore \x80 text ";
+        g_escSrc[i] = mix[i % (int)(sizeof(mix) - 1)];
+    }
+    g_escSrc[sizeof(g_escSrc) - 1] = '\0';
+
+    bench_add("term/hist_push (full ring)", bench_hist_push_full);
+    bench_add("term/replace_last", bench_replace_last);
+    bench_add("term/json_escape (1 KB)", bench_json_escape_1k);
+    bench_add("term/apply_model_json (3 actions)", bench_apply_model_json);
+    bench_add("term/build_llm_request (48 msgs)", bench_build_request);
+    bench_add("term/run (canned LLM reply)", bench_term_run_canned);
+}
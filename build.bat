@@ -15,16 +15,16 @@ if not exist ".\bin" (
     mkdir ".\bin"
 )
 
-REM Compile server (winsock)
-gcc .\server\server.c .\server\toy_term.c ^
+REM Compile server (winsock). Add -DKSPACE_TRACE to compile in the event tracer.
+gcc .\server\server.c .\server\toy_term.c .\server\llm.c .\server\command.c .\server\sched.c .\server\snapshot.c .\server\journal.c .\server\metrics.c .\server\trace.c .\common\timing.c .\common\netchan.c .\common\netsim.c .\common\spsc_ring.c .\common\shm_link.c .\common\numcodec.c .\common\arena.c .\common\entropy.c ^
     -o .\bin\server.exe ^
     -I.\common -I.\server ^
-    -lws2_32 -lm -std=c99
+    -lws2_32 -lbcrypt -lm -std=c99
 
 if errorlevel 1 goto :error
 
 REM Compile client (raylib)
-gcc .\client\client.c .\client\net.c .\client\terminal_ui.c .\client\psx_shader.c ^
+gcc .\client\client.c .\client\net.c .\client\net_thread.c .\client\input_batch.c .\client\interp.c .\client\world.c .\client\terminal_ui.c .\client\terminal_render.c .\client\glyph_grid.c .\client\scene_render.c .\client\scene_batch.c .\client\cull.c .\client\frame_prof.c .\client\psx_shader.c .\common\timing.c .\common\spsc_ring.c .\common\numcodec.c .\common\netchan.c .\common\netsim.c .\common\shm_link.c ^
     -o .\bin\client.exe ^
     -I.\common -I.\client ^
     -I"%RAYLIB_ROOT%" -L"%RAYLIB_ROOT%" ^
@@ -33,7 +33,36 @@ gcc .\client\client.c .\client\net.c .\client\terminal_ui.c .\client\psx_shader.
 
 if errorlevel 1 goto :error
 
-echo Built bin\server.exe and bin\client.exe
+REM Compile headless load generator (no raylib)
+gcc .\client\bot.c .\client\net.c .\common\timing.c .\common\netchan.c .\common\netsim.c .\common\spsc_ring.c .\common\shm_link.c ^
+    -o .\bin\bot.exe ^
+    -I.\common -I.\client ^
+    -lws2_32 -std=c99
+
+if errorlevel 1 goto :error
+
+REM Compile microbenchmarks (no raylib; server.c and toy_term.c are included by the suites)
+gcc -O2 .\bench\bench.c .\bench\bench_server.c .\bench\bench_term.c .\bench\bench_client.c .\bench\bench_common.c ^
+    .\client\world.c .\client\net.c .\client\input_batch.c .\client\interp.c .\client\terminal_ui.c .\client\frame_prof.c .\client\glyph_grid.c .\client\scene_batch.c .\client\cull.c .\common\timing.c .\common\spsc_ring.c .\common\numcodec.c .\common\netchan.c .\common\netsim.c .\common\shm_link.c .\common\arena.c .\common\entropy.c .\server\snapshot.c .\server\journal.c .\server\metrics.c .\server\trace.c .\server\llm.c .\server\command.c .\server\sched.c ^
+    -o .\bin\bench.exe ^
+    -I.\common -I.\server -I.\client ^
+    -lws2_32 -lbcrypt -std=c99
+
+if errorlevel 1 goto :error
+
+REM Compile headless checks (no raylib); exits non-zero if any check fails
+gcc -O2 .\check\check.c .\check\check_client.c .\check\check_common.c .\client\glyph_grid.c .\client\scene_batch.c .\client\cull.c ^
+    .\common\spsc_ring.c .\common\numcodec.c ^
+    -o .\bin\check.exe ^
+    -I.\check -I.\client -I.\common ^
+    -std=c99
+
+if errorlevel 1 goto :error
+
+.\bin\check.exe
+if errorlevel 1 goto :error
+
+echo Built bin\server.exe, bin\client.exe, bin\bot.exe, bin\bench.exe and bin\check.exe
 goto :eof
 
 :error
@@ -0,0 +1,66 @@
+// check/check.c - headless assertion checks for client and protocol code
+//
+//   check [--filter <substr>]
+//
+// Prints one line per case and exits 1 if any check failed, so it can gate
+// a build or a CI job.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "check.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_CASES 64
+
+typedef struct {
+    const char* name;
+    CheckFn fn;
+} CheckCase;
+
+static CheckCase g_cases[MAX_CASES];
+static int g_caseCount = 0;
+static int g_failures = 0;
+
+void check_add(const char* name, CheckFn fn) {
+    if (g_caseCount < MAX_CASES) {
+        g_cases[g_caseCount].name = name;
+        g_cases[g_caseCount].fn = fn;
+        g_caseCount++;
+    }
+}
+
+int check_expect(int ok, const char* file, int line, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        g_failures++;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+    }
+
+    check_register_client();
+    check_register_common();
+
+    int ran = 0, failed = 0;
+    for (int i = 0; i < g_caseCount; i++) {
+        const CheckCase* cc = &g_cases[i];
+        if (filter && !strstr(cc->name, filter)) continue;
+
+        int before = g_failures;
+        cc->fn();
+        int ok = (g_failures == before);
+        printf("%-4s %s\n", ok ? "ok" : "FAIL", cc->name);
+        fflush(stdout);
+        ran++;
+        failed += !ok;
+    }
+    printf("%d of %d cases passed\n", ran - failed, ran);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// Headless assertion checks for the pure-C pieces the benchmarks time. Each
+// case asserts with CHECK; a failure prints where and why, the case carries
+// on, and the executable exits non-zero if anything failed.
+
+typedef void (*CheckFn)(void);
+
+void check_add(const char* name, CheckFn fn);
+
+// Returns ok so callers can skip checks that depend on this one.
+int  check_expect(int ok, const char* file, int line, const char* what);
+
+#define CHECK(cond) check_expect((cond) != 0, __FILE__, __LINE__, #cond)
+
+// One per suite file.
+void check_register_client(void);
+void check_register_common(void);
+
+#endif
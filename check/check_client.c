@@ -0,0 +1,269 @@
+// Client-side geometry: what the glyph grid, the culler and the scene batch
+// hand the renderer.
+
+#include "check.h"
+#include "../client/glyph_grid.h"
+#include "../client/scene_batch.h"
+#include "../client/cull.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static int near(float a, float b) {
+    return fabsf(a - b) < 1e-5f;
+}
+
+// Checks the quad q of row r against glyph ch drawn at column col.
+static void check_glyph_quad(const GlyphGrid* g, int r, int q, int ch, int col) {
+    const GlyphVertex* v = g->verts + (size_t)r * (size_t)g->cols * 4 + (size_t)q * 4;
+    int idx = ch - GLYPH_FIRST;
+    float du = g->cellW / g->atlasW, dv = g->cellH / g->atlasH;
+    float u0 = (float)(idx % g->atlasCols) * du;
+    float v0 = (float)(idx / g->atlasCols) * dv;
+    float x0 = g->originX + g->cellW * (float)col;
+    float y0 = g->originY + g->pitchY * (float)r;
+
+    // top-left, bottom-left, bottom-right, top-right
+    CHECK(near(v[0].x, x0) && near(v[0].y, y0) && near(v[0].u, u0) && near(v[0].v, v0));
+    CHECK(near(v[1].x, x0) && near(v[1].y, y0 + g->cellH) && near(v[1].u, u0) && near(v[1].v, v0 + dv));
+    CHECK(near(v[2].x, x0 + g->cellW) && near(v[2].y, y0 + g->cellH) && near(v[2].u, u0 + du) && near(v[2].v, v0 + dv));
+    CHECK(near(v[3].x, x0 + g->cellW) && near(v[3].y, y0) && near(v[3].u, u0 + du) && near(v[3].v, v0));
+}
+
+static void check_glyph_grid(void) {
+    GlyphGrid g;
+    if (!CHECK(glyphgrid_init(&g, 8, 3, 10.0f, 8.0f, 10.0f, 18.0f, 20.0f, 16))) return;
+
+    // 95 glyphs, 16 per atlas row: 16 x 6 cells
+    CHECK(near(g.atlasW, 160.0f) && near(g.atlasH, 108.0f));
+
+    // spaces take no quad; only the touched row is dirty
+    CHECK(glyphgrid_set_row(&g, 0, "Hi A", NULL) == 1);
+    CHECK(g.rowDirty[0] && !g.rowDirty[1] && !g.rowDirty[2]);
+    CHECK(glyphgrid_build(&g) == 1);
+    CHECK(g.rowQuads[0] == 3);
+    CHECK(glyphgrid_quad_count(&g) == 3);
+    check_glyph_quad(&g, 0, 0, 'H', 0);
+    check_glyph_quad(&g, 0, 1, 'i', 1);
+    check_glyph_quad(&g, 0, 2, 'A', 3);
+    CHECK(near(g.verts[0].u, 0.5f));   // 'H' is cell 40: column 8 of 16
+
+    // the same text split over a and b is not a change
+    CHECK(glyphgrid_set_row(&g, 0, "Hi ", "A") == 0);
+    CHECK(!g.rowDirty[0]);
+    CHECK(glyphgrid_build(&g) == 0);
+
+    // clipped to cols; bytes outside the atlas draw as '?'
+    CHECK(glyphgrid_set_row(&g, 2, "0123456789", NULL) == 1);
+    CHECK(glyphgrid_set_row(&g, 1, "\x01", NULL) == 1);
+    CHECK(glyphgrid_build(&g) == 2);
+    CHECK(g.rowQuads[1] == 1 && g.rowQuads[2] == 8);
+    check_glyph_quad(&g, 1, 0, '?', 0);
+    check_glyph_quad(&g, 2, 7, '7', 7);
+    CHECK(glyphgrid_quad_count(&g) == 12);
+
+    // shrinking a row rebuilds just that row
+    CHECK(glyphgrid_set_row(&g, 0, "Hi", NULL) == 1);
+    CHECK(glyphgrid_build(&g) == 1);
+    CHECK(g.rowQuads[0] == 2);
+    CHECK(glyphgrid_quad_count(&g) == 11);
+
+    CHECK(glyphgrid_set_row(&g, 3, "x", NULL) == 0);   // out of range
+    glyphgrid_free(&g);
+}
+
+// Camera at eye height looking down +z, as in the benchmarks: 70 degree
+// vertical fov at 16:9, so the side planes sit at |x| = 1.245 z.
+static void check_camera(Frustum* f, float eye[3]) {
+    float tgt[3] = { 0, 1.6f, 1 }, up[3] = { 0, 1, 0 };
+    eye[0] = 0; eye[1] = 1.6f; eye[2] = 0;
+    frustum_from_camera(f, eye, tgt, up, 70.0f, 16.0f / 9.0f, 0.01f, 1000.0f);
+}
+
+static void place(ObjCube* o, int i, float x, float y, float z) {
+    o->id = i + 1;
+    o->x = x; o->y = y; o->z = z;
+    o->size = 1.0f;
+    o->r = (unsigned char)(i * 20);
+    o->g = 255;
+    o->b = 0;
+    o->alive = 1;
+}
+
+// Ten cubes (two SIMD groups and a tail) with a 100 m draw distance.
+#define CULL_CASE_OBJS 10
+static const int kCullVisible[] = { 0, 4, 6, 7 };
+
+static void cull_case(ObjCube* objs) {
+    place(&objs[0], 0,   0.0f,  1.6f,  10.0f);   // straight ahead
+    place(&objs[1], 1,   0.0f,  1.6f, -10.0f);   // behind
+    place(&objs[2], 2,   0.0f,  1.6f, 150.0f);   // past the draw distance
+    place(&objs[3], 3, 100.0f,  1.6f,  10.0f);   // far off to the side
+    place(&objs[4], 4,   5.0f,  1.6f,  10.0f);   // ahead, off centre
+    place(&objs[5], 5,   0.0f, 30.0f,  10.0f);   // above the view
+    place(&objs[6], 6,  12.8f,  1.6f,  10.0f);   // straddles a side plane
+    place(&objs[7], 7,   0.0f,  1.6f, 100.2f);   // reaches into the draw distance
+    place(&objs[8], 8,   0.0f,  1.6f, 100.6f);   // just beyond it
+    place(&objs[9], 9,  14.0f,  1.6f,  10.0f);   // just outside a side plane
+}
+
+static int visible_is(const CullSet* s, const int* want, int n) {
+    if (s->visibleCount != n) return 0;
+    for (int i = 0; i < n; i++) {
+        if (s->visible[i] != want[i]) return 0;
+    }
+    return 1;
+}
+
+static void check_cull_known(void) {
+    ObjCube objs[CULL_CASE_OBJS];
+    cull_case(objs);
+    Frustum f;
+    float eye[3];
+    check_camera(&f, eye);
+
+    CullSet cs;
+    if (!CHECK(cullset_init(&cs, CULL_CASE_OBJS))) return;
+    cullset_load(&cs, objs, CULL_CASE_OBJS);
+
+    int n = (int)(sizeof(kCullVisible) / sizeof(kCullVisible[0]));
+    CHECK(cull_run_scalar(&cs, &f, eye, 100.0f) == n);
+    CHECK(visible_is(&cs, kCullVisible, n));
+    CHECK(cull_run(&cs, &f, eye, 100.0f) == n);
+    CHECK(visible_is(&cs, kCullVisible, n));
+
+    // no distance limit: the far cubes come back, in index order
+    static const int kNoLimit[] = { 0, 2, 4, 6, 7, 8 };
+    CHECK(cull_run(&cs, &f, eye, 0.0f) == 6);
+    CHECK(visible_is(&cs, kNoLimit, 6));
+
+    float ahead[3] = { 0.0f, 1.6f, 10.0f }, behind[3] = { 0.0f, 1.6f, -10.0f };
+    CHECK(frustum_test_cube(&f, ahead, 0.5f));
+    CHECK(!frustum_test_cube(&f, behind, 0.5f));
+    cullset_free(&cs);
+}
+
+// Over a large random field the SIMD path must match the scalar reference
+// exactly, not just in count.
+static void check_cull_simd_matches(void) {
+    enum { N = 100000 };
+    ObjCube* objs = (ObjCube*)calloc(N, sizeof(ObjCube));
+    CullSet cs;
+    int* ref = (int*)malloc(N * sizeof(int));
+    if (!CHECK(objs && ref && cullset_init(&cs, N))) {
+        free(objs);
+        free(ref);
+        return;
+    }
+    unsigned rng = 777u;
+    for (int i = 0; i < N; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        float x = ((float)(rng >> 8) / 16777216.0f - 0.5f) * 400.0f;
+        rng = rng * 1664525u + 1013904223u;
+        float z = ((float)(rng >> 8) / 16777216.0f - 0.5f) * 400.0f;
+        place(&objs[i], i, x, 0.5f, z);
+        objs[i].size = 0.5f;
+    }
+    Frustum f;
+    float eye[3];
+    check_camera(&f, eye);
+    cullset_load(&cs, objs, N);
+
+    int n = cull_run_scalar(&cs, &f, eye, 100.0f);
+    for (int i = 0; i < n; i++) ref[i] = cs.visible[i];
+    CHECK(n > 0 && n < N);
+    CHECK(cull_run(&cs, &f, eye, 100.0f) == n);
+    CHECK(visible_is(&cs, ref, n));
+
+    cullset_free(&cs);
+    free(ref);
+    free(objs);
+}
+
+// Cull, then pack: one instance per visible cube, in visible order.
+static void check_scene_batch(void) {
+    ObjCube objs[CULL_CASE_OBJS];
+    cull_case(objs);
+    objs[6].size = 2.0f;
+    Frustum f;
+    float eye[3];
+    check_camera(&f, eye);
+
+    CullSet cs;
+    SceneBatch b;
+    if (!CHECK(cullset_init(&cs, CULL_CASE_OBJS))) return;
+    if (!CHECK(scenebatch_init(&b, CULL_CASE_OBJS))) {
+        cullset_free(&cs);
+        return;
+    }
+    cullset_load(&cs, objs, CULL_CASE_OBJS);
+    int vis = cull_run(&cs, &f, eye, 100.0f);
+    CHECK(scene_build(&b, objs, cs.visible, vis) == 4);
+    CHECK(b.count == 4);
+
+    // instance 2 is cube 6: scale on the diagonal, translation in the last
+    // column, colour in the bottom row
+    const float* m = b.xforms + 2 * SCENE_XFORM_FLOATS;
+    CHECK(m[0] == 2.0f && m[5] == 2.0f && m[10] == 2.0f);
+    CHECK(m[1] == 0.0f && m[2] == 0.0f && m[4] == 0.0f && m[6] == 0.0f && m[8] == 0.0f && m[9] == 0.0f);
+    CHECK(m[3] == 12.8f && m[7] == 1.6f && m[11] == 10.0f);
+    CHECK(near(m[12], 120.0f / 255.0f) && m[13] == 1.0f && m[14] == 0.0f && m[15] == 1.0f);
+    CHECK(b.xforms[3] == 0.0f && b.xforms[11] == 10.0f);   // instance 0 is cube 0
+
+    // a full batch packs what fits
+    scenebatch_free(&b);
+    if (CHECK(scenebatch_init(&b, 3))) {
+        CHECK(scene_build(&b, objs, cs.visible, vis) == 3);
+        CHECK(b.xforms[2 * SCENE_XFORM_FLOATS + 11] == 10.0f);
+    }
+    CHECK(scene_build(&b, objs, cs.visible, 0) == 0 && b.count == 0);
+
+    scenebatch_free(&b);
+    cullset_free(&cs);
+}
+
+// Remote players ride the same batch after the cubes, two boxes each.
+static void check_scene_remotes(void) {
+    ObjCube cube;
+    place(&cube, 0, 0.0f, 0.5f, 5.0f);
+    int visible[1] = { 0 };
+
+    static Interp in;   // large; keep it off the stack
+    in.count = 2;
+    in.ents[0].x = 1.0f; in.ents[0].y = 1.6f; in.ents[0].z = 4.0f; in.ents[0].yaw = 0.0f;
+    in.ents[1].x = -2.0f; in.ents[1].y = 1.6f; in.ents[1].z = 6.0f; in.ents[1].yaw = 1.5707964f;
+
+    SceneBatch b;
+    if (!CHECK(scenebatch_init(&b, 1 + 2 * SCENE_REMOTE_BOXES))) return;
+    CHECK(scene_build(&b, &cube, visible, 1) == 1);
+    CHECK(scene_add_remotes(&b, &in) == 5 && b.count == 5);
+
+    // body: 0.5 x 1.7 x 0.5, centred 0.75 m below the eye
+    const float* m = b.xforms + 1 * SCENE_XFORM_FLOATS;
+    CHECK(m[0] == 0.5f && m[5] == 1.7f && m[10] == 0.5f);
+    CHECK(m[3] == 1.0f && near(m[7], 0.85f) && m[11] == 4.0f);
+    CHECK(near(m[12], 190.0f / 255.0f) && near(m[13], 33.0f / 255.0f));
+
+    // facing block 0.3 m along the yaw: +z for yaw 0, +x for a quarter turn
+    m = b.xforms + 2 * SCENE_XFORM_FLOATS;
+    CHECK(m[0] == 0.2f && m[5] == 0.15f && near(m[3], 1.0f) && near(m[11], 4.3f));
+    m = b.xforms + 4 * SCENE_XFORM_FLOATS;
+    CHECK(near(m[3], -1.7f) && near(m[7], 1.5f) && near(m[11], 6.0f));
+
+    // a rebuild replaces the batch; a player that does not fit whole is left out
+    scenebatch_free(&b);
+    if (CHECK(scenebatch_init(&b, 1 + SCENE_REMOTE_BOXES + 1))) {
+        scene_build(&b, &cube, visible, 1);
+        CHECK(scene_add_remotes(&b, &in) == 3);
+        CHECK(scene_build(&b, &cube, visible, 1) == 1 && b.count == 1);
+    }
+    scenebatch_free(&b);
+}
+
+void check_register_client(void) {
+    check_add("client/glyphgrid rows and quads", check_glyph_grid);
+    check_add("client/cull known camera", check_cull_known);
+    check_add("client/cull SIMD matches scalar (100k)", check_cull_simd_matches);
+    check_add("client/scene_batch packing", check_scene_batch);
+    check_add("client/scene_batch remote players", check_scene_remotes);
+}
@@ -0,0 +1,150 @@
+// Shared code that parses what the other side sent: the SPSC ring as it is
+// read from a mapping another process writes, and the numeric codec against
+// the libc calls it replaces.
+
+// MinGW: compare against mingw-w64's own printf/strtof, which round
+// exactly like glibc; msvcrt's %.*f does not, and numcodec follows glibc.
+#define __USE_MINGW_ANSI_STDIO 1
+
+#include "check.h"
+#include "../common/spsc_ring.h"
+#include "../common/numcodec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_CAP 256u
+
+// An empty ring over ctr and buf, as the creating side leaves it.
+static void ring_with(SpscRing* r, SpscCounters* ctr, uint8_t* buf) {
+    memset(ctr, 0, sizeof(*ctr));
+    memset(buf, 0, RING_CAP);
+    spsc_attach(r, ctr, buf, RING_CAP);
+}
+
+static void check_spsc_peer_limits(void) {
+    SpscCounters ctr;
+    static uint8_t buf[RING_CAP];
+    SpscRing r;
+    uint32_t len, bad;
+
+    // well-formed records, including one after a WRAP, are read back
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef01234567", 72));
+    CHECK(spsc_push(&r, "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef01234567", 72));
+    CHECK(spsc_peek(&r, &len) && len == 72);
+    spsc_pop(&r);
+    CHECK(spsc_peek(&r, &len) && len == 72);
+    spsc_pop(&r);
+    CHECK(spsc_push(&r, "wrapped", 7));
+    const char* rec = (const char*)spsc_peek(&r, &len);
+    CHECK(rec && len == 7 && memcmp(rec, "wrapped", 7) == 0);
+    spsc_pop(&r);
+    CHECK(!spsc_peek(&r, &len) && !r.corrupt);
+
+    // head more than cap ahead of tail
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "hi", 2));
+    ctr.head = RING_CAP + 8;
+    CHECK(!spsc_peek(&r, &len) && r.corrupt);
+
+    // a record longer than cap/2
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "hi", 2));
+    bad = RING_CAP / 2 + 1;
+    memcpy(buf, &bad, 4);
+    CHECK(!spsc_peek(&r, &len) && r.corrupt);
+
+    // a record running past head
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "hi", 2));
+    bad = 40;
+    memcpy(buf, &bad, 4);
+    CHECK(!spsc_peek(&r, &len) && r.corrupt);
+
+    // a WRAP that skips past head
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "hi", 2));
+    bad = 0xffffffffu;
+    memcpy(buf, &bad, 4);
+    CHECK(!spsc_peek(&r, &len) && r.corrupt);
+
+    // stays rejected, and pop releases only what peek validated
+    ring_with(&r, &ctr, buf);
+    CHECK(spsc_push(&r, "hi", 2));
+    CHECK(spsc_push(&r, "there", 5));
+    CHECK(spsc_peek(&r, &len) && len == 2);
+    bad = RING_CAP / 2;
+    memcpy(buf, &bad, 4);
+    spsc_pop(&r);
+    CHECK(ctr.tail == 8);
+    rec = (const char*)spsc_peek(&r, &len);
+    CHECK(rec && len == 5 && memcmp(rec, "there", 5) == 0);
+}
+
+// Formats f with numcodec and snprintf, then parses the text back with
+// numcodec and strtof; both pairs must agree bit for bit (any NaN for NaN).
+static int codec_matches(float f, int decimals) {
+    char mine[NUM_FORMAT_MAX], ref[NUM_FORMAT_MAX];
+    num_format_float(mine, f, decimals);
+    snprintf(ref, sizeof(ref), "%.*f", decimals, (double)f);
+    const char* p = ref;
+    float back = 0.0f, want = strtof(ref, NULL);
+    num_parse_float(&p, &back);
+    if (strcmp(mine, ref) == 0 && (memcmp(&back, &want, sizeof(float)) == 0 || (want != want && back != back))) return 1;
+    fprintf(stderr, "numcodec: %a at %d decimals: wrote %s, parsed %a; libc %s, %a\n",
+            (double)f, decimals, mine, (double)back, ref, (double)want);
+    return 0;
+}
+
+// A strided walk over the float bit patterns (odd stride, so every class
+// turns up: subnormals, huge values, infinities, NaNs), each formatted at
+// 3, 6 and a rotating 0..9 decimals.
+static void check_numcodec_format(void) {
+    uint32_t bits = 0;
+    int bad = 0;
+    for (int i = 0; i < (1 << 18) && bad < 8; i++) {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        bad += !CHECK(codec_matches(f, 3));
+        bad += !CHECK(codec_matches(f, 6));
+        bad += !CHECK(codec_matches(f, (int)(bits % 10u)));
+        bits += 0x9E3779B1u;
+    }
+    // ties at the printed precision, and the STATE values
+    static const float kTies[] = { 0.5f, 1.5f, 2.5f, -0.5f, 0.125f, 0.375f, 1e-7f, -0.000001f, 12.345678f };
+    for (int i = 0; i < (int)(sizeof(kTies) / sizeof(kTies[0])); i++) {
+        for (int d = 0; d <= 9; d++) CHECK(codec_matches(kTies[i], d));
+    }
+}
+
+// Text the fast path must either handle exactly or hand to strtof: the
+// value and where parsing stops have to match strtof.
+static void check_numcodec_parse(void) {
+    static const char* kText[] = {
+        "0x1p3", "-0X1.8p1", "0x", "+0xg", "inf", "-infinity", "nan", "1e", "1e+", "5.", "+.5",
+        "  12.5 7", "0.1", "3.4028235e38", "3.4028236e38", "1e-45", "1.17549435e-38",
+        "9007199254740993", "12345678901234567890", "0.000000000000000000000001", "1e23",
+        "16777217", "-0", "0.30000001192092896",
+    };
+    for (int i = 0; i < (int)(sizeof(kText) / sizeof(kText[0])); i++) {
+        const char* p = kText[i];
+        char* end;
+        float got = -1.0f, want = strtof(kText[i], &end);
+        int ok = num_parse_float(&p, &got);
+        if (!CHECK(ok && p == end && (memcmp(&got, &want, sizeof(float)) == 0 || (want != want && got != got)))) {
+            fprintf(stderr, "numcodec: \"%s\" parsed %a, stopped at %d; strtof %a, %d\n",
+                    kText[i], (double)got, (int)(p - kText[i]), (double)want, (int)(end - kText[i]));
+        }
+    }
+    const char* p = "  -x";
+    float f;
+    CHECK(!num_parse_float(&p, &f) && p[0] == ' ');
+}
+
+void check_register_common(void) {
+    check_add("common/spsc_ring rejects bad peer records", check_spsc_peer_limits);
+    check_add("common/numcodec formats like snprintf", check_numcodec_format);
+    check_add("common/numcodec parses like strtof", check_numcodec_parse);
+}
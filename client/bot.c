@@ -0,0 +1,345 @@
+// client/bot.c - headless load generator. Spawns N simulated players on top of
+// client/net.c, drives INPUT at a fixed rate plus periodic CMD spawns,
+// validates every reply and reports latency percentiles and throughput.
+//
+//   bot [--host 127.0.0.1] [--port 27015] [--players 10] [--rate 30]
+//       [--spawn-every 5] [--duration 30] [--udp | --shm]
+//       [--sim-latency ms] [--sim-jitter ms] [--sim-bandwidth kbit/s]
+//       [--sim-loss %] [--sim-reorder %]
+//
+// Exit code is non-zero if any reply failed validation or a player was
+// disconnected, so it can gate soak runs.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "net.h"
+#include "../common/protocol.h"
+#include "../common/timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_QUEUE 256   // outstanding INPUTs tracked per player
+
+typedef struct {
+    NetClient net;
+    int index;
+    int welcomed;
+    int synced;           // initial STATE seen
+    int dead;
+
+    double nextInput;
+    double nextSpawn;
+    double nextWander;
+    float fwd, right, yawRate;
+    unsigned rng;
+
+    // send times of INPUTs still waiting for their STATE (FIFO)
+    double inputSent[INPUT_QUEUE];
+    int qHead, qLen;
+
+    double spawnSentAt;   // 0 = no spawn outstanding
+} Bot;
+
+typedef struct {
+    float* v;
+    int n, cap;
+} Samples;
+
+static Samples g_inputLat;
+static Samples g_spawnLat;
+
+static struct {
+    uint64_t states;
+    uint64_t histLines;
+    uint64_t objAdds;
+    uint64_t spawnsOk;
+    uint64_t spawnsFull;
+    uint64_t spawnsLimited; // refused by the server's per-client rate limit
+    uint64_t untracked;     // INPUTs sent while the FIFO was full
+    uint64_t protoErrors;
+    uint64_t disconnects;
+} g_stats;
+
+static void samples_add(Samples* s, float v) {
+    if (s->n == s->cap) {
+        int ncap = s->cap ? s->cap * 2 : 4096;
+        float* nv = (float*)realloc(s->v, (size_t)ncap * sizeof(float));
+        if (!nv) return;
+        s->v = nv;
+        s->cap = ncap;
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void samples_report(const char* name, Samples* s) {
+    if (s->n == 0) {
+        printf("%-22s no samples\n", name);
+        return;
+    }
+    qsort(s->v, (size_t)s->n, sizeof(float), cmp_float);
+    printf("%-22s p50 %7.3f  p90 %7.3f  p99 %7.3f  max %7.3f ms  (%d samples)\n", name,
+           s->v[s->n / 2], s->v[(int)(s->n * 0.90)], s->v[(int)(s->n * 0.99)], s->v[s->n - 1], s->n);
+}
+
+static float rand01(Bot* b) {
+    // xorshift32
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 17;
+    b->rng ^= b->rng << 5;
+    return (float)(b->rng & 0xFFFFFF) / (float)0x1000000;
+}
+
+static void proto_error(Bot* b, const char* line) {
+    g_stats.protoErrors++;
+    if (g_stats.protoErrors <= 10) printf("bot %d: bad reply: %s\n", b->index, line);
+}
+
+static void on_server_line(const char* line, void* ud) {
+    Bot* b = (Bot*)ud;
+    double now = time_now();
+
+    if (strncmp(line, "WELCOME ", 8) == 0) {
+        char ver[32];
+        if (sscanf(line + 8, "%31s", ver) != 1 || strcmp(ver, PROTO_VERSION) != 0) proto_error(b, line);
+        b->welcomed = 1;
+    }
+    else if (strncmp(line, "STATE ", 6) == 0) {
+        float v[5];
+        if (sscanf(line + 6, "%f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4]) != 5) {
+            proto_error(b, line);
+            return;
+        }
+        g_stats.states++;
+        // the first STATE is the initial sync, not a reply; with a jittery
+        // link it can arrive after the first INPUT has gone out
+        if (!b->synced) {
+            b->synced = 1;
+        } else if (b->qLen > 0) {
+            samples_add(&g_inputLat, (float)((now - b->inputSent[b->qHead]) * 1000.0));
+            b->qHead = (b->qHead + 1) % INPUT_QUEUE;
+            b->qLen--;
+        }
+    }
+    else if (strncmp(line, "HIST ", 5) == 0) {
+        int n = 0;
+        unsigned seq = 0;
+        if (sscanf(line + 5, "%d %u", &n, &seq) != 2 || n < 0) proto_error(b, line);
+    }
+    else if (strncmp(line, "LINE ", 5) == 0) {
+        g_stats.histLines++;
+        if (b->spawnSentAt > 0) {
+            int ok = strcmp(line + 5, "Spawned cube.") == 0;
+            int full = strcmp(line + 5, "Error: object limit reached") == 0;
+            int limited = strncmp(line + 5, "Error: too many ", 16) == 0 ||
+                          strstr(line + 5, "commands already waiting") != NULL;
+            if (limited) {
+                g_stats.spawnsLimited++;
+                b->spawnSentAt = 0;
+            } else if (ok || full) {
+                samples_add(&g_spawnLat, (float)((now - b->spawnSentAt) * 1000.0));
+                if (ok) g_stats.spawnsOk++; else g_stats.spawnsFull++;
+                b->spawnSentAt = 0;
+            } else if (strncmp(line + 5, "Error", 5) == 0) {
+                proto_error(b, line);
+                b->spawnSentAt = 0;
+            }
+        }
+    }
+    else if (strncmp(line, "OBJ_ADD ", 8) == 0) {
+        int id, r, g, bl;
+        float x, y, z, s;
+        if (sscanf(line + 8, "%d %f %f %f %f %d %d %d", &id, &x, &y, &z, &s, &r, &g, &bl) != 8) {
+            proto_error(b, line);
+            return;
+        }
+        g_stats.objAdds++;
+    }
+    else if (strncmp(line, "SNAP ", 5) == 0) {
+        unsigned seq, ms;
+        int n;
+        if (sscanf(line + 5, "%u %u %d", &seq, &ms, &n) != 3 || n < 0) proto_error(b, line);
+    }
+    else if (strncmp(line, "ENT ", 4) == 0) {
+        int id;
+        float x, y, z, yaw;
+        if (sscanf(line + 4, "%d %f %f %f %f", &id, &x, &y, &z, &yaw) != 5) proto_error(b, line);
+    }
+    else if (strncmp(line, "OBJ_CLEAR", 9) == 0 || strncmp(line, "OBJ_DEL ", 8) == 0) {
+        // fine
+    }
+    else {
+        proto_error(b, line);
+    }
+}
+
+// Wander like a player: hold a direction for a second or two, keep turning.
+static void send_input(Bot* b, double now, float dt) {
+    if (now >= b->nextWander) {
+        b->fwd = (float)((int)(rand01(b) * 3.0f) - 1);
+        b->right = (float)((int)(rand01(b) * 3.0f) - 1);
+        b->yawRate = (rand01(b) - 0.5f) * 2.0f;
+        b->nextWander = now + 0.5 + rand01(b) * 1.5;
+    }
+    float pitchD = (rand01(b) - 0.5f) * 0.01f;
+
+    if (!net_sendf(&b->net, "INPUT %.3f %.3f %.3f %.6f %.6f %.6f\n",
+                   b->fwd, b->right, 0.0f, b->yawRate * dt, pitchD, dt)) return;
+
+    if (b->qLen < INPUT_QUEUE) {
+        b->inputSent[(b->qHead + b->qLen) % INPUT_QUEUE] = now;
+        b->qLen++;
+    } else {
+        g_stats.untracked++;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* host = "127.0.0.1";
+    int port = 27015;
+    int players = 10;
+    double rate = 30.0;
+    double spawnEvery = 5.0;
+    double duration = 30.0;
+    int udp = 0;
+    int shm = 0;
+    NetSimConfig sim;
+    memset(&sim, 0, sizeof(sim));
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--udp") == 0) { udp = 1; continue; }
+        if (strcmp(a, "--shm") == 0) { shm = 1; continue; }
+        if (!v) break;
+        if      (strcmp(a, "--host") == 0)        { host = v; i++; }
+        else if (strcmp(a, "--port") == 0)        { port = atoi(v); i++; }
+        else if (strcmp(a, "--players") == 0)     { players = atoi(v); i++; }
+        else if (strcmp(a, "--rate") == 0)        { rate = atof(v); i++; }
+        else if (strcmp(a, "--spawn-every") == 0) { spawnEvery = atof(v); i++; }
+        else if (strcmp(a, "--duration") == 0)    { duration = atof(v); i++; }
+        else if (netsim_arg(&sim, a, v))          { i++; }
+    }
+    if (players < 1) players = 1;
+    if (rate <= 0.0) rate = 1.0;
+
+    if (!net_init()) return 1;
+    net_set_sim(&sim);
+    net_set_shm(shm);
+
+    Bot* bots = (Bot*)calloc((size_t)players, sizeof(Bot));
+    if (!bots) return 1;
+
+    double start = time_now();
+    for (int i = 0; i < players; i++) {
+        Bot* b = &bots[i];
+        b->index = i;
+        b->rng = 0x9E3779B9u * (unsigned)(i + 1);
+        if (!net_connect(&b->net, host, (uint16_t)port)) {
+            printf("bot %d: connect to %s:%d failed\n", i, host, port);
+            b->dead = 1;
+            g_stats.disconnects++;
+            continue;
+        }
+        net_sendf(&b->net, "HELLO\n");
+        if (udp) net_sendf(&b->net, "UDP\n");
+        // stagger so players don't all send in the same millisecond
+        b->nextInput = start + (1.0 / rate) * ((double)i / players);
+        b->nextSpawn = start + spawnEvery * (0.5 + rand01(b));
+    }
+
+    printf("bot: %d players -> %s:%d%s, INPUT %.1f Hz, spawn every %.1f s, %.0f s\n",
+           players, host, port, udp ? " (UDP)" : shm ? " (shared memory)" : "", rate, spawnEvery, duration);
+    if (netsim_active(&sim)) {
+        char desc[128];
+        netsim_describe(&sim, desc, (int)sizeof(desc));
+        printf("bot: simulated link, each way: %s\n", desc);
+    }
+
+    const float dt = (float)(1.0 / rate);
+    double end = start + duration;
+    for (;;) {
+        double now = time_now();
+        if (now >= end) break;
+
+        for (int i = 0; i < players; i++) {
+            Bot* b = &bots[i];
+            if (b->dead) continue;
+
+            if (b->welcomed) {
+                if (now >= b->nextInput) {
+                    send_input(b, now, dt);
+                    b->nextInput += 1.0 / rate;
+                    if (b->nextInput < now) b->nextInput = now;   // don't burst to catch up
+                }
+                if (spawnEvery > 0 && now >= b->nextSpawn && b->spawnSentAt == 0) {
+                    float x = (rand01(b) - 0.5f) * 20.0f;
+                    float z = (rand01(b) - 0.5f) * 20.0f;
+                    if (net_sendf(&b->net, "CMD spawn %.2f 0.5 %.2f\n", x, z)) b->spawnSentAt = now;
+                    b->nextSpawn = now + spawnEvery;
+                }
+            }
+
+            if (!net_poll_lines(&b->net, on_server_line, b)) {
+                printf("bot %d: disconnected\n", i);
+                b->dead = 1;
+                g_stats.disconnects++;
+            }
+        }
+
+        time_sleep_ms(1);
+    }
+
+    double elapsed = time_now() - start;
+    uint64_t bytesIn = 0, bytesOut = 0, linesIn = 0, linesOut = 0;
+    uint64_t udpPlayers = 0, udpPackets = 0, udpResends = 0, udpDropped = 0;
+    for (int i = 0; i < players; i++) {
+        const NetChan* ch = bots[i].net.chan;
+        if (ch) {
+            udpPlayers++;
+            udpPackets += ch->packetsOut;
+            udpResends += ch->resends;
+            udpDropped += ch->dropped;
+        }
+        bytesIn += bots[i].net.bytesIn;
+        bytesOut += bots[i].net.bytesOut;
+        linesIn += bots[i].net.linesIn;
+        linesOut += bots[i].net.linesOut;
+        net_close(&bots[i].net);
+    }
+
+    printf("\n%d players, %.1f s\n", players, elapsed);
+    printf("sent     %10llu msgs %10.1f msg/s %12llu bytes %10.1f KB/s\n",
+           (unsigned long long)linesOut, linesOut / elapsed,
+           (unsigned long long)bytesOut, bytesOut / elapsed / 1024.0);
+    printf("received %10llu msgs %10.1f msg/s %12llu bytes %10.1f KB/s\n",
+           (unsigned long long)linesIn, linesIn / elapsed,
+           (unsigned long long)bytesIn, bytesIn / elapsed / 1024.0);
+    if (udp) {
+        printf("UDP      %10llu of %d players, %llu packets out, %llu resends, %llu stale/duplicate in\n",
+               (unsigned long long)udpPlayers, players, (unsigned long long)udpPackets,
+               (unsigned long long)udpResends, (unsigned long long)udpDropped);
+    }
+    samples_report("INPUT -> STATE", &g_inputLat);
+    samples_report("CMD spawn -> reply", &g_spawnLat);
+    printf("states %llu, terminal lines %llu, OBJ_ADDs %llu\n",
+           (unsigned long long)g_stats.states, (unsigned long long)g_stats.histLines,
+           (unsigned long long)g_stats.objAdds);
+    printf("spawns ok %llu, rejected (object limit) %llu, rate limited %llu, untracked inputs %llu\n",
+           (unsigned long long)g_stats.spawnsOk, (unsigned long long)g_stats.spawnsFull,
+           (unsigned long long)g_stats.spawnsLimited, (unsigned long long)g_stats.untracked);
+    printf("protocol errors %llu, disconnects %llu\n",
+           (unsigned long long)g_stats.protoErrors, (unsigned long long)g_stats.disconnects);
+
+    free(bots);
+    free(g_inputLat.v);
+    free(g_spawnLat.v);
+    net_shutdown();
+    return (g_stats.protoErrors || g_stats.disconnects) ? 1 : 0;
+}
@@ -3,54 +3,43 @@
 
 #include "raylib.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 #include "net.h"
+#include "net_thread.h"
+#include "input_batch.h"
 #include "terminal_ui.h"
+#include "terminal_render.h"
+#include "scene_render.h"
+#include "world.h"
+#include "frame_prof.h"
 #include "psx_shader.h"
 #include "../common/protocol.h"
 
-#define MAX_OBJS 256
+// desk with the terminal monitor standing on it
+static const Vector3 DESK_POS  = { 0, 0.5f, 7 };
+static const Vector3 DESK_SIZE = { 3, 1, 1.5f };
+static const Vector3 MON_POS   = { 0, 1.3f, 7 };
+static const Vector3 MON_SIZE  = { 0.8f, 0.6f, 0.05f };
 
 typedef struct {
-    int id;
-    Vector3 pos;
-    float size;
-    unsigned char r, g, b;
-    int alive;
-} ObjCube;
-
-typedef struct {
-    float x, y, z;
-    float yaw, pitch;
-} PlayerState;
-
-typedef struct {
-    NetClient net;
-    TerminalUI term;
-    PlayerState ps;
+    NetThread* net;
+    ClientWorld world;
+    InputBatch input;
+    int udp;            // ask for the UDP channel after every HELLO
 
     int focused;
     int paused;
 
-    int haveHistory;
-    int expectHist;
-    int gotHist;
-
     // prediction
-    int haveState;
+    int havePred;
     Vector3 predPos;
     float predYaw;
     float predPitch;
-
-    ObjCube objs[MAX_OBJS];
 } ClientState;
 
-static void clear_objs(ClientState* cs);
-static ObjCube* find_obj(ClientState* cs, int id);
-static ObjCube* alloc_obj(ClientState* cs, int id);
-
 static float Snap(float v, float step) {
     return floorf(v / step + 0.5f) * step;
 }
@@ -74,97 +63,94 @@ static void SetMouseCaptured(int captured) {
     }
 }
 
-static void on_server_line(const char* line, void* ud) {
-    const char* p = line;
-    if (strncmp(p, "LINE ", 5) == 0) p += 5;
-
-    ClientState* cs = (ClientState*)ud;
-
-    if (strncmp(line, "HIST ", 5) == 0) {
-        cs->expectHist = atoi(line + 5);
-        cs->gotHist = 0;
-        cs->term.histCount = 0;
-        cs->haveHistory = 1;
-    }
-    else if (strncmp(line, "LINE ", 5) == 0) {
-        termui_push_line(&cs->term, line + 5);
-        cs->gotHist++;
-    }
-    else if (strncmp(line, "STATE ", 6) == 0) {
-        sscanf(line + 6, "%f %f %f %f %f",
-            &cs->ps.x, &cs->ps.y, &cs->ps.z,
-            &cs->ps.yaw, &cs->ps.pitch);
-
-        if (!cs->haveState) {
-            cs->haveState = 1;
-            cs->predPos = (Vector3){ cs->ps.x, cs->ps.y, cs->ps.z };
-            cs->predYaw = cs->ps.yaw;
-            cs->predPitch = cs->ps.pitch;
-        }
-    }
-    else if (strncmp(line, "OBJ_CLEAR", 9) == 0) {
-        clear_objs(cs);
-    }
-    else if (strncmp(line, "OBJ_DEL ", 8) == 0) {
-        int id = 0;
-        if (sscanf(line + 8, "%d", &id) == 1) {
-            ObjCube* o = find_obj(cs, id);
-            if (o) o->alive = 0;
-        }
-    }
-    else if (strncmp(line, "OBJ_ADD ", 8) == 0) {
-        printf("adding");
-        int id = 0, r = 255, g = 255, b = 255;
-        float x=0,y=0,z=0,s=1;
-        if (sscanf(line + 8, "%d %f %f %f %f %d %d %d", &id, &x, &y, &z, &s, &r, &g, &b) == 8) {
-            ObjCube* o = alloc_obj(cs, id);
-            if (o) {
-                o->pos = (Vector3){ x, y, z };
-                o->size = s;
-                o->r = (unsigned char)r;
-                o->g = (unsigned char)g;
-                o->b = (unsigned char)b;
-            }
-        }
+// HELLO with our session and the next history seq we expect; the server
+// answers with only the lines we are missing.
+static void send_hello(ClientState* cs) {
+    if (cs->world.haveSession) {
+        net_thread_sendf(cs->net, "HELLO %016llx %u\n", (unsigned long long)cs->world.sessionId, termui_next_seq(&cs->world.term));
+    } else {
+        net_thread_sendf(cs->net, "HELLO\n");
     }
+    if (cs->udp) net_thread_sendf(cs->net, "UDP\n");
 }
 
-static int ray_hit_box(Camera3D cam, BoundingBox box) {
-    Ray ray = GetMouseRay(GetMousePosition(), cam);
-    RayCollision hit = GetRayCollisionBox(ray, box);
-    return hit.hit;
+static void on_net_event(NetEventKind kind, const char* line, void* ud) {
+    ClientState* cs = (ClientState*)ud;
+    if (kind == NET_EV_LINE) world_on_line(line, &cs->world);
+    else if (kind == NET_EV_CONNECTED) send_hello(cs);
 }
 
-static ObjCube* find_obj(ClientState* cs, int id) {
-    for (int i = 0; i < MAX_OBJS; i++) {
-        if (cs->objs[i].alive && cs->objs[i].id == id) return &cs->objs[i];
+// F3 overlay: frame-time percentiles over the last PROF_WINDOW frames and the
+// average/max of each pass. Stats are refreshed a few times a second.
+static void draw_profiler(const ProfStats* st) {
+    const int x = 10, lineH = 16;
+    int y = 10;
+    DrawRectangle(x - 6, y - 6, 330, lineH * (PROF_PASS_COUNT + 3) + 12, (Color){ 0, 0, 0, 170 });
+
+    DrawText(TextFormat("frame p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                        st->p50, st->p95, st->p99, st->max), x, y, 10, RAYWHITE);
+    y += lineH;
+    DrawText(TextFormat("net msgs/frame in %.1f  out %.1f  (%d frames)",
+                        st->msgsInAvg, st->msgsOutAvg, st->frames), x, y, 10, RAYWHITE);
+    y += lineH + 4;
+    for (int i = 0; i < PROF_PASS_COUNT; i++) {
+        float avg = st->passAvg[i];
+        DrawRectangle(x + 150, y + 1, (int)(avg * 10.0f), 8, (Color){ 80, 200, 120, 255 });
+        DrawText(TextFormat("%-9s %6.3f  max %6.3f", kProfPassNames[i], avg, st->passMax[i]),
+                 x, y, 10, RAYWHITE);
+        y += lineH;
     }
-    return NULL;
 }
 
-static ObjCube* alloc_obj(ClientState* cs, int id) {
-    ObjCube* o = find_obj(cs, id);
-    if (o) return o;
-    for (int i = 0; i < MAX_OBJS; i++) {
-        if (!cs->objs[i].alive) {
-            cs->objs[i].alive = 1;
-            cs->objs[i].id = id;
-            return &cs->objs[i];
-        }
-    }
-    return NULL;
+// The one scene submission path, shared by the low-res and full-res modes.
+static void draw_scene(SceneRenderer* sr, const ClientWorld* w, Camera3D camera, float aspect,
+                       Texture2D termTex) {
+    BeginMode3D(camera);
+        DrawGrid(20, 1.0f);
+        DrawCube(DESK_POS, DESK_SIZE.x, DESK_SIZE.y, DESK_SIZE.z, DARKGRAY);
+
+        scenerender_draw(sr, w, camera, aspect);
+
+        Vector3 screenPos = (Vector3){ MON_POS.x, MON_POS.y, MON_POS.z - (MON_SIZE.z/2 + 0.001f) };
+        Vector2 screenSize = (Vector2){ MON_SIZE.x * 0.95f, MON_SIZE.y * 0.90f };
+
+        Rectangle srcTerm = {
+            0, 0,
+            (float)termTex.width,
+            (float)-termTex.height
+        };
+
+        DrawBillboardRec(camera, termTex, srcTerm, screenPos, screenSize, WHITE);
+    EndMode3D();
 }
 
-static void clear_objs(ClientState* cs) {
-    for (int i = 0; i < MAX_OBJS; i++) cs->objs[i].alive = 0;
+static int ray_hit_box(Camera3D cam, BoundingBox box) {
+    Ray ray = GetMouseRay(GetMousePosition(), cam);
+    RayCollision hit = GetRayCollisionBox(ray, box);
+    return hit.hit;
 }
 
 int main(int argc, char **argv) {
     int disableLowRes = 1;
+    const char* profCsv = NULL;
+    float inputRate = 30.0f;
+    int udp = 0;
+    int shm = 0;
+    NetSimConfig sim = { 0 };
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--lowres") == 0) {
             disableLowRes = 0;
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            profCsv = argv[++i];
+        } else if (strcmp(argv[i], "--input-rate") == 0 && i + 1 < argc) {
+            inputRate = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--udp") == 0) {
+            udp = 1;
+        } else if (strcmp(argv[i], "--shm") == 0) {
+            shm = 1;
+        } else if (i + 1 < argc && netsim_arg(&sim, argv[i], argv[i + 1])) {
+            i++;
         }
     }
 
@@ -174,12 +160,19 @@ int main(int argc, char **argv) {
     SetTargetFPS(60);
 
     if (!net_init()) return 1;
+    // before the net thread starts; it applies to every connection
+    net_set_sim(&sim);
+    net_set_shm(shm);
 
     ClientState cs = { 0 };
-    termui_init(&cs.term);
+    world_init(&cs.world);
+    inputbatch_init(&cs.input, inputRate);
+    cs.udp = udp;
 
-    if (!net_connect(&cs.net, "127.0.0.1", 27015)) return 1;
-    net_sendf(&cs.net, "HELLO\n");
+    // connects in the background and retries once a second; HELLO goes out
+    // when the connection event is drained
+    cs.net = net_thread_start("127.0.0.1", 27015);
+    if (!cs.net) return 1;
 
     Camera3D camera = { 0 };
     camera.position = (Vector3){ 0.0f, 1.6f, 2.0f };
@@ -188,17 +181,15 @@ int main(int argc, char **argv) {
     camera.fovy     = 70.0f;
     camera.projection = CAMERA_PERSPECTIVE;
 
-    Vector3 deskPos  = { 0, 0.5f, 7 };
-    Vector3 deskSize = { 3, 1, 1.5f };
-    Vector3 monPos   = { deskPos.x, deskPos.y + 0.8f, deskPos.z };
-    Vector3 monSize  = { 0.8f, 0.6f, 0.05f };
-
     BoundingBox monBox = {
-        { monPos.x - monSize.x / 2, monPos.y - monSize.y / 2, monPos.z - monSize.z / 2 },
-        { monPos.x + monSize.x / 2, monPos.y + monSize.y / 2, monPos.z + monSize.z / 2 }
+        { MON_POS.x - MON_SIZE.x / 2, MON_POS.y - MON_SIZE.y / 2, MON_POS.z - MON_SIZE.z / 2 },
+        { MON_POS.x + MON_SIZE.x / 2, MON_POS.y + MON_SIZE.y / 2, MON_POS.z + MON_SIZE.z / 2 }
     };
 
-    RenderTexture2D termRT = LoadRenderTexture(512, 256);
+    TermRenderer term;
+    termrender_init(&term, GetFontDefault(), 512, 256);
+    SceneRenderer scene;
+    scenerender_init(&scene);
     RenderTexture2D sceneRT = { 0 };
 
     if (!disableLowRes) {
@@ -207,10 +198,24 @@ int main(int argc, char **argv) {
     }
     Shader psxShader = LoadPsxShader();
 
+    static FrameProf prof;
+    prof_init(&prof);
+    if (profCsv && !prof_csv_open(&prof, profCsv)) printf("cannot write %s\n", profCsv);
+    int showProf = 0;
+    ProfStats profStats = { 0 };
+
     SetMouseCaptured(1);
 
     while (!WindowShouldClose()) {
-        if (!net_poll_lines(&cs.net, on_server_line, &cs)) break;
+        prof_frame_begin(&prof);
+
+        // lines are stamped with the drain time, so snapshot jitter as seen
+        // here includes up to a frame of latency; the buffer absorbs it
+        cs.world.clock = GetTime();
+        net_thread_drain(cs.net, on_net_event, &cs);
+        prof_mark(&prof, PROF_NET);
+
+        if (IsKeyPressed(KEY_F3)) showProf = !showProf;
 
         if (IsKeyPressed(KEY_ESCAPE)) {
             if (cs.focused) {
@@ -233,31 +238,33 @@ int main(int argc, char **argv) {
 
         if (cs.focused) {
             if (IsKeyPressed(KEY_ENTER)) {
-                net_sendf(&cs.net, "CMD %s\n", cs.term.command);
-                termui_clear_command(&cs.term);
+                net_thread_sendf(cs.net, "CMD %s\n", cs.world.term.command);
+                termui_clear_command(&cs.world.term);
             }
 
-            if (IsKeyPressed(KEY_BACKSPACE) && cs.term.cmdLen > 0) {
-                cs.term.command[--cs.term.cmdLen] = 0;
-            }
+            if (IsKeyPressed(KEY_BACKSPACE)) termui_backspace(&cs.world.term);
 
             int ch = GetCharPressed();
             while (ch > 0) {
-                if (cs.term.cmdLen < COMMAND_MAX_CHARS - 1 &&
-                    termui_allowed_char(ch)) {
-                    cs.term.command[cs.term.cmdLen++] = (char)ch;
-                    cs.term.command[cs.term.cmdLen] = 0;
-                }
+                termui_type_char(&cs.world.term, ch);
                 ch = GetCharPressed();
             }
         }
 
+        prof_mark(&prof, PROF_INPUT);
+
         float dt = GetFrameTime();
 
-        if (!cs.haveState) {
+        if (!cs.world.haveState) {
             cs.predPos = camera.position;
             cs.predYaw = 0;
             cs.predPitch = 0;
+        } else if (!cs.havePred) {
+            // first authoritative state: snap instead of smoothing toward it
+            cs.havePred = 1;
+            cs.predPos = (Vector3){ cs.world.ps.x, cs.world.ps.y, cs.world.ps.z };
+            cs.predYaw = cs.world.ps.yaw;
+            cs.predPitch = cs.world.ps.pitch;
         }
 
         if (!cs.paused && !cs.focused) {
@@ -299,18 +306,24 @@ int main(int argc, char **argv) {
             cs.predPos.y += wish.y * speed * dt;
             cs.predPos.z += wish.z * speed * dt;
 
-            net_sendf(&cs.net,
-                "INPUT %.3f %.3f %.3f %.6f %.6f %.6f\n",
-                fwd, right, up, yawDelta, pitchDelta, dt);
+            InputSample smp = { fwd, right, up, yawDelta, pitchDelta, dt };
+            inputbatch_add(&cs.input, &smp);
         }
 
-        if (cs.haveState) {
+        // frames are sampled every frame but sent at the input rate, several
+        // per INPUT line; prediction above already used them
+        char inputLine[512];
+        if (inputbatch_flush(&cs.input, GetTime(), inputLine, sizeof(inputLine)) > 0) {
+            net_thread_sendf(cs.net, "%s", inputLine);
+        }
+
+        if (cs.havePred) {
             float a = 1.0f - expf(-12.0f * dt);
-            cs.predPos.x += (cs.ps.x - cs.predPos.x) * a;
-            cs.predPos.y += (cs.ps.y - cs.predPos.y) * a;
-            cs.predPos.z += (cs.ps.z - cs.predPos.z) * a;
-            cs.predYaw   += (cs.ps.yaw - cs.predYaw) * a;
-            cs.predPitch += (cs.ps.pitch - cs.predPitch) * a;
+            cs.predPos.x += (cs.world.ps.x - cs.predPos.x) * a;
+            cs.predPos.y += (cs.world.ps.y - cs.predPos.y) * a;
+            cs.predPos.z += (cs.world.ps.z - cs.predPos.z) * a;
+            cs.predYaw   += (cs.world.ps.yaw - cs.predYaw) * a;
+            cs.predPitch += (cs.world.ps.pitch - cs.predPitch) * a;
         }
 
         float cy = cosf(cs.predYaw), sy = sinf(cs.predYaw);
@@ -326,35 +339,20 @@ int main(int argc, char **argv) {
         camera.position = SnapV3(camera.position, 1.0f / 64.0f);
         camera.target   = SnapV3(camera.target,   1.0f / 64.0f);
 
-        termui_render(termRT, GetFontDefault(), &cs.term);
+        // other players, drawn slightly in the past between snapshots
+        interp_update(&cs.world.remotes, GetTime());
+
+        prof_mark(&prof, PROF_PREDICT);
+
+        termrender_update(&term, &cs.world.term);
+        prof_mark(&prof, PROF_TERMINAL);
 
         if (!disableLowRes) {
             BeginTextureMode(sceneRT);
                 ClearBackground((Color){ 10, 10, 12, 255 });
-                BeginMode3D(camera);
-                    DrawGrid(20, 1.0f);
-                    DrawCube(deskPos, deskSize.x, deskSize.y, deskSize.z, DARKGRAY);
-
-                    for (int i = 0; i < MAX_OBJS; i++) {
-                        if (!cs.objs[i].alive) continue;
-                        ObjCube* o = &cs.objs[i];
-                        Color col = (Color){ o->r, o->g, o->b, 255 };
-                        DrawCube(o->pos, o->size, o->size, o->size, col);
-                        DrawCubeWires(o->pos, o->size, o->size, o->size, (Color){0,0,0,120});
-                    }
-
-                    Vector3 screenPos = (Vector3){ monPos.x, monPos.y, monPos.z - (monSize.z/2 + 0.001f) };
-                    Vector2 screenSize = (Vector2){ monSize.x * 0.95f, monSize.y * 0.90f };
-
-                    Rectangle srcTerm = {
-                        0, 0,
-                        (float)termRT.texture.width,
-                        (float)-termRT.texture.height
-                    };
-
-                    DrawBillboardRec(camera, termRT.texture, srcTerm, screenPos, screenSize, WHITE);
-                EndMode3D();
+                draw_scene(&scene, &cs.world, camera, 320.0f / 180.0f, term.target.texture);
             EndTextureMode();
+            prof_mark(&prof, PROF_SCENE);
         }
 
         BeginDrawing();
@@ -369,40 +367,34 @@ int main(int argc, char **argv) {
                         (float)GetScreenHeight()
                     },
                     (Vector2){ 0, 0 }, 0, WHITE);
+                prof_mark(&prof, PROF_UPSCALE);
             } else {
-                BeginMode3D(camera);
-                    DrawGrid(20, 1.0f);
-                    DrawCube(deskPos, deskSize.x, deskSize.y, deskSize.z, DARKGRAY);
-
-                    for (int i = 0; i < MAX_OBJS; i++) {
-                        if (!cs.objs[i].alive) continue;
-                        ObjCube* o = &cs.objs[i];
-                        Color col = (Color){ o->r, o->g, o->b, 255 };
-                        DrawCube(o->pos, o->size, o->size, o->size, col);
-                        DrawCubeWires(o->pos, o->size, o->size, o->size, (Color){0,0,0,120});
-                    }
-
-                    Vector3 screenPos = (Vector3){ monPos.x, monPos.y, monPos.z - (monSize.z/2 + 0.001f) };
-                    Vector2 screenSize = (Vector2){ monSize.x * 0.95f, monSize.y * 0.90f };
-
-                    Rectangle srcTerm = {
-                        0, 0,
-                        (float)termRT.texture.width,
-                        (float)-termRT.texture.height
-                    };
+                draw_scene(&scene, &cs.world, camera,
+                           (float)GetScreenWidth() / (float)GetScreenHeight(), term.target.texture);
+                prof_mark(&prof, PROF_SCENE);
+            }
 
-                    DrawBillboardRec(camera, termRT.texture, srcTerm, screenPos, screenSize, WHITE);
-                EndMode3D();
+            if (showProf) {
+                if (prof.frames % 15 == 0) prof_stats(&prof, &profStats);
+                draw_profiler(&profStats);
             }
+            prof_mark(&prof, PROF_OVERLAY);
         EndDrawing();
+
+        NetThreadStats ns;
+        net_thread_stats(cs.net, &ns);
+        prof_frame_end(&prof, ns.linesIn, ns.linesOut, ns.bytesIn, ns.bytesOut);
     }
 
+    prof_csv_close(&prof);
+
     if (!disableLowRes) {
         UnloadRenderTexture(sceneRT);
     }
-    UnloadRenderTexture(termRT);
+    scenerender_free(&scene);
+    termrender_free(&term);
 
-    net_close(&cs.net);
+    net_thread_stop(cs.net);
     net_shutdown();
     CloseWindow();
     return 0;
@@ -0,0 +1,206 @@
+#include "cull.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+static void set_plane(float* p, float nx, float ny, float nz, const float at[3]) {
+    float len = sqrtf(nx*nx + ny*ny + nz*nz);
+    if (len > 0.0f) { nx /= len; ny /= len; nz /= len; }
+    p[0] = nx;
+    p[1] = ny;
+    p[2] = nz;
+    p[3] = -(nx*at[0] + ny*at[1] + nz*at[2]);
+}
+
+void frustum_from_camera(Frustum* f, const float pos[3], const float target[3], const float up[3],
+                         float fovyDeg, float aspect, float znear, float zfar) {
+    // camera basis, same construction as a look-at view matrix
+    float fw[3] = { target[0]-pos[0], target[1]-pos[1], target[2]-pos[2] };
+    float len = sqrtf(fw[0]*fw[0] + fw[1]*fw[1] + fw[2]*fw[2]);
+    if (len <= 0.0f) len = 1.0f;
+    fw[0] /= len; fw[1] /= len; fw[2] /= len;
+
+    float rt[3] = {
+        fw[1]*up[2] - fw[2]*up[1],
+        fw[2]*up[0] - fw[0]*up[2],
+        fw[0]*up[1] - fw[1]*up[0]
+    };
+    len = sqrtf(rt[0]*rt[0] + rt[1]*rt[1] + rt[2]*rt[2]);
+    if (len <= 0.0f) len = 1.0f;
+    rt[0] /= len; rt[1] /= len; rt[2] /= len;
+
+    float uv[3] = {
+        rt[1]*fw[2] - rt[2]*fw[1],
+        rt[2]*fw[0] - rt[0]*fw[2],
+        rt[0]*fw[1] - rt[1]*fw[0]
+    };
+
+    float ty = tanf(fovyDeg * 0.5f * 3.14159265f / 180.0f);
+    float tx = ty * aspect;
+
+    float nearPt[3] = { pos[0] + fw[0]*znear, pos[1] + fw[1]*znear, pos[2] + fw[2]*znear };
+    float farPt[3]  = { pos[0] + fw[0]*zfar,  pos[1] + fw[1]*zfar,  pos[2] + fw[2]*zfar };
+
+    // side planes pass through the eye; n = +-axis + forward * tan(half angle)
+    set_plane(f->planes[0],  rt[0] + fw[0]*tx,  rt[1] + fw[1]*tx,  rt[2] + fw[2]*tx, pos);
+    set_plane(f->planes[1], -rt[0] + fw[0]*tx, -rt[1] + fw[1]*tx, -rt[2] + fw[2]*tx, pos);
+    set_plane(f->planes[2],  uv[0] + fw[0]*ty,  uv[1] + fw[1]*ty,  uv[2] + fw[2]*ty, pos);
+    set_plane(f->planes[3], -uv[0] + fw[0]*ty, -uv[1] + fw[1]*ty, -uv[2] + fw[2]*ty, pos);
+    set_plane(f->planes[4],  fw[0],  fw[1],  fw[2], nearPt);
+    set_plane(f->planes[5], -fw[0], -fw[1], -fw[2], farPt);
+}
+
+int frustum_test_cube(const Frustum* f, const float c[3], float h) {
+    for (int i = 0; i < 6; i++) {
+        const float* p = f->planes[i];
+        // grouped like the SSE path so both give bit-identical results
+        float dist = (p[0]*c[0] + p[1]*c[1]) + (p[2]*c[2] + p[3]);
+        // projected radius of the box onto the plane normal
+        float r = h * (fabsf(p[0]) + fabsf(p[1]) + fabsf(p[2]));
+        if (dist + r < 0.0f) return 0;
+    }
+    return 1;
+}
+
+int cullset_init(CullSet* s, int cap) {
+    s->cx = (float*)malloc((size_t)cap * sizeof(float));
+    s->cy = (float*)malloc((size_t)cap * sizeof(float));
+    s->cz = (float*)malloc((size_t)cap * sizeof(float));
+    s->half = (float*)malloc((size_t)cap * sizeof(float));
+    s->visible = (int*)malloc(((size_t)cap + 4) * sizeof(int));   // +4: SIMD overhang
+    s->count = 0;
+    s->visibleCount = 0;
+    s->cap = cap;
+    if (!s->cx || !s->cy || !s->cz || !s->half || !s->visible) {
+        cullset_free(s);
+        return 0;
+    }
+    return 1;
+}
+
+void cullset_free(CullSet* s) {
+    free(s->cx);
+    free(s->cy);
+    free(s->cz);
+    free(s->half);
+    free(s->visible);
+    s->cx = s->cy = s->cz = s->half = NULL;
+    s->visible = NULL;
+    s->count = 0;
+    s->visibleCount = 0;
+    s->cap = 0;
+}
+
+void cullset_load(CullSet* s, const ObjCube* objs, int n) {
+    if (n > s->cap) n = s->cap;
+    for (int i = 0; i < n; i++) {
+        s->cx[i] = objs[i].x;
+        s->cy[i] = objs[i].y;
+        s->cz[i] = objs[i].z;
+        s->half[i] = objs[i].size * 0.5f;
+    }
+    s->count = n;
+}
+
+// Tests cubes [from, to) one at a time, appending to the visible list.
+static int cull_range_scalar(CullSet* s, int from, int to, const Frustum* f,
+                             const float eye[3], float maxDist) {
+    int vis = s->visibleCount;
+    for (int i = from; i < to; i++) {
+        float c[3] = { s->cx[i], s->cy[i], s->cz[i] };
+        float h = s->half[i];
+        if (maxDist > 0.0f) {
+            float dx = c[0] - eye[0], dy = c[1] - eye[1], dz = c[2] - eye[2];
+            float lim = maxDist + h;
+            if (dx*dx + dy*dy + dz*dz > lim*lim) continue;
+        }
+        if (!frustum_test_cube(f, c, h)) continue;
+        s->visible[vis++] = i;
+    }
+    s->visibleCount = vis;
+    return vis;
+}
+
+int cull_run_scalar(CullSet* s, const Frustum* f, const float eye[3], float maxDist) {
+    s->visibleCount = 0;
+    return cull_range_scalar(s, 0, s->count, f, eye, maxDist);
+}
+
+#ifdef CULL_SSE
+
+// for each 4-bit visibility mask: the visible lanes, packed to the front
+static const int kLanes[16][4] = {
+    {0,0,0,0}, {0,0,0,0}, {1,0,0,0}, {0,1,0,0},
+    {2,0,0,0}, {0,2,0,0}, {1,2,0,0}, {0,1,2,0},
+    {3,0,0,0}, {0,3,0,0}, {1,3,0,0}, {0,1,3,0},
+    {2,3,0,0}, {0,2,3,0}, {1,2,3,0}, {0,1,2,3},
+};
+static const int kLaneCount[16] = { 0,1,1,2, 1,2,2,3, 1,2,2,3, 2,3,3,4 };
+
+int cull_run(CullSet* s, const Frustum* f, const float eye[3], float maxDist) {
+    // per-plane broadcasts, hoisted out of the object loop
+    __m128 pnx[6], pny[6], pnz[6], pd[6], pr[6];
+    for (int p = 0; p < 6; p++) {
+        const float* pl = f->planes[p];
+        pnx[p] = _mm_set1_ps(pl[0]);
+        pny[p] = _mm_set1_ps(pl[1]);
+        pnz[p] = _mm_set1_ps(pl[2]);
+        pd[p]  = _mm_set1_ps(pl[3]);
+        pr[p]  = _mm_set1_ps(fabsf(pl[0]) + fabsf(pl[1]) + fabsf(pl[2]));
+    }
+    __m128 ex = _mm_set1_ps(eye[0]);
+    __m128 ey = _mm_set1_ps(eye[1]);
+    __m128 ez = _mm_set1_ps(eye[2]);
+    __m128 md = _mm_set1_ps(maxDist);
+    int useDist = maxDist > 0.0f;
+
+    int vis = 0;
+    int n4 = s->count & ~3;
+    for (int i = 0; i < n4; i += 4) {
+        __m128 cx = _mm_loadu_ps(s->cx + i);
+        __m128 cy = _mm_loadu_ps(s->cy + i);
+        __m128 cz = _mm_loadu_ps(s->cz + i);
+        __m128 h  = _mm_loadu_ps(s->half + i);
+
+        // lanes set to all-ones once a cube is known to be outside
+        __m128 out = _mm_setzero_ps();
+        if (useDist) {
+            __m128 dx = _mm_sub_ps(cx, ex);
+            __m128 dy = _mm_sub_ps(cy, ey);
+            __m128 dz = _mm_sub_ps(cz, ez);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 lim = _mm_add_ps(md, h);
+            out = _mm_cmpgt_ps(d2, _mm_mul_ps(lim, lim));
+        }
+        for (int p = 0; p < 6; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pnx[p], cx), _mm_mul_ps(pny[p], cy)),
+                                     _mm_add_ps(_mm_mul_ps(pnz[p], cz), pd[p]));
+            __m128 r = _mm_mul_ps(h, pr[p]);
+            // dist < -r  <=>  dist + r < 0
+            out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(dist, r), _mm_setzero_ps()));
+        }
+
+        // branch-free compaction: always store four indices, advance by the
+        // number that were visible (visible[] has slack for the overhang)
+        int keep = ~_mm_movemask_ps(out) & 0xf;
+        __m128i idx = _mm_add_epi32(_mm_set1_epi32(i), _mm_loadu_si128((const __m128i*)kLanes[keep]));
+        _mm_storeu_si128((__m128i*)(s->visible + vis), idx);
+        vis += kLaneCount[keep];
+    }
+
+    s->visibleCount = vis;
+    return cull_range_scalar(s, n4, s->count, f, eye, maxDist);
+}
+
+#else
+
+int cull_run(CullSet* s, const Frustum* f, const float eye[3], float maxDist) {
+    return cull_run_scalar(s, f, eye, maxDist);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CULL_H
+#define CULL_H
+
+// Frustum and distance culling for the client's cubes. The object store is
+// gathered into a structure-of-arrays CullSet so four cubes are tested per
+// plane with one SSE multiply-add chain; the result is a compact list of
+// visible indices for the renderer. No raylib, so it runs headlessly.
+
+#include "world.h"
+
+// Planes face inward: a point p is inside when n.p + d >= 0 for all six.
+typedef struct {
+    float planes[6][4];   // nx, ny, nz, d
+} Frustum;
+
+// Perspective frustum matching a raylib Camera3D (fovy in degrees).
+void frustum_from_camera(Frustum* f, const float pos[3], const float target[3], const float up[3],
+                         float fovyDeg, float aspect, float znear, float zfar);
+
+// 1 if the axis-aligned box centred at c with half extent h may be visible.
+int  frustum_test_cube(const Frustum* f, const float c[3], float h);
+
+typedef struct {
+    // cube centres and half extents, one array per component
+    float* cx;
+    float* cy;
+    float* cz;
+    float* half;
+    int count;
+    int cap;
+
+    int* visible;       // indices into the loaded objects
+    int visibleCount;
+} CullSet;
+
+int  cullset_init(CullSet* s, int cap);
+void cullset_free(CullSet* s);
+
+// Gathers objs[0..n) (clipped to cap) into the arrays.
+void cullset_load(CullSet* s, const ObjCube* objs, int n);
+
+// Fills s->visible with cubes inside f and within maxDist of eye (maxDist
+// <= 0 disables the distance test). Returns the visible count. cull_run
+// uses SSE when the target has it; cull_run_scalar is the reference path.
+int  cull_run(CullSet* s, const Frustum* f, const float eye[3], float maxDist);
+int  cull_run_scalar(CullSet* s, const Frustum* f, const float eye[3], float maxDist);
+
+#endif
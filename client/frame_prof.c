@@ -0,0 +1,111 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "frame_prof.h"
+#include "../common/timing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char* kProfPassNames[PROF_PASS_COUNT] = {
+    "net", "input", "predict", "terminal", "scene", "upscale", "overlay", "present"
+};
+
+void prof_init(FrameProf* p) {
+    memset(p, 0, sizeof(*p));
+}
+
+void prof_frame_begin(FrameProf* p) {
+    p->frameStart = p->markAt = time_now_ns();
+    memset(p->frameNs, 0, sizeof(p->frameNs));
+}
+
+void prof_mark(FrameProf* p, ProfPass pass) {
+    uint64_t now = time_now_ns();
+    p->frameNs[pass] += now - p->markAt;
+    p->markAt = now;
+}
+
+void prof_frame_end(FrameProf* p, uint64_t linesIn, uint64_t linesOut,
+                    uint64_t bytesIn, uint64_t bytesOut) {
+    // anything after the last mark is charged to present
+    prof_mark(p, PROF_PRESENT);
+
+    int slot = p->head;
+    float frameMs = (float)((double)(p->markAt - p->frameStart) * 1e-6);
+    p->frameMs[slot] = frameMs;
+    for (int i = 0; i < PROF_PASS_COUNT; i++) {
+        p->passMs[slot][i] = (float)((double)p->frameNs[i] * 1e-6);
+    }
+
+    // counters only grow, except when a reconnect starts a fresh NetClient
+    uint64_t dIn = linesIn >= p->lastLinesIn ? linesIn - p->lastLinesIn : linesIn;
+    uint64_t dOut = linesOut >= p->lastLinesOut ? linesOut - p->lastLinesOut : linesOut;
+    uint64_t dBytesIn = bytesIn >= p->lastBytesIn ? bytesIn - p->lastBytesIn : bytesIn;
+    uint64_t dBytesOut = bytesOut >= p->lastBytesOut ? bytesOut - p->lastBytesOut : bytesOut;
+    p->msgsIn[slot] = (uint32_t)dIn;
+    p->msgsOut[slot] = (uint32_t)dOut;
+    p->lastLinesIn = linesIn;
+    p->lastLinesOut = linesOut;
+    p->lastBytesIn = bytesIn;
+    p->lastBytesOut = bytesOut;
+
+    if (p->csv) {
+        fprintf(p->csv, "%llu,%.4f", (unsigned long long)p->frames, frameMs);
+        for (int i = 0; i < PROF_PASS_COUNT; i++) fprintf(p->csv, ",%.4f", p->passMs[slot][i]);
+        fprintf(p->csv, ",%llu,%llu,%llu,%llu\n", (unsigned long long)dIn, (unsigned long long)dOut,
+                (unsigned long long)dBytesIn, (unsigned long long)dBytesOut);
+    }
+
+    p->head = (p->head + 1) % PROF_WINDOW;
+    if (p->count < PROF_WINDOW) p->count++;
+    p->frames++;
+}
+
+static int cmp_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+void prof_stats(const FrameProf* p, ProfStats* out) {
+    memset(out, 0, sizeof(*out));
+    int n = p->count;
+    out->frames = n;
+    if (n == 0) return;
+
+    float sorted[PROF_WINDOW];
+    memcpy(sorted, p->frameMs, (size_t)n * sizeof(float));
+    qsort(sorted, (size_t)n, sizeof(float), cmp_float);
+    out->p50 = sorted[n / 2];
+    out->p95 = sorted[(int)(n * 0.95f)];
+    out->p99 = sorted[(int)(n * 0.99f)];
+    out->max = sorted[n - 1];
+
+    uint64_t in = 0, outMsgs = 0;
+    for (int f = 0; f < n; f++) {
+        for (int i = 0; i < PROF_PASS_COUNT; i++) {
+            float ms = p->passMs[f][i];
+            out->passAvg[i] += ms;
+            if (ms > out->passMax[i]) out->passMax[i] = ms;
+        }
+        in += p->msgsIn[f];
+        outMsgs += p->msgsOut[f];
+    }
+    for (int i = 0; i < PROF_PASS_COUNT; i++) out->passAvg[i] /= (float)n;
+    out->msgsInAvg = (float)in / (float)n;
+    out->msgsOutAvg = (float)outMsgs / (float)n;
+}
+
+int prof_csv_open(FrameProf* p, const char* path) {
+    prof_csv_close(p);
+    p->csv = fopen(path, "w");
+    if (!p->csv) return 0;
+    fprintf(p->csv, "frame,frame_ms");
+    for (int i = 0; i < PROF_PASS_COUNT; i++) fprintf(p->csv, ",%s_ms", kProfPassNames[i]);
+    fprintf(p->csv, ",msgs_in,msgs_out,bytes_in,bytes_out\n");
+    return 1;
+}
+
+void prof_csv_close(FrameProf* p) {
+    if (p->csv) fclose(p->csv);
+    p->csv = NULL;
+}
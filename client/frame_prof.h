@@ -0,0 +1,75 @@
+#ifndef FRAME_PROF_H
+#define FRAME_PROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// CPU-side per-pass frame timer. A frame is split into consecutive passes:
+// prof_mark() charges the time since the previous mark to one pass, so the
+// passes always add up to the frame. Cost is one clock read per mark, cheap
+// enough to leave on in release builds. Pure C, no raylib.
+//
+// Times are CPU submission times; GPU work that the driver defers shows up
+// wherever the CPU ends up waiting for it (usually PROF_PRESENT).
+
+typedef enum {
+    PROF_NET,        // draining the network thread, applying server lines
+    PROF_INPUT,      // keyboard/mouse, terminal typing
+    PROF_PREDICT,    // movement prediction, INPUT send, camera
+    PROF_TERMINAL,   // terminal render texture
+    PROF_SCENE,      // 3D scene (low-res target or direct)
+    PROF_UPSCALE,    // low-res target -> window
+    PROF_OVERLAY,    // this profiler's own overlay
+    PROF_PRESENT,    // EndDrawing: swap, frame limiter, driver waits
+    PROF_PASS_COUNT
+} ProfPass;
+
+#define PROF_WINDOW 256   // frames kept for percentiles
+
+typedef struct {
+    uint64_t frameStart;
+    uint64_t markAt;
+    uint64_t frameNs[PROF_PASS_COUNT];   // current frame, per pass
+
+    // rolling window of finished frames
+    float    frameMs[PROF_WINDOW];
+    float    passMs[PROF_WINDOW][PROF_PASS_COUNT];
+    uint32_t msgsIn[PROF_WINDOW];
+    uint32_t msgsOut[PROF_WINDOW];
+    int      head;
+    int      count;
+    uint64_t frames;
+
+    // net counter values at the end of the previous frame
+    uint64_t lastLinesIn, lastLinesOut;
+    uint64_t lastBytesIn, lastBytesOut;
+
+    FILE*    csv;
+} FrameProf;
+
+typedef struct {
+    int   frames;
+    float p50, p95, p99, max;        // frame ms
+    float passAvg[PROF_PASS_COUNT];  // ms
+    float passMax[PROF_PASS_COUNT];
+    float msgsInAvg, msgsOutAvg;     // per frame
+} ProfStats;
+
+extern const char* kProfPassNames[PROF_PASS_COUNT];
+
+void prof_init(FrameProf* p);
+void prof_frame_begin(FrameProf* p);
+void prof_mark(FrameProf* p, ProfPass pass);
+
+// Closes the frame; the net counters are the NetClient totals, which are
+// turned into per-frame deltas.
+void prof_frame_end(FrameProf* p, uint64_t linesIn, uint64_t linesOut,
+                    uint64_t bytesIn, uint64_t bytesOut);
+
+void prof_stats(const FrameProf* p, ProfStats* out);
+
+// One CSV row per frame from now on. Returns 0 if the file can't be opened.
+int  prof_csv_open(FrameProf* p, const char* path);
+void prof_csv_close(FrameProf* p);
+
+#endif
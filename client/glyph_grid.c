@@ -0,0 +1,117 @@
+#include "glyph_grid.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int glyphgrid_init(GlyphGrid* g, int cols, int rows, float originX, float originY,
+                   float cellW, float cellH, float pitchY, int atlasCols) {
+    memset(g, 0, sizeof(*g));
+    g->cols = cols;
+    g->rows = rows;
+    g->originX = originX;
+    g->originY = originY;
+    g->cellW = cellW;
+    g->cellH = cellH;
+    g->pitchY = pitchY;
+    g->atlasCols = atlasCols;
+
+    int aw = 0, ah = 0;
+    glyphgrid_atlas_size(g, &aw, &ah);
+    g->atlasW = (float)aw;
+    g->atlasH = (float)ah;
+
+    size_t cells = (size_t)cols * (size_t)rows;
+    g->text = (char*)calloc(cells, 1);
+    g->verts = (GlyphVertex*)calloc(cells * 4, sizeof(GlyphVertex));
+    g->rowQuads = (int*)calloc((size_t)rows, sizeof(int));
+    g->rowDirty = (unsigned char*)calloc((size_t)rows, 1);
+    if (!g->text || !g->verts || !g->rowQuads || !g->rowDirty) {
+        glyphgrid_free(g);
+        return 0;
+    }
+    return 1;
+}
+
+void glyphgrid_free(GlyphGrid* g) {
+    free(g->text);
+    free(g->verts);
+    free(g->rowQuads);
+    free(g->rowDirty);
+    g->text = NULL;
+    g->verts = NULL;
+    g->rowQuads = NULL;
+    g->rowDirty = NULL;
+}
+
+void glyphgrid_atlas_size(const GlyphGrid* g, int* w, int* h) {
+    int atlasRows = (GLYPH_COUNT + g->atlasCols - 1) / g->atlasCols;
+    *w = (int)g->cellW * g->atlasCols;
+    *h = (int)g->cellH * atlasRows;
+}
+
+int glyphgrid_set_row(GlyphGrid* g, int row, const char* a, const char* b) {
+    if (row < 0 || row >= g->rows) return 0;
+    char* dst = g->text + (size_t)row * (size_t)g->cols;
+
+    // compare while copying; stop writing once we know nothing changed
+    int changed = 0;
+    int n = 0;
+    for (const char* p = a; p && *p && n < g->cols; p++, n++) {
+        if (dst[n] != *p) { dst[n] = *p; changed = 1; }
+    }
+    for (const char* p = b; p && *p && n < g->cols; p++, n++) {
+        if (dst[n] != *p) { dst[n] = *p; changed = 1; }
+    }
+    for (; n < g->cols; n++) {
+        if (dst[n]) { dst[n] = 0; changed = 1; }
+    }
+
+    if (changed) g->rowDirty[row] = 1;
+    return changed;
+}
+
+int glyphgrid_build(GlyphGrid* g) {
+    float du = g->cellW / g->atlasW;
+    float dv = g->cellH / g->atlasH;
+    int rebuilt = 0;
+
+    for (int r = 0; r < g->rows; r++) {
+        if (!g->rowDirty[r]) continue;
+        g->rowDirty[r] = 0;
+        rebuilt++;
+
+        const char* text = g->text + (size_t)r * (size_t)g->cols;
+        GlyphVertex* v = g->verts + (size_t)r * (size_t)g->cols * 4;
+        float y0 = g->originY + g->pitchY * (float)r;
+        float y1 = y0 + g->cellH;
+        int quads = 0;
+
+        for (int c = 0; c < g->cols && text[c]; c++) {
+            int ch = (unsigned char)text[c];
+            if (ch == ' ') continue;
+            if (ch < GLYPH_FIRST || ch > GLYPH_LAST) ch = '?';
+
+            int idx = ch - GLYPH_FIRST;
+            float u0 = (float)(idx % g->atlasCols) * du;
+            float v0 = (float)(idx / g->atlasCols) * dv;
+            float x0 = g->originX + g->cellW * (float)c;
+            float x1 = x0 + g->cellW;
+
+            // top-left, bottom-left, bottom-right, top-right
+            v[0].x = x0; v[0].y = y0; v[0].u = u0;      v[0].v = v0;
+            v[1].x = x0; v[1].y = y1; v[1].u = u0;      v[1].v = v0 + dv;
+            v[2].x = x1; v[2].y = y1; v[2].u = u0 + du; v[2].v = v0 + dv;
+            v[3].x = x1; v[3].y = y0; v[3].u = u0 + du; v[3].v = v0;
+            v += 4;
+            quads++;
+        }
+        g->rowQuads[r] = quads;
+    }
+    return rebuilt;
+}
+
+int glyphgrid_quad_count(const GlyphGrid* g) {
+    int n = 0;
+    for (int r = 0; r < g->rows; r++) n += g->rowQuads[r];
+    return n;
+}
@@ -0,0 +1,53 @@
+#ifndef GLYPH_GRID_H
+#define GLYPH_GRID_H
+
+// Monospace text screen as a quad list over a pre-baked glyph atlas. Pure C,
+// no raylib: the caller bakes the atlas and submits the quads with one
+// texture bound, so a whole screen of text is a single draw.
+//
+// Rows are compared on update; only rows whose text changed get their quads
+// rebuilt. Spaces produce no quad.
+
+#define GLYPH_FIRST 32
+#define GLYPH_LAST  126
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+
+typedef struct {
+    float x, y;   // screen position
+    float u, v;   // atlas texcoord
+} GlyphVertex;
+
+typedef struct {
+    int cols, rows;
+    float originX, originY;
+    float cellW, cellH;     // glyph quad size
+    float pitchY;           // distance between rows
+
+    // atlas: cells of cellW x cellH laid out atlasCols per row, top-down
+    int   atlasCols;
+    float atlasW, atlasH;
+
+    char*          text;       // rows * cols, NUL-padded
+    GlyphVertex*   verts;      // rows * cols * 4, row r starts at r * cols * 4
+    int*           rowQuads;   // quads in use per row
+    unsigned char* rowDirty;
+} GlyphGrid;
+
+int  glyphgrid_init(GlyphGrid* g, int cols, int rows, float originX, float originY,
+                    float cellW, float cellH, float pitchY, int atlasCols);
+void glyphgrid_free(GlyphGrid* g);
+
+// Pixel size of the atlas the caller must bake: GLYPH_COUNT cells of
+// cellW x cellH, atlasCols per row, glyph GLYPH_FIRST + i at cell i.
+void glyphgrid_atlas_size(const GlyphGrid* g, int* w, int* h);
+
+// Sets row text to a followed by b (b may be NULL), clipped to cols. Marks
+// the row dirty only if its text actually changed. Returns 1 if it did.
+int  glyphgrid_set_row(GlyphGrid* g, int row, const char* a, const char* b);
+
+// Rebuilds quads for dirty rows. Returns the number of rows rebuilt.
+int  glyphgrid_build(GlyphGrid* g);
+
+int  glyphgrid_quad_count(const GlyphGrid* g);
+
+#endif
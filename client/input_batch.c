@@ -0,0 +1,102 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "input_batch.h"
+#include "../common/numcodec.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void inputbatch_init(InputBatch* b, float rateHz) {
+    memset(b, 0, sizeof(*b));
+    if (rateHz <= 0.0f) rateHz = 30.0f;
+    b->interval = 1.0 / rateHz;
+}
+
+static int moving(const InputSample* s) {
+    return s->fwd != 0.0f || s->right != 0.0f || s->up != 0.0f;
+}
+
+static int looking(const InputSample* s) {
+    return s->yawDelta != 0.0f || s->pitchDelta != 0.0f;
+}
+
+void inputbatch_add(InputBatch* b, const InputSample* s) {
+    b->frames++;
+
+    // nothing pressed, nothing turned: the server step would be a no-op
+    if (!moving(s) && !looking(s)) {
+        b->idle++;
+        return;
+    }
+
+    if (b->count > 0) {
+        InputSample* last = &b->s[b->count - 1];
+        // same keys held and no turning in either: movement along a fixed
+        // heading is linear in dt, so one longer step is equivalent
+        if (!looking(s) && !looking(last) && s->fwd == last->fwd &&
+            s->right == last->right && s->up == last->up) {
+            last->dt += s->dt;
+            b->merged++;
+            return;
+        }
+        // pure mouse look: the deltas add (the server clamps pitch once
+        // per step, so this differs only while pinned at the limit)
+        if (!moving(s) && !moving(last)) {
+            last->yawDelta += s->yawDelta;
+            last->pitchDelta += s->pitchDelta;
+            last->dt += s->dt;
+            b->merged++;
+            return;
+        }
+    }
+
+    if (b->count == PROTO_INPUT_MAX_SAMPLES) {
+        // full (only if flush was not called since): fold the look into the
+        // last sample rather than drop it
+        InputSample* last = &b->s[b->count - 1];
+        last->yawDelta += s->yawDelta;
+        last->pitchDelta += s->pitchDelta;
+        last->dt += s->dt;
+        b->merged++;
+        return;
+    }
+    b->s[b->count++] = *s;
+}
+
+int inputbatch_flush(InputBatch* b, double now, char* buf, int cap) {
+    if (now < b->nextSend && b->count < PROTO_INPUT_MAX_SAMPLES) return 0;
+    if (b->count == 0) return 0;
+
+    // keep a steady cadence, but don't burst to catch up after a stall
+    b->nextSend += b->interval;
+    if (b->nextSend < now) b->nextSend = now + b->interval;
+
+    // " %.3f %.3f %.3f %.6f %.6f %.6f" per sample, through numcodec
+    int n = snprintf(buf, (size_t)cap, "INPUT");
+    for (int i = 0; i < b->count && n < cap; i++) {
+        const InputSample* s = &b->s[i];
+        const float v[6] = { s->fwd, s->right, s->up, s->yawDelta, s->pitchDelta, s->dt };
+        for (int k = 0; k < 6 && n < cap; k++) {
+            char field[NUM_FORMAT_MAX];
+            int len = num_format_float(field, v[k], k < 3 ? 3 : 6);
+            if (n + 1 + len >= cap) {
+                n = cap;
+                break;
+            }
+            buf[n++] = ' ';
+            memcpy(buf + n, field, (size_t)len);
+            n += len;
+        }
+    }
+    if (n + 1 >= cap) {
+        // cap is sized for PROTO_INPUT_MAX_SAMPLES; treat overflow as a bug
+        b->count = 0;
+        return 0;
+    }
+    buf[n++] = '\n';
+    buf[n] = '\0';
+
+    b->count = 0;
+    b->messages++;
+    return n;
+}
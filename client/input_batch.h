@@ -0,0 +1,40 @@
+#ifndef INPUT_BATCH_H
+#define INPUT_BATCH_H
+
+#include <stdint.h>
+#include "../common/protocol.h"
+
+// Collects per-frame input samples and sends them as one INPUT message at a
+// fixed command rate instead of every frame. Frames with no input are not
+// recorded at all, and adjacent samples merge where the server simulation
+// gives the same result. No raylib, so it can be driven headlessly.
+
+typedef struct {
+    float fwd, right, up;
+    float yawDelta, pitchDelta;
+    float dt;
+} InputSample;
+
+typedef struct {
+    InputSample s[PROTO_INPUT_MAX_SAMPLES];
+    int count;
+
+    double interval;     // seconds between messages
+    double nextSend;
+
+    // lifetime counters
+    uint64_t frames;     // samples offered
+    uint64_t idle;       // dropped as zero-input
+    uint64_t merged;     // folded into the previous sample
+    uint64_t messages;
+} InputBatch;
+
+void inputbatch_init(InputBatch* b, float rateHz);
+void inputbatch_add(InputBatch* b, const InputSample* s);
+
+// Formats the pending samples as one INPUT line into buf and clears them if
+// a message is due at time now (or the batch is full). Returns the line
+// length, or 0 if nothing should be sent yet.
+int  inputbatch_flush(InputBatch* b, double now, char* buf, int cap);
+
+#endif
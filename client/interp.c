@@ -0,0 +1,179 @@
+#include "interp.h"
+
+#include <math.h>
+#include <string.h>
+
+#define PI_F 3.14159265f
+
+// Smoothing for the clock estimate, per snapshot.
+#define OFFSET_GAIN   0.05
+#define JITTER_GAIN   0.1
+#define INTERVAL_GAIN 0.1
+
+// Render time follows its target by stretching or squeezing playback by at
+// most this fraction of real time, so corrections never look like a jump.
+#define DELAY_SLEW    0.1
+
+void interp_init(Interp* in) {
+    memset(in, 0, sizeof(*in));
+}
+
+static RemoteEnt* find_ent(Interp* in, int id) {
+    for (int i = 0; i < in->count; i++) {
+        if (in->ents[i].id == id) return &in->ents[i];
+    }
+    return NULL;
+}
+
+// Drops entities the last snapshot did not mention.
+static void finish_snapshot(Interp* in) {
+    for (int i = 0; i < in->count; ) {
+        if (!in->ents[i].seen) {
+            in->ents[i] = in->ents[--in->count];
+            continue;
+        }
+        in->ents[i].seen = 0;
+        i++;
+    }
+    in->pending = 0;
+}
+
+static double clampd(double v, double lo, double hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void update_clock(Interp* in, double serverTime, double localNow) {
+    double sample = serverTime - localNow;
+
+    if (!in->synced) {
+        in->synced = 1;
+        in->offset = sample;
+        in->jitter = 0.0;
+        in->interval = 0.05;
+        in->delay = in->targetDelay = in->interval + INTERP_MIN_DELAY;
+        in->lastUpdate = localNow;
+        in->renderTime = serverTime - in->delay;
+        in->lastSnap = serverTime;
+        return;
+    }
+
+    double dt = serverTime - in->lastSnap;
+    if (dt > 0.0) in->interval += (dt - in->interval) * INTERVAL_GAIN;
+    in->lastSnap = serverTime;
+
+    // both clocks run at the same rate, so the sample only moves by the
+    // network delay; its spread around the mean is the jitter to absorb
+    double dev = sample - in->offset;
+    in->jitter += (fabs(dev) - in->jitter) * JITTER_GAIN;
+    in->offset += dev * OFFSET_GAIN;
+
+    // the next snapshot is due one interval later and may arrive late by
+    // about twice the mean deviation; stay far enough back to have it
+    in->targetDelay = clampd(in->interval + 2.0 * in->jitter, INTERP_MIN_DELAY, INTERP_MAX_DELAY);
+}
+
+void interp_begin(Interp* in, double serverTime, int n, double localNow) {
+    if (in->pending > 0) finish_snapshot(in);   // previous one was cut short
+
+    if (in->synced && serverTime < in->lastSnap) interp_init(in);
+
+    update_clock(in, serverTime, localNow);
+    in->snapTime = serverTime;
+    in->snapshots++;
+    in->pending = n > 0 ? n : 0;
+    if (in->pending == 0) finish_snapshot(in);
+}
+
+void interp_ent(Interp* in, int id, float x, float y, float z, float yaw) {
+    if (in->pending <= 0) return;
+
+    RemoteEnt* e = find_ent(in, id);
+    if (!e && in->count < INTERP_MAX_ENTS) {
+        e = &in->ents[in->count++];
+        memset(e, 0, sizeof(*e));
+        e->id = id;
+        e->x = x; e->y = y; e->z = z; e->yaw = yaw;
+    }
+    if (e) {
+        e->head = (e->head + 1) & (INTERP_HISTORY - 1);
+        if (e->count < INTERP_HISTORY) e->count++;
+        InterpSample* s = &e->hist[e->head];
+        s->t = in->snapTime;
+        s->x = x; s->y = y; s->z = z; s->yaw = yaw;
+        e->seen = 1;
+    }
+
+    if (--in->pending == 0) finish_snapshot(in);
+}
+
+// The i-th newest sample; 0 is the newest.
+static const InterpSample* ent_sample(const RemoteEnt* e, int i) {
+    return &e->hist[(e->head - i) & (INTERP_HISTORY - 1)];
+}
+
+static float lerp_angle(float a, float b, float f) {
+    float d = b - a;
+    while (d > PI_F) d -= 2.0f * PI_F;
+    while (d < -PI_F) d += 2.0f * PI_F;
+    return a + d * f;
+}
+
+static void set_between(RemoteEnt* e, const InterpSample* a, const InterpSample* b, double t) {
+    double span = b->t - a->t;
+    float f = span > 0.0 ? (float)((t - a->t) / span) : 1.0f;
+    e->x = a->x + (b->x - a->x) * f;
+    e->y = a->y + (b->y - a->y) * f;
+    e->z = a->z + (b->z - a->z) * f;
+    e->yaw = lerp_angle(a->yaw, b->yaw, f);
+}
+
+// Returns 1 if t lies past the newest sample (the entity is extrapolated).
+static int sample_ent(RemoteEnt* e, double t) {
+    if (e->count == 0) return 0;
+    const InterpSample* newest = ent_sample(e, 0);
+
+    if (t >= newest->t) {
+        if (e->count < 2 || t == newest->t) {
+            set_between(e, newest, newest, t);
+            return t > newest->t;
+        }
+        // carry on along the last segment for a short while, then hold
+        double ahead = t - newest->t;
+        if (ahead > INTERP_MAX_EXTRAPOLATE) ahead = INTERP_MAX_EXTRAPOLATE;
+        set_between(e, ent_sample(e, 1), newest, newest->t + ahead);
+        return 1;
+    }
+
+    for (int i = 1; i < e->count; i++) {
+        const InterpSample* a = ent_sample(e, i);
+        if (a->t <= t) {
+            set_between(e, a, ent_sample(e, i - 1), t);
+            return 0;
+        }
+    }
+    // older than anything kept, e.g. an entity that just appeared
+    const InterpSample* oldest = ent_sample(e, e->count - 1);
+    set_between(e, oldest, oldest, t);
+    return 0;
+}
+
+void interp_update(Interp* in, double localNow) {
+    if (!in->synced) return;
+
+    double dt = clampd(localNow - in->lastUpdate, 0.0, 0.25);
+    in->lastUpdate = localNow;
+
+    // advance at real time, then steer toward the target by at most
+    // DELAY_SLEW of it; only a large error (first sync) is taken at once
+    double target = localNow + in->offset - in->targetDelay;
+    double t = in->renderTime + dt;
+    double err = target - t;
+    if (fabs(err) > INTERP_MAX_DELAY) t = target;
+    else t += clampd(err, -dt * DELAY_SLEW, dt * DELAY_SLEW);
+    in->renderTime = t;
+    in->delay = localNow + in->offset - t;
+
+    for (int i = 0; i < in->count; i++) {
+        if (sample_ent(&in->ents[i], in->renderTime)) in->extrapolated++;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdint.h>
+
+// Snapshot interpolation for remote players. The server sends their
+// positions at a fixed rate, each snapshot stamped with server time; this
+// keeps a short history per entity and draws them a little in the past, at
+// a render time that trails the estimated server clock by about one
+// snapshot interval plus the measured arrival jitter. Motion between
+// snapshots is a straight lerp, so it stays smooth at 10-20 Hz.
+// Pure data, no raylib.
+
+#define INTERP_MAX_ENTS  64
+#define INTERP_HISTORY   16      // samples per entity, power of two
+
+#define INTERP_MIN_DELAY        0.02   // seconds behind the server clock
+#define INTERP_MAX_DELAY        0.5
+#define INTERP_MAX_EXTRAPOLATE  0.1    // past the newest sample, then hold
+
+typedef struct {
+    double t;              // server time, seconds
+    float x, y, z, yaw;
+} InterpSample;
+
+typedef struct {
+    int id;
+    int seen;              // present in the snapshot being received
+    int head, count;       // ring of the newest INTERP_HISTORY samples
+    InterpSample hist[INTERP_HISTORY];
+
+    float x, y, z, yaw;    // sampled at the current render time
+} RemoteEnt;
+
+typedef struct {
+    // packed in ents[0..count); entities missing from a snapshot are removed
+    RemoteEnt ents[INTERP_MAX_ENTS];
+    int count;
+
+    // snapshot being received
+    int pending;           // ENT lines still expected
+    double snapTime;
+
+    // clock estimate and buffer depth, all in seconds
+    int synced;
+    double lastSnap;       // server time of the newest snapshot
+    double offset;         // server minus local clock, averaged
+    double jitter;         // mean deviation of arrivals from offset
+    double interval;       // mean server time between snapshots
+    double delay;          // current distance behind the server clock
+    double targetDelay;
+    double lastUpdate;     // local time of the previous interp_update
+    double renderTime;     // server time being drawn
+
+    uint64_t snapshots;
+    uint64_t extrapolated; // entity samples drawn past their newest data
+} Interp;
+
+void interp_init(Interp* in);
+
+// Starts a snapshot of n entities taken at serverTime and received at local
+// time localNow; n interp_ent calls follow. A snapshot older than the last
+// one (server restart) resets the clock and history.
+void interp_begin(Interp* in, double serverTime, int n, double localNow);
+void interp_ent(Interp* in, int id, float x, float y, float z, float yaw);
+
+// Once per frame: advances the render time and samples every entity.
+void interp_update(Interp* in, double localNow);
+
+#endif
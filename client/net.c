@@ -3,6 +3,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "net.h"
+#include "../common/timing.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -18,6 +19,8 @@
   #include <arpa/inet.h>
   #include <sys/socket.h>
   #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/select.h>
   #define INVALID_SOCKET (-1)
   #define SOCKET_ERROR (-1)
   #define closesocket close
@@ -48,8 +51,20 @@ void net_shutdown(void) {
 #endif
 }
 
+static void sim_open(NetClient* c);
+static void sim_close(NetClient* c);
+static int  shm_handshake(NetClient* c);
+static void shm_close(NetClient* c);
+
 int net_connect(NetClient* c, const char* host, uint16_t port) {
-    memset(c, 0, sizeof(*c));
+    // counters, the receive buffer and its limits carry across reconnects;
+    // only the connection state starts over
+    c->connected = 0;
+    c->rxLen = 0;
+    c->skipping = 0;
+    c->chan = NULL;
+    c->sim = NULL;
+    c->shm = NULL;
     c->s = socket(AF_INET, SOCK_STREAM, 0);
     if (c->s == INVALID_SOCKET) return 0;
 
@@ -74,16 +89,166 @@ int net_connect(NetClient* c, const char* host, uint16_t port) {
         return 0;
     }
 
+    // INPUT lines are tiny and latency-bound; don't let Nagle batch them
+    int one = 1;
+    setsockopt(c->s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+    if (!shm_handshake(c)) {
+        closesocket(c->s);
+        c->s = INVALID_SOCKET;
+        return 0;
+    }
+
     set_nonblocking(c->s);
     c->connected = 1;
+    if (!c->shm) sim_open(c);
     return 1;
 }
 
+static void udp_close(NetClient* c) {
+    if (!c->chan) return;
+    closesocket(c->u);
+    free(c->chan);
+    c->chan = NULL;
+}
+
 void net_close(NetClient* c) {
     if (c->connected) {
         closesocket(c->s);
         c->connected = 0;
     }
+    udp_close(c);
+    sim_close(c);
+    shm_close(c);
+    free(c->rx);
+    c->rx = NULL;
+    c->rxLen = 0;
+    c->rxCap = 0;
+}
+
+void net_set_rx_limit(NetClient* c, int maxBytes, NetOverflowPolicy policy) {
+    c->rxMax = maxBytes > 0 ? maxBytes : 0;
+    c->overflow = policy;
+}
+
+// Blocks until s is readable (or writable) or timeoutMs passes.
+static int wait_socket(net_socket_t s, int forWrite, int timeoutMs) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(s, &set);
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    int r = forWrite ? select((int)s + 1, NULL, &set, NULL, &tv)
+                     : select((int)s + 1, &set, NULL, NULL, &tv);
+    return r > 0;
+}
+
+static int would_block(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+// Writes all of data to the TCP socket, waiting up to NET_SEND_WAIT_MS
+// whenever its send buffer is full.
+static int send_stream(NetClient* c, const char* data, int len) {
+    int sent = 0;
+    while (sent < len) {
+        int r = send(c->s, data + sent, len - sent, 0);
+        if (r > 0) {
+            sent += r;
+            continue;
+        }
+        // the socket is non-blocking; a full send buffer is not an error
+        if (r < 0 && would_block() && wait_socket(c->s, 1, NET_SEND_WAIT_MS)) continue;
+        return 0;
+    }
+    return 1;
+}
+
+// -------------------- simulated link --------------------
+
+static NetSimConfig g_simCfg;
+
+void net_set_sim(const NetSimConfig* cfg) {
+    g_simCfg = *cfg;
+}
+
+static void sim_open(NetClient* c) {
+    // every connection draws its own loss/jitter sequence
+    c->sim = netsim_pipes_open(&g_simCfg, (uint32_t)time_now_ns() ^ (uint32_t)(uintptr_t)c);
+}
+
+static void sim_close(NetClient* c) {
+    netsim_pipes_close(c->sim);
+    c->sim = NULL;
+}
+
+// Sends the TCP bytes the link has delivered by now. 0 if the socket failed.
+static int sim_pump_tcp(NetClient* c) {
+    char buf[4096];
+    double now = time_now();
+    int n;
+    while ((n = netsim_pop(&c->sim->tcpOut, now, buf, (int)sizeof(buf))) > 0) {
+        if (!send_stream(c, buf, n)) return 0;
+    }
+    return 1;
+}
+
+static void sim_pump_udp(NetClient* c) {
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    double now = time_now();
+    int n;
+    while ((n = netsim_pop(&c->sim->udpOut, now, pkt, (int)sizeof(pkt))) > 0) {
+        send(c->u, (const char*)pkt, n, 0);
+    }
+}
+
+static void udp_flush(NetClient* c);
+
+int net_send(NetClient* c, const char* data, int len) {
+    if (!c->connected) return 0;
+    if (c->shm) {
+        // a full ring waits for the server like a full send buffer
+        double giveUp = time_now() + NET_SEND_WAIT_MS / 1000.0;
+        while (!shmlink_send(c->shm, data, len)) {
+            if (time_now() >= giveUp) return 0;
+            time_sleep_ms(1);
+        }
+        if (shmlink_wake_needed(c->shm)) send(c->s, "\n", 1, 0);
+        c->bytesOut += (uint64_t)len;
+        c->linesOut++;
+        return 1;
+    }
+    if (c->chan) {
+        int lane = -1;
+        if (len > 6 && memcmp(data, "INPUT ", 6) == 0) lane = NETCHAN_LANE_INPUT;
+        else if (len > 4 && memcmp(data, "CMD ", 4) == 0) lane = NETCHAN_RELIABLE;
+        if (lane >= 0) {
+            if (!netchan_queue(c->chan, lane, data, len)) return 0;
+            c->linesOut++;
+            udp_flush(c);
+            return 1;
+        }
+    }
+    if (c->sim) {
+        // a full link waits for room like a full send buffer
+        double giveUp = time_now() + NET_SEND_WAIT_MS / 1000.0;
+        while (!netsim_push(&c->sim->tcpOut, data, len, time_now())) {
+            if (!sim_pump_tcp(c) || time_now() >= giveUp) return 0;
+            time_sleep_ms(1);
+        }
+        c->bytesOut += (uint64_t)len;
+        c->linesOut++;
+        return sim_pump_tcp(c);
+    }
+    if (!send_stream(c, data, len)) return 0;
+    c->bytesOut += (uint64_t)len;
+    c->linesOut++;
+    return 1;
 }
 
 int net_sendf(NetClient* c, const char* fmt, ...) {
@@ -93,64 +258,409 @@ int net_sendf(NetClient* c, const char* fmt, ...) {
     va_start(ap, fmt);
     vsnprintf(buf, sizeof(buf), fmt, ap);
     va_end(ap);
+    return net_send(c, buf, (int)strlen(buf));
+}
 
-    int len = (int)strlen(buf);
-    int sent = 0;
-    while (sent < len) {
-        int r = send(c->s, buf + sent, len - sent, 0);
-        if (r <= 0) return 0;
-        sent += r;
+// Readability on up to three sockets; INVALID_SOCKET entries are skipped.
+static int wait_any(net_socket_t a, net_socket_t b, net_socket_t w, int timeoutMs) {
+    net_socket_t s[3] = { a, b, w };
+    net_socket_t top = 0;
+    fd_set set;
+    FD_ZERO(&set);
+    for (int i = 0; i < 3; i++) {
+        if (s[i] == INVALID_SOCKET) continue;
+        FD_SET(s[i], &set);
+        if (s[i] > top) top = s[i];
+    }
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    return select((int)top + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+int net_wait_readable_wake(NetClient* c, net_socket_t wake, int timeoutMs) {
+    if (!c->connected) return 0;
+    if (c->shm) {
+        // the server pokes the socket only while our sleep flag is up
+        if (!shmlink_sleep_begin(c->shm)) return 1;
+        int r = wait_any(c->s, wake, INVALID_SOCKET, timeoutMs);
+        shmlink_sleep_end(c->shm);
+        return r || spsc_pending(&c->shm->in);
+    }
+    double due;
+    if (c->sim && netsim_pipes_next_due(c->sim, &due)) {
+        // wake when the simulated link hands over its next chunk
+        int ms = (int)((due - time_now()) * 1000.0) + 1;
+        if (ms <= 1) return 1;
+        if (ms < timeoutMs) timeoutMs = ms;
+    }
+    if (!c->chan) return wait_any(c->s, wake, INVALID_SOCKET, timeoutMs);
+
+    if (timeoutMs > NET_CHAN_TICK_MS) timeoutMs = NET_CHAN_TICK_MS;
+    return wait_any(c->s, c->u, wake, timeoutMs);
+}
+
+int net_wait_readable(NetClient* c, int timeoutMs) {
+    return net_wait_readable_wake(c, INVALID_SOCKET, timeoutMs);
+}
+
+int net_wake_open(net_socket_t* out) {
+    net_socket_t w = socket(AF_INET, SOCK_DGRAM, 0);
+    if (w == INVALID_SOCKET) return 0;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t alen = sizeof(addr);
+    if (bind(w, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(w, (struct sockaddr*)&addr, &alen) == SOCKET_ERROR ||
+        connect(w, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(w);
+        return 0;
     }
+    set_nonblocking(w);
+    *out = w;
     return 1;
 }
 
-static char g_accum[4096];
-static int  g_accumLen = 0;
+void net_wake_poke(net_socket_t w) {
+    char b = 0;
+    send(w, &b, 1, 0);   // a full buffer already means a wakeup is pending
+}
 
-int net_poll_lines(NetClient* c, void (*on_line)(const char*, void*), void* userdata) {
-    if (!c->connected) return 0;
+void net_wake_drain(net_socket_t w) {
+    char buf[64];
+    while (recv(w, buf, sizeof(buf), 0) > 0) {}
+}
+
+void net_wake_close(net_socket_t w) {
+    closesocket(w);
+}
+
+int net_split_lines(char* buf, int len, int* consumed,
+                    void (*on_line)(const char*, void*), void* userdata) {
+    int start = 0, lines = 0;
+    for (;;) {
+        char* nl = (char*)memchr(buf + start, '\n', (size_t)(len - start));
+        if (!nl) break;
+        int end = (int)(nl - buf);
+        // terminate in place; the callback reads straight from buf
+        if (end > start && buf[end - 1] == '\r') buf[end - 1] = '\0';
+        *nl = '\0';
+        on_line(buf + start, userdata);
+        lines++;
+        start = end + 1;
+    }
+    *consumed = start;
+    return lines;
+}
+
+// Makes room for at least one more recv. Returns 0 if the buffer is at its
+// cap and full, i.e. the pending partial line is longer than rxMax.
+static int rx_reserve(NetClient* c) {
+    int max = c->rxMax > 0 ? c->rxMax : NET_RX_MAX_DEFAULT;
+    if (c->rxLen < c->rxCap && (c->rxCap - c->rxLen >= NET_RX_INITIAL || c->rxCap >= max)) return 1;
+    if (c->rxCap >= max) return 0;
+
+    int cap = c->rxCap ? c->rxCap : NET_RX_INITIAL;
+    while (cap - c->rxLen < NET_RX_INITIAL && cap < max) cap *= 2;
+    if (cap > max) cap = max;
+    char* rx = (char*)realloc(c->rx, (size_t)cap);
+    if (!rx) return c->rxLen < c->rxCap;
+    c->rx = rx;
+    c->rxCap = cap;
+    return 1;
+}
+
+static void drop_connection(NetClient* c) {
+    closesocket(c->s);
+    c->connected = 0;
+    c->rxLen = 0;
+    udp_close(c);
+    sim_close(c);
+    shm_close(c);
+}
+
+// -------------------- UDP channel --------------------
+
+static void udp_flush(NetClient* c) {
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    int n;
+    double now = time_now();
+    while ((n = netchan_flush(c->chan, now, pkt)) > 0) {
+        if (c->sim) {
+            netsim_push(&c->sim->udpOut, pkt, n, now);
+            c->bytesOut += (uint64_t)n;
+        } else if (send(c->u, (const char*)pkt, n, 0) == n) {
+            c->bytesOut += (uint64_t)n;
+        }
+    }
+    if (c->sim) sim_pump_udp(c);
+}
+
+// "UDP <port> <token>": a datagram socket to the same host, connected so
+// plain send/recv work. The first flush sends a keepalive, which is what
+// tells the server where we are.
+static void udp_open(NetClient* c, const char* args) {
+    if (c->chan) return;
+    unsigned port = 0, token = 0;
+    if (sscanf(args, "%u %x", &port, &token) != 2 || port == 0 || port > 65535) return;
+
+    struct sockaddr_in addr;
+#ifdef _WIN32
+    int addrLen = (int)sizeof(addr);
+#else
+    socklen_t addrLen = sizeof(addr);
+#endif
+    if (getpeername(c->s, (struct sockaddr*)&addr, &addrLen) != 0) return;
+    addr.sin_port = htons((uint16_t)port);
+
+    net_socket_t u = socket(AF_INET, SOCK_DGRAM, 0);
+    if (u == INVALID_SOCKET) return;
+    if (connect(u, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(u);
+        return;
+    }
+    set_nonblocking(u);
+
+    NetChan* ch = (NetChan*)malloc(sizeof(NetChan));
+    if (!ch) {
+        closesocket(u);
+        return;
+    }
+    netchan_init(ch, token, time_now());
+    netchan_set_redundancy(ch, NETCHAN_LANE_INPUT, NET_INPUT_REDUNDANCY);
+    c->u = u;
+    c->chan = ch;
+    udp_flush(c);
+}
+
+typedef struct {
+    NetClient* c;
+    void (*on_line)(const char*, void*);
+    void* ud;
+} PollCtx;
+
+// Transport lines stop here; everything else goes to the caller.
+static void poll_line(const char* line, void* ud) {
+    PollCtx* p = (PollCtx*)ud;
+    if (line[0] == 'U' && strncmp(line, "UDP ", 4) == 0) {
+        udp_open(p->c, line + 4);
+        return;
+    }
+    p->on_line(line, p->ud);
+}
+
+static void udp_deliver(int lane, const char* data, int len, void* ud) {
+    (void)lane;
+    PollCtx* p = (PollCtx*)ud;
+    char buf[NETCHAN_MAX_MSG + 1];
+    memcpy(buf, data, (size_t)len);
+    int used = 0;
+    p->c->linesIn += (uint64_t)net_split_lines(buf, len, &used, p->on_line, p->ud);
+}
+
+// Returns 0 if the channel timed out; the caller drops the connection.
+static int poll_udp(NetClient* c, PollCtx* ctx) {
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    double now = time_now();
+    for (;;) {
+        int r = recv(c->u, (char*)pkt, (int)sizeof(pkt), 0);
+        if (r <= 0) break;   // would block, or an ICMP error surfaced: the timeout decides
+        if (c->sim) {
+            netsim_push(&c->sim->udpIn, pkt, r, now);
+            continue;
+        }
+        c->bytesIn += (uint64_t)r;
+        netchan_receive(c->chan, pkt, r, now, udp_deliver, ctx);
+    }
+    if (c->sim) {
+        int r;
+        while ((r = netsim_pop(&c->sim->udpIn, now, pkt, (int)sizeof(pkt))) > 0) {
+            c->bytesIn += (uint64_t)r;
+            netchan_receive(c->chan, pkt, r, now, udp_deliver, ctx);
+        }
+    }
+    if (netchan_timed_out(c->chan, now)) {
+        printf("net: UDP channel silent for %.0f s, disconnecting\n", NETCHAN_TIMEOUT);
+        return 0;
+    }
+    udp_flush(c);
+    return 1;
+}
+
+// -------------------- shared memory --------------------
+
+static int g_useShm;
+
+void net_set_shm(int enable) {
+    g_useShm = enable;
+}
+
+// Sends "SHM" and waits for the answer on the still-blocking socket, a
+// byte at a time so nothing after it is consumed. "SHM <name>" maps the
+// server's rings; "SHM -" or silence keeps plain TCP. Returns 0 only if
+// the server switched over but the mapping could not be opened, which
+// leaves the connection unusable.
+static int shm_handshake(NetClient* c) {
+    if (!g_useShm) return 1;
+    if (!send_stream(c, "SHM\n", 4)) return 0;
+
+    char line[SHM_LINK_NAME_MAX + 8];
+    int len = 0;
+    double giveUp = time_now() + NET_SHM_WAIT_MS / 1000.0;
+    while (len < (int)sizeof(line) - 1) {
+        int ms = (int)((giveUp - time_now()) * 1000.0);
+        if (ms <= 0 || !wait_socket(c->s, 0, ms)) break;
+        if (recv(c->s, line + len, 1, 0) != 1) return 0;
+        if (line[len] != '\n') {
+            len++;
+            continue;
+        }
+        line[len] = '\0';
+        if (strncmp(line, "SHM ", 4) != 0 || strcmp(line + 4, "-") == 0) break;
+
+        ShmLink* l = (ShmLink*)malloc(sizeof(ShmLink));
+        if (!l || !shmlink_open(l, line + 4)) {
+            printf("net: cannot map shared memory %s\n", line + 4);
+            free(l);
+            return 0;
+        }
+        shmlink_unlink(l);   // both sides have it now; leave nothing behind
+        c->shm = l;
+        return 1;
+    }
+    printf("net: server offers no shared-memory link, using TCP\n");
+    return 1;
+}
 
-    char tmp[1024];
+static void shm_close(NetClient* c) {
+    if (!c->shm) return;
+    shmlink_close(c->shm);
+    free(c->shm);
+    c->shm = NULL;
+}
+
+// Lines come from the ring, split in place; the socket is only read to
+// notice the close and to eat wakeup bytes.
+static int poll_shm(NetClient* c, PollCtx* ctx) {
+    char tmp[256];
     for (;;) {
         int r = recv(c->s, tmp, (int)sizeof(tmp), 0);
+        if (r > 0) continue;
+        if (r < 0 && would_block()) break;
+        drop_connection(c);
+        return 0;
+    }
+    char* rec;
+    int len;
+    while ((rec = shmlink_peek(c->shm, &len)) != NULL) {
+        int used = 0;
+        c->bytesIn += (uint64_t)len;
+        c->linesIn += (uint64_t)net_split_lines(rec, len, &used, ctx->on_line, ctx->ud);
+        shmlink_pop(c->shm);
+    }
+    if (shmlink_corrupt(c->shm)) {
+        printf("net: shared-memory ring corrupt, disconnecting\n");
+        drop_connection(c);
+        return 0;
+    }
+    return 1;
+}
+
+// -------------------- TCP --------------------
+
+// Reads from the TCP socket, through the simulated link when it is on.
+// Returns the byte count, 0 when nothing is ready yet, -1 once the peer
+// has closed (with the link, only after everything queued has arrived).
+static int tcp_read(NetClient* c, char* buf, int cap) {
+    if (!c->sim) {
+        int r = recv(c->s, buf, cap, 0);
+        if (r > 0) return r;
+        return (r < 0 && would_block()) ? 0 : -1;
+    }
+
+    NetSimPipes* p = c->sim;
+    double now = time_now();
+    char tmp[4096];
+    // leave the rest in the socket while the link is full, as TCP would
+    while (!p->peerClosed && p->tcpIn.bytes + (int)sizeof(tmp) <= NETSIM_MAX_QUEUED) {
+        int r = recv(c->s, tmp, (int)sizeof(tmp), 0);
+        if (r > 0) {
+            netsim_push(&p->tcpIn, tmp, r, now);
+            continue;
+        }
+        if (!(r < 0 && would_block())) p->peerClosed = 1;
+        break;
+    }
+    int n = netsim_pop(&p->tcpIn, now, buf, cap);
+    if (n > 0) return n;
+    return (p->peerClosed && p->tcpIn.count == 0) ? -1 : 0;
+}
+
+static int poll_tcp(NetClient* c, PollCtx* ctx) {
+    for (;;) {
+        if (!rx_reserve(c)) {
+            c->overflows++;
+            if (c->overflow == NET_OVERFLOW_DISCONNECT) {
+                printf("net: line longer than %d bytes, disconnecting\n", c->rxCap);
+                drop_connection(c);
+                return 0;
+            }
+            printf("net: line longer than %d bytes, skipped\n", c->rxCap);
+            c->rxLen = 0;
+            c->skipping = 1;
+        }
+
+        // recv straight into the line buffer, after any partial line
+        int r = tcp_read(c, c->rx + c->rxLen, c->rxCap - c->rxLen);
         if (r > 0) {
-            if (g_accumLen + r >= (int)sizeof(g_accum)) {
-                // overflow; reset
-                g_accumLen = 0;
+            c->bytesIn += (uint64_t)r;
+
+            if (c->skipping) {
+                // still inside the oversized line: drop through its newline
+                char* nl = (char*)memchr(c->rx + c->rxLen, '\n', (size_t)r);
+                if (!nl) continue;
+                int keep = (int)(c->rx + c->rxLen + r - (nl + 1));
+                memmove(c->rx, nl + 1, (size_t)keep);
+                c->rxLen = keep;
+                c->skipping = 0;
+            } else {
+                c->rxLen += r;
             }
-            memcpy(g_accum + g_accumLen, tmp, r);
-            g_accumLen += r;
 
-            // extract lines
             int start = 0;
-            for (int i=0;i<g_accumLen;i++) {
-                if (g_accum[i] == '\n') {
-                    int len = i - start;
-                    if (len > 0 && g_accum[start + len - 1] == '\r') len--;
-                    char line[1024];
-                    if (len >= (int)sizeof(line)) len = (int)sizeof(line)-1;
-                    memcpy(line, g_accum + start, len);
-                    line[len] = '\0';
-                    on_line(line, userdata);
-                    start = i + 1;
-                }
-            }
+            c->linesIn += (uint64_t)net_split_lines(c->rx, c->rxLen, &start, poll_line, ctx);
+
             // shift remaining
             if (start > 0) {
-                memmove(g_accum, g_accum + start, g_accumLen - start);
-                g_accumLen -= start;
+                memmove(c->rx, c->rx + start, (size_t)(c->rxLen - start));
+                c->rxLen -= start;
             }
             continue;
         }
 
-#ifdef _WIN32
-        int e = WSAGetLastError();
-        if (e == WSAEWOULDBLOCK) return 1;
-#else
-        if (r < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) return 1;
-#endif
+        if (r == 0) return 1;
         // disconnected
-        c->connected = 0;
+        drop_connection(c);
         return 0;
     }
 }
+
+int net_poll_lines(NetClient* c, void (*on_line)(const char*, void*), void* userdata) {
+    if (!c->connected) return 0;
+    PollCtx ctx = { c, on_line, userdata };
+    if (c->shm) return poll_shm(c, &ctx);
+    if (c->sim && !sim_pump_tcp(c)) {
+        drop_connection(c);
+        return 0;
+    }
+    if (!poll_tcp(c, &ctx)) return 0;
+    if (c->chan && !poll_udp(c, &ctx)) {
+        drop_connection(c);
+        return 0;
+    }
+    return 1;
+}
@@ -2,6 +2,9 @@
 #define NET_H
 
 #include <stdint.h>   // <-- for uint16_t
+#include "../common/netchan.h"
+#include "../common/netsim.h"
+#include "../common/shm_link.h"
 
 #ifdef _WIN32
   // Prevent windows.h from pulling in GDI/USER stuff that conflicts with raylib
@@ -25,20 +28,112 @@
   typedef int net_socket_t;
 #endif
 
+// Receive buffer: starts at NET_RX_INITIAL and doubles as needed up to
+// rxMax (NET_RX_MAX_DEFAULT when 0), so bursts like a full history plus a
+// world resync are carried intact. Only a single line longer than rxMax can
+// overflow it; what happens then is the overflow policy.
+#define NET_RX_INITIAL     4096
+#define NET_RX_MAX_DEFAULT (1 << 20)
+
+typedef enum {
+    NET_OVERFLOW_DISCONNECT,   // drop the connection (reconnect resyncs)
+    NET_OVERFLOW_SKIP_LINE     // discard the oversized line, count it, go on
+} NetOverflowPolicy;
+
 typedef struct {
     net_socket_t s;
     int connected;
+
+    // bytes received but not yet framed into lines (partial line)
+    char* rx;
+    int   rxLen, rxCap;
+    int   rxMax;
+    NetOverflowPolicy overflow;
+    int   skipping;            // inside an oversized line being discarded
+
+    // optional datagram channel, opened when the server answers a "UDP"
+    // request (the answer itself never reaches on_line). While it is open,
+    // INPUT rides its unreliable lane with the last few repeated, CMD its
+    // reliable lane, and the server sends STATE/SNAP/ENT and terminal and
+    // object lines the same way. It closes with the TCP connection.
+    net_socket_t u;
+    NetChan* chan;
+
+    // simulated link conditions (net_set_sim); NULL when off
+    NetSimPipes* sim;
+
+    // shared-memory link to a server on this host (net_set_shm), set up
+    // inside net_connect. While it is open every line in both directions
+    // goes through its rings and the socket only carries wakeups.
+    ShmLink* shm;
+
+    // traffic counters (never reset by the net layer)
+    uint64_t bytesIn, bytesOut;
+    uint64_t linesIn, linesOut;
+    uint64_t overflows;        // oversized lines hit, whatever the policy
 } NetClient;
 
 int  net_init(void);
 void net_shutdown(void);
 
 int  net_connect(NetClient* c, const char* host, uint16_t port);
-void net_close(NetClient* c);
+void net_close(NetClient* c);     // also frees the receive buffer
 
+// Call before or between connections; maxBytes <= 0 keeps the default.
+void net_set_rx_limit(NetClient* c, int maxBytes, NetOverflowPolicy policy);
+
+// Puts a simulated link (common/netsim.h) under every connection made from
+// now on, in both directions and on both sockets. Outgoing data leaves and
+// incoming data is handed over as the link allows from net_poll_lines, so
+// keep polling while the simulator is on.
+void net_set_sim(const NetSimConfig* cfg);
+
+// Makes every later net_connect ask the server for a shared-memory link
+// before returning. A server that declines, or does not answer within
+// NET_SHM_WAIT_MS, leaves the connection on TCP. The simulator does not
+// apply to shared-memory connections.
+#define NET_SHM_WAIT_MS 1000
+void net_set_shm(int enable);
+
+// Sends one already-formatted line (or several). If the socket's send
+// buffer is full it waits up to NET_SEND_WAIT_MS for room. With the UDP
+// channel open, INPUT and CMD lines go over it instead (routed by the tag
+// of the first line).
+#define NET_SEND_WAIT_MS 100
+#define NET_INPUT_REDUNDANCY 3   // packets each INPUT rides in over UDP
+int  net_send(NetClient* c, const char* data, int len);
 int  net_sendf(NetClient* c, const char* fmt, ...);
 
-// Poll available lines (non-blocking)
+// Waits up to timeoutMs for incoming data on either socket; 1 if there is
+// some. While the UDP channel is open the wait is capped at
+// NET_CHAN_TICK_MS so its timers keep running.
+#define NET_CHAN_TICK_MS 10
+int  net_wait_readable(NetClient* c, int timeoutMs);
+
+// The same wait, also ended early once wake (see net_wake_open) is poked.
+int  net_wait_readable_wake(NetClient* c, net_socket_t wake, int timeoutMs);
+
+// A socket another thread pokes to cut a wait short, e.g. after queueing a
+// line to send. It is a loopback datagram socket connected to itself, so it
+// sits in the same select() as the connection on every platform. poke is
+// safe from any thread; drain belongs to the waiting thread.
+int  net_wake_open(net_socket_t* out);
+void net_wake_poke(net_socket_t w);
+void net_wake_drain(net_socket_t w);
+void net_wake_close(net_socket_t w);
+
+// Poll available lines (non-blocking). Lines are passed without their
+// newline, NUL-terminated in place in the receive buffer: no copy, valid
+// only for the duration of the callback. Also runs the UDP channel's
+// timers (acks, resends, keepalives), so call it regularly even when
+// nothing is readable. Returns 0 once disconnected, including by
+// NET_OVERFLOW_DISCONNECT or the UDP channel timing out.
 int  net_poll_lines(NetClient* c, void (*on_line)(const char*, void*), void* userdata);
 
+// The framing step of net_poll_lines, usable on any buffer: calls on_line
+// for each complete line in buf[0..len), terminating it in place. Sets
+// *consumed to the bytes used; returns the number of lines.
+int  net_split_lines(char* buf, int len, int* consumed,
+                     void (*on_line)(const char*, void*), void* userdata);
+
 #endif // NET_H
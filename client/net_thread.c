@@ -0,0 +1,254 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "net_thread.h"
+#include "net.h"
+#include "../common/spsc_ring.h"
+#include "../common/timing.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+#define IN_RING_BYTES   (1u << 20)
+#define OUT_RING_BYTES  (1u << 16)
+#define OUT_LINE_MAX    1024
+#define RECONNECT_MS    1000
+#define IDLE_WAIT_MS    500     // longest sleep with nothing to do; sends wake it
+#define POLL_WAIT_MS    1       // without a wake socket: bounds send latency
+
+#define flag_load(p)       __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define flag_store(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Inbound record: header, then the NUL-terminated line (empty for events).
+typedef struct {
+    uint32_t kind;
+    uint32_t epoch;
+} InHeader;
+
+// Outbound record: the connection epoch it was queued for, then the line.
+typedef struct {
+    uint32_t epoch;
+} OutHeader;
+
+struct NetThread {
+    char host[64];
+    uint16_t port;
+
+    SpscRing in;        // network thread -> render thread
+    SpscRing out;       // render thread -> network thread
+
+    int quit;           // atomic
+
+    // The network thread raises sleeping before it blocks in select(); the
+    // render thread pokes wake after queueing a line if it sees the flag.
+    net_socket_t wake;
+    int haveWake;
+    int sleeping;       // atomic
+
+    // network thread only
+    NetClient net;
+    uint32_t epoch;     // bumped on every successful connect
+
+    // render thread only
+    uint32_t renderEpoch;   // epoch of the connection we know is up, 0 if none
+
+    NetThreadStats stats;   // written by the network thread, atomically
+
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+static int quitting(NetThread* t) {
+    return flag_load(&t->quit);
+}
+
+// Network thread. Blocks while the render thread is behind, so nothing is
+// ever dropped; the socket simply stops being read in the meantime.
+static void push_in(NetThread* t, NetEventKind kind, const char* line) {
+    uint32_t len = (uint32_t)strlen(line) + 1;
+    uint8_t* dst;
+    while (!(dst = (uint8_t*)spsc_reserve(&t->in, (uint32_t)sizeof(InHeader) + len))) {
+        if (quitting(t)) return;
+        time_sleep_ms(1);
+    }
+    InHeader h = { (uint32_t)kind, t->epoch };
+    memcpy(dst, &h, sizeof(h));
+    memcpy(dst + sizeof(h), line, len);
+    spsc_commit(&t->in, (uint32_t)sizeof(InHeader) + len);
+}
+
+static void on_net_line(const char* line, void* ud) {
+    push_in((NetThread*)ud, NET_EV_LINE, line);
+}
+
+static void flush_out(NetThread* t) {
+    const uint8_t* rec;
+    uint32_t len;
+    while ((rec = (const uint8_t*)spsc_peek(&t->out, &len)) != NULL) {
+        OutHeader h;
+        memcpy(&h, rec, sizeof(h));
+        // lines queued for an older connection are stale (e.g. INPUT
+        // ahead of the new HELLO); drop them
+        if (t->net.connected && h.epoch == t->epoch) {
+            net_send(&t->net, (const char*)rec + sizeof(h), (int)(len - sizeof(h)));
+        }
+        spsc_pop(&t->out);
+    }
+}
+
+static void publish_stats(NetThread* t) {
+    __atomic_store_n(&t->stats.bytesIn, t->net.bytesIn, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->stats.bytesOut, t->net.bytesOut, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->stats.linesIn, t->net.linesIn, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->stats.linesOut, t->net.linesOut, __ATOMIC_RELAXED);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI net_main(LPVOID arg)
+#else
+static void* net_main(void* arg)
+#endif
+{
+    NetThread* t = (NetThread*)arg;
+    double nextConnect = 0;
+
+    while (!quitting(t)) {
+        if (!t->net.connected) {
+            flush_out(t);   // discards: nothing to send on
+            double now = time_now();
+            if (now < nextConnect) {
+                time_sleep_ms(10);
+                continue;
+            }
+            nextConnect = now + RECONNECT_MS / 1000.0;
+            if (!net_connect(&t->net, t->host, t->port)) continue;
+            t->epoch++;
+            push_in(t, NET_EV_CONNECTED, "");
+        }
+
+        flush_out(t);
+        // polled even when nothing arrived: the UDP channel's acks and
+        // resends run from here (net_wait_readable caps the wait for them)
+        if (t->haveWake) {
+            __atomic_store_n(&t->sleeping, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!spsc_pending(&t->out)) net_wait_readable_wake(&t->net, t->wake, IDLE_WAIT_MS);
+            __atomic_store_n(&t->sleeping, 0, __ATOMIC_RELAXED);
+            net_wake_drain(t->wake);
+        } else {
+            net_wait_readable(&t->net, POLL_WAIT_MS);
+        }
+        if (!net_poll_lines(&t->net, on_net_line, t)) {
+            push_in(t, NET_EV_DISCONNECTED, "");
+            nextConnect = time_now() + RECONNECT_MS / 1000.0;
+        }
+        publish_stats(t);
+    }
+
+    net_close(&t->net);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+NetThread* net_thread_start(const char* host, uint16_t port) {
+    NetThread* t = (NetThread*)calloc(1, sizeof(NetThread));
+    if (!t) return NULL;
+    snprintf(t->host, sizeof(t->host), "%s", host);
+    t->port = port;
+
+    if (!spsc_init(&t->in, IN_RING_BYTES) || !spsc_init(&t->out, OUT_RING_BYTES)) goto fail;
+    t->haveWake = net_wake_open(&t->wake);
+
+#ifdef _WIN32
+    t->thread = CreateThread(NULL, 0, net_main, t, 0, NULL);
+    if (!t->thread) goto fail;
+#else
+    if (pthread_create(&t->thread, NULL, net_main, t) != 0) goto fail;
+#endif
+    return t;
+
+fail:
+    if (t->haveWake) net_wake_close(t->wake);
+    spsc_free(&t->in);
+    spsc_free(&t->out);
+    free(t);
+    return NULL;
+}
+
+void net_thread_stop(NetThread* t) {
+    if (!t) return;
+    flag_store(&t->quit, 1);
+    if (t->haveWake) net_wake_poke(t->wake);
+#ifdef _WIN32
+    WaitForSingleObject(t->thread, INFINITE);
+    CloseHandle(t->thread);
+#else
+    pthread_join(t->thread, NULL);
+#endif
+    if (t->haveWake) net_wake_close(t->wake);
+    spsc_free(&t->in);
+    spsc_free(&t->out);
+    free(t);
+}
+
+int net_thread_drain(NetThread* t, NetEventFn fn, void* ud) {
+    const uint8_t* rec;
+    uint32_t len;
+    while ((rec = (const uint8_t*)spsc_peek(&t->in, &len)) != NULL) {
+        InHeader h;
+        memcpy(&h, rec, sizeof(h));
+        if (h.kind == NET_EV_CONNECTED) t->renderEpoch = h.epoch;
+        if (h.kind == NET_EV_DISCONNECTED) t->renderEpoch = 0;
+        fn((NetEventKind)h.kind, (const char*)rec + sizeof(h), ud);
+        spsc_pop(&t->in);
+    }
+    return t->renderEpoch != 0;
+}
+
+int net_thread_sendf(NetThread* t, const char* fmt, ...) {
+    if (!t->renderEpoch) return 0;
+
+    uint8_t* dst = (uint8_t*)spsc_reserve(&t->out, (uint32_t)sizeof(OutHeader) + OUT_LINE_MAX);
+    if (!dst) return 0;
+
+    OutHeader h = { t->renderEpoch };
+    memcpy(dst, &h, sizeof(h));
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf((char*)dst + sizeof(h), OUT_LINE_MAX, fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if (n >= OUT_LINE_MAX) n = OUT_LINE_MAX - 1;
+    spsc_commit(&t->out, (uint32_t)(sizeof(h) + (size_t)n));
+
+    // pairs with the fence in net_main: either it sees the record before
+    // sleeping or we see it asleep
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (t->haveWake && __atomic_load_n(&t->sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&t->sleeping, 0, __ATOMIC_RELAXED)) {
+        net_wake_poke(t->wake);
+    }
+    return 1;
+}
+
+void net_thread_stats(NetThread* t, NetThreadStats* out) {
+    out->bytesIn = __atomic_load_n(&t->stats.bytesIn, __ATOMIC_RELAXED);
+    out->bytesOut = __atomic_load_n(&t->stats.bytesOut, __ATOMIC_RELAXED);
+    out->linesIn = __atomic_load_n(&t->stats.linesIn, __ATOMIC_RELAXED);
+    out->linesOut = __atomic_load_n(&t->stats.linesOut, __ATOMIC_RELAXED);
+}
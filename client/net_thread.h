@@ -0,0 +1,41 @@
+#ifndef NET_THREAD_H
+#define NET_THREAD_H
+
+#include <stdint.h>
+
+// Client networking on its own thread. The thread owns the NetClient:
+// it connects (and reconnects once a second), frames incoming lines, and
+// sends queued outgoing lines. The render thread only touches two
+// single-producer/single-consumer rings, so a slow socket or a large burst
+// never stalls a frame.
+
+typedef enum {
+    NET_EV_LINE,           // one server line
+    NET_EV_CONNECTED,      // a new connection is up; send HELLO now
+    NET_EV_DISCONNECTED
+} NetEventKind;
+
+typedef struct {
+    uint64_t bytesIn, bytesOut;
+    uint64_t linesIn, linesOut;
+} NetThreadStats;
+
+typedef struct NetThread NetThread;
+
+NetThread* net_thread_start(const char* host, uint16_t port);
+void       net_thread_stop(NetThread* t);
+
+// Render thread. Delivers queued events in order; line is NUL-terminated
+// and valid only during the callback. Returns 1 while connected.
+typedef void (*NetEventFn)(NetEventKind kind, const char* line, void* ud);
+int  net_thread_drain(NetThread* t, NetEventFn fn, void* ud);
+
+// Render thread. Queues one line for sending. Returns 0 if not connected
+// or the queue is full. Lines queued before a reconnect are never sent on
+// the new connection.
+int  net_thread_sendf(NetThread* t, const char* fmt, ...);
+
+// Render thread. Traffic counters as of the network thread's last pass.
+void net_thread_stats(NetThread* t, NetThreadStats* out);
+
+#endif
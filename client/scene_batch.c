@@ -0,0 +1,52 @@
+#include "scene_batch.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+int scenebatch_init(SceneBatch* b, int cap) {
+    b->xforms = (float*)malloc((size_t)cap * SCENE_XFORM_FLOATS * sizeof(float));
+    b->count = 0;
+    b->cap = b->xforms ? cap : 0;
+    return b->xforms != NULL;
+}
+
+void scenebatch_free(SceneBatch* b) {
+    free(b->xforms);
+    b->xforms = NULL;
+    b->count = 0;
+    b->cap = 0;
+}
+
+// An axis-aligned box of size sx x sy x sz centred at (x, y, z).
+static void add_box(SceneBatch* b, float x, float y, float z, float sx, float sy, float sz,
+                    unsigned char r, unsigned char g, unsigned char bl) {
+    float* m = b->xforms + (size_t)b->count * SCENE_XFORM_FLOATS;
+    m[0]  = sx;   m[1]  = 0.0f; m[2]  = 0.0f; m[3]  = x;
+    m[4]  = 0.0f; m[5]  = sy;   m[6]  = 0.0f; m[7]  = y;
+    m[8]  = 0.0f; m[9]  = 0.0f; m[10] = sz;   m[11] = z;
+    m[12] = r / 255.0f;
+    m[13] = g / 255.0f;
+    m[14] = bl / 255.0f;
+    m[15] = 1.0f;
+    b->count++;
+}
+
+int scene_build(SceneBatch* b, const ObjCube* objs, const int* visible, int n) {
+    b->count = 0;
+    for (int i = 0; i < n && b->count < b->cap; i++) {
+        const ObjCube* o = &objs[visible[i]];
+        add_box(b, o->x, o->y, o->z, o->size, o->size, o->size, o->r, o->g, o->b);
+    }
+    return b->count;
+}
+
+int scene_add_remotes(SceneBatch* b, const Interp* in) {
+    for (int i = 0; i < in->count && b->count + SCENE_REMOTE_BOXES <= b->cap; i++) {
+        // the reported position is the eye, 1.6 m above the floor
+        const RemoteEnt* e = &in->ents[i];
+        add_box(b, e->x, e->y - 0.75f, e->z, 0.5f, 1.7f, 0.5f, 190, 33, 55);
+        add_box(b, e->x + sinf(e->yaw) * 0.3f, e->y - 0.1f, e->z + cosf(e->yaw) * 0.3f,
+                0.2f, 0.15f, 0.2f, 245, 245, 245);
+    }
+    return b->count;
+}
@@ -0,0 +1,37 @@
+#ifndef SCENE_BATCH_H
+#define SCENE_BATCH_H
+
+// CPU side of cube rendering: packs the cubes that survived culling (see
+// cull.h), then the remote players' boxes, into one per-instance transform
+// buffer. No raylib, so it can be driven headlessly; scene_render.c uploads
+// the buffer in one instanced draw.
+
+#include "world.h"
+
+// One 4x4 transform per instance, row-major (the memory layout of raylib's
+// Matrix). The bottom row of an affine transform is always 0,0,0,1, so it
+// carries the cube's colour instead: m[12..14] = r, g, b in 0..1. The
+// instancing shader reads it back and restores the row.
+#define SCENE_XFORM_FLOATS 16
+
+typedef struct {
+    float* xforms;    // cap * SCENE_XFORM_FLOATS
+    int count;
+    int cap;
+} SceneBatch;
+
+int  scenebatch_init(SceneBatch* b, int cap);
+void scenebatch_free(SceneBatch* b);
+
+// Instances each remote player adds: a body box and a small block on the
+// side they face.
+#define SCENE_REMOTE_BOXES 2
+
+// Packs objs[visible[0..n)], replacing the batch. Returns the number packed.
+int  scene_build(SceneBatch* b, const ObjCube* objs, const int* visible, int n);
+
+// Appends SCENE_REMOTE_BOXES instances per remote player, as far as the
+// batch has room. Returns the batch's new count.
+int  scene_add_remotes(SceneBatch* b, const Interp* in);
+
+#endif
@@ -0,0 +1,95 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include "scene_render.h"
+#include "rlgl.h"
+#include <stddef.h>
+
+// cubes further than this are not drawn; the floor grid ends well inside it
+#define SCENE_DRAW_DISTANCE 100.0f
+
+// The colour rides in the bottom row of the instance transform (see
+// scene_batch.h); it is pulled out here and the row reset to 0,0,0,1.
+static const char *CUBE_VS =
+"#version 330\n"
+"in vec3 vertexPosition;\n"
+"in mat4 instanceTransform;\n"
+"uniform mat4 mvp;\n"
+"out vec3 fragLocal;\n"
+"out vec3 fragCol;\n"
+"void main(){\n"
+"    mat4 m = instanceTransform;\n"
+"    fragCol = vec3(m[0][3], m[1][3], m[2][3]);\n"
+"    m[0][3] = 0.0; m[1][3] = 0.0; m[2][3] = 0.0;\n"
+"    fragLocal = vertexPosition;\n"
+"    gl_Position = mvp * m * vec4(vertexPosition, 1.0);\n"
+"}\n";
+
+// Edges are where two local coordinates sit on the cube surface; fwidth
+// keeps the line about a pixel and a half wide at any distance. The 0.47
+// blend matches the old DrawCubeWires colour (0,0,0,120).
+static const char *CUBE_FS =
+"#version 330\n"
+"in vec3 fragLocal;\n"
+"in vec3 fragCol;\n"
+"out vec4 finalColor;\n"
+"void main(){\n"
+"    vec3 a = abs(fragLocal) * 2.0;\n"
+"    vec3 w = fwidth(fragLocal) * 3.0;\n"
+"    vec3 e = step(1.0 - w, a);\n"
+"    float edge = step(2.0, e.x + e.y + e.z);\n"
+"    finalColor = vec4(mix(fragCol, vec3(0.0), edge * 0.47), 1.0);\n"
+"}\n";
+
+void scenerender_init(SceneRenderer* s) {
+    s->cube = GenMeshCube(1.0f, 1.0f, 1.0f);
+    s->material = LoadMaterialDefault();
+
+    Shader sh = LoadShaderFromMemory(CUBE_VS, CUBE_FS);
+    s->instanced = sh.id != rlGetShaderIdDefault();
+    if (s->instanced) {
+        sh.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(sh, "mvp");
+        sh.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(sh, "instanceTransform");
+        s->material.shader = sh;
+    }
+
+    cullset_init(&s->cull, MAX_OBJS);
+    scenebatch_init(&s->batch, MAX_OBJS + INTERP_MAX_ENTS * SCENE_REMOTE_BOXES);
+}
+
+void scenerender_free(SceneRenderer* s) {
+    scenebatch_free(&s->batch);
+    cullset_free(&s->cull);
+    UnloadMaterial(s->material);   // also unloads the instancing shader
+    UnloadMesh(s->cube);
+}
+
+void scenerender_draw(SceneRenderer* s, const ClientWorld* w, Camera3D camera, float aspect) {
+    Frustum f;
+    float pos[3] = { camera.position.x, camera.position.y, camera.position.z };
+    float tgt[3] = { camera.target.x, camera.target.y, camera.target.z };
+    float up[3]  = { camera.up.x, camera.up.y, camera.up.z };
+    frustum_from_camera(&f, pos, tgt, up, camera.fovy, aspect,
+                        (float)RL_CULL_DISTANCE_NEAR, (float)RL_CULL_DISTANCE_FAR);
+
+    cullset_load(&s->cull, w->objs, w->objCount);
+    int vis = cull_run(&s->cull, &f, pos, SCENE_DRAW_DISTANCE);
+    scene_build(&s->batch, w->objs, s->cull.visible, vis);
+    int n = scene_add_remotes(&s->batch, &w->remotes);
+    if (n == 0) return;
+
+    if (s->instanced) {
+        // SceneBatch transforms share raylib's Matrix memory layout
+        DrawMeshInstanced(s->cube, s->material, (const Matrix*)s->batch.xforms, n);
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const float* m = s->batch.xforms + (size_t)i * SCENE_XFORM_FLOATS;
+        Vector3 p = { m[3], m[7], m[11] };
+        Color col = { (unsigned char)(m[12]*255.0f + 0.5f), (unsigned char)(m[13]*255.0f + 0.5f),
+                      (unsigned char)(m[14]*255.0f + 0.5f), 255 };
+        DrawCube(p, m[0], m[5], m[10], col);
+        DrawCubeWires(p, m[0], m[5], m[10], (Color){0,0,0,120});
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SCENE_RENDER_H
+#define SCENE_RENDER_H
+
+#include "raylib.h"
+#include "scene_batch.h"
+#include "cull.h"
+
+// Draws the world's cubes and the other players: culls the cubes against the
+// frustum and a draw distance (cull.c), packs the survivors with scene_build
+// and the players with scene_add_remotes, then submits the whole batch as
+// one instanced draw of a unit cube mesh. The shader darkens
+// the cube edges, which replaces the per-cube wireframe.
+// Falls back to per-cube immediate drawing if the shader did not compile.
+typedef struct {
+    Mesh cube;
+    Material material;
+    int instanced;
+    CullSet cull;
+    SceneBatch batch;
+} SceneRenderer;
+
+void scenerender_init(SceneRenderer* s);
+void scenerender_free(SceneRenderer* s);
+
+// Call inside BeginMode3D(camera); aspect is the render target's.
+void scenerender_draw(SceneRenderer* s, const ClientWorld* w, Camera3D camera, float aspect);
+
+#endif
@@ -0,0 +1,119 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include "terminal_render.h"
+#include "rlgl.h"
+#include <stddef.h>
+
+#define TERM_FONT_SIZE 18
+#define TERM_CELL_W    10
+#define TERM_MARGIN_X  10
+#define TERM_MARGIN_Y  8
+#define ATLAS_COLS     16
+
+// Renders every printable glyph centred in a fixed cell. The default font is
+// proportional; centring keeps narrow glyphs like 'i' readable on the grid.
+static Texture2D bake_atlas(Font font, const GlyphGrid* g) {
+    int w, h;
+    glyphgrid_atlas_size(g, &w, &h);
+
+    RenderTexture2D rt = LoadRenderTexture(w, h);
+    BeginTextureMode(rt);
+        ClearBackground(BLANK);
+        for (int i=0; i<GLYPH_COUNT; i++) {
+            char s[2] = { (char)(GLYPH_FIRST + i), 0 };
+            Vector2 size = MeasureTextEx(font, s, (float)TERM_FONT_SIZE, 1.0f);
+            float x = (float)(i % ATLAS_COLS) * g->cellW + (g->cellW - size.x) * 0.5f;
+            float y = (float)(i / ATLAS_COLS) * g->cellH;
+            DrawTextEx(font, s, (Vector2){ x, y }, (float)TERM_FONT_SIZE, 1.0f, WHITE);
+        }
+    EndTextureMode();
+
+    // render textures are stored bottom-up; flip once so quad UVs stay simple
+    Image img = LoadImageFromTexture(rt.texture);
+    ImageFlipVertical(&img);
+    Texture2D atlas = LoadTextureFromImage(img);
+    UnloadImage(img);
+    UnloadRenderTexture(rt);
+    return atlas;
+}
+
+void termrender_init(TermRenderer* r, Font font, int width, int height) {
+    r->target = LoadRenderTexture(width, height);
+    r->scanlines = LoadRenderTexture(width, height);
+    r->drawnRevision = 0;
+    r->drawn = 0;
+
+    int cols = (width - 2*TERM_MARGIN_X) / TERM_CELL_W;
+    glyphgrid_init(&r->grid, cols, VISIBLE_LINES, (float)TERM_MARGIN_X, (float)TERM_MARGIN_Y,
+                   (float)TERM_CELL_W, (float)TERM_FONT_SIZE, (float)(TERM_FONT_SIZE + 2), ATLAS_COLS);
+    r->atlas = bake_atlas(font, &r->grid);
+
+    // opaque lines here; the translucency is applied as a tint when the
+    // overlay is composited, which matches drawing the lines directly
+    BeginTextureMode(r->scanlines);
+        ClearBackground(BLANK);
+        for (int sy=0; sy<height; sy+=4) {
+            DrawLine(0, sy, width, sy, (Color){0,20,0,255});
+        }
+    EndTextureMode();
+}
+
+void termrender_free(TermRenderer* r) {
+    glyphgrid_free(&r->grid);
+    UnloadTexture(r->atlas);
+    UnloadRenderTexture(r->scanlines);
+    UnloadRenderTexture(r->target);
+}
+
+static void sync_grid(GlyphGrid* g, const TerminalUI* t) {
+    int start = 0;
+    if (t->histCount > VISIBLE_LINES) start = t->histCount - VISIBLE_LINES;
+
+    int row = 0;
+    for (int i=start; i<t->histCount; i++, row++) {
+        // the prompt line is history + command; the grid concatenates
+        // them while comparing, so nothing is composed here
+        const char* tail = (i == t->histCount-1) ? t->command : NULL;
+        glyphgrid_set_row(g, row, t->history[i], tail);
+    }
+    for (; row<g->rows; row++) glyphgrid_set_row(g, row, NULL, NULL);
+
+    glyphgrid_build(g);
+}
+
+static void draw_grid(const GlyphGrid* g, Texture2D atlas, Color tint) {
+    rlSetTexture(atlas.id);
+    rlBegin(RL_QUADS);
+        rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+        for (int r=0; r<g->rows; r++) {
+            const GlyphVertex* v = g->verts + (size_t)r * (size_t)g->cols * 4;
+            for (int q=0; q<g->rowQuads[r]*4; q++) {
+                rlTexCoord2f(v[q].u, v[q].v);
+                rlVertex2f(v[q].x, v[q].y);
+            }
+        }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+int termrender_update(TermRenderer* r, const TerminalUI* t) {
+    if (r->drawn && r->drawnRevision == t->revision) return 0;
+
+    sync_grid(&r->grid, t);
+
+    BeginTextureMode(r->target);
+        ClearBackground((Color){0,0,0,255});
+        draw_grid(&r->grid, r->atlas, GREEN);
+
+        // render textures are stored bottom-up; flip when sampling
+        Texture2D scan = r->scanlines.texture;
+        DrawTextureRec(scan, (Rectangle){ 0, 0, (float)scan.width, (float)-scan.height },
+                       (Vector2){ 0, 0 }, (Color){255,255,255,30});
+    EndTextureMode();
+
+    r->drawnRevision = t->revision;
+    r->drawn = 1;
+    return 1;
+}
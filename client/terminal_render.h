@@ -0,0 +1,31 @@
+#ifndef TERMINAL_RENDER_H
+#define TERMINAL_RENDER_H
+
+#include "raylib.h"
+#include "terminal_ui.h"
+#include "glyph_grid.h"
+
+// Owns the terminal's render texture and only redraws it when the
+// TerminalUI revision changes; an unchanged terminal costs no draw calls.
+// The scanline overlay is static, so it is drawn once into its own texture
+// and composited with a single quad on each redraw.
+//
+// Text goes through a glyph atlas baked once from the font at init. The
+// visible screen is a GlyphGrid whose changed rows are rebuilt on the CPU;
+// the whole grid is then submitted as one textured quad batch.
+typedef struct {
+    RenderTexture2D target;      // sampled by the in-world monitor
+    RenderTexture2D scanlines;
+    Texture2D atlas;
+    GlyphGrid grid;
+    unsigned drawnRevision;
+    int drawn;                   // target holds a valid frame
+} TermRenderer;
+
+void termrender_init(TermRenderer* r, Font font, int width, int height);
+void termrender_free(TermRenderer* r);
+
+// Redraws target if t changed since the last call. Returns 1 if it did.
+int  termrender_update(TermRenderer* r, const TerminalUI* t);
+
+#endif
@@ -3,7 +3,6 @@
 
 #include "terminal_ui.h"
 #include <string.h>
-#include <stdio.h>
 #include <ctype.h>
 
 void termui_init(TerminalUI* t) {
@@ -13,10 +12,25 @@ void termui_init(TerminalUI* t) {
 void termui_clear_command(TerminalUI* t) {
     t->command[0] = '\0';
     t->cmdLen = 0;
+    t->revision++;
+}
+
+void termui_type_char(TerminalUI* t, int c) {
+    if (t->cmdLen >= COMMAND_MAX_CHARS - 1 || !termui_allowed_char(c)) return;
+    t->command[t->cmdLen++] = (char)c;
+    t->command[t->cmdLen] = '\0';
+    t->revision++;
+}
+
+void termui_backspace(TerminalUI* t) {
+    if (t->cmdLen <= 0) return;
+    t->command[--t->cmdLen] = '\0';
+    t->revision++;
 }
 
 void termui_push_line(TerminalUI* t, const char* line) {
     if (!line) line = "";
+    t->revision++;
     if (t->histCount < HISTORY_MAX_LINES) {
         strncpy(t->history[t->histCount], line, LINE_MAX_CHARS-1);
         t->history[t->histCount][LINE_MAX_CHARS-1] = '\0';
@@ -24,44 +38,33 @@ void termui_push_line(TerminalUI* t, const char* line) {
         return;
     }
     for (int i=1;i<HISTORY_MAX_LINES;i++) strcpy(t->history[i-1], t->history[i]);
+    t->histBaseSeq++;
     strncpy(t->history[HISTORY_MAX_LINES-1], line, LINE_MAX_CHARS-1);
     t->history[HISTORY_MAX_LINES-1][LINE_MAX_CHARS-1] = '\0';
 }
 
 void termui_replace_last(TerminalUI* t, const char* line) {
     if (t->histCount <= 0) return;
+    t->revision++;
     strncpy(t->history[t->histCount-1], line, LINE_MAX_CHARS-1);
     t->history[t->histCount-1][LINE_MAX_CHARS-1] = '\0';
 }
 
-int termui_allowed_char(int c) {
-    const char *ok = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+-*/()=._\"'[]{},:<>!@#$%^&|?; ";
-    return (strchr(ok, c) != NULL);
+void termui_truncate_from(TerminalUI* t, unsigned seq) {
+    t->revision++;
+    if (seq < t->histBaseSeq || seq > termui_next_seq(t)) {
+        t->histCount = 0;
+        t->histBaseSeq = seq;
+        return;
+    }
+    t->histCount = (int)(seq - t->histBaseSeq);
 }
 
-void termui_render(RenderTexture2D rt, Font font, const TerminalUI* t) {
-    BeginTextureMode(rt);
-        ClearBackground((Color){0,0,0,255});
-
-        int start = 0;
-        if (t->histCount > VISIBLE_LINES) start = t->histCount - VISIBLE_LINES;
-
-        int fontSize = 18;
-        int y = 8;
-        for (int i=start; i<t->histCount; i++) {
-            const char* line = t->history[i];
-            if (i == t->histCount-1) {
-                char composed[LINE_MAX_CHARS + COMMAND_MAX_CHARS];
-                snprintf(composed, sizeof(composed), "%s%s", line, t->command);
-                DrawTextEx(font, composed, (Vector2){10, (float)y}, (float)fontSize, 1.0f, GREEN);
-            } else {
-                DrawTextEx(font, line, (Vector2){10, (float)y}, (float)fontSize, 1.0f, GREEN);
-            }
-            y += fontSize + 2;
-        }
+unsigned termui_next_seq(const TerminalUI* t) {
+    return t->histBaseSeq + (unsigned)t->histCount;
+}
 
-        for (int sy=0; sy<rt.texture.height; sy+=4) {
-            DrawLine(0, sy, rt.texture.width, sy, (Color){0,20,0,30});
-        }
-    EndTextureMode();
+int termui_allowed_char(int c) {
+    const char *ok = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+-*/()=._\"'[]{},:<>!@#$%^&|?; ";
+    return (strchr(ok, c) != NULL);
 }
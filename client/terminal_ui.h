@@ -1,8 +1,6 @@
 #ifndef TERMINAL_UI_H
 #define TERMINAL_UI_H
 
-#include "raylib.h"
-
 #define HISTORY_MAX_LINES 256
 #define LINE_MAX_CHARS    256
 #define COMMAND_MAX_CHARS 256
@@ -11,17 +9,27 @@
 typedef struct {
     char history[HISTORY_MAX_LINES][LINE_MAX_CHARS];
     int  histCount;
+    unsigned histBaseSeq;   // server sequence number of history[0]
 
     char command[COMMAND_MAX_CHARS];
     int  cmdLen;
+
+    // bumped by every change to history or the command line, so renderers
+    // can skip frames where nothing visible changed
+    unsigned revision;
 } TerminalUI;
 
 void termui_init(TerminalUI* t);
 void termui_clear_command(TerminalUI* t);
+void termui_type_char(TerminalUI* t, int c);   // ignores disallowed chars and overflow
+void termui_backspace(TerminalUI* t);
 void termui_push_line(TerminalUI* t, const char* line);
 void termui_replace_last(TerminalUI* t, const char* line);
 
-void termui_render(RenderTexture2D rt, Font font, const TerminalUI* t);
+// Drops every line with seq >= seq so a HIST resync can append from there.
+// A seq outside what we hold (gap or older) clears the history instead.
+void termui_truncate_from(TerminalUI* t, unsigned seq);
+unsigned termui_next_seq(const TerminalUI* t);
 
 int  termui_allowed_char(int c);
 
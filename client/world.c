@@ -0,0 +1,194 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "world.h"
+#include "../common/numcodec.h"
+#include <string.h>
+
+void world_init(ClientWorld* w) {
+    memset(w, 0, sizeof(*w));
+    termui_init(&w->term);
+}
+
+// Message handlers. args points just past the tag and its space (or at the
+// terminating NUL for bare tags); the line is parsed in place.
+
+static void on_welcome(ClientWorld* w, const char* args) {
+    // WELCOME <version> <session>
+    while (*args && *args != ' ') args++;
+    uint64_t id = 0;
+    if (num_parse_hex64(&args, &id)) {
+        w->sessionId = id;
+        w->haveSession = 1;
+    }
+    // possibly a different server process: its clock starts over
+    interp_init(&w->remotes);
+}
+
+static void on_hist(ClientWorld* w, const char* args) {
+    unsigned seq = 0;
+    w->expectHist = 0;
+    if (num_parse_int(&args, &w->expectHist)) num_parse_uint(&args, &seq);
+    w->gotHist = 0;
+    termui_truncate_from(&w->term, seq);
+    w->haveHistory = 1;
+}
+
+static void on_text(ClientWorld* w, const char* args) {
+    termui_push_line(&w->term, args);
+    w->gotHist++;
+}
+
+static void on_state(ClientWorld* w, const char* args) {
+    PlayerState ps;
+    if (num_parse_float(&args, &ps.x) && num_parse_float(&args, &ps.y) &&
+        num_parse_float(&args, &ps.z) && num_parse_float(&args, &ps.yaw) &&
+        num_parse_float(&args, &ps.pitch)) {
+        w->ps = ps;
+        w->haveState = 1;
+    }
+}
+
+static void on_obj_clear(ClientWorld* w, const char* args) {
+    (void)args;
+    world_clear_objs(w);
+}
+
+static void on_obj_del(ClientWorld* w, const char* args) {
+    int id = 0;
+    if (num_parse_int(&args, &id)) {
+        ObjCube* o = world_find_obj(w, id);
+        if (o) world_remove_obj(w, o);
+    }
+}
+
+static void on_obj_add(ClientWorld* w, const char* args) {
+    int id = 0, r = 255, g = 255, b = 255;
+    float x = 0, y = 0, z = 0, s = 1;
+    if (num_parse_int(&args, &id) && num_parse_float(&args, &x) && num_parse_float(&args, &y) &&
+        num_parse_float(&args, &z) && num_parse_float(&args, &s) && num_parse_int(&args, &r) &&
+        num_parse_int(&args, &g) && num_parse_int(&args, &b)) {
+        ObjCube* o = world_alloc_obj(w, id);
+        if (o) {
+            o->x = x; o->y = y; o->z = z;
+            o->size = s;
+            o->r = (unsigned char)r;
+            o->g = (unsigned char)g;
+            o->b = (unsigned char)b;
+        }
+    }
+}
+
+static void on_snap(ClientWorld* w, const char* args) {
+    // SNAP <seq> <ms> <n>
+    unsigned seq = 0, ms = 0;
+    int n = 0;
+    if (num_parse_uint(&args, &seq) && num_parse_uint(&args, &ms) && num_parse_int(&args, &n)) {
+        interp_begin(&w->remotes, (double)ms * 0.001, n, w->clock);
+    }
+}
+
+static void on_ent(ClientWorld* w, const char* args) {
+    // ENT <id> <x> <y> <z> <yaw>
+    int id = 0;
+    float x, y, z, yaw;
+    if (num_parse_int(&args, &id) && num_parse_float(&args, &x) && num_parse_float(&args, &y) &&
+        num_parse_float(&args, &z) && num_parse_float(&args, &yaw)) {
+        interp_ent(&w->remotes, id, x, y, z, yaw);
+    }
+}
+
+typedef void (*MsgHandler)(ClientWorld* w, const char* args);
+
+typedef struct {
+    const char* tag;
+    int len;
+    MsgHandler fn;
+} MsgEntry;
+
+static const MsgEntry kMessages[] = {
+    { "WELCOME",   7, on_welcome },
+    { "HIST",      4, on_hist },
+    { "LINE",      4, on_text },
+    { "STATE",     5, on_state },
+    { "OBJ_CLEAR", 9, on_obj_clear },
+    { "OBJ_DEL",   7, on_obj_del },
+    { "OBJ_ADD",   7, on_obj_add },
+    { "SNAP",      4, on_snap },
+    { "ENT",       3, on_ent },
+};
+
+#define MSG_COUNT ((int)(sizeof(kMessages) / sizeof(kMessages[0])))
+#define MSG_SLOTS 32   // power of two, well above MSG_COUNT
+
+// Open-addressed table from tag hash to kMessages index (+1; 0 = empty),
+// filled on first use. A lookup is one hash and usually one memcmp.
+static unsigned char g_msgSlots[MSG_SLOTS];
+static int g_msgSlotsReady;
+
+static unsigned tag_hash(const char* tag, int len) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++) h = (h ^ (unsigned char)tag[i]) * 16777619u;
+    return h;
+}
+
+static void build_msg_slots(void) {
+    for (int i = 0; i < MSG_COUNT; i++) {
+        unsigned h = tag_hash(kMessages[i].tag, kMessages[i].len);
+        while (g_msgSlots[h & (MSG_SLOTS - 1)]) h++;
+        g_msgSlots[h & (MSG_SLOTS - 1)] = (unsigned char)(i + 1);
+    }
+    g_msgSlotsReady = 1;
+}
+
+static MsgHandler find_handler(const char* tag, int len) {
+    if (!g_msgSlotsReady) build_msg_slots();
+    unsigned h = tag_hash(tag, len);
+    for (;;) {
+        int e = g_msgSlots[h & (MSG_SLOTS - 1)];
+        if (!e) return NULL;
+        const MsgEntry* m = &kMessages[e - 1];
+        if (m->len == len && memcmp(m->tag, tag, (size_t)len) == 0) return m->fn;
+        h++;
+    }
+}
+
+void world_on_line(const char* line, void* ud) {
+    ClientWorld* w = (ClientWorld*)ud;
+
+    int len = 0;
+    while (line[len] && line[len] != ' ') len++;
+
+    MsgHandler fn = find_handler(line, len);
+    if (!fn) return;   // PROMPT and anything newer than this client
+    fn(w, line[len] ? line + len + 1 : line + len);
+}
+
+ObjCube* world_find_obj(ClientWorld* w, int id) {
+    for (int i = 0; i < w->objCount; i++) {
+        if (w->objs[i].id == id) return &w->objs[i];
+    }
+    return NULL;
+}
+
+ObjCube* world_alloc_obj(ClientWorld* w, int id) {
+    ObjCube* o = world_find_obj(w, id);
+    if (o) return o;
+    if (w->objCount >= MAX_OBJS) return NULL;
+    o = &w->objs[w->objCount++];
+    memset(o, 0, sizeof(*o));
+    o->alive = 1;
+    o->id = id;
+    return o;
+}
+
+void world_remove_obj(ClientWorld* w, ObjCube* o) {
+    ObjCube* last = &w->objs[w->objCount - 1];
+    if (o != last) *o = *last;
+    last->alive = 0;
+    w->objCount--;
+}
+
+void world_clear_objs(ClientWorld* w) {
+    for (int i = 0; i < w->objCount; i++) w->objs[i].alive = 0;
+    w->objCount = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+// Client-side replica of what the server tells us: player state, terminal
+// history and world objects. Pure data + protocol handling, no raylib, so it
+// can be driven headlessly (benchmarks, tools).
+
+#include <stdint.h>
+
+#include "terminal_ui.h"
+#include "interp.h"
+
+#define MAX_OBJS 256
+
+typedef struct {
+    int id;
+    float x, y, z;
+    float size;
+    unsigned char r, g, b;
+    int alive;
+} ObjCube;
+
+typedef struct {
+    float x, y, z;
+    float yaw, pitch;
+} PlayerState;
+
+typedef struct {
+    TerminalUI term;
+    PlayerState ps;
+    int haveState;
+
+    int haveHistory;
+    int expectHist;
+    int gotHist;
+
+    // server session, kept across reconnects so history can resume
+    int haveSession;
+    uint64_t sessionId;
+
+    // live cubes are packed in objs[0..objCount); removal moves the last
+    // cube into the hole, so pointers are only valid until the next delete
+    ObjCube objs[MAX_OBJS];
+    int objCount;
+
+    // other players, from SNAP/ENT
+    Interp remotes;
+
+    // local time (seconds) the lines being handled arrived; set by the
+    // caller before feeding world_on_line, used to stamp snapshots
+    double clock;
+} ClientWorld;
+
+void     world_init(ClientWorld* w);
+
+// net_poll_lines callback; ud is the ClientWorld.
+void     world_on_line(const char* line, void* ud);
+
+ObjCube* world_find_obj(ClientWorld* w, int id);
+ObjCube* world_alloc_obj(ClientWorld* w, int id);
+void     world_remove_obj(ClientWorld* w, ObjCube* o);
+void     world_clear_objs(ClientWorld* w);
+
+#endif
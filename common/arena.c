@@ -0,0 +1,94 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+struct ArenaBlock {
+    ArenaBlock* prev;
+    size_t cap;
+    // data follows, at the next ARENA_ALIGN boundary
+};
+
+static size_t align_up(size_t n) {
+    return (n + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static uint8_t* block_data(ArenaBlock* b) {
+    return (uint8_t*)b + align_up(sizeof(ArenaBlock));
+}
+
+static ArenaBlock* block_new(Arena* a, size_t cap, ArenaBlock* prev) {
+    ArenaBlock* b = (ArenaBlock*)malloc(align_up(sizeof(ArenaBlock)) + cap);
+    if (!b) return NULL;
+    b->prev = prev;
+    b->cap = cap;
+    a->capacity += cap;
+    a->mallocs++;
+    return b;
+}
+
+static void block_drop(Arena* a, ArenaBlock* b) {
+    a->capacity -= b->cap;
+    free(b);
+}
+
+void* arena_alloc(Arena* a, size_t size) {
+    size = align_up(size ? size : 1);
+    if (!a->block || a->block->cap - a->used < size) {
+        // overflow: at least double, so a growing request chains few blocks
+        size_t minBlock = a->minBlock ? a->minBlock : ARENA_MIN_BLOCK;
+        size_t cap = a->block ? a->block->cap * 2 : minBlock;
+        if (cap < size) cap = align_up(size);
+        ArenaBlock* b = block_new(a, cap, a->block);
+        if (!b) return NULL;
+        a->block = b;
+        a->used = 0;
+    }
+    void* p = block_data(a->block) + a->used;
+    a->used += size;
+    a->inUse += size;
+    if (a->inUse > a->peak) a->peak = a->inUse;
+    return p;
+}
+
+ArenaMark arena_mark(const Arena* a) {
+    ArenaMark m;
+    m.block = a->block;
+    m.used = a->used;
+    m.inUse = a->inUse;
+    return m;
+}
+
+void arena_release(Arena* a, ArenaMark m) {
+    // drop overflow blocks opened since the mark, but always keep the base
+    // block: a mark taken on an empty arena should not give its memory back
+    while (a->block && a->block != m.block && a->block->prev) {
+        ArenaBlock* prev = a->block->prev;
+        block_drop(a, a->block);
+        a->block = prev;
+    }
+    a->used = a->block == m.block ? m.used : 0;
+    a->inUse = m.inUse;
+}
+
+void arena_reset(Arena* a) {
+    if (a->block && a->block->prev) {
+        // the request did not fit one block: replace the chain by one that
+        // holds its peak, ready for the next request
+        size_t cap = a->block->cap;
+        if (cap < a->peak) cap = a->peak;
+        arena_free(a);
+        a->block = block_new(a, cap, NULL);
+    }
+    a->used = 0;
+    a->inUse = 0;
+    a->peak = 0;
+}
+
+void arena_free(Arena* a) {
+    while (a->block) {
+        ArenaBlock* prev = a->block->prev;
+        block_drop(a, a->block);
+        a->block = prev;
+    }
+    a->used = a->inUse = a->peak = 0;
+}
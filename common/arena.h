@@ -0,0 +1,49 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator for scratch memory that lives for one request. Allocating
+// moves a pointer; arena_reset drops everything at once and keeps the
+// memory for the next request. A request that outgrows the current block
+// chains overflow blocks, and the next reset swaps them for a single block
+// big enough for the whole request, so once sizes settle a request costs no
+// malloc at all.
+//
+// A zeroed Arena is ready to use. Not thread-safe: one per thread.
+
+#define ARENA_MIN_BLOCK  (64 * 1024)
+#define ARENA_ALIGN      16
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* block;     // current block; older ones hang off it
+    size_t used;           // bytes taken from the current block
+    size_t inUse;          // bytes handed out since the last reset
+    size_t peak;           // largest inUse since the last reset
+    size_t minBlock;       // 0 = ARENA_MIN_BLOCK
+    size_t capacity;       // bytes held across all blocks
+    uint64_t mallocs;      // blocks ever allocated
+} Arena;
+
+typedef struct {
+    ArenaBlock* block;
+    size_t used, inUse;
+} ArenaMark;
+
+// ARENA_ALIGN-aligned and uninitialized; NULL if out of memory.
+void*  arena_alloc(Arena* a, size_t size);
+
+// Frees everything allocated after the mark, for scratch inside a request.
+ArenaMark arena_mark(const Arena* a);
+void   arena_release(Arena* a, ArenaMark m);
+
+// Ends the request: O(1) unless it needed overflow blocks.
+void   arena_reset(Arena* a);
+
+// Returns all memory; the arena can be used again afterwards.
+void   arena_free(Arena* a);
+
+#endif
@@ -0,0 +1,39 @@
+#include "entropy.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+  #include <bcrypt.h>
+  #pragma comment(lib, "bcrypt.lib")
+#else
+  #include <stdio.h>
+  #if defined(__linux__)
+    #include <errno.h>
+    #include <sys/random.h>
+  #endif
+#endif
+
+int entropy_fill(void* out, size_t len) {
+#ifdef _WIN32
+    return BCryptGenRandom(NULL, (PUCHAR)out, (ULONG)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+    unsigned char* p = (unsigned char*)out;
+  #if defined(__linux__)
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;                      // ENOSYS on old kernels: try the device
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    if (len == 0) return 1;
+  #endif
+    FILE* f = fopen("/dev/urandom", "rb");
+    if (!f) return 0;
+    size_t got = fread(p, 1, len, f);
+    fclose(f);
+    return got == len;
+#endif
+}
@@ -0,0 +1,13 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stddef.h>
+
+// Unpredictable bytes from the OS generator, for values a remote peer must
+// not be able to guess (session resume ids, UDP tokens). Not for gameplay
+// randomness, which has to replay from the journal.
+//
+// Returns 0 if the OS could not supply len bytes; out is then undefined.
+int entropy_fill(void* out, size_t len);
+
+#endif
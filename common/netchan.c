@@ -0,0 +1,335 @@
+#include "netchan.h"
+
+#include <string.h>
+
+// Packet layout, little-endian:
+//   u32 token, u16 seq, u16 ack, u32 ackBits, u16 relAck, u8 flags,
+//   u8 msgCount, then msgCount x { u8 lane, u16 id, u16 len, len bytes }
+// flags bit 0: ack/ackBits are valid (the sender has heard from us).
+#define HEADER_BYTES 16
+#define FLAG_ACK 1
+#define MSG_HEADER_BYTES 5
+
+#define REL_MASK (NETCHAN_REL_WINDOW - 1)
+
+static int seq_newer(uint16_t a, uint16_t b) {
+    return (int16_t)(uint16_t)(a - b) > 0;
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+void netchan_init(NetChan* ch, uint32_t token, double now) {
+    memset(ch, 0, sizeof(*ch));
+    ch->token = token;
+    ch->lastRecv = now;
+    ch->rtt = 0.1;
+    for (int l = 1; l < NETCHAN_LANES; l++) ch->lanes[l].redundancy = 1;
+}
+
+void netchan_set_redundancy(NetChan* ch, int lane, int packets) {
+    if (lane <= 0 || lane >= NETCHAN_LANES) return;
+    if (packets < 1) packets = 1;
+    ch->lanes[lane].redundancy = packets;
+}
+
+// Appends to m if it has not gone out yet and there is room.
+static int msg_append(NetChanMsg* m, const char* text, int len) {
+    if (m->sent || m->len + len > NETCHAN_MAX_MSG) return 0;
+    memcpy(m->data + m->len, text, (size_t)len);
+    m->len = (uint16_t)(m->len + len);
+    return 1;
+}
+
+static int queue_line(NetChan* ch, int lane, const char* text, int len) {
+    if (len > NETCHAN_MAX_MSG) len = NETCHAN_MAX_MSG;
+
+    if (lane == NETCHAN_RELIABLE) {
+        if (ch->relNext != ch->relBase && msg_append(&ch->relOut[(uint16_t)(ch->relNext - 1) & REL_MASK], text, len)) return 1;
+        if ((uint16_t)(ch->relNext - ch->relBase) >= NETCHAN_REL_WINDOW) return 0;
+        NetChanMsg* m = &ch->relOut[ch->relNext & REL_MASK];
+        m->id = ch->relNext++;
+        m->len = 0;
+        m->sent = 0;
+        m->acked = 0;
+        return msg_append(m, text, len);
+    }
+
+    NetChanLane* L = &ch->lanes[lane];
+    if (L->count > 0 && msg_append(&L->msgs[L->head], text, len)) return 1;
+    L->head = (L->head + 1) % NETCHAN_LANE_KEEP;
+    if (L->count < NETCHAN_LANE_KEEP) L->count++;
+    NetChanMsg* m = &L->msgs[L->head];
+    m->id = L->nextId++;
+    m->len = 0;
+    m->sent = 0;
+    L->sends[L->head] = 0;
+    return msg_append(m, text, len);
+}
+
+int netchan_queue(NetChan* ch, int lane, const char* text, int len) {
+    if (lane < 0 || lane >= NETCHAN_LANES) return 0;
+    // one line at a time, so a message never splits a line
+    while (len > 0) {
+        const char* nl = (const char*)memchr(text, '\n', (size_t)len);
+        int n = nl ? (int)(nl - text) + 1 : len;
+        if (!queue_line(ch, lane, text, n)) return 0;
+        text += n;
+        len -= n;
+    }
+    return 1;
+}
+
+int netchan_peek_token(const uint8_t* pkt, int len, uint32_t* token) {
+    if (len < HEADER_BYTES) return 0;
+    *token = get32(pkt);
+    return 1;
+}
+
+static void on_acked(NetChan* ch, uint16_t seq, double now) {
+    NetChanSent* s = &ch->sent[seq % NETCHAN_SENT_KEEP];
+    if (!s->valid || s->seq != seq) return;
+    ch->rtt += ((now - s->sentAt) - ch->rtt) * 0.1;
+    // reliable messages whose latest copy rode in this packet have arrived,
+    // even if the cumulative ack is still held up by an earlier loss
+    for (uint16_t id = ch->relBase; id != ch->relNext; id++) {
+        NetChanMsg* m = &ch->relOut[id & REL_MASK];
+        if (m->sent && m->packet == seq) m->acked = 1;
+    }
+    for (int l = 1; l < NETCHAN_LANES; l++) {
+        NetChanLane* L = &ch->lanes[l];
+        if (!s->laneHas[l]) continue;
+        if (!L->haveAcked || seq_newer(s->laneTop[l], L->acked)) {
+            L->acked = s->laneTop[l];
+            L->haveAcked = 1;
+        }
+    }
+    s->valid = 0;
+}
+
+// Records seq in the receive window. Returns 0 for a duplicate.
+static int mark_received(NetChan* ch, uint16_t seq) {
+    if (!ch->haveRemote) {
+        ch->haveRemote = 1;
+        ch->remoteSeq = seq;
+        ch->recvBits = 0;
+        return 1;
+    }
+    if (seq_newer(seq, ch->remoteSeq)) {
+        uint16_t shift = (uint16_t)(seq - ch->remoteSeq);
+        if (shift > 32) ch->recvBits = 0;
+        else ch->recvBits = (shift == 32 ? 0 : ch->recvBits << shift) | (1u << (shift - 1));
+        ch->remoteSeq = seq;
+        return 1;
+    }
+    if (seq == ch->remoteSeq) return 0;
+    uint16_t back = (uint16_t)(ch->remoteSeq - seq - 1);
+    if (back < 32) {
+        if (ch->recvBits & (1u << back)) return 0;
+        ch->recvBits |= 1u << back;
+    }
+    // older than the window: the lanes still reject anything stale
+    return 1;
+}
+
+static void receive_reliable(NetChan* ch, uint16_t id, const uint8_t* data, int len,
+                             NetChanDeliverFn fn, void* ud) {
+    uint16_t ahead = (uint16_t)(id - ch->relExpect);
+    if (ahead >= NETCHAN_REL_WINDOW) {
+        ch->dropped++;   // already delivered (or impossibly far ahead)
+        return;
+    }
+    NetChanMsg* m = &ch->relIn[id & REL_MASK];
+    if (ch->relHave[id & REL_MASK]) {
+        ch->dropped++;
+        return;
+    }
+    m->id = id;
+    m->len = (uint16_t)len;
+    memcpy(m->data, data, (size_t)len);
+    ch->relHave[id & REL_MASK] = 1;
+
+    while (ch->relHave[ch->relExpect & REL_MASK]) {
+        NetChanMsg* r = &ch->relIn[ch->relExpect & REL_MASK];
+        ch->relHave[ch->relExpect & REL_MASK] = 0;
+        ch->relExpect++;
+        fn(NETCHAN_RELIABLE, r->data, r->len, ud);
+    }
+}
+
+int netchan_receive(NetChan* ch, const uint8_t* pkt, int len, double now,
+                    NetChanDeliverFn fn, void* ud) {
+    if (len < HEADER_BYTES || get32(pkt) != ch->token) return 0;
+    uint16_t seq = get16(pkt + 4);
+    uint16_t ack = get16(pkt + 6);
+    uint32_t ackBits = get32(pkt + 8);
+    uint16_t relAck = get16(pkt + 12);
+    int flags = pkt[14];
+    int count = pkt[15];
+
+    // validate the message table before acting on any of it
+    int pos = HEADER_BYTES;
+    for (int i = 0; i < count; i++) {
+        if (pos + MSG_HEADER_BYTES > len) return 0;
+        int mlen = get16(pkt + pos + 3);
+        if (pkt[pos] >= NETCHAN_LANES || mlen > NETCHAN_MAX_MSG || pos + MSG_HEADER_BYTES + mlen > len) return 0;
+        pos += MSG_HEADER_BYTES + mlen;
+    }
+
+    ch->lastRecv = now;
+    ch->packetsIn++;
+    ch->bytesIn += (uint64_t)len;
+    if (!mark_received(ch, seq)) {
+        ch->dropped++;
+        return 1;
+    }
+
+    if (flags & FLAG_ACK) {
+        on_acked(ch, ack, now);
+        for (int i = 0; i < 32; i++) {
+            if (ackBits & (1u << i)) on_acked(ch, (uint16_t)(ack - 1 - i), now);
+        }
+    }
+
+    // cumulative ack of the reliable lane; ignore anything past what we sent
+    if (!seq_newer(relAck, ch->relNext)) {
+        while (ch->relBase != ch->relNext && seq_newer(relAck, ch->relBase)) ch->relBase++;
+    }
+
+    pos = HEADER_BYTES;
+    for (int i = 0; i < count; i++) {
+        int lane = pkt[pos];
+        uint16_t id = get16(pkt + pos + 1);
+        int mlen = get16(pkt + pos + 3);
+        const uint8_t* data = pkt + pos + MSG_HEADER_BYTES;
+        pos += MSG_HEADER_BYTES + mlen;
+
+        if (lane == NETCHAN_RELIABLE) {
+            receive_reliable(ch, id, data, mlen, fn, ud);
+            continue;
+        }
+        NetChanLane* L = &ch->lanes[lane];
+        if (L->haveDelivered && !seq_newer(id, L->delivered)) {
+            ch->dropped++;
+            continue;
+        }
+        L->delivered = id;
+        L->haveDelivered = 1;
+        fn(lane, (const char*)data, mlen, ud);
+    }
+
+    if (count > 0 && !ch->ackOwed) {
+        ch->ackOwed = 1;
+        ch->ackOwedSince = now;
+    }
+    return 1;
+}
+
+static int rel_due(const NetChan* ch, const NetChanMsg* m, double now) {
+    double rto = ch->rtt * 2.0;
+    if (rto < NETCHAN_MIN_RTO) rto = NETCHAN_MIN_RTO;
+    if (m->acked) return 0;
+    return !m->sent || now - m->sentAt >= rto;
+}
+
+// Whether anything forces a packet out now. Unreliable messages that have
+// already gone out once only ride along; they never trigger a packet.
+static int packet_due(const NetChan* ch, double now) {
+    for (int l = 1; l < NETCHAN_LANES; l++) {
+        const NetChanLane* L = &ch->lanes[l];
+        if (L->count > 0 && !L->msgs[L->head].sent) return 1;
+    }
+    for (uint16_t id = ch->relBase; id != ch->relNext; id++) {
+        if (rel_due(ch, &ch->relOut[id & REL_MASK], now)) return 1;
+    }
+    if (ch->ackOwed && now - ch->ackOwedSince >= NETCHAN_ACK_DELAY) return 1;
+    return now - ch->lastSend >= NETCHAN_KEEPALIVE;
+}
+
+static int put_msg(uint8_t* out, int* pos, int lane, const NetChanMsg* m) {
+    if (*pos + MSG_HEADER_BYTES + m->len > NETCHAN_MAX_PACKET) return 0;
+    uint8_t* p = out + *pos;
+    p[0] = (uint8_t)lane;
+    put16(p + 1, m->id);
+    put16(p + 3, m->len);
+    memcpy(p + MSG_HEADER_BYTES, m->data, m->len);
+    *pos += MSG_HEADER_BYTES + m->len;
+    return 1;
+}
+
+int netchan_flush(NetChan* ch, double now, uint8_t* out) {
+    if (!packet_due(ch, now)) return 0;
+
+    NetChanSent* rec = &ch->sent[ch->seq % NETCHAN_SENT_KEEP];
+    if (rec->valid) ch->lost++;
+    memset(rec, 0, sizeof(*rec));
+
+    int pos = HEADER_BYTES;
+    int count = 0;
+
+    // unreliable first: latest state beats catching up on old text
+    for (int l = 1; l < NETCHAN_LANES; l++) {
+        NetChanLane* L = &ch->lanes[l];
+        for (int k = L->count - 1; k >= 0 && count < 255; k--) {
+            int slot = (L->head - k + NETCHAN_LANE_KEEP) % NETCHAN_LANE_KEEP;
+            NetChanMsg* m = &L->msgs[slot];
+            if (L->sends[slot] >= L->redundancy || (m->sent && m->sentAt == now)) continue;
+            if (L->haveAcked && !seq_newer(m->id, L->acked)) continue;
+            if (!put_msg(out, &pos, l, m)) break;
+            L->sends[slot]++;
+            m->sent = 1;
+            m->sentAt = now;
+            rec->laneTop[l] = m->id;
+            rec->laneHas[l] = 1;
+            count++;
+        }
+    }
+
+    for (uint16_t id = ch->relBase; id != ch->relNext && count < 255; id++) {
+        NetChanMsg* m = &ch->relOut[id & REL_MASK];
+        if (!rel_due(ch, m, now)) continue;
+        if (!put_msg(out, &pos, NETCHAN_RELIABLE, m)) break;
+        if (m->sent) ch->resends++;
+        m->sent = 1;
+        m->sentAt = now;
+        m->packet = ch->seq;
+        count++;
+    }
+
+    put32(out, ch->token);
+    put16(out + 4, ch->seq);
+    put16(out + 6, ch->remoteSeq);
+    put32(out + 8, ch->recvBits);
+    put16(out + 12, ch->relExpect);
+    out[14] = ch->haveRemote ? FLAG_ACK : 0;
+    out[15] = (uint8_t)count;
+
+    rec->seq = ch->seq;
+    rec->valid = 1;
+    rec->sentAt = now;
+    ch->seq++;
+    ch->lastSend = now;
+    ch->ackOwed = 0;
+    ch->packetsOut++;
+    ch->bytesOut += (uint64_t)pos;
+    return pos;
+}
+
+int netchan_timed_out(const NetChan* ch, double now) {
+    return now - ch->lastRecv > NETCHAN_TIMEOUT;
+}
@@ -0,0 +1,129 @@
+#ifndef NETCHAN_H
+#define NETCHAN_H
+
+#include <stdint.h>
+
+// Datagram channel for the optional UDP transport. Pure packet logic, no
+// sockets: the owner feeds received datagrams in and sends what
+// netchan_flush produces. Shared by server, client and tools.
+//
+// Every packet carries a sequence number and acks for the peer's last 33
+// packets. Messages travel on lanes:
+//
+//   lane 0         reliable-ordered: resent every RTO until the packet
+//                  carrying its latest copy is acked or the peer's
+//                  cumulative ack covers it; delivered once and in order
+//   lanes 1..N-1   unreliable-sequenced: only messages newer than the last
+//                  one delivered get through, older arrivals are dropped.
+//                  The newest few are repeated in following packets until
+//                  acked (see netchan_set_redundancy), so a single lost
+//                  packet costs nothing.
+//
+// A message is one or more protocol lines, each ending in '\n'. Lines
+// queued on a lane before the next flush are packed into one message.
+
+#define NETCHAN_LANES        3
+#define NETCHAN_RELIABLE     0
+#define NETCHAN_LANE_INPUT   1      // INPUT up, STATE down
+#define NETCHAN_LANE_SNAP    2      // SNAP/ENT down
+
+#define NETCHAN_MAX_PACKET   1200   // stays under a typical path MTU
+#define NETCHAN_MAX_MSG      1024
+#define NETCHAN_REL_WINDOW   64     // reliable messages in flight, power of two
+#define NETCHAN_LANE_KEEP    4      // unreliable messages kept per lane
+#define NETCHAN_SENT_KEEP    64     // sent packets remembered for acks
+
+#define NETCHAN_MIN_RTO      0.05   // seconds before a reliable resend
+#define NETCHAN_ACK_DELAY    0.02   // longest an ack waits for a ride
+#define NETCHAN_KEEPALIVE    0.25   // idle packet interval
+#define NETCHAN_TIMEOUT      10.0   // silence before the peer counts as gone
+
+typedef struct {
+    uint16_t id;
+    uint16_t len;
+    uint8_t  sent;         // has gone out at least once
+    double   sentAt;
+    uint16_t packet;       // reliable: packet it last went out in
+    uint8_t  acked;        // reliable: that packet was acked, no resend
+    char     data[NETCHAN_MAX_MSG];
+} NetChanMsg;
+
+typedef struct {
+    NetChanMsg msgs[NETCHAN_LANE_KEEP];   // ring, newest at head
+    int head, count;
+    uint16_t nextId;
+    uint16_t acked;        // newest id the peer has acknowledged
+    int haveAcked;
+    int sends[NETCHAN_LANE_KEEP];
+    int redundancy;        // packets each message rides in, at most
+
+    uint16_t delivered;    // receiving side: newest id handed out
+    int haveDelivered;
+} NetChanLane;
+
+typedef struct {
+    uint16_t seq;
+    int valid;
+    double sentAt;
+    uint16_t laneTop[NETCHAN_LANES];   // newest unreliable id included, per lane
+    uint8_t laneHas[NETCHAN_LANES];
+} NetChanSent;
+
+typedef struct {
+    uint32_t token;        // stamped on every packet; picks the connection
+
+    // packet sequencing
+    uint16_t seq;          // next outgoing
+    uint16_t remoteSeq;    // newest received
+    uint32_t recvBits;     // bit i set: remoteSeq - 1 - i was received
+    int haveRemote;
+    int ackOwed;           // received messages not acked yet
+    double ackOwedSince;
+    double lastSend, lastRecv;
+    double rtt;            // smoothed, seconds
+    NetChanSent sent[NETCHAN_SENT_KEEP];
+
+    // reliable lane, outgoing: ids [relBase, relNext) are in relOut
+    NetChanMsg relOut[NETCHAN_REL_WINDOW];
+    uint16_t relBase, relNext;
+
+    // reliable lane, incoming: relIn holds early arrivals
+    NetChanMsg relIn[NETCHAN_REL_WINDOW];
+    uint8_t relHave[NETCHAN_REL_WINDOW];
+    uint16_t relExpect;
+
+    NetChanLane lanes[NETCHAN_LANES];   // [0] unused
+
+    // counters
+    uint64_t packetsOut, packetsIn, bytesOut, bytesIn;
+    uint64_t resends;      // reliable messages sent again
+    uint64_t dropped;      // stale or duplicate arrivals ignored
+    uint64_t lost;         // own packets that fell out of the ack window unacked
+} NetChan;
+
+typedef void (*NetChanDeliverFn)(int lane, const char* data, int len, void* ud);
+
+void netchan_init(NetChan* ch, uint32_t token, double now);
+void netchan_set_redundancy(NetChan* ch, int lane, int packets);
+
+// Queues text (whole lines) on a lane. Returns 0 if the reliable window is
+// full; the connection should then be dropped, it cannot keep up.
+int  netchan_queue(NetChan* ch, int lane, const char* text, int len);
+
+// Reads the token of a raw packet; 0 if too short to be one.
+int  netchan_peek_token(const uint8_t* pkt, int len, uint32_t* token);
+
+// Handles one received datagram: acks, then every message that may be
+// delivered, in order, through fn. Returns 0 if the packet was malformed.
+int  netchan_receive(NetChan* ch, const uint8_t* pkt, int len, double now,
+                     NetChanDeliverFn fn, void* ud);
+
+// Builds the next packet that is due into out (NETCHAN_MAX_PACKET bytes):
+// new messages, reliable resends, an owed ack or a keepalive. Returns its
+// length, or 0 when nothing needs sending now. Call until it returns 0.
+int  netchan_flush(NetChan* ch, double now, uint8_t* out);
+
+// 1 once the peer has been silent for NETCHAN_TIMEOUT.
+int  netchan_timed_out(const NetChan* ch, double now);
+
+#endif
@@ -0,0 +1,183 @@
+#include "netsim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int netsim_arg(NetSimConfig* cfg, const char* flag, const char* value) {
+    double v = atof(value);
+    if (v < 0.0) v = 0.0;
+    if      (strcmp(flag, "--sim-latency") == 0)   cfg->latencyMs = v;
+    else if (strcmp(flag, "--sim-jitter") == 0)    cfg->jitterMs = v;
+    else if (strcmp(flag, "--sim-bandwidth") == 0) cfg->bandwidthKbps = v;
+    else if (strcmp(flag, "--sim-loss") == 0)      cfg->lossPct = v > 100.0 ? 100.0 : v;
+    else if (strcmp(flag, "--sim-reorder") == 0)   cfg->reorderPct = v > 100.0 ? 100.0 : v;
+    else return 0;
+    return 1;
+}
+
+int netsim_active(const NetSimConfig* cfg) {
+    return cfg->latencyMs > 0.0 || cfg->jitterMs > 0.0 || cfg->bandwidthKbps > 0.0 ||
+           cfg->lossPct > 0.0 || cfg->reorderPct > 0.0;
+}
+
+void netsim_describe(const NetSimConfig* cfg, char* out, int cap) {
+    char bw[32] = "unlimited";
+    if (cfg->bandwidthKbps > 0.0) snprintf(bw, sizeof(bw), "%.0f kbit/s", cfg->bandwidthKbps);
+    snprintf(out, (size_t)cap, "latency %.0f+-%.0f ms, %s, loss %.1f%%, reorder %.1f%%",
+             cfg->latencyMs, cfg->jitterMs, bw, cfg->lossPct, cfg->reorderPct);
+}
+
+void netsim_init(NetSim* sim, const NetSimConfig* cfg, int datagram, uint32_t seed) {
+    memset(sim, 0, sizeof(*sim));
+    sim->cfg = *cfg;
+    sim->datagram = datagram;
+    sim->rng = seed ? seed : 0x9E3779B9u;
+}
+
+void netsim_free(NetSim* sim) {
+    for (int i = 0; i < sim->count; i++) free(sim->q[sim->head + i].data);
+    free(sim->q);
+    sim->q = NULL;
+    sim->head = sim->count = sim->cap = 0;
+    sim->bytes = 0;
+}
+
+// xorshift32, uniform in [0, 1)
+static double sim_rand(NetSim* sim) {
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return (x >> 8) * (1.0 / 16777216.0);
+}
+
+// Makes room for one more chunk at the end of the queue.
+static int sim_reserve(NetSim* sim) {
+    if (sim->head + sim->count < sim->cap) return 1;
+    if (sim->head > 0) {
+        memmove(sim->q, sim->q + sim->head, (size_t)sim->count * sizeof(NetSimChunk));
+        sim->head = 0;
+        if (sim->count < sim->cap) return 1;
+    }
+    int cap = sim->cap ? sim->cap * 2 : 64;
+    NetSimChunk* q = (NetSimChunk*)realloc(sim->q, (size_t)cap * sizeof(NetSimChunk));
+    if (!q) return 0;
+    sim->q = q;
+    sim->cap = cap;
+    return 1;
+}
+
+int netsim_push(NetSim* sim, const void* data, int len, double now) {
+    if (len <= 0) return 1;
+    if (sim->datagram && sim_rand(sim) * 100.0 < sim->cfg.lossPct) {
+        sim->lost++;
+        return 1;
+    }
+    if (sim->bytes + len > NETSIM_MAX_QUEUED) {
+        if (!sim->datagram) return 0;
+        sim->overflowed++;
+        return 1;
+    }
+
+    // serialize onto the link, then cross it
+    double t = now;
+    if (sim->cfg.bandwidthKbps > 0.0) {
+        if (sim->linkFree > t) t = sim->linkFree;
+        t += len * 8.0 / (sim->cfg.bandwidthKbps * 1000.0);
+        sim->linkFree = t;
+    }
+    double delay = sim->cfg.latencyMs + sim->cfg.jitterMs * (2.0 * sim_rand(sim) - 1.0);
+    double due = t + (delay > 0.0 ? delay * 0.001 : 0.0);
+    if (sim->datagram) {
+        if (sim_rand(sim) * 100.0 < sim->cfg.reorderPct) {
+            due += 2.0 * sim->cfg.jitterMs * 0.001 + NETSIM_REORDER_HOLD;
+            sim->reordered++;
+        }
+    } else {
+        if (due < sim->lastDue) due = sim->lastDue;
+        sim->lastDue = due;
+    }
+
+    uint8_t* copy = (uint8_t*)malloc((size_t)len);
+    if (!copy || !sim_reserve(sim)) {
+        free(copy);
+        if (!sim->datagram) return 0;
+        sim->overflowed++;
+        return 1;
+    }
+    memcpy(copy, data, (size_t)len);
+
+    // sorted insert from the back; usually it belongs there
+    int i = sim->head + sim->count;
+    while (i > sim->head && sim->q[i - 1].due > due) i--;
+    memmove(sim->q + i + 1, sim->q + i, (size_t)(sim->head + sim->count - i) * sizeof(NetSimChunk));
+    sim->q[i].due = due;
+    sim->q[i].len = len;
+    sim->q[i].off = 0;
+    sim->q[i].data = copy;
+    sim->count++;
+    sim->bytes += len;
+    return 1;
+}
+
+int netsim_pop(NetSim* sim, double now, void* out, int cap) {
+    if (sim->count == 0 || sim->q[sim->head].due > now || cap <= 0) return 0;
+    NetSimChunk* c = &sim->q[sim->head];
+    int n = c->len - c->off;
+    if (n > cap) n = cap;
+    memcpy(out, c->data + c->off, (size_t)n);
+
+    c->off += n;
+    if (sim->datagram || c->off == c->len) {
+        sim->bytes -= c->len - (c->off - n);
+        free(c->data);
+        sim->head++;
+        sim->count--;
+        sim->passed++;
+        if (sim->count == 0) sim->head = 0;
+    } else {
+        sim->bytes -= n;
+    }
+    return n;
+}
+
+int netsim_next_due(const NetSim* sim, double* due) {
+    if (sim->count == 0) return 0;
+    *due = sim->q[sim->head].due;
+    return 1;
+}
+
+NetSimPipes* netsim_pipes_open(const NetSimConfig* cfg, uint32_t seed) {
+    if (!netsim_active(cfg)) return NULL;
+    NetSimPipes* p = (NetSimPipes*)calloc(1, sizeof(NetSimPipes));
+    if (!p) return NULL;
+    // each direction draws its own loss/jitter sequence
+    netsim_init(&p->tcpOut, cfg, 0, seed);
+    netsim_init(&p->tcpIn, cfg, 0, seed * 3u + 1u);
+    netsim_init(&p->udpOut, cfg, 1, seed * 5u + 2u);
+    netsim_init(&p->udpIn, cfg, 1, seed * 7u + 3u);
+    return p;
+}
+
+void netsim_pipes_close(NetSimPipes* p) {
+    if (!p) return;
+    netsim_free(&p->tcpOut);
+    netsim_free(&p->tcpIn);
+    netsim_free(&p->udpOut);
+    netsim_free(&p->udpIn);
+    free(p);
+}
+
+int netsim_pipes_next_due(const NetSimPipes* p, double* due) {
+    const NetSim* q[4] = { &p->tcpOut, &p->tcpIn, &p->udpOut, &p->udpIn };
+    int any = 0;
+    for (int i = 0; i < 4; i++) {
+        double d;
+        if (!netsim_next_due(q[i], &d)) continue;
+        if (!any || d < *due) *due = d;
+        any = 1;
+    }
+    return any;
+}
@@ -0,0 +1,92 @@
+#ifndef NETSIM_H
+#define NETSIM_H
+
+#include <stdint.h>
+
+// Network condition simulator for loopback testing. A NetSim is one
+// direction of one socket: bytes (stream) or datagrams go in as they are
+// sent or received, and come out once the simulated link would have
+// delivered them. No sockets here; client/net.c and the server wrap their
+// send/recv calls with it when any --sim-* flag is given.
+//
+//   latency    one-way delay added in each direction
+//   jitter     +/- uniform spread around the latency
+//   bandwidth  link rate; bytes queue behind each other at this rate
+//   loss       datagrams only: chance a packet silently vanishes
+//   reorder    datagrams only: chance a packet is held back by twice the
+//              jitter plus NETSIM_REORDER_HOLD, landing behind later ones
+//
+// A stream never reorders or loses bytes: jitter only delays, and each chunk
+// comes out no earlier than the one before it, as over real TCP.
+
+#define NETSIM_MAX_QUEUED    (4 << 20)   // bytes held per direction
+#define NETSIM_REORDER_HOLD  0.02        // seconds
+
+typedef struct {
+    double latencyMs;
+    double jitterMs;
+    double bandwidthKbps;  // kilobits per second, 0 = unlimited
+    double lossPct;        // 0..100
+    double reorderPct;     // 0..100
+} NetSimConfig;
+
+typedef struct {
+    double due;            // local time it leaves the simulated link
+    int len, off;          // off: bytes of a stream chunk already popped
+    uint8_t* data;
+} NetSimChunk;
+
+typedef struct {
+    NetSimConfig cfg;
+    int datagram;
+
+    NetSimChunk* q;        // q[head..head+count), sorted by due
+    int head, count, cap;
+    int bytes;             // queued, not yet popped
+
+    double linkFree;       // bandwidth: when the link finishes the last chunk
+    double lastDue;        // stream: chunks leave in order
+    uint32_t rng;
+
+    uint64_t passed, lost, reordered, overflowed;
+} NetSim;
+
+// Everything one connection sends and receives: both directions of its TCP
+// stream and of its optional datagram channel.
+typedef struct {
+    NetSim tcpOut, tcpIn, udpOut, udpIn;
+    int peerClosed;        // the TCP socket hit EOF; what is queued still arrives
+} NetSimPipes;
+
+// Recognizes one --sim-* flag with its value. Returns 1 if it was one.
+int  netsim_arg(NetSimConfig* cfg, const char* flag, const char* value);
+
+// 1 if cfg changes anything, i.e. the simulator should be wrapped in.
+int  netsim_active(const NetSimConfig* cfg);
+
+// "latency 80+-20 ms, 512 kbit/s, loss 5%, reorder 2%" for startup logs.
+void netsim_describe(const NetSimConfig* cfg, char* out, int cap);
+
+void netsim_init(NetSim* sim, const NetSimConfig* cfg, int datagram, uint32_t seed);
+void netsim_free(NetSim* sim);
+
+// NULL when cfg is not active (or out of memory): no simulation.
+NetSimPipes* netsim_pipes_open(const NetSimConfig* cfg, uint32_t seed);
+void netsim_pipes_close(NetSimPipes* p);
+
+// Earliest moment anything queued in p comes out, in any direction.
+int  netsim_pipes_next_due(const NetSimPipes* p, double* due);
+
+// Hands data to the link at local time now. A stream returns 0 when
+// NETSIM_MAX_QUEUED would be exceeded (the caller waits, as on a full send
+// buffer); a datagram that does not fit is dropped like any other.
+int  netsim_push(NetSim* sim, const void* data, int len, double now);
+
+// Takes the next delivered chunk, up to cap bytes of it (a datagram longer
+// than cap is truncated). Returns its length, or 0 when nothing is due.
+int  netsim_pop(NetSim* sim, double now, void* out, int cap);
+
+// Sets *due to when the next chunk comes out; 0 when nothing is queued.
+int  netsim_next_due(const NetSim* sim, double* due);
+
+#endif
@@ -0,0 +1,221 @@
+#include "numcodec.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* skip_blanks(const char* s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int num_parse_uint(const char** p, unsigned* out) {
+    const char* s = skip_blanks(*p);
+    int neg = 0;
+    if (*s == '-' || *s == '+') { neg = (*s == '-'); s++; }
+    if (!is_digit(*s)) return 0;
+    unsigned v = 0;
+    while (is_digit(*s)) v = v * 10u + (unsigned)(*s++ - '0');
+    *out = neg ? 0u - v : v;
+    *p = s;
+    return 1;
+}
+
+int num_parse_int(const char** p, int* out) {
+    const char* s = skip_blanks(*p);
+    int neg = (*s == '-');
+    if (*s == '-' || *s == '+') s++;
+    if (!is_digit(*s)) return 0;
+    unsigned v = 0;
+    while (is_digit(*s)) v = v * 10u + (unsigned)(*s++ - '0');
+    *out = neg ? -(int)v : (int)v;
+    *p = s;
+    return 1;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int num_parse_hex64(const char** p, uint64_t* out) {
+    const char* s = skip_blanks(*p);
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X') && hex_value(s[2]) >= 0) s += 2;
+    if (hex_value(*s) < 0) return 0;
+    uint64_t v = 0;
+    int d;
+    while ((d = hex_value(*s)) >= 0) { v = (v << 4) | (uint64_t)d; s++; }
+    *out = v;
+    *p = s;
+    return 1;
+}
+
+int num_parse_hex(const char** p, unsigned* out) {
+    uint64_t v;
+    if (!num_parse_hex64(p, &v)) return 0;
+    *out = (unsigned)v;
+    return 1;
+}
+
+// exactly representable in a double
+static const double kPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+int num_parse_float(const char** p, float* out) {
+    const char* start = skip_blanks(*p);
+    const char* s = start;
+    int neg = 0;
+    if (*s == '-' || *s == '+') { neg = (*s == '-'); s++; }
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) goto slow;
+
+    // plain decimal with up to 19 significant digits: the mantissa fits a
+    // uint64 and the scale is one exact power of ten. Anything else (inf,
+    // nan, hex floats, long or extreme inputs) goes to strtof.
+    // sig counts from the first non-zero digit; mant itself may wrap on
+    // long inputs, which then take the slow path anyway
+    uint64_t mant = 0;
+    int sig = 0, exp10 = 0, any = 0;
+    while (is_digit(*s)) {
+        if (sig || *s != '0') sig++;
+        mant = mant * 10u + (uint64_t)(*s++ - '0');
+        any = 1;
+    }
+    if (*s == '.') {
+        s++;
+        while (is_digit(*s)) {
+            if (sig || *s != '0') sig++;
+            mant = mant * 10u + (uint64_t)(*s++ - '0');
+            exp10--;
+            any = 1;
+        }
+    }
+    if (!any || sig > 19) goto slow;
+
+    if (*s == 'e' || *s == 'E') {
+        const char* e = s + 1;
+        int eneg = 0, ev = 0;
+        if (*e == '-' || *e == '+') { eneg = (*e == '-'); e++; }
+        if (is_digit(*e)) {
+            while (is_digit(*e)) {
+                if (ev < 10000) ev = ev * 10 + (*e - '0');
+                e++;
+            }
+            exp10 += eneg ? -ev : ev;
+            s = e;
+        }
+    }
+
+    if (mant >> 53 || exp10 < -22 || exp10 > 22) goto slow;
+
+    // one correctly rounded double operation, then the float conversion.
+    // That second rounding can only go wrong if the double landed exactly
+    // halfway between two floats (any float midpoint strictly between it
+    // and the true value would have been the nearer double), so that one
+    // case is left to strtof. The range here never reaches float subnormals
+    // or infinity.
+    double v = (double)mant;
+    v = exp10 < 0 ? v / kPow10[-exp10] : v * kPow10[exp10];
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    if ((bits & 0x1fffffffu) == 0x10000000u) goto slow;
+    *out = neg ? -(float)v : (float)v;
+    *p = s;
+    return 1;
+
+slow: {
+        char* end = NULL;
+        float f = strtof(start, &end);
+        if (end == start) return 0;
+        *out = f;
+        *p = end;
+        return 1;
+    }
+}
+
+static const char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes v in decimal, at least minDigits digits (zero padded), no NUL.
+static int put_u64(char* out, uint64_t v, int minDigits) {
+    char tmp[24];
+    int n = 0;
+    while (v >= 100) {
+        const char* d = &kDigitPairs[(v % 100) * 2];
+        v /= 100;
+        tmp[n++] = d[1];
+        tmp[n++] = d[0];
+    }
+    if (v >= 10) {
+        tmp[n++] = kDigitPairs[v * 2 + 1];
+        tmp[n++] = kDigitPairs[v * 2];
+    } else {
+        tmp[n++] = (char)('0' + v);
+    }
+    while (n < minDigits) tmp[n++] = '0';
+    for (int i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+int num_format_int(char* out, int v) {
+    int n = 0;
+    uint32_t u = (uint32_t)v;
+    if (v < 0) {
+        out[n++] = '-';
+        u = 0u - u;
+    }
+    n += put_u64(out + n, u, 1);
+    out[n] = '\0';
+    return n;
+}
+
+static const uint64_t kPow10u[] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+
+int num_format_float(char* out, float v, int decimals) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int bexp = (int)((bits >> 23) & 0xffu);
+    if (bexp == 0xff || decimals < 0 || decimals > 9)
+        return snprintf(out, NUM_FORMAT_MAX, "%.*f", decimals, (double)v);
+
+    // v = m * 2^e exactly, so v * 10^decimals = m * 10^decimals * 2^e: an
+    // integer shifted right, whose dropped bits decide the rounding
+    uint64_t m = bexp ? ((bits & 0x7fffffu) | 0x800000u) : (bits & 0x7fffffu);
+    int e = bexp ? bexp - 150 : -149;
+    uint64_t n = m * kPow10u[decimals];   // < 2^54
+    uint64_t q;
+    if (e >= 0) {
+        if (e >= 10) return snprintf(out, NUM_FORMAT_MAX, "%.*f", decimals, (double)v);
+        q = n << e;
+    } else if (-e >= 64) {
+        q = 0;   // below 2^-10 of the last digit
+    } else {
+        int k = -e;
+        uint64_t rem = n & ((1ull << k) - 1u);
+        uint64_t half = 1ull << (k - 1);
+        q = n >> k;
+        if (rem > half || (rem == half && (q & 1u))) q++;
+    }
+
+    int len = 0;
+    if (bits >> 31) out[len++] = '-';   // "-0.000000" too, like printf
+    len += put_u64(out + len, q / kPow10u[decimals], 1);
+    if (decimals > 0) {
+        out[len++] = '.';
+        len += put_u64(out + len, q % kPow10u[decimals], decimals);
+    }
+    out[len] = '\0';
+    return len;
+}
@@ -0,0 +1,28 @@
+#ifndef NUMCODEC_H
+#define NUMCODEC_H
+
+#include <stdint.h>
+
+// Numeric fields of the ASCII protocol. Locale-independent and allocation
+// free; shared by server, client and tools.
+//
+// Each parser skips leading blanks, reads one number, and advances *p past
+// it. On failure it returns 0 and leaves *p alone. Accepted syntax matches
+// the corresponding sscanf conversion (%d, %u, %x, %f).
+
+int num_parse_int(const char** p, int* out);
+int num_parse_uint(const char** p, unsigned* out);
+int num_parse_hex(const char** p, unsigned* out);
+int num_parse_hex64(const char** p, uint64_t* out);   // %llx
+int num_parse_float(const char** p, float* out);
+
+// Writers: the same text snprintf would produce for "%d" and "%.*f"
+// (decimals 0..9; rounding is exact, ties to even as in glibc), written to
+// out with a terminating NUL. Return the length. out needs NUM_FORMAT_MAX
+// bytes.
+#define NUM_FORMAT_MAX 64
+
+int num_format_int(char* out, int v);
+int num_format_float(char* out, float v, int decimals);
+
+#endif
@@ -3,18 +3,24 @@
 
 // Simple line-based TCP protocol
 // Client -> Server:
-//   HELLO
-//   INPUT <fwd> <right> <up> <yawDelta> <pitchDelta> <dt>
+//   HELLO [<session> <nextSeq>]   (resume: session id from WELCOME, next
+//                                  history seq the client is missing)
+//   INPUT <fwd> <right> <up> <yawDelta> <pitchDelta> <dt> [...]
+//                            (1..PROTO_INPUT_MAX_SAMPLES groups of six,
+//                             simulated in order; one STATE in reply)
 //   CMD <text...>            (toy terminal command)
 // Server -> Client:
-//   WELCOME <version>
+//   WELCOME <version> <session>
 //   STATE <x> <y> <z> <yaw> <pitch>
-//   HIST <n>
-//   LINE <text...>
+//   HIST <n> <seq>          (n LINEs follow, replacing history from seq on)
+//   LINE <text...>          (appends; seq is the previous line's seq + 1)
 //   PROMPT                  (signals prompt line exists already)
 //   OBJ_ADD <id> <x> <y> <z> <s> <r> <g> <b>
 //   OBJ_DEL <id>
 //   OBJ_CLEAR
+//   SNAP <seq> <ms> <n>     (other players at server time ms; n ENTs follow,
+//                            anyone not listed has left)
+//   ENT <id> <x> <y> <z> <yaw>
 // Notes:
 // - All messages are ASCII lines terminated by '\n'.
 // - Server may send LINE messages anytime (terminal output/history).
@@ -22,4 +28,6 @@
 
 #define PROTO_VERSION "0.1"
 
+#define PROTO_INPUT_MAX_SAMPLES 8
+
 #endif
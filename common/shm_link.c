@@ -0,0 +1,187 @@
+#ifndef _WIN32
+  #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "shm_link.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+#define SHM_MAGIC   0x4d48534bu   // "KSHM"
+#define SHM_VERSION 1
+
+enum { SIDE_SERVER, SIDE_CLIENT };
+
+void shmlink_make_name(char* out, int cap, unsigned key) {
+#ifdef _WIN32
+    snprintf(out, (size_t)cap, "Local\\kspace-%lu-%08x", (unsigned long)GetCurrentProcessId(), key);
+#else
+    snprintf(out, (size_t)cap, "/kspace-%ld-%08x", (long)getpid(), key);
+#endif
+}
+
+// Maps size bytes under name; creates the segment when create is set,
+// otherwise takes its size from the existing one.
+static int map_segment(ShmLink* l, const char* name, uint32_t size, int create) {
+#ifdef _WIN32
+    HANDLE h = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, name)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (!h) return 0;
+    if (create && GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(h);
+        return 0;
+    }
+    void* base = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!base) {
+        CloseHandle(h);
+        return 0;
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION mi;
+        VirtualQuery(base, &mi, sizeof(mi));
+        size = (uint32_t)mi.RegionSize;
+    }
+    l->handle = h;
+#else
+    int fd = create ? shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600)
+                    : shm_open(name, O_RDWR, 0);
+    if (fd < 0) return 0;
+    if (create && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    if (!create) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ShmLinkHeader)) {
+            close(fd);
+            return 0;
+        }
+        size = (uint32_t)st.st_size;
+    }
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);   // the mapping keeps the segment
+    if (base == MAP_FAILED) {
+        if (create) shm_unlink(name);
+        return 0;
+    }
+#endif
+    l->base = base;
+    l->size = size;
+    l->hdr = (ShmLinkHeader*)base;
+    snprintf(l->name, sizeof(l->name), "%s", name);
+    return 1;
+}
+
+static int attach_rings(ShmLink* l) {
+    ShmLinkHeader* h = l->hdr;
+    uint8_t* toServer = (uint8_t*)l->base + sizeof(ShmLinkHeader);
+    uint8_t* toClient = toServer + h->ringBytes;
+    SpscRing* srv = l->isServer ? &l->in : &l->out;
+    SpscRing* cli = l->isServer ? &l->out : &l->in;
+    return spsc_attach(srv, &h->toServer, toServer, h->ringBytes) &&
+           spsc_attach(cli, &h->toClient, toClient, h->ringBytes);
+}
+
+int shmlink_create(ShmLink* l, const char* name) {
+    memset(l, 0, sizeof(*l));
+    l->isServer = 1;
+    uint32_t size = (uint32_t)sizeof(ShmLinkHeader) + 2 * SHM_LINK_RING_BYTES;
+    if (!map_segment(l, name, size, 1)) return 0;
+
+    // fresh mappings are zeroed, so the counters and flags start at rest
+    ShmLinkHeader* h = l->hdr;
+    h->version = SHM_VERSION;
+    h->ringBytes = SHM_LINK_RING_BYTES;
+    attach_rings(l);
+    __atomic_store_n(&h->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int shmlink_open(ShmLink* l, const char* name) {
+    memset(l, 0, sizeof(*l));
+    if (!map_segment(l, name, 0, 0)) return 0;
+    ShmLinkHeader* h = l->hdr;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC || h->version != SHM_VERSION ||
+        (uint64_t)sizeof(ShmLinkHeader) + 2ull * h->ringBytes > l->size || !attach_rings(l)) {
+        shmlink_close(l);
+        return 0;
+    }
+    return 1;
+}
+
+void shmlink_unlink(ShmLink* l) {
+#ifndef _WIN32
+    if (l->name[0]) shm_unlink(l->name);
+#endif
+    l->name[0] = '\0';
+}
+
+void shmlink_close(ShmLink* l) {
+    if (!l->base) return;
+    if (l->isServer) shmlink_unlink(l);
+#ifdef _WIN32
+    UnmapViewOfFile(l->base);
+    CloseHandle((HANDLE)l->handle);
+#else
+    munmap(l->base, l->size);
+#endif
+    memset(l, 0, sizeof(*l));
+}
+
+int shmlink_send(ShmLink* l, const char* data, int len) {
+    return spsc_push(&l->out, data, (uint32_t)len);
+}
+
+char* shmlink_peek(ShmLink* l, int* len) {
+    uint32_t n;
+    char* rec = (char*)spsc_peek(&l->in, &n);
+    if (rec) *len = (int)n;
+    return rec;
+}
+
+void shmlink_pop(ShmLink* l) {
+    spsc_pop(&l->in);
+}
+
+int shmlink_corrupt(const ShmLink* l) {
+    return l->in.corrupt;
+}
+
+// The sleep flag and the ring head are a Dekker pair: each side writes its
+// own, fences, then reads the other's, so a record committed just as the
+// reader goes to sleep is seen by one of the two.
+int shmlink_sleep_begin(ShmLink* l) {
+    uint32_t* flag = &l->hdr->waiting[l->isServer ? SIDE_SERVER : SIDE_CLIENT];
+    __atomic_store_n(flag, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (spsc_pending(&l->in)) {
+        __atomic_store_n(flag, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return 1;
+}
+
+void shmlink_sleep_end(ShmLink* l) {
+    __atomic_store_n(&l->hdr->waiting[l->isServer ? SIDE_SERVER : SIDE_CLIENT], 0, __ATOMIC_RELAXED);
+}
+
+int shmlink_wake_needed(ShmLink* l) {
+    uint32_t* flag = &l->hdr->waiting[l->isServer ? SIDE_CLIENT : SIDE_SERVER];
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(flag, __ATOMIC_RELAXED)) return 0;
+    return __atomic_exchange_n(flag, 0, __ATOMIC_RELAXED) != 0;
+}
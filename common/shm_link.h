@@ -0,0 +1,81 @@
+#ifndef SHM_LINK_H
+#define SHM_LINK_H
+
+#include <stdint.h>
+#include "spsc_ring.h"
+
+// Shared-memory transport for a client and server on the same host. One
+// mapping holds two SPSC rings (common/spsc_ring.c), one per direction;
+// each record is one or more protocol lines, so both ends keep their text
+// framing and parsers. Sending or receiving a line is a copy into or out
+// of the mapping, with no system call.
+//
+// The mapping carries no wakeups. A side about to block in select() says
+// so with shmlink_sleep_begin; a sender that finds the flag set clears it
+// and pokes the peer through some descriptor it does wait on (kspace uses
+// a byte on the TCP connection that set the link up). A busy reader is
+// never poked.
+
+#define SHM_LINK_RING_BYTES  (1u << 20)   // per direction
+#define SHM_LINK_NAME_MAX    64
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ringBytes;
+    uint32_t pad;
+    uint32_t waiting[2];   // [side]: asleep, wants a poke on new data
+    uint8_t  pad1[40];
+    SpscCounters toServer, toClient;
+    // then the two ring buffers, toServer first
+} ShmLinkHeader;
+
+typedef struct {
+    char name[SHM_LINK_NAME_MAX];
+    int isServer;
+    ShmLinkHeader* hdr;
+    SpscRing out, in;
+
+    // platform mapping
+    void* base;
+    uint32_t size;
+    void* handle;          // Windows file mapping; unused on POSIX
+} ShmLink;
+
+// Server: creates and maps a fresh segment under name (see
+// shmlink_make_name). Client: maps an existing one. Return 0 on failure.
+int  shmlink_create(ShmLink* l, const char* name);
+int  shmlink_open(ShmLink* l, const char* name);
+
+// A name unique to this process and key, in the platform's namespace.
+void shmlink_make_name(char* out, int cap, unsigned key);
+
+// Removes the name; the mapping stays valid for whoever has it open. The
+// client calls it once attached, so nothing is left behind if either side
+// dies later.
+void shmlink_unlink(ShmLink* l);
+
+// Unmaps (and unlinks, on the server).
+void shmlink_close(ShmLink* l);
+
+// Queues text (whole lines) as one record. Returns 0 if the ring is full.
+int  shmlink_send(ShmLink* l, const char* data, int len);
+
+// The oldest unread record, in place; consume with shmlink_pop. The bytes
+// may be modified (e.g. split in place) until then.
+char* shmlink_peek(ShmLink* l, int* len);
+void  shmlink_pop(ShmLink* l);
+
+// 1 once the peer has written something no correct sender could (see
+// spsc_peek); nothing more is read and the connection should be dropped.
+int   shmlink_corrupt(const ShmLink* l);
+
+// Before blocking: returns 0 if data is already waiting (do not block),
+// else 1 with the sleep flag raised. shmlink_sleep_end lowers it.
+int  shmlink_sleep_begin(ShmLink* l);
+void shmlink_sleep_end(ShmLink* l);
+
+// After sending: 1 (once) if the peer is asleep and must be poked.
+int  shmlink_wake_needed(ShmLink* l);
+
+#endif
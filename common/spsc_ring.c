@@ -0,0 +1,121 @@
+#include "spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ring_load_acquire(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_store_release(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Each record is a 4-byte length followed by the payload, padded to 4 bytes.
+// A record never wraps: if it does not fit before the end of the buffer, a
+// WRAP marker fills the rest and the record starts again at offset 0.
+#define REC_WRAP 0xffffffffu
+
+static uint32_t rec_size(uint32_t len) {
+    return 4u + ((len + 3u) & ~3u);
+}
+
+int spsc_init(SpscRing* r, uint32_t capPow2) {
+    memset(r, 0, sizeof(*r));
+    if (capPow2 < 64 || (capPow2 & (capPow2 - 1))) return 0;
+    // counters after the data, so the buffer keeps malloc's alignment
+    uint8_t* mem = (uint8_t*)calloc(1, (size_t)capPow2 + sizeof(SpscCounters));
+    if (!mem) return 0;
+    r->buf = mem;
+    r->ctr = (SpscCounters*)(mem + capPow2);
+    r->cap = capPow2;
+    r->owned = 1;
+    return 1;
+}
+
+int spsc_attach(SpscRing* r, SpscCounters* ctr, void* buf, uint32_t capPow2) {
+    memset(r, 0, sizeof(*r));
+    if (capPow2 < 64 || (capPow2 & (capPow2 - 1))) return 0;
+    r->buf = (uint8_t*)buf;
+    r->ctr = ctr;
+    r->cap = capPow2;
+    return 1;
+}
+
+void spsc_free(SpscRing* r) {
+    if (r->owned) free(r->buf);
+    memset(r, 0, sizeof(*r));
+}
+
+int spsc_pending(SpscRing* r) {
+    return ring_load_acquire(&r->ctr->head) != ring_load_acquire(&r->ctr->tail);
+}
+
+void* spsc_reserve(SpscRing* r, uint32_t maxLen) {
+    uint32_t need = rec_size(maxLen);
+    uint32_t head = r->ctr->head;                   // our own counter
+    uint32_t tail = ring_load_acquire(&r->ctr->tail);
+    uint32_t off = head & (r->cap - 1);
+    uint32_t toEnd = r->cap - off;
+
+    // a wrapped record costs the tail of the buffer as well
+    uint32_t cost = need <= toEnd ? need : toEnd + need;
+    if (need > r->cap / 2 || r->cap - (head - tail) < cost) return NULL;
+
+    if (need > toEnd) {
+        // toEnd is a multiple of 4 and at least 4, so the marker fits; it
+        // becomes visible together with the record at commit
+        uint32_t wrap = REC_WRAP;
+        memcpy(r->buf + off, &wrap, 4);
+        head += toEnd;
+        off = 0;
+    }
+    r->resv = head;
+    return r->buf + off + 4;
+}
+
+void spsc_commit(SpscRing* r, uint32_t len) {
+    memcpy(r->buf + (r->resv & (r->cap - 1)), &len, 4);
+    ring_store_release(&r->ctr->head, r->resv + rec_size(len));
+}
+
+int spsc_push(SpscRing* r, const void* data, uint32_t len) {
+    void* dst = spsc_reserve(r, len);
+    if (!dst) return 0;
+    memcpy(dst, data, len);
+    spsc_commit(r, len);
+    return 1;
+}
+
+const void* spsc_peek(SpscRing* r, uint32_t* len) {
+    if (r->corrupt) return NULL;
+    uint32_t tail = r->ctr->tail;
+    uint32_t head = ring_load_acquire(&r->ctr->head);
+    if (tail == head) return NULL;
+    if (head - tail > r->cap) goto corrupt;
+
+    uint32_t off = tail & (r->cap - 1);
+    uint32_t n;
+    memcpy(&n, r->buf + off, 4);
+    if (n == REC_WRAP) {
+        if (r->cap - off > head - tail) goto corrupt;
+        tail += r->cap - off;
+        ring_store_release(&r->ctr->tail, tail);
+        if (tail == head) return NULL;
+        off = 0;
+        memcpy(&n, r->buf, 4);
+    }
+    // spsc_reserve never hands out more than cap/2, so this also rejects a
+    // second WRAP and keeps rec_size from overflowing
+    if (n > r->cap / 2 || rec_size(n) > head - tail || rec_size(n) > r->cap - off) goto corrupt;
+
+    r->peeked = rec_size(n);
+    *len = n;
+    return r->buf + off + 4;
+
+corrupt:
+    r->corrupt = 1;
+    return NULL;
+}
+
+void spsc_pop(SpscRing* r) {
+    // the size checked by spsc_peek; the length word itself may have been
+    // rewritten by a misbehaving producer since
+    ring_store_release(&r->ctr->tail, r->ctr->tail + r->peeked);
+    r->peeked = 0;
+}
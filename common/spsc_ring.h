@@ -0,0 +1,64 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+
+// Single-producer/single-consumer byte ring of variable-length records.
+// Exactly one thread pushes and one thread peeks/pops; the two only share
+// the head and tail counters, published with acquire/release atomics (gcc
+// and clang builtins). Records are contiguous in memory, so the consumer
+// reads them in place.
+//
+// The counters and the buffer can also live in memory the caller provides
+// (spsc_attach), e.g. a mapping shared by two processes; the record format
+// and the rules are the same.
+
+// The shared part. Head and tail sit on separate cache lines so producer
+// and consumer writes do not contend.
+typedef struct {
+    uint32_t head;        // bytes ever written; written by the producer only
+    uint8_t  pad0[60];
+    uint32_t tail;        // bytes ever consumed; written by the consumer only
+    uint8_t  pad1[60];
+} SpscCounters;
+
+typedef struct {
+    uint8_t* buf;
+    uint32_t cap;         // power of two
+    SpscCounters* ctr;
+    uint32_t resv;        // producer only: offset of the reserved record
+    uint32_t peeked;      // consumer only: bytes spsc_pop will release
+    int corrupt;          // consumer only: see spsc_peek
+    int owned;            // buf and ctr were allocated by spsc_init
+} SpscRing;
+
+int  spsc_init(SpscRing* r, uint32_t capPow2);
+void spsc_free(SpscRing* r);
+
+// Uses ctr and buf (capPow2 bytes) owned by the caller. Whoever creates the
+// memory zeroes ctr once; both sides then attach to it. spsc_free only
+// forgets them.
+int  spsc_attach(SpscRing* r, SpscCounters* ctr, void* buf, uint32_t capPow2);
+
+// 1 if a record is waiting; usable by either side.
+int  spsc_pending(SpscRing* r);
+
+// Producer. Copies len bytes as one record. Returns 0 if it does not fit
+// right now (the ring is full); the caller decides whether to retry.
+int  spsc_push(SpscRing* r, const void* data, uint32_t len);
+
+// Producer, two-part form: reserve up to maxLen bytes, fill, then commit
+// the length actually written (<= maxLen). Avoids a staging copy.
+void* spsc_reserve(SpscRing* r, uint32_t maxLen);
+void  spsc_commit(SpscRing* r, uint32_t len);
+
+// Consumer. Returns the oldest record (valid until spsc_pop) or NULL.
+// The counters and lengths are checked against what a correct producer
+// can write (no more than cap bytes outstanding, records of at most cap/2
+// that end inside the buffer), since with spsc_attach the producer may be
+// another process. On a violation it sets corrupt and returns NULL from
+// then on; the ring cannot be trusted again.
+const void* spsc_peek(SpscRing* r, uint32_t* len);
+void        spsc_pop(SpscRing* r);
+
+#endif
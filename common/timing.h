@@ -0,0 +1,13 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+// Monotonic clock shared by server, client and tools. Kept in its own
+// translation unit so <windows.h> never leaks into raylib code.
+
+uint64_t time_now_ns(void);
+double   time_now(void);          // seconds
+void     time_sleep_ms(int ms);
+
+#endif
@@ -0,0 +1,80 @@
+#include "command.h"
+#include "../common/numcodec.h"
+
+#include <string.h>
+
+static unsigned verb_hash(const char* verb, int len) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++) h = (h ^ (unsigned char)verb[i]) * 16777619u;
+    return h;
+}
+
+static int word_len(const char* s) {
+    int n = 0;
+    while (s[n] && s[n] != ' ' && s[n] != '\t') n++;
+    return n;
+}
+
+int cmd_router_init(CmdRouter* r, const CmdDef* defs, int count) {
+    memset(r, 0, sizeof(*r));
+    if (count > CMD_SLOTS / 2) return 0;
+    r->defs = defs;
+    r->count = count;
+    for (int i = 0; i < count; i++) {
+        unsigned h = verb_hash(defs[i].verb, (int)strlen(defs[i].verb));
+        while (r->slots[h & (CMD_SLOTS - 1)]) h++;
+        r->slots[h & (CMD_SLOTS - 1)] = (unsigned char)(i + 1);
+    }
+    return 1;
+}
+
+const CmdDef* cmd_find(const CmdRouter* r, const char* line, const char** args) {
+    int len = word_len(line);
+    if (len == 0) return NULL;
+    unsigned h = verb_hash(line, len);
+    for (;;) {
+        int e = r->slots[h & (CMD_SLOTS - 1)];
+        if (!e) return NULL;
+        const CmdDef* d = &r->defs[e - 1];
+        if (strncmp(d->verb, line, (size_t)len) == 0 && d->verb[len] == '\0') {
+            const char* a = line + len;
+            while (*a == ' ' || *a == '\t') a++;
+            *args = a;
+            return d;
+        }
+        h++;
+    }
+}
+
+int cmd_parse(const CmdDef* d, const char* args, CmdArgs* out) {
+    out->count = 0;
+    const char* p = args;
+    for (const char* k = d->spec; *k && out->count < CMD_MAX_ARGS; k++) {
+        int optional = (*k >= 'A' && *k <= 'Z');
+        int ok;
+        switch (*k | 0x20) {
+        case 'f': ok = num_parse_float(&p, &out->v[out->count].f); break;
+        case 'i': ok = num_parse_int(&p, &out->v[out->count].i); break;
+        case 's':
+            while (*p == ' ' || *p == '\t') p++;
+            out->v[out->count].s = p;
+            ok = 1;
+            break;
+        default:  ok = 0; break;
+        }
+        if (!ok) return optional;
+        out->count++;
+    }
+    return 1;
+}
+
+int cmd_dispatch(const CmdRouter* r, const char* line, void* ctx, const CmdDef** def) {
+    const char* args;
+    const CmdDef* d = cmd_find(r, line, &args);
+    if (def) *def = d;
+    if (!d) return CMD_UNKNOWN;
+    CmdArgs a;
+    if (!cmd_parse(d, args, &a)) return CMD_BAD_ARGS;
+    d->fn(ctx, line, &a);
+    return CMD_OK;
+}
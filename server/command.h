@@ -0,0 +1,87 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Verb table for terminal commands ("CMD <verb> <args>") and for the
+// one-line commands the model answers with. A router hashes every verb once
+// at init; dispatch is one hash of the first word and usually one compare,
+// however many verbs there are.
+//
+// Each verb declares its arguments as a spec string, one letter per
+// argument, parsed with common/numcodec before the handler runs:
+//
+//   f  float          i  int          s  the rest of the line (last only)
+//
+// Lowercase letters are required, uppercase optional; parsing stops at the
+// first optional argument that is missing or malformed, leaving it and the
+// ones after it at their defaults (see cmd_float/cmd_int). Text after the
+// last argument is ignored.
+
+#define CMD_MAX_ARGS  8
+#define CMD_SLOTS     64   // power of two, at least twice the verbs per router
+
+typedef struct {
+    int count;             // arguments parsed
+    union {
+        float f;
+        int i;
+        const char* s;
+    } v[CMD_MAX_ARGS];
+} CmdArgs;
+
+typedef void (*CmdFn)(void* ctx, const char* line, const CmdArgs* args);
+
+// How expensive a verb is to run. Cheap ones run as they arrive; the others
+// are rate limited per client and queued fairly (see sched.h).
+enum {
+    CMD_CLASS_CHEAP,       // a few lines of output
+    CMD_CLASS_SPAWN,       // creates objects and broadcasts them
+    CMD_CLASS_MODEL,       // a round trip to the language model
+    CMD_CLASSES
+};
+
+typedef struct {
+    const char* verb;
+    const char* spec;
+    const char* usage;     // shown when the required arguments do not parse
+    CmdFn fn;
+    int cls;               // CMD_CLASS_*
+} CmdDef;
+
+typedef struct {
+    const CmdDef* defs;
+    int count;
+    unsigned char slots[CMD_SLOTS];   // defs index + 1; 0 = empty
+} CmdRouter;
+
+enum { CMD_OK, CMD_UNKNOWN, CMD_BAD_ARGS };
+
+// defs must outlive the router. Returns 0 if there are too many verbs.
+int  cmd_router_init(CmdRouter* r, const CmdDef* defs, int count);
+
+// The entry for line's first word, or NULL. *args is set past the verb.
+const CmdDef* cmd_find(const CmdRouter* r, const char* line, const char** args);
+
+// Parses args per d->spec. Returns 0 if a required argument is missing.
+int  cmd_parse(const CmdDef* d, const char* args, CmdArgs* out);
+
+// Finds, parses and calls the handler with ctx. CMD_BAD_ARGS does not call
+// it; *def (optional) is set whenever the verb was found.
+int  cmd_dispatch(const CmdRouter* r, const char* line, void* ctx, const CmdDef** def);
+
+// Argument n, or fallback if it was not given.
+static inline float cmd_float(const CmdArgs* a, int n, float fallback) {
+    return n < a->count ? a->v[n].f : fallback;
+}
+static inline int cmd_int(const CmdArgs* a, int n, int fallback) {
+    return n < a->count ? a->v[n].i : fallback;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
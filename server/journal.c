@@ -0,0 +1,101 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "journal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char JOURNAL_MAGIC[4] = { 'K', 'J', 'N', 'L' };
+
+static FILE*    g_journal = NULL;
+static uint64_t g_journalRecords = 0;
+
+int journal_open(const char* path) {
+    if (g_journal) return 0;
+    g_journal = fopen(path, "wb");
+    if (!g_journal) return 0;
+
+    // records are tiny; let stdio batch them between per-tick flushes
+    setvbuf(g_journal, NULL, _IOFBF, 1 << 16);
+
+    uint32_t version = JOURNAL_VERSION;
+    fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), g_journal);
+    fwrite(&version, sizeof(version), 1, g_journal);
+    g_journalRecords = 0;
+    return 1;
+}
+
+int journal_is_open(void) {
+    return g_journal != NULL;
+}
+
+void journal_append(uint32_t tick, JournalType type, int conn, const void* data, uint32_t len) {
+    if (!g_journal) return;
+
+    JournalRec rec;
+    rec.tick = tick;
+    rec.type = (uint8_t)type;
+    rec.reserved = 0;
+    rec.conn = (uint16_t)conn;
+    rec.len = len;
+    fwrite(&rec, sizeof(rec), 1, g_journal);
+    if (len) fwrite(data, 1, len, g_journal);
+    g_journalRecords++;
+}
+
+void journal_flush(void) {
+    if (g_journal) fflush(g_journal);
+}
+
+uint64_t journal_close(void) {
+    if (!g_journal) return 0;
+    fclose(g_journal);
+    g_journal = NULL;
+    return g_journalRecords;
+}
+
+int journal_reader_open(JournalReader* r, const char* path) {
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f) return 0;
+
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 1, sizeof(magic), r->f) != sizeof(magic) ||
+        fread(&version, sizeof(version), 1, r->f) != 1 ||
+        memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 ||
+        version != JOURNAL_VERSION) {
+        journal_reader_close(r);
+        return 0;
+    }
+    return 1;
+}
+
+int journal_read(JournalReader* r) {
+    if (r->bad) return -1;
+    if (!r->f) return 0;
+    size_t got = fread(&r->rec, 1, sizeof(r->rec), r->f);
+    if (got == 0 && feof(r->f)) return 0;
+    if (got != sizeof(r->rec) || r->rec.len > JOURNAL_REC_MAX) goto bad;
+
+    // +1 so line payloads can be handed out NUL-terminated
+    if (r->rec.len + 1 > r->cap) {
+        uint8_t* nd = (uint8_t*)realloc(r->data, r->rec.len + 1);
+        if (!nd) goto bad;
+        r->data = nd;
+        r->cap = r->rec.len + 1;
+    }
+    if (r->rec.len && fread(r->data, 1, r->rec.len, r->f) != r->rec.len) goto bad;
+    r->data[r->rec.len] = 0;
+    return 1;
+
+bad:
+    r->bad = 1;
+    return -1;
+}
+
+void journal_reader_close(JournalReader* r) {
+    if (r->f) fclose(r->f);
+    free(r->data);
+    memset(r, 0, sizeof(*r));
+}
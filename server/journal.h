@@ -0,0 +1,71 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Append-only binary journal of everything that feeds the simulation:
+// connection open/close, accepted client lines, LLM responses, generated
+// session ids and commands refused by the rate limiter. Re-running a
+// journal against an empty world reproduces the exact same state without
+// sockets, clocks or llama-server.
+//
+// File: "KJNL" + uint32 version, then records back to back:
+//   JournalRec header (native endianness) followed by len payload bytes.
+
+#define JOURNAL_VERSION 2u
+
+// Largest payload a reader accepts; well above any LLM response body.
+#define JOURNAL_REC_MAX (1u << 20)
+
+typedef enum {
+    J_OPEN = 1,     // conn slot accepted a socket
+    J_CLOSE,        // conn slot disconnected
+    J_LINE,         // payload: one client line (HELLO / INPUT / CMD)
+    J_LLM,          // payload: 1 byte ok flag + response body or error text,
+                    // answering the oldest model call still out
+    J_SESSION_ID,   // payload: uint64 id handed to a new session
+    J_REFUSED       // payload: reason byte, class byte, CMD text turned away
+} JournalType;
+
+typedef struct {
+    uint32_t tick;
+    uint8_t  type;
+    uint8_t  reserved;
+    uint16_t conn;
+    uint32_t len;
+} JournalRec;
+
+// Writer. One journal per process; appends are buffered and flushed once per
+// server tick via journal_flush().
+int      journal_open(const char* path);
+int      journal_is_open(void);
+void     journal_append(uint32_t tick, JournalType type, int conn, const void* data, uint32_t len);
+void     journal_flush(void);
+uint64_t journal_close(void);   // returns the number of records written
+
+// Reader. data stays valid until the next journal_read().
+typedef struct {
+    FILE*      f;
+    JournalRec rec;
+    uint8_t*   data;
+    uint32_t   cap;
+    int        bad;        // a read failed; every later read fails too
+} JournalReader;
+
+int  journal_reader_open(JournalReader* r, const char* path);
+
+// 1 = got a record, 0 = clean end of file, -1 = truncated or corrupt (a
+// partial record, a length over JOURNAL_REC_MAX, or out of memory).
+int  journal_read(JournalReader* r);
+void journal_reader_close(JournalReader* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
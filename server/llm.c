@@ -0,0 +1,512 @@
+#include "llm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "../common/timing.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include <windows.h>
+  #pragma comment(lib, "ws2_32.lib")
+  #define SHUT_RDWR SD_BOTH
+#else
+  #include <unistd.h>
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <pthread.h>
+  #include <arpa/inet.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  typedef int SOCKET;
+  #define INVALID_SOCKET (-1)
+  #define SOCKET_ERROR   (-1)
+  #define closesocket close
+#endif
+
+// -------------------- tweakables --------------------
+
+// Your llama-server address:
+#define LLM_HOST "127.0.0.1"
+#define LLM_PORT 8080
+
+#define HTTP_RECV_MAX  (256 * 1024)
+
+// A server that is down fails fast; one that accepted the request gets
+// this long between bytes of the reply (generation happens before any).
+#define HTTP_CONNECT_TIMEOUT_MS  2000
+#define HTTP_IO_TIMEOUT_MS       30000
+
+// ----------------------------------------------------
+
+static const char* kEndpointPaths[LLM_ENDPOINTS] = { "/v1/chat/completions", "/completion" };
+static const char* kEndpointNames[LLM_ENDPOINTS] = { "chat", "completion" };
+
+static Arena g_scratch;
+
+Arena* llm_scratch(void) {
+    return &g_scratch;
+}
+
+const char* llm_endpoint_name(LlmEndpoint ep) {
+    return (unsigned)ep < LLM_ENDPOINTS ? kEndpointNames[ep] : "?";
+}
+
+// -------------------- HTTP client (minimal) --------------------
+
+static void sock_set_blocking(SOCKET s, int blocking) {
+#ifdef _WIN32
+    u_long nb = blocking ? 0 : 1;
+    ioctlsocket(s, FIONBIO, &nb);
+#else
+    int fl = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, blocking ? (fl & ~O_NONBLOCK) : (fl | O_NONBLOCK));
+#endif
+}
+
+// Bounds every later send and recv, so a hung llama-server cannot hold
+// the caller forever.
+static void sock_set_io_timeout(SOCKET s, int ms) {
+#ifdef _WIN32
+    DWORD t = (DWORD)ms;
+#else
+    struct timeval t;
+    t.tv_sec = ms / 1000;
+    t.tv_usec = (ms % 1000) * 1000;
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&t, sizeof(t));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&t, sizeof(t));
+}
+
+static int connect_in_progress(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
+static SOCKET sock_connect(const char *host, int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) return INVALID_SOCKET;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+
+#ifdef _WIN32
+    addr.sin_addr.s_addr = inet_addr(host);
+#else
+    inet_pton(AF_INET, host, &addr.sin_addr);
+#endif
+
+    // non-blocking connect, so an unreachable host costs the timeout at most
+    sock_set_blocking(s, 0);
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        if (!connect_in_progress()) {
+            closesocket(s);
+            return INVALID_SOCKET;
+        }
+        fd_set wr, ex;
+        FD_ZERO(&wr);
+        FD_ZERO(&ex);
+        FD_SET(s, &wr);
+        FD_SET(s, &ex);   // Windows reports a refused connect here
+        struct timeval tv = { HTTP_CONNECT_TIMEOUT_MS / 1000, (HTTP_CONNECT_TIMEOUT_MS % 1000) * 1000 };
+        int soErr = 0;
+#ifdef _WIN32
+        int len = (int)sizeof(soErr);
+#else
+        socklen_t len = sizeof(soErr);
+#endif
+        if (select((int)s + 1, NULL, &wr, &ex, &tv) <= 0 || !FD_ISSET(s, &wr) ||
+            getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&soErr, &len) != 0 || soErr != 0) {
+            closesocket(s);
+            return INVALID_SOCKET;
+        }
+    }
+    sock_set_blocking(s, 1);
+    sock_set_io_timeout(s, HTTP_IO_TIMEOUT_MS);
+    return s;
+}
+
+static int sock_send_all(SOCKET s, const char *buf, int len) {
+    int sent = 0;
+    while (sent < len) {
+        int r = send(s, buf + sent, len - sent, 0);
+        if (r <= 0) return 0;
+        sent += r;
+    }
+    return 1;
+}
+
+static int sock_recv_some(SOCKET s, char *buf, int cap) {
+    int r = recv(s, buf, cap, 0);
+    return r;
+}
+
+static int parse_content_length(const char *hdrs) {
+    const char *p = strstr(hdrs, "Content-Length:");
+    if (!p) p = strstr(hdrs, "content-length:");
+    if (!p) return -1;
+    p = strchr(p, ':');
+    if (!p) return -1;
+    p++;
+    while (*p && isspace((unsigned char)*p)) p++;
+    return atoi(p);
+}
+
+static int header_is_chunked(const char *hdrs) {
+    return (strstr(hdrs, "Transfer-Encoding: chunked") ||
+            strstr(hdrs, "transfer-encoding: chunked")) ? 1 : 0;
+}
+
+// Sends the request on s and reads the response body into out (cap).
+// Returns 1 ok. Buffers come from scratch; http_post_json gives them back
+// and closes s.
+static int http_exchange(Arena *scratch, SOCKET s, const char *host, int port, const char *path,
+                         const char *jsonBody, char *out, int outCap,
+                         char *err, int errCap) {
+    int bodyLen = (int)strlen(jsonBody);
+    int reqCap = bodyLen + (int)strlen(path) + (int)strlen(host) + 160;
+    char *req = (char*)arena_alloc(scratch, (size_t)reqCap);
+    if (!req) {
+        snprintf(err, errCap, "Out of memory");
+        return 0;
+    }
+
+    int n = snprintf(req, (size_t)reqCap,
+        "POST %s HTTP/1.1\r\n"
+        "Host: %s:%d\r\n"
+        "Content-Type: application/json\r\n"
+        "Connection: close\r\n"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        path, host, port, bodyLen, jsonBody);
+
+    if (n <= 0 || n >= reqCap) {
+        snprintf(err, errCap, "Request too large");
+        return 0;
+    }
+
+    if (!sock_send_all(s, req, n)) {
+        snprintf(err, errCap, "Failed to send request");
+        return 0;
+    }
+
+    // read all into a temp buffer (toy)
+    char *tmp = (char*)arena_alloc(scratch, HTTP_RECV_MAX);
+    int tmpCap = tmp ? HTTP_RECV_MAX : 0;
+    int tmpLen = 0;
+
+    if (!tmp) {
+        snprintf(err, errCap, "Out of memory");
+        return 0;
+    }
+
+    for (;;) {
+        char buf[4096];
+        int r = sock_recv_some(s, buf, (int)sizeof(buf));
+        if (r < 0) {
+            snprintf(err, errCap, "No reply from llama-server within %d s", HTTP_IO_TIMEOUT_MS / 1000);
+            return 0;
+        }
+        if (r == 0) break;
+        if (tmpLen + r >= tmpCap) break;
+        memcpy(tmp + tmpLen, buf, r);
+        tmpLen += r;
+    }
+
+    if (tmpLen <= 0) {
+        snprintf(err, errCap, "No response");
+        return 0;
+    }
+    tmp[tmpLen] = '\0';
+
+    // split headers/body
+    char *sep = strstr(tmp, "\r\n\r\n");
+    if (!sep) {
+        snprintf(err, errCap, "Bad HTTP response");
+        return 0;
+    }
+    *sep = '\0';
+    const char *hdrs = tmp;
+    const char *body = sep + 4;
+
+    // crude status check
+    if (!strstr(hdrs, "200")) {
+        // try to show some body
+        char preview[256];
+        strncpy(preview, body, sizeof(preview) - 1);
+        preview[sizeof(preview) - 1] = '\0';
+        snprintf(err, errCap, "HTTP error. Body: %.200s", preview);
+        return 0;
+    }
+
+    // If chunked, decode it.
+    if (header_is_chunked(hdrs)) {
+        const char *p = body;
+        int w = 0;
+        while (*p) {
+            unsigned chunkSize = 0;
+            // read hex size
+            while (*p && *p != '\r' && *p != '\n') {
+                char c = *p++;
+                int v = 0;
+                if (c >= '0' && c <= '9') v = c - '0';
+                else if (c >= 'a' && c <= 'f') v = 10 + (c - 'a');
+                else if (c >= 'A' && c <= 'F') v = 10 + (c - 'A');
+                else { /* ignore */ }
+                chunkSize = (chunkSize << 4) | (unsigned)v;
+            }
+            // skip CRLF
+            while (*p == '\r' || *p == '\n') p++;
+            if (chunkSize == 0) break;
+
+            for (unsigned i = 0; i < chunkSize && *p; i++) {
+                if (w < outCap - 1) out[w++] = *p;
+                p++;
+            }
+            out[w] = '\0';
+            // skip trailing CRLF after chunk data
+            while (*p == '\r' || *p == '\n') p++;
+        }
+        return 1;
+    }
+
+    // Not chunked: if content-length exists, respect it
+    int cl = parse_content_length(hdrs);
+    if (cl >= 0) {
+        int copy = cl;
+        if (copy > outCap - 1) copy = outCap - 1;
+        memcpy(out, body, copy);
+        out[copy] = '\0';
+        return 1;
+    }
+
+    // Otherwise copy what we have
+    strncpy(out, body, outCap - 1);
+    out[outCap - 1] = '\0';
+    return 1;
+}
+
+static int worker_track(LlmWorker *w, SOCKET s);
+
+// One request on a fresh connection. A worker (or NULL) gets to see the
+// socket, so llm_worker_stop can abort it.
+static int http_post_json(Arena *scratch, LlmWorker *w, const char *host, int port, const char *path,
+                          const char *jsonBody, char *out, int outCap,
+                          char *err, int errCap) {
+    if (err && errCap) err[0] = '\0';
+    if (out && outCap) out[0] = '\0';
+
+    SOCKET s = sock_connect(host, port);
+    if (s == INVALID_SOCKET) {
+        snprintf(err, errCap, "Could not connect to llama-server at %s:%d", host, port);
+        return 0;
+    }
+    if (w && !worker_track(w, s)) {
+        closesocket(s);
+        snprintf(err, errCap, "Cancelled");
+        return 0;
+    }
+
+    ArenaMark mark = arena_mark(scratch);
+    int ok = http_exchange(scratch, s, host, port, path, jsonBody, out, outCap, err, errCap);
+    arena_release(scratch, mark);
+
+    if (w) worker_track(w, INVALID_SOCKET);
+    closesocket(s);
+    return ok;
+}
+
+static int http_call(Arena *scratch, LlmWorker *w, LlmEndpoint ep, const char *body,
+                     char *out, int outCap, char *err, int errCap) {
+    if ((unsigned)ep >= LLM_ENDPOINTS) {
+        snprintf(err, errCap, "Unknown LLM endpoint");
+        return 0;
+    }
+    return http_post_json(scratch, w, LLM_HOST, LLM_PORT, kEndpointPaths[ep], body, out, outCap, err, errCap);
+}
+
+int llm_http(LlmEndpoint ep, const char* body, char* out, int outCap, char* err, int errCap) {
+    return http_call(&g_scratch, NULL, ep, body, out, outCap, err, errCap);
+}
+
+// -------------------- backend --------------------
+
+static LlmBackendFn g_backend = llm_http;
+
+void llm_set_backend(LlmBackendFn fn) {
+    g_backend = fn ? fn : llm_http;
+}
+
+int llm_request(LlmEndpoint ep, const char* body, char* out, int outCap, char* err, int errCap) {
+    return g_backend(ep, body, out, outCap, err, errCap);
+}
+
+// -------------------- tiny thread shim --------------------
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION   llm_mutex_t;
+typedef CONDITION_VARIABLE llm_cond_t;
+typedef HANDLE             llm_thread_t;
+#define mutex_init(m)    InitializeCriticalSection(m)
+#define mutex_free(m)    DeleteCriticalSection(m)
+#define mutex_lock(m)    EnterCriticalSection(m)
+#define mutex_unlock(m)  LeaveCriticalSection(m)
+#define cond_init(c)     InitializeConditionVariable(c)
+#define cond_free(c)     ((void)0)
+#define cond_wait(c, m)  SleepConditionVariableCS((c), (m), INFINITE)
+#define cond_signal(c)   WakeConditionVariable(c)
+#else
+typedef pthread_mutex_t    llm_mutex_t;
+typedef pthread_cond_t     llm_cond_t;
+typedef pthread_t          llm_thread_t;
+#define mutex_init(m)    pthread_mutex_init((m), NULL)
+#define mutex_free(m)    pthread_mutex_destroy(m)
+#define mutex_lock(m)    pthread_mutex_lock(m)
+#define mutex_unlock(m)  pthread_mutex_unlock(m)
+#define cond_init(c)     pthread_cond_init((c), NULL)
+#define cond_free(c)     pthread_cond_destroy(c)
+#define cond_wait(c, m)  pthread_cond_wait((c), (m))
+#define cond_signal(c)   pthread_cond_signal(c)
+#endif
+
+// -------------------- worker --------------------
+
+struct LlmWorker {
+    LlmCall*  queued;      // submitted, not sent yet
+    LlmCall** queuedTail;
+    LlmCall*  done;        // finished, not polled yet
+    LlmCall** doneTail;
+    SOCKET    live;        // the request in flight, for stop to abort
+    int       quit;
+
+    Arena     scratch;     // HTTP buffers; worker thread only
+
+    llm_mutex_t  mu;
+    llm_cond_t   cv;
+    llm_thread_t thread;
+};
+
+// Publishes the socket of the request in flight (INVALID_SOCKET when it is
+// done). Returns 0 if the worker is stopping and the request should not go.
+static int worker_track(LlmWorker *w, SOCKET s) {
+    mutex_lock(&w->mu);
+    int ok = !(w->quit && s != INVALID_SOCKET);
+    if (ok) w->live = s;
+    mutex_unlock(&w->mu);
+    return ok;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg)
+#else
+static void* worker_main(void* arg)
+#endif
+{
+    LlmWorker *w = (LlmWorker*)arg;
+
+    mutex_lock(&w->mu);
+    for (;;) {
+        while (!w->queued && !w->quit) cond_wait(&w->cv, &w->mu);
+        if (w->quit) break;
+
+        LlmCall *call = w->queued;
+        w->queued = call->next;
+        if (!w->queued) w->queuedTail = &w->queued;
+        mutex_unlock(&w->mu);
+
+        uint64_t t0 = time_now_ns();
+        call->ok = http_call(&w->scratch, w, call->ep, call->body, call->out, call->outCap,
+                             call->err, (int)sizeof(call->err));
+        call->seconds = (double)(time_now_ns() - t0) * 1e-9;
+        arena_reset(&w->scratch);
+
+        mutex_lock(&w->mu);
+        call->next = NULL;
+        *w->doneTail = call;
+        w->doneTail = &call->next;
+    }
+    mutex_unlock(&w->mu);
+    return 0;
+}
+
+LlmWorker* llm_worker_start(void) {
+    LlmWorker *w = (LlmWorker*)calloc(1, sizeof(LlmWorker));
+    if (!w) return NULL;
+
+    w->queuedTail = &w->queued;
+    w->doneTail = &w->done;
+    w->live = INVALID_SOCKET;
+    mutex_init(&w->mu);
+    cond_init(&w->cv);
+
+#ifdef _WIN32
+    w->thread = CreateThread(NULL, 0, worker_main, w, 0, NULL);
+    if (!w->thread) {
+#else
+    if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+#endif
+        cond_free(&w->cv);
+        mutex_free(&w->mu);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void llm_worker_submit(LlmWorker* w, LlmCall* call) {
+    call->next = NULL;
+    call->ok = 0;
+    call->err[0] = '\0';
+    call->seconds = 0.0;
+
+    mutex_lock(&w->mu);
+    *w->queuedTail = call;
+    w->queuedTail = &call->next;
+    cond_signal(&w->cv);
+    mutex_unlock(&w->mu);
+}
+
+LlmCall* llm_worker_poll(LlmWorker* w) {
+    mutex_lock(&w->mu);
+    LlmCall *call = w->done;
+    if (call) {
+        w->done = call->next;
+        if (!w->done) w->doneTail = &w->done;
+    }
+    mutex_unlock(&w->mu);
+    return call;
+}
+
+void llm_worker_stop(LlmWorker* w) {
+    if (!w) return;
+
+    mutex_lock(&w->mu);
+    w->quit = 1;
+    // recv in the worker returns at once instead of after the timeout
+    if (w->live != INVALID_SOCKET) shutdown(w->live, SHUT_RDWR);
+    cond_signal(&w->cv);
+    mutex_unlock(&w->mu);
+
+#ifdef _WIN32
+    WaitForSingleObject(w->thread, INFINITE);
+    CloseHandle(w->thread);
+#else
+    pthread_join(w->thread, NULL);
+#endif
+
+    cond_free(&w->cv);
+    mutex_free(&w->mu);
+    arena_free(&w->scratch);
+    free(w);
+}
@@ -0,0 +1,74 @@
+#ifndef LLM_H
+#define LLM_H
+
+#include "../common/arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The one way to reach the language model. Both LLM features go through
+// it: the terminal's chat (toy_term.c, OpenAI-style chat completions with
+// conversation memory) and the "ai" command (server.c, a single-line
+// /completion). Each builds the JSON body for its endpoint and parses the
+// reply; sending goes through the current backend.
+typedef enum {
+    LLM_CHAT,              // POST /v1/chat/completions
+    LLM_COMPLETION,        // POST /completion
+    LLM_ENDPOINTS
+} LlmEndpoint;
+
+// POST body to endpoint, write the response body to out (or a message to
+// err) and return 1 on success. The default, llm_http, talks to
+// llama-server; the benchmarks swap in a canned reply.
+typedef int (*LlmBackendFn)(LlmEndpoint ep, const char* body,
+                            char* out, int outCap, char* err, int errCap);
+
+void        llm_set_backend(LlmBackendFn fn);   // NULL restores llm_http
+int         llm_request(LlmEndpoint ep, const char* body,
+                        char* out, int outCap, char* err, int errCap);
+int         llm_http(LlmEndpoint ep, const char* body,
+                     char* out, int outCap, char* err, int errCap);
+
+const char* llm_endpoint_name(LlmEndpoint ep);  // "chat", "completion"
+
+// Scratch for one LLM command: request and response buffers, HTTP buffers,
+// parsed content. The code running the command resets it when done; the
+// memory is kept for the next one. Belongs to the thread running commands.
+Arena*      llm_scratch(void);
+
+// Calls for a caller that must not wait on the model (the server's main
+// loop). One worker thread sends them to llama-server over HTTP, oldest
+// first, with HTTP buffers of its own; the backend hook is not used. The
+// caller owns each LlmCall and its buffers: it fills ep, body and out,
+// submits, and must not touch the call again until llm_worker_poll hands
+// it back with ok, out or err and seconds set. Calls come back in the order
+// they were submitted.
+#define LLM_ERR_MAX 256
+
+typedef struct LlmCall {
+    LlmEndpoint ep;
+    const char* body;
+    char*  out;
+    int    outCap;
+    int    ok;
+    char   err[LLM_ERR_MAX];
+    double seconds;            // round trip
+    struct LlmCall* next;      // the worker's queue
+} LlmCall;
+
+typedef struct LlmWorker LlmWorker;
+
+LlmWorker*  llm_worker_start(void);
+void        llm_worker_submit(LlmWorker* w, LlmCall* call);
+LlmCall*    llm_worker_poll(LlmWorker* w);   // a finished call, or NULL
+
+// Aborts the request in flight, drops the ones not sent yet and joins.
+// Calls not handed back by then are never touched again.
+void        llm_worker_stop(LlmWorker* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
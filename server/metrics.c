@@ -0,0 +1,80 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void hist_observe(Histogram* h, double v) {
+    int i = 0;
+    double bound = h->base;
+    while (i < METRICS_BUCKETS && v > bound) {
+        bound *= 2.0;
+        i++;
+    }
+    h->buckets[i]++;
+    h->count++;
+    h->sum += v;
+}
+
+void metrics_printf(MetricsOut* o, const char* fmt, ...) {
+    for (;;) {
+        size_t room = o->cap - o->len;
+        if (o->buf) {
+            va_list ap;
+            va_start(ap, fmt);
+            int n = vsnprintf(o->buf + o->len, room, fmt, ap);
+            va_end(ap);
+            if (n < 0) return;
+            if ((size_t)n < room) {
+                o->len += (size_t)n;
+                return;
+            }
+        }
+        size_t ncap = o->cap ? o->cap * 2 : 16384;
+        char* nb = (char*)realloc(o->buf, ncap);
+        if (!nb) return;
+        o->buf = nb;
+        o->cap = ncap;
+    }
+}
+
+void metrics_free(MetricsOut* o) {
+    free(o->buf);
+    o->buf = NULL;
+    o->len = o->cap = 0;
+}
+
+void metrics_header(MetricsOut* o, const char* name, const char* type, const char* help) {
+    metrics_printf(o, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_value(MetricsOut* o, const char* name, const char* labels, double v) {
+    if (labels && labels[0]) metrics_printf(o, "%s{%s} %.15g\n", name, labels, v);
+    else metrics_printf(o, "%s %.15g\n", name, v);
+}
+
+void metrics_histogram(MetricsOut* o, const char* name, const char* labels, const Histogram* h) {
+    const char* sep = (labels && labels[0]) ? "," : "";
+    if (!labels) labels = "";
+
+    uint64_t cum = 0;
+    double bound = h->base;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        cum += h->buckets[i];
+        metrics_printf(o, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", name, labels, sep, bound,
+                       (unsigned long long)cum);
+        bound *= 2.0;
+    }
+    cum += h->buckets[METRICS_BUCKETS];
+    metrics_printf(o, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)cum);
+
+    if (labels[0]) {
+        metrics_printf(o, "%s_sum{%s} %.9g\n", name, labels, h->sum);
+        metrics_printf(o, "%s_count{%s} %llu\n", name, labels, (unsigned long long)h->count);
+    } else {
+        metrics_printf(o, "%s_sum %.9g\n", name, h->sum);
+        metrics_printf(o, "%s_count %llu\n", name, (unsigned long long)h->count);
+    }
+}
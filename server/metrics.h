@@ -0,0 +1,55 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Plain counters and fixed-bucket histograms plus a Prometheus text writer.
+//
+// Nothing here locks or allocates on the record path. Every metric is owned
+// by exactly one thread (the server's main loop, in practice) and is only
+// read from that same thread when the admin port is scraped, so plain
+// integers are enough.
+
+#define METRICS_BUCKETS 24   // upper bounds base * 2^i, plus +Inf
+
+typedef struct {
+    double   base;                          // upper bound of bucket 0
+    uint64_t count;
+    double   sum;
+    uint64_t buckets[METRICS_BUCKETS + 1];  // non-cumulative; last is +Inf
+} Histogram;
+
+#define HISTOGRAM_SECONDS { 1e-6 }   // 1 us .. ~8 s
+#define HISTOGRAM_COUNT   { 1.0 }    // 1 .. ~8M
+
+void hist_observe(Histogram* h, double v);
+
+// Growable text buffer for one scrape.
+typedef struct {
+    char*  buf;
+    size_t len;
+    size_t cap;
+} MetricsOut;
+
+void metrics_printf(MetricsOut* o, const char* fmt, ...);
+void metrics_free(MetricsOut* o);
+
+// "# HELP" / "# TYPE" lines; emit once per metric name before its series.
+void metrics_header(MetricsOut* o, const char* name, const char* type, const char* help);
+
+// One sample. labels is the inside of {...} without braces, or NULL.
+void metrics_value(MetricsOut* o, const char* name, const char* labels, double v);
+
+// _bucket/_sum/_count series for one histogram.
+void metrics_histogram(MetricsOut* o, const char* name, const char* labels, const Histogram* h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
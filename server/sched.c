@@ -0,0 +1,166 @@
+#include "sched.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int rate_take(RateBucket* b, double now, float rate, float burst, float cost) {
+    if (b->last == 0.0) {
+        b->tokens = burst;
+    } else if (now > b->last) {
+        b->tokens += (float)(now - b->last) * rate;
+        if (b->tokens > burst) b->tokens = burst;
+    }
+    b->last = now;
+    if (b->tokens < cost) return 0;
+    b->tokens -= cost;
+    return 1;
+}
+
+typedef struct {
+    int head, count;       // ring of jobs in this flow's slice of q->jobs
+    int deficit;
+    int listed;            // on the active list
+    int held;              // skipped by fair_pop; see fair_hold
+} FairFlow;
+
+struct FairQueue {
+    int flows, depth, quantum;
+    FairFlow* flow;
+    FairJob* jobs;         // flows * depth
+    int* active;           // ring of flow ids with work, in service order
+    int activeHead, activeCount;
+    int fresh;             // the flow at the head has not had its quantum yet
+    int pending;
+};
+
+FairQueue* fair_create(int flows, int depth, int quantum) {
+    FairQueue* q = (FairQueue*)calloc(1, sizeof(FairQueue));
+    if (!q) return NULL;
+    q->flows = flows;
+    q->depth = depth;
+    q->quantum = quantum;
+    q->fresh = 1;
+    q->flow = (FairFlow*)calloc((size_t)flows, sizeof(FairFlow));
+    q->jobs = (FairJob*)calloc((size_t)flows * (size_t)depth, sizeof(FairJob));
+    q->active = (int*)calloc((size_t)flows, sizeof(int));
+    if (!q->flow || !q->jobs || !q->active) {
+        fair_destroy(q);
+        return NULL;
+    }
+    return q;
+}
+
+void fair_destroy(FairQueue* q) {
+    if (!q) return;
+    free(q->flow);
+    free(q->jobs);
+    free(q->active);
+    free(q);
+}
+
+int fair_push(FairQueue* q, int flow, int cost, const char* line) {
+    if (flow < 0 || flow >= q->flows) return 0;
+    FairFlow* f = &q->flow[flow];
+    if (f->count == q->depth) return 0;
+
+    FairJob* j = &q->jobs[flow * q->depth + (f->head + f->count) % q->depth];
+    j->cost = cost;
+    strncpy(j->line, line, FAIR_LINE_MAX - 1);
+    j->line[FAIR_LINE_MAX - 1] = '\0';
+    f->count++;
+    q->pending++;
+
+    if (!f->listed && !f->held) {
+        f->listed = 1;
+        q->active[(q->activeHead + q->activeCount) % q->flows] = flow;
+        q->activeCount++;
+    }
+    return 1;
+}
+
+// Takes the head flow off the active list; it keeps its deficit only if it
+// goes back on at the tail.
+static int pop_active(FairQueue* q) {
+    int flow = q->active[q->activeHead];
+    q->activeHead = (q->activeHead + 1) % q->flows;
+    q->activeCount--;
+    q->fresh = 1;
+    return flow;
+}
+
+int fair_pop(FairQueue* q, int* flow, FairJob* out) {
+    while (q->activeCount > 0) {
+        int id = q->active[q->activeHead];
+        FairFlow* f = &q->flow[id];
+        if (f->count == 0 || f->held) {
+            // dropped or held while listed; fair_hold lists it again
+            pop_active(q);
+            f->listed = 0;
+            f->deficit = 0;
+            continue;
+        }
+        if (q->fresh) {
+            f->deficit += q->quantum;
+            q->fresh = 0;
+        }
+
+        FairJob* j = &q->jobs[id * q->depth + f->head];
+        if (j->cost > f->deficit) {
+            // round over for this flow; the deficit carries to the next one
+            pop_active(q);
+            q->active[(q->activeHead + q->activeCount) % q->flows] = id;
+            q->activeCount++;
+            continue;
+        }
+
+        f->deficit -= j->cost;
+        *flow = id;
+        memcpy(out, j, sizeof(*out));
+        f->head = (f->head + 1) % q->depth;
+        f->count--;
+        q->pending--;
+        if (f->count == 0) {
+            pop_active(q);
+            f->listed = 0;
+            f->deficit = 0;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+void fair_drop(FairQueue* q, int flow) {
+    if (flow < 0 || flow >= q->flows) return;
+    FairFlow* f = &q->flow[flow];
+    q->pending -= f->count;
+    f->count = 0;
+    f->head = 0;
+    f->held = 0;
+}
+
+void fair_hold(FairQueue* q, int flow, int held) {
+    if (flow < 0 || flow >= q->flows) return;
+    FairFlow* f = &q->flow[flow];
+    f->held = held;
+    if (!held && f->count > 0 && !f->listed) {
+        f->listed = 1;
+        q->active[(q->activeHead + q->activeCount) % q->flows] = flow;
+        q->activeCount++;
+    }
+}
+
+int fair_pending(const FairQueue* q) {
+    return q->pending;
+}
+
+int fair_ready(const FairQueue* q) {
+    for (int i = 0; i < q->activeCount; i++) {
+        const FairFlow* f = &q->flow[q->active[(q->activeHead + i) % q->flows]];
+        if (f->count > 0 && !f->held) return 1;
+    }
+    return 0;
+}
+
+int fair_flow_pending(const FairQueue* q, int flow) {
+    return (flow >= 0 && flow < q->flows) ? q->flow[flow].count : 0;
+}
@@ -0,0 +1,56 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Admission and ordering for expensive commands.
+//
+// A RateBucket caps how often one client may start a class of command: it
+// holds up to burst tokens, refills at rate per second, and each command
+// takes its cost. A FairQueue then decides which admitted command runs
+// next, deficit round-robin over flows (one per connection): every flow
+// with work gets quantum cost units per round, so a client queueing ten
+// model calls waits its turn behind a client queueing one. A flow can be
+// held: it keeps its jobs but is skipped until released.
+
+typedef struct {
+    float  tokens;
+    double last;           // time of the last refill; 0 = never used (full)
+} RateBucket;
+
+// Takes cost tokens at time now. Returns 0, taking nothing, if there are
+// not enough.
+int  rate_take(RateBucket* b, double now, float rate, float burst, float cost);
+
+#define FAIR_LINE_MAX 512
+
+typedef struct {
+    int  cost;
+    char line[FAIR_LINE_MAX];
+} FairJob;
+
+typedef struct FairQueue FairQueue;
+
+// flows numbered 0..flows-1, each holding up to depth jobs.
+FairQueue* fair_create(int flows, int depth, int quantum);
+void       fair_destroy(FairQueue* q);
+
+// Returns 0 if the flow already has depth jobs waiting.
+int  fair_push(FairQueue* q, int flow, int cost, const char* line);
+
+// The next job in DRR order and its flow. Returns 0 when nothing waits.
+int  fair_pop(FairQueue* q, int* flow, FairJob* out);
+
+void fair_drop(FairQueue* q, int flow);   // forget a flow's waiting jobs, and any hold
+void fair_hold(FairQueue* q, int flow, int held);
+int  fair_pending(const FairQueue* q);
+int  fair_ready(const FairQueue* q);      // 1 if fair_pop would return a job
+int  fair_flow_pending(const FairQueue* q, int flow);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,15 +1,20 @@
-// server/server.c - standalone authoritative game server (1 client, TCP)
+// server/server.c - standalone authoritative game server (multi-client, TCP)
 // Protocol (line-based):
 //   Client -> Server:
-//     HELLO
-//     INPUT <fwd> <right> <jump> <yawDelta> <pitchDelta> <dt>
+//     HELLO [<session> <nextSeq>]
+//     INPUT <fwd> <right> <jump> <yawDelta> <pitchDelta> <dt> [...]
 //     CMD <text...>
+//     UDP                      (after HELLO: move traffic onto datagrams)
+//     SHM                      (before HELLO, same host: shared memory)
 //
 //   Server -> Client:
-//     WELCOME <version>
-//     HIST <n>
+//     WELCOME <version> <session>
+//     HIST <n> <seq>
 //     LINE <text...>
 //     STATE <x> <y> <z> <yaw> <pitch>
+//     SNAP <seq> <ms> <n>, then n x ENT <id> <x> <y> <z> <yaw>
+//     UDP <port> <token>
+//     SHM <name> | SHM -
 
 #define _CRT_SECURE_NO_WARNINGS
 
@@ -18,16 +23,23 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
+#include <time.h>
+#include <signal.h>
 
 #ifdef _WIN32
+  #define FD_SETSIZE 1024   // winsock defaults to 64 sockets per select()
   #include <winsock2.h>
   #include <ws2tcpip.h>
   #pragma comment(lib, "ws2_32.lib")
 #else
   #include <unistd.h>
+  #include <fcntl.h>
   #include <arpa/inet.h>
   #include <sys/socket.h>
   #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/select.h>
+  #include <errno.h>
   typedef int SOCKET;
   #define INVALID_SOCKET (-1)
   #define SOCKET_ERROR (-1)
@@ -36,8 +48,25 @@
 
 #include "../common/protocol.h"
 #include "toy_term.h"
-
-#define MAX_OBJS 256
+#include "snapshot.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "../common/timing.h"
+#include "../common/netchan.h"
+#include "../common/netsim.h"
+#include "../common/shm_link.h"
+#include "../common/numcodec.h"
+#include "../common/arena.h"
+#include "../common/entropy.h"
+#include "llm.h"
+#include "command.h"
+#include "sched.h"
+
+#define MAX_OBJS    256
+#define MAX_CLIENTS 256
+#define MAX_SESSIONS 16384
+#define LINE_CAP    512
 
 typedef struct {
     int id;
@@ -50,6 +79,9 @@ typedef struct {
 static ObjCube g_objs[MAX_OBJS];
 static int g_nextObjId = 1;
 
+// Snapshots copy the entity store verbatim; keep the layouts in lockstep.
+typedef char obj_layout_matches_snapshot[(sizeof(ObjCube) == sizeof(SnapObj)) ? 1 : -1];
+
 static ObjCube* obj_alloc(void) {
     for (int i = 0; i < MAX_OBJS; i++) {
         if (!g_objs[i].alive) {
@@ -61,22 +93,6 @@ static ObjCube* obj_alloc(void) {
     return NULL;
 }
 
-static int send_line(SOCKET s, const char* lineWithNewline);
-
-static void send_obj_add(SOCKET c, const ObjCube* o) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "OBJ_ADD %d %.3f %.3f %.3f %.3f %d %d %d\n",
-             o->id, o->x, o->y, o->z, o->s, o->r, o->g, o->b);
-    send_line(c, buf);
-}
-
-static void send_all_objs(SOCKET c) {
-    // could send OBJ_CLEAR first if you want strict sync
-    for (int i = 0; i < MAX_OBJS; i++) {
-        if (g_objs[i].alive) send_obj_add(c, &g_objs[i]);
-    }
-}
-
 typedef struct {
     float x, y, z;
     float yaw, pitch;
@@ -86,102 +102,825 @@ typedef struct {
     int grounded;
 } PlayerState;
 
-static int send_line(SOCKET s, const char* lineWithNewline) {
-    int len = (int)strlen(lineWithNewline);
+// Per-player state. Kept small: the terminal is arena-backed and only holds
+// what the player has actually produced. Sessions outlive their connection so
+// a reconnecting client can resume where it left off.
+typedef struct {
+    uint64_t id;            // resume token: random, never shown to other players
+    int attached;
+    time_t lastSeen;
+    PlayerState ps;
+    ToyTerm* term;
+    RateBucket cmdRate[CMD_CLASSES];   // per class; cheap commands are not limited
+    int modelBusy;          // a model call is out; see model_call_send()
+} Session;
+
+// One live TCP connection and its partial-line receive buffer. sess is NULL
+// until the client has said HELLO.
+typedef struct {
+    SOCKET sock;
+    Session* sess;
+    unsigned sentSeq;   // history seq the client will receive next
+    char inbuf[LINE_CAP];
+    int  inLen;
+
+    // TCP output the socket did not take yet, sent when select() reports
+    // it writable; see conn_write()
+    char* out;
+    int   outLen, outCap;
+    int   tcpStalled;   // TCP_BACKLOG or TCP_ERROR; tcp_reap drops it
+
+    uint64_t bytesIn, bytesOut;
+    uint64_t linesIn, linesOut;
+
+    // optional datagram channel, offered after a "UDP" request; traffic
+    // moves onto it once the first valid datagram tells us the address
+    NetChan* chan;
+    int udpBound;
+    int udpStalled;     // the reliable window filled up
+    struct sockaddr_in udpAddr;
+
+    NetSimPipes* sim;   // simulated link (--sim-*); NULL when off
+
+    // shared-memory link to a same-host client, set up by "SHM" before
+    // HELLO; all lines then go through it and the socket only wakes
+    ShmLink* shm;
+    int shmStalled;     // the client stopped draining its ring
+} Conn;
+
+static Conn g_conns[MAX_CLIENTS];
+static Session* g_sessions[MAX_SESSIONS];
+static int g_sessionCount = 0;
+static FairQueue* g_cmdQueue;   // expensive commands waiting; see cmd_submit()
+
+// -------------------- metrics --------------------
+
+// Everything below is written and scraped on the main loop only, so the hot
+// path is plain increments and a clock read; see serve_metrics().
+
+enum { MSG_IN_HELLO, MSG_IN_INPUT, MSG_IN_CMD, MSG_IN_OTHER, MSG_IN_KINDS };
+static const char* kMsgInNames[MSG_IN_KINDS] = { "HELLO", "INPUT", "CMD", "other" };
+
+enum {
+    MSG_OUT_WELCOME, MSG_OUT_HIST, MSG_OUT_LINE, MSG_OUT_STATE,
+    MSG_OUT_OBJ_ADD, MSG_OUT_OBJ_DEL, MSG_OUT_OBJ_CLEAR, MSG_OUT_SNAP, MSG_OUT_ENT,
+    MSG_OUT_OTHER, MSG_OUT_KINDS
+};
+static const char* kMsgOutNames[MSG_OUT_KINDS] = {
+    "WELCOME", "HIST", "LINE", "STATE", "OBJ_ADD", "OBJ_DEL", "OBJ_CLEAR", "SNAP", "ENT", "other"
+};
+
+
+enum { PHASE_JOURNAL, PHASE_COMMANDS, PHASE_SNAPSHOT, PHASE_BROADCAST, PHASE_POLL, PHASE_ACCEPT, PHASE_RECV, PHASE_ADMIN, PHASE_COUNT };
+static const char* kPhaseNames[PHASE_COUNT] = { "journal", "commands", "snapshot", "broadcast", "poll", "accept", "recv", "admin" };
+
+static struct {
+    uint64_t msgsIn[MSG_IN_KINDS];
+    uint64_t msgsOut[MSG_OUT_KINDS];
+    uint64_t bytesIn, bytesOut;
+    uint64_t sendErrors;
+    uint64_t connsAccepted, connsRejected, connsClosed;
+    uint64_t llmCalls[LLM_ENDPOINTS], llmFailures[LLM_ENDPOINTS];
+    uint64_t snapshotsTaken, snapshotsSkipped;
+    uint64_t udpPacketsIn, udpPacketsOut, udpRejected;
+    uint64_t cmdQueued[CMD_CLASSES], cmdRefused[CMD_CLASSES];
+    uint64_t ticks;
+    uint64_t scrapes;
+
+    Histogram handle[MSG_IN_KINDS];   // seconds per dispatched line
+    Histogram llmRtt[LLM_ENDPOINTS];      // seconds per request
+    Histogram phase[PHASE_COUNT];     // seconds per tick phase
+    Histogram tickBusy;               // seconds per tick, excluding poll
+    Histogram tickLines;              // lines dispatched per active tick
+} g_metrics;
+
+static uint64_t g_tickLines = 0;
+
+static void metrics_init(void) {
+    for (int i = 0; i < MSG_IN_KINDS; i++) g_metrics.handle[i].base = 1e-6;
+    for (int i = 0; i < LLM_ENDPOINTS; i++) g_metrics.llmRtt[i].base = 1e-3;
+    for (int i = 0; i < PHASE_COUNT; i++) g_metrics.phase[i].base = 1e-6;
+    g_metrics.tickBusy.base = 1e-6;
+    g_metrics.tickLines.base = 1.0;
+}
+
+static int msg_in_kind(const char* line) {
+    if (strncmp(line, "INPUT ", 6) == 0) return MSG_IN_INPUT;
+    if (strncmp(line, "CMD ", 4) == 0) return MSG_IN_CMD;
+    if (strncmp(line, "HELLO", 5) == 0) return MSG_IN_HELLO;
+    return MSG_IN_OTHER;
+}
+
+static int msg_out_kind(const char* line) {
+    switch (line[0]) {
+    case 'W': return MSG_OUT_WELCOME;
+    case 'H': return MSG_OUT_HIST;
+    case 'L': return MSG_OUT_LINE;
+    case 'S': return line[1] == 'N' ? MSG_OUT_SNAP : MSG_OUT_STATE;
+    case 'E': return MSG_OUT_ENT;
+    case 'O':
+        if (line[4] == 'A') return MSG_OUT_OBJ_ADD;
+        if (line[4] == 'D') return MSG_OUT_OBJ_DEL;
+        if (line[4] == 'C') return MSG_OUT_OBJ_CLEAR;
+        return MSG_OUT_OTHER;
+    default:  return MSG_OUT_OTHER;
+    }
+}
+
+// Closes the phase that started at *t and starts the next one.
+static void phase_mark(uint64_t* t, int phase) {
+    uint64_t now = time_now_ns();
+    hist_observe(&g_metrics.phase[phase], (double)(now - *t) * 1e-9);
+    *t = now;
+}
+
+// -------------------- journal / replay --------------------
+
+static uint32_t g_tick = 0;                 // one per main-loop iteration
+static JournalReader* g_replay = NULL;      // non-NULL while replaying
+static uint64_t g_replayRecords = 0;
+static int g_replayFailed = 0;              // the result cannot be trusted
+
+static void replay_corrupt(void) {
+    printf("replay: journal truncated or corrupt at record %llu (tick %u)\n",
+           (unsigned long long)g_replayRecords, g_tick);
+    g_replayFailed = 1;
+}
+
+// Pulls the next journal record during replay, which must be of the given
+// type since the live run appended it at exactly this point.
+static int replay_expect(JournalType type) {
+    g_replayRecords++;
+    int got = journal_read(g_replay);
+    if (got < 0) {
+        replay_corrupt();
+        return 0;
+    }
+    if (got == 0 || g_replay->rec.type != type) {
+        printf("replay: diverged at tick %u (expected record type %d)\n", g_tick, (int)type);
+        g_replayFailed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// LLM responses are the only outside input besides client lines; record them
+// live where they are applied and feed them back there during replay (see
+// model_apply()).
+static void llm_record(int ok, const char* data) {
+    if (!journal_is_open()) return;
+    uint32_t len = (uint32_t)strlen(data);
+    char* rec = (char*)malloc(len + 1);
+    if (!rec) return;
+    rec[0] = (char)(ok ? 1 : 0);
+    memcpy(rec + 1, data, len);
+    journal_append(g_tick, J_LLM, 0, rec, len + 1);
+    free(rec);
+}
+
+static int send_all(SOCKET s, const char* data, int len) {
     int sent = 0;
     while (sent < len) {
-        int r = send(s, lineWithNewline + sent, len - sent, 0);
+        int r = send(s, data + sent, len - sent, 0);
         if (r <= 0) return 0;
         sent += r;
     }
     return 1;
 }
 
-static int recv_line(SOCKET s, char* out, int cap) {
-    // simple byte-by-byte until \n
-    int n = 0;
-    while (n < cap - 1) {
-        char ch;
-        int r = recv(s, &ch, 1, 0);
-        if (r <= 0) return 0;
-        if (ch == '\n') break;
-        if (ch != '\r') out[n++] = ch;
+// Writes a whole line to a socket. Returns the byte count, or -1 on error.
+static int send_raw(SOCKET s, const char* lineWithNewline) {
+    int len = (int)strlen(lineWithNewline);
+    return send_all(s, lineWithNewline, len) ? len : -1;
+}
+
+// Client sockets are non-blocking: a client that stops reading must not
+// stall the loop in send() for everyone else. Whatever the socket does not
+// take goes into the connection's queue, which is bounded like the UDP
+// window and the shared-memory ring; a client that lets it fill is dropped
+// and resyncs on reconnect.
+#define CONN_OUT_MAX (256 * 1024)
+
+enum { TCP_BACKLOG = 1, TCP_ERROR };
+
+static void set_nonblocking(SOCKET s) {
+#ifdef _WIN32
+    u_long nb = 1;
+    ioctlsocket(s, FIONBIO, &nb);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static int sock_would_block(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+// Sends from data until the socket would block. Returns the bytes sent, or
+// -1 on a hard error.
+static int send_some(SOCKET s, const char* data, int len) {
+    int sent = 0;
+    while (sent < len) {
+        int r = send(s, data + sent, len - sent, 0);
+        if (r > 0) {
+            sent += r;
+            continue;
+        }
+        if (r < 0 && sock_would_block()) break;
+        return -1;
+    }
+    return sent;
+}
+
+// Sends now what the socket takes, queueing the rest behind anything
+// already waiting. Returns 0 once the connection is stalled.
+static int conn_write(Conn* c, const char* data, int len) {
+    if (c->tcpStalled) return 0;
+    int sent = 0;
+    if (c->outLen == 0) {
+        sent = send_some(c->sock, data, len);
+        if (sent < 0) {
+            c->tcpStalled = TCP_ERROR;
+            return 0;
+        }
+        if (sent == len) return 1;
     }
-    out[n] = '\0';
+
+    int rest = len - sent;
+    if (c->outLen + rest > CONN_OUT_MAX) {
+        c->tcpStalled = TCP_BACKLOG;
+        return 0;
+    }
+    if (c->outLen + rest > c->outCap) {
+        int cap = c->outCap ? c->outCap : 4096;
+        while (cap < c->outLen + rest) cap *= 2;
+        if (cap > CONN_OUT_MAX) cap = CONN_OUT_MAX;
+        char* grown = (char*)realloc(c->out, (size_t)cap);
+        if (!grown) {
+            c->tcpStalled = TCP_BACKLOG;
+            return 0;
+        }
+        c->out = grown;
+        c->outCap = cap;
+    }
+    memcpy(c->out + c->outLen, data + sent, (size_t)rest);
+    c->outLen += rest;
     return 1;
 }
 
-static void send_history(SOCKET c, ToyTerm* term) {
-    char buf[512];
-    int n = term_history_count(term);
-    snprintf(buf, sizeof(buf), "HIST %d\n", n);
-    send_line(c, buf);
+// Sends as much of the queue as the socket takes now.
+static void conn_flush(Conn* c) {
+    int sent = send_some(c->sock, c->out, c->outLen);
+    if (sent < 0) {
+        c->tcpStalled = TCP_ERROR;
+        return;
+    }
+    if (sent > 0) {
+        memmove(c->out, c->out + sent, (size_t)(c->outLen - sent));
+        c->outLen -= sent;
+    }
+}
 
-    for (int i = 0; i < n; i++) {
-        const char* ln = term_history_line(term, i);
-        if (!ln) ln = "";
-        snprintf(buf, sizeof(buf), "LINE %s\n", ln);
-        send_line(c, buf);
+static int udp_queue(Conn* c, int kind, const char* lineWithNewline);
+static int shm_queue(Conn* c, const char* lineWithNewline);
+
+static int send_line(Conn* c, const char* lineWithNewline) {
+    int kind = msg_out_kind(lineWithNewline);
+    g_metrics.msgsOut[kind]++;
+    c->linesOut++;
+    if (g_replay) return 1;   // headless
+    if (c->udpBound) return udp_queue(c, kind, lineWithNewline);
+    if (c->shm) return shm_queue(c, lineWithNewline);
+
+    int n = (int)strlen(lineWithNewline);
+    // through the simulated link it goes out from sim_service, when due
+    int ok = c->sim ? netsim_push(&c->sim->tcpOut, lineWithNewline, n, time_now())
+                    : conn_write(c, lineWithNewline, n);
+    if (!ok) {
+        g_metrics.sendErrors++;
+        return 0;
     }
+    c->bytesOut += (uint64_t)n;
+    g_metrics.bytesOut += (uint64_t)n;
+    return 1;
+}
+
+// Field writers for the hot outgoing lines: " <v>" appended at p, same text
+// as snprintf's "%d" / "%.Nf" without the format parsing and locale lookup.
+// A line of k fields needs k * (NUM_FORMAT_MAX + 1) bytes past its tag.
+static char* put_int(char* p, int v) {
+    *p++ = ' ';
+    return p + num_format_int(p, v);
+}
+
+static char* put_float(char* p, float v, int decimals) {
+    *p++ = ' ';
+    return p + num_format_float(p, v, decimals);
 }
 
-static void send_state(SOCKET c, const PlayerState* ps) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "STATE %.6f %.6f %.6f %.6f %.6f\n",
-             ps->x, ps->y, ps->z, ps->yaw, ps->pitch);
+static void send_obj_add(Conn* c, const ObjCube* o) {
+    char buf[16 + 8 * (NUM_FORMAT_MAX + 1)];
+    char* p = buf;
+    memcpy(p, "OBJ_ADD", 7);
+    p = put_int(p + 7, o->id);
+    p = put_float(p, o->x, 3);
+    p = put_float(p, o->y, 3);
+    p = put_float(p, o->z, 3);
+    p = put_float(p, o->s, 3);
+    p = put_int(p, o->r);
+    p = put_int(p, o->g);
+    p = put_int(p, o->b);
+    p[0] = '\n';
+    p[1] = '\0';
     send_line(c, buf);
 }
 
-static int http_post_localhost_8080(const char* path, const char* jsonBody, char* out, int outCap) {
-    // Connect to 127.0.0.1:8080 and POST jsonBody to path. Store full HTTP response in out.
-    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s == INVALID_SOCKET) return 0;
+static void send_all_objs(Conn* c) {
+    // could send OBJ_CLEAR first if you want strict sync
+    for (int i = 0; i < MAX_OBJS; i++) {
+        if (g_objs[i].alive) send_obj_add(c, &g_objs[i]);
+    }
+}
 
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(8080);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+static void handle_line(Conn* c, char* line);
+
+// Splits received bytes into lines and dispatches them. Over-long lines are
+// split at LINE_CAP-1 bytes; a partial line is carried to the next call.
+static void conn_feed(Conn* c, const char* data, int len) {
+    for (int i = 0; i < len; i++) {
+        char ch = data[i];
+        if (ch == '\r') continue;
+        if (ch != '\n') c->inbuf[c->inLen++] = ch;
+        if (ch == '\n' || c->inLen == LINE_CAP - 1) {
+            c->inbuf[c->inLen] = '\0';
+            c->inLen = 0;
+            handle_line(c, c->inbuf);
+        }
+    }
+}
 
-    if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        closesocket(s);
+// Drains whatever the socket has. Returns 0 when the peer disconnected.
+static int conn_read(Conn* c) {
+    char tmp[1024];
+    int r = recv(c->sock, tmp, (int)sizeof(tmp), 0);
+    if (r < 0 && sock_would_block()) return 1;
+    if (c->shm) return r > 0;   // wakeup bytes; the lines are in the ring
+    if (r <= 0) {
+        // lines still crossing the simulated link arrive before the close
+        if (c->sim && c->sim->tcpIn.count > 0) {
+            c->sim->peerClosed = 1;
+            return 1;
+        }
         return 0;
     }
+    c->bytesIn += (uint64_t)r;
+    g_metrics.bytesIn += (uint64_t)r;
+    if (c->sim) return netsim_push(&c->sim->tcpIn, tmp, r, time_now());
+    TRACE_BEGIN("parse");
+    conn_feed(c, tmp, r);
+    TRACE_END("parse");
+    return 1;
+}
 
-    char req[8192];
-    int bodyLen = (int)strlen(jsonBody);
-    int n = snprintf(req, sizeof(req),
-        "POST %s HTTP/1.1\r\n"
-        "Host: 127.0.0.1:8080\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %d\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        "%s",
-        path, bodyLen, jsonBody);
+// -------------------- datagram channel --------------------
+
+// One UDP socket serves every client. A client asks for it with "UDP" over
+// TCP after HELLO and gets "UDP <port> <token>". The token is 32 bits from
+// entropy_fill (nonzero, unique among connections) and encodes nothing; a
+// datagram is matched to its connection by udp_find's scan, never by
+// decoding the token. From the first datagram carrying the token on, STATE
+// and SNAP/ENT go out unreliable-sequenced and everything else on the
+// channel's reliable lane, so movement never queues behind a burst of
+// terminal or object lines. WELCOME and the UDP reply stay on TCP, which
+// also carries the connection's lifetime.
+static SOCKET g_udpSock = INVALID_SOCKET;
+static int g_udpPort = 0;
+static int g_udpBound = 0;   // connections currently on UDP
+
+static int udp_queue(Conn* c, int kind, const char* lineWithNewline) {
+    int lane = NETCHAN_RELIABLE;
+    if (kind == MSG_OUT_STATE) lane = NETCHAN_LANE_INPUT;
+    else if (kind == MSG_OUT_SNAP || kind == MSG_OUT_ENT) lane = NETCHAN_LANE_SNAP;
+    if (!netchan_queue(c->chan, lane, lineWithNewline, (int)strlen(lineWithNewline))) {
+        // reliable window full: the client is not keeping up; udp_reap
+        // drops it and the reconnect resyncs
+        c->udpStalled = 1;
+        g_metrics.sendErrors++;
+        return 0;
+    }
+    return 1;
+}
 
-    if (n <= 0 || n >= (int)sizeof(req)) {
-        closesocket(s);
+// The connection whose channel uses token, or NULL.
+static Conn* udp_find(uint32_t token) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].chan && g_conns[i].chan->token == token) return &g_conns[i];
+    }
+    return NULL;
+}
+
+static void handle_udp_request(Conn* c) {
+    if (g_replay || g_udpSock == INVALID_SOCKET || c->chan || c->shm) return;
+
+    // the token is all a datagram has to prove which connection it belongs
+    // to, so it must not be guessable: all 32 bits from the OS generator
+    uint32_t token = 0;
+    while (token == 0 || udp_find(token)) {
+        if (!entropy_fill(&token, sizeof(token))) return;   // stays on TCP
+    }
+    c->chan = (NetChan*)malloc(sizeof(NetChan));
+    if (!c->chan) return;
+    netchan_init(c->chan, token, time_now());
+    // a STATE rides in two packets, so one loss never skips a reply
+    netchan_set_redundancy(c->chan, NETCHAN_LANE_INPUT, 2);
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "UDP %d %08x\n", g_udpPort, token);
+    send_line(c, buf);
+}
+
+static void udp_deliver(int lane, const char* data, int len, void* ud) {
+    (void)lane;
+    Conn* c = (Conn*)ud;
+    char buf[NETCHAN_MAX_MSG + 1];
+    memcpy(buf, data, (size_t)len);
+    buf[len] = '\0';
+    char* p = buf;
+    while (*p && c->sock != INVALID_SOCKET) {
+        char* nl = strchr(p, '\n');
+        if (nl) *nl = '\0';
+        if (*p) handle_line(c, p);
+        if (!nl) break;
+        p = nl + 1;
+    }
+}
+
+// Feeds one datagram from `from` to c's channel. The sender becomes the
+// connection's address (following NAT rebinding) only once the channel has
+// taken the packet as its newest yet: a datagram that fails validation, or
+// replays an old sequence number, cannot redirect the connection's traffic.
+static void udp_accept(Conn* c, const uint8_t* pkt, int n, const struct sockaddr_in* from, double now) {
+    NetChan* ch = c->chan;
+    int hadRemote = ch->haveRemote;
+    uint16_t prevSeq = ch->remoteSeq;
+
+    TRACE_BEGIN("udp_receive");
+    int ok = netchan_receive(ch, pkt, n, now, udp_deliver, c);
+    TRACE_END("udp_receive");
+    if (!ok) {
+        g_metrics.udpRejected++;
+        return;
+    }
+    // delivered lines may have closed the connection
+    if (c->chan != ch) return;
+    if (hadRemote && ch->remoteSeq == prevSeq) return;   // duplicate or older
+
+    if (!c->udpBound) g_udpBound++;
+    c->udpBound = 1;
+    c->udpAddr = *from;
+}
+
+static void udp_recv(void) {
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    double now = time_now();
+    for (;;) {
+        struct sockaddr_in from;
+#ifdef _WIN32
+        int fromLen = (int)sizeof(from);
+#else
+        socklen_t fromLen = sizeof(from);
+#endif
+        int n = recvfrom(g_udpSock, (char*)pkt, (int)sizeof(pkt), 0, (struct sockaddr*)&from, &fromLen);
+        if (n <= 0) break;
+
+        uint32_t token;
+        Conn* c = netchan_peek_token(pkt, n, &token) ? udp_find(token) : NULL;
+        if (!c) {
+            g_metrics.udpRejected++;
+            continue;
+        }
+        g_metrics.udpPacketsIn++;
+        g_metrics.bytesIn += (uint64_t)n;
+        c->bytesIn += (uint64_t)n;
+
+        if (c->sim) {
+            // the sender travels with the datagram; udp_accept needs it
+            uint8_t rec[sizeof(from) + NETCHAN_MAX_PACKET];
+            memcpy(rec, &from, sizeof(from));
+            memcpy(rec + sizeof(from), pkt, (size_t)n);
+            netsim_push(&c->sim->udpIn, rec, (int)sizeof(from) + n, now);
+            continue;
+        }
+        udp_accept(c, pkt, n, &from, now);
+    }
+}
+
+static void conn_close(Conn* c);
+
+// Drops clients whose channel went silent or fell too far behind. Runs
+// before the poll set is built, so no closed socket ends up in it.
+static void udp_reap(void) {
+    if (!g_udpBound) return;
+    double now = time_now();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (!c->udpBound) continue;
+        if (c->udpStalled || netchan_timed_out(c->chan, now)) {
+            printf("Client dropped (UDP %s).\n", c->udpStalled ? "backlog" : "timeout");
+            conn_close(c);
+        }
+    }
+}
+
+// Drops clients whose TCP output backed up past CONN_OUT_MAX or failed.
+// Same place in the loop as udp_reap.
+static void tcp_reap(void) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (c->sock == INVALID_SOCKET || !c->tcpStalled) continue;
+        printf("Client dropped (TCP %s).\n", c->tcpStalled == TCP_BACKLOG ? "backlog" : "send error");
+        conn_close(c);
+    }
+}
+
+// Sends whatever each channel has due: new messages, resends, acks and
+// keepalives.
+static void udp_service(void) {
+    if (!g_udpBound) return;
+    uint8_t pkt[NETCHAN_MAX_PACKET];
+    double now = time_now();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (!c->udpBound) continue;
+        int n;
+        while ((n = netchan_flush(c->chan, now, pkt)) > 0) {
+            if (c->sim) netsim_push(&c->sim->udpOut, pkt, n, now);
+            else sendto(g_udpSock, (const char*)pkt, n, 0, (const struct sockaddr*)&c->udpAddr, (int)sizeof(c->udpAddr));
+            g_metrics.udpPacketsOut++;
+            g_metrics.bytesOut += (uint64_t)n;
+            c->bytesOut += (uint64_t)n;
+        }
+    }
+}
+
+// -------------------- shared-memory link --------------------
+
+// A client on this host may send "SHM" before HELLO. It gets "SHM <name>"
+// naming a fresh mapping with one ring per direction (common/shm_link.c),
+// or "SHM -" if it is not local or shared memory is off. Everything after
+// the reply goes through the rings, which the loop drains every tick; the
+// socket stays open only for its close and for wakeup bytes. Before
+// select() each link's sleep flag is raised, so a client sending while the
+// loop is blocked pokes the socket, and a blocked client is poked the same
+// way when lines arrive for it.
+static int g_shmEnabled = 1;
+static int g_shmLinks = 0;   // connections currently on shared memory
+
+static int shm_queue(Conn* c, const char* lineWithNewline) {
+    int n = (int)strlen(lineWithNewline);
+    if (!shmlink_send(c->shm, lineWithNewline, n)) {
+        c->shmStalled = 1;   // shm_service drops it
+        g_metrics.sendErrors++;
         return 0;
     }
+    c->bytesOut += (uint64_t)n;
+    g_metrics.bytesOut += (uint64_t)n;
+    if (shmlink_wake_needed(c->shm)) conn_write(c, "\n", 1);
+    return 1;
+}
+
+static int peer_is_local(SOCKET s) {
+    struct sockaddr_in peer;
+#ifdef _WIN32
+    int len = (int)sizeof(peer);
+#else
+    socklen_t len = sizeof(peer);
+#endif
+    if (getpeername(s, (struct sockaddr*)&peer, &len) != 0) return 0;
+    return (ntohl(peer.sin_addr.s_addr) >> 24) == 127;
+}
+
+static void handle_shm_request(Conn* c) {
+    if (g_replay || c->shm || c->chan) return;
+    ShmLink* l = NULL;
+    char name[SHM_LINK_NAME_MAX];
+    if (g_shmEnabled && peer_is_local(c->sock)) {
+        unsigned key = (unsigned)(time_now_ns() * 0x9E3779B97F4A7C15ull >> 40) << 8 | (unsigned)(c - g_conns);
+        shmlink_make_name(name, (int)sizeof(name), key);
+        l = (ShmLink*)malloc(sizeof(ShmLink));
+        if (l && !shmlink_create(l, name)) {
+            free(l);
+            l = NULL;
+        }
+    }
+    if (!l) {
+        send_line(c, "SHM -\n");
+        return;
+    }
 
-    int sent = 0;
-    while (sent < n) {
-        int r = send(s, req + sent, n - sent, 0);
-        if (r <= 0) { closesocket(s); return 0; }
-        sent += r;
+    char buf[SHM_LINK_NAME_MAX + 8];
+    snprintf(buf, sizeof(buf), "SHM %s\n", name);
+    send_line(c, buf);   // last thing on the socket
+    c->shm = l;
+    g_shmLinks++;
+}
+
+// Parses what every link has received and drops clients that stopped
+// reading. Closes connections, so it runs where udp_reap may.
+static void shm_service(void) {
+    if (!g_shmLinks) return;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (!c->shm) continue;
+        if (c->shmStalled) {
+            printf("Client dropped (shared-memory ring %s).\n", shmlink_corrupt(c->shm) ? "corrupt" : "full");
+            conn_close(c);
+            continue;
+        }
+        char* rec;
+        int len;
+        TRACE_BEGIN("parse");
+        while (c->shm && (rec = shmlink_peek(c->shm, &len)) != NULL) {
+            c->bytesIn += (uint64_t)len;
+            g_metrics.bytesIn += (uint64_t)len;
+            conn_feed(c, rec, len);
+            if (c->shm) shmlink_pop(c->shm);
+        }
+        TRACE_END("parse");
+        // the peer broke the ring's invariants; dropped on the next pass
+        if (c->shm && shmlink_corrupt(c->shm)) c->shmStalled = 1;
     }
+}
 
-    int total = 0;
-    while (total < outCap - 1) {
-        int r = recv(s, out + total, outCap - 1 - total, 0);
-        if (r <= 0) break;
-        total += r;
+// Raises every link's sleep flag before select(). Returns 0 if one already
+// has lines waiting, in which case select() must not block.
+static int shm_sleep(void) {
+    int idle = 1;
+    for (int i = 0; g_shmLinks && i < MAX_CLIENTS; i++) {
+        if (g_conns[i].shm && !shmlink_sleep_begin(g_conns[i].shm)) idle = 0;
     }
-    out[total] = 0;
+    return idle;
+}
 
-    closesocket(s);
-    return total > 0;
+static void shm_wake(void) {
+    for (int i = 0; g_shmLinks && i < MAX_CLIENTS; i++) {
+        if (g_conns[i].shm) shmlink_sleep_end(g_conns[i].shm);
+    }
+}
+
+// -------------------- simulated link --------------------
+
+// With any --sim-* flag every connection gets a NetSimPipes: received bytes
+// and datagrams wait in it before they are parsed, output waits in it
+// before it reaches a socket, as if the link had the configured latency,
+// jitter, bandwidth and loss. Journaling sees lines when they come out.
+static NetSimConfig g_simCfg;
+
+// Hands over whatever the links have delivered by now, in both directions,
+// and closes connections whose peer left once their last lines are in.
+static void sim_service(void) {
+    if (!netsim_active(&g_simCfg)) return;
+    char buf[4096];
+    double now = time_now();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (!c->sim) continue;
+        NetSimPipes* p = c->sim;
+        int n;
+
+        TRACE_BEGIN("parse");
+        while ((n = netsim_pop(&p->tcpIn, now, buf, (int)sizeof(buf))) > 0) conn_feed(c, buf, n);
+        TRACE_END("parse");
+        while ((n = netsim_pop(&p->udpIn, now, buf, (int)sizeof(buf))) > 0) {
+            struct sockaddr_in from;
+            if (!c->chan || n < (int)sizeof(from)) continue;
+            memcpy(&from, buf, sizeof(from));
+            udp_accept(c, (const uint8_t*)buf + sizeof(from), n - (int)sizeof(from), &from, now);
+        }
+        if (p->peerClosed && p->tcpIn.count == 0) {
+            printf("Client disconnected.\n");
+            conn_close(c);
+            continue;
+        }
+
+        while ((n = netsim_pop(&p->tcpOut, now, buf, (int)sizeof(buf))) > 0) {
+            if (!conn_write(c, buf, n)) g_metrics.sendErrors++;
+        }
+        while ((n = netsim_pop(&p->udpOut, now, buf, (int)sizeof(buf))) > 0) {
+            sendto(g_udpSock, buf, n, 0, (const struct sockaddr*)&c->udpAddr, (int)sizeof(c->udpAddr));
+        }
+    }
+}
+
+// Seconds until the next chunk any link delivers; -1 when all are empty.
+static double sim_next_wait(void) {
+    double next = -1.0;
+    if (!netsim_active(&g_simCfg)) return next;
+    double now = time_now();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        double due;
+        if (!g_conns[i].sim || !netsim_pipes_next_due(g_conns[i].sim, &due)) continue;
+        double wait = due > now ? due - now : 0.0;
+        if (next < 0.0 || wait < next) next = wait;
+    }
+    return next;
+}
+
+static void broadcast_obj_add(const ObjCube* o) {
+    TRACE_BEGIN("broadcast");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].sess) send_obj_add(&g_conns[i], o);
+    }
+    TRACE_END("broadcast");
+}
+
+// Sends history from seq onward as "HIST n seq" plus n LINEs. The client
+// drops anything it holds at or after seq and appends the new lines.
+static void send_history_from(Conn* c, unsigned seq) {
+    ToyTerm* term = c->sess->term;
+    unsigned first = term_history_first_seq(term);
+    unsigned next = term_history_next_seq(term);
+    if (seq < first) seq = first;
+    if (seq > next) seq = next;
+    TRACE_BEGIN("send_history");
+
+    char buf[512];
+    snprintf(buf, sizeof(buf), "HIST %u %u\n", next - seq, seq);
+    send_line(c, buf);
+
+    for (unsigned q = seq; q < next; q++) {
+        const char* ln = term_history_line(term, (int)(q - first));
+        if (!ln) ln = "";
+        snprintf(buf, sizeof(buf), "LINE %s\n", ln);
+        send_line(c, buf);
+    }
+    c->sentSeq = next;
+    TRACE_END("send_history");
+}
+
+// Pushes whatever the client hasn't seen. The newest line it already has may
+// have been edited since (prompt -> ">>> cmd"), so that one is resent too.
+static void flush_history(Conn* c) {
+    send_history_from(c, c->sentSeq ? c->sentSeq - 1 : 0);
+}
+
+static void send_state(Conn* c, const PlayerState* ps) {
+    TRACE_BEGIN("send_state");
+    char buf[16 + 5 * (NUM_FORMAT_MAX + 1)];
+    char* p = buf;
+    memcpy(p, "STATE", 5);
+    p = put_float(p + 5, ps->x, 6);
+    p = put_float(p, ps->y, 6);
+    p = put_float(p, ps->z, 6);
+    p = put_float(p, ps->yaw, 6);
+    p = put_float(p, ps->pitch, 6);
+    p[0] = '\n';
+    p[1] = '\0';
+    send_line(c, buf);
+    TRACE_END("send_state");
+}
+
+// Every attached player's position, sent to everyone else at a fixed rate
+// as "SNAP <seq> <ms> <n>" plus n ENT lines. Stamped with server time (ms
+// since start) so clients can interpolate other players smoothly between
+// snapshots instead of needing one per frame. Entities are identified by
+// connection slot; session ids double as resume tokens and stay private.
+static uint32_t g_snapSeq = 0;
+
+static void broadcast_entities(uint32_t serverMs) {
+    TRACE_BEGIN("broadcast_entities");
+    int attached = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].sess) attached++;
+    }
+    g_snapSeq++;
+
+    char buf[16 + 5 * (NUM_FORMAT_MAX + 1)];
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn* c = &g_conns[i];
+        if (!c->sess) continue;
+        snprintf(buf, sizeof(buf), "SNAP %u %u %d\n", g_snapSeq, serverMs, attached - 1);
+        send_line(c, buf);
+        for (int j = 0; j < MAX_CLIENTS; j++) {
+            const Session* other = g_conns[j].sess;
+            if (!other || j == i) continue;
+            char* p = buf;
+            memcpy(p, "ENT", 3);
+            p = put_int(p + 3, j);
+            p = put_float(p, other->ps.x, 3);
+            p = put_float(p, other->ps.y, 3);
+            p = put_float(p, other->ps.z, 3);
+            p = put_float(p, other->ps.yaw, 4);
+            p[0] = '\n';
+            p[1] = '\0';
+            send_line(c, buf);
+        }
+    }
+    TRACE_END("broadcast_entities");
 }
 
 static int json_extract_content_field(const char* httpResp, char* out, int outCap) {
@@ -215,13 +954,24 @@ static int json_extract_content_field(const char* httpResp, char* out, int outCa
     return 1;
 }
 
-static int llm_make_command(const char* userText, char* outCmd, int outCap) {
+#define COMPLETION_PROMPT_MAX   2048
+#define COMPLETION_BODY_MAX     4096
+#define COMPLETION_RESP_MAX     (16 * 1024)
+#define COMPLETION_CONTENT_MAX  1024
+
+// The "ai" request body (COMPLETION_BODY_MAX bytes). Returns 0 if out of
+// memory.
+static int model_command_body_scratch(const char* userText, char* body) {
     // Ask llama-server /completion to output ONE line like:
     // SPAWN_CUBE x y z size r g b
     // Keep it short and parseable.
 
-    char prompt[2048];
-    snprintf(prompt, sizeof(prompt),
+    Arena* scratch = llm_scratch();
+    char* prompt = (char*)arena_alloc(scratch, COMPLETION_PROMPT_MAX);
+    char* safePrompt = (char*)arena_alloc(scratch, COMPLETION_PROMPT_MAX);
+    if (!prompt || !safePrompt) return 0;
+
+    snprintf(prompt, COMPLETION_PROMPT_MAX,
         "You are a command generator for a tiny 3D room toy.\n"
         "Output exactly ONE line. No extra text.\n"
         "Allowed commands:\n"
@@ -238,17 +988,15 @@ static int llm_make_command(const char* userText, char* outCmd, int outCap) {
     // JSON request for llama-server /completion
     // Escape quotes minimally by banning them in userText (fine for a toy), or you can escape properly later.
     // We'll just be cautious and replace double quotes.
-    char safePrompt[2048];
     int w=0;
-    for (int i=0; prompt[i] && w < (int)sizeof(safePrompt)-1; i++) {
+    for (int i=0; prompt[i] && w < COMPLETION_PROMPT_MAX-1; i++) {
         char c = prompt[i];
         if (c == '\"') c = '\'';
         safePrompt[w++] = c;
     }
     safePrompt[w] = 0;
 
-    char body[4096];
-    snprintf(body, sizeof(body),
+    snprintf(body, COMPLETION_BODY_MAX,
         "{"
         "\"prompt\":\"%s\","
         "\"n_predict\":64,"
@@ -256,14 +1004,23 @@ static int llm_make_command(const char* userText, char* outCmd, int outCap) {
         "\"stop\":[\"\\n\"]"
         "}",
         safePrompt);
+    return 1;
+}
 
-    char resp[16384];
-    if (!http_post_localhost_8080("/completion", body, resp, (int)sizeof(resp))) {
-        return 0;
-    }
+static int model_command_body(const char* userText, char* body) {
+    int ok = model_command_body_scratch(userText, body);
+    arena_reset(llm_scratch());
+    return ok;
+}
 
-    char content[1024];
-    if (!json_extract_content_field(resp, content, (int)sizeof(content))) {
+// The one command line in an "ai" reply, trimmed. Returns 0 if there is
+// none.
+static int model_command_parse(const char* resp, char* outCmd, int outCap) {
+    Arena* scratch = llm_scratch();
+    char* content = (char*)arena_alloc(scratch, COMPLETION_CONTENT_MAX);
+    int ok = content && json_extract_content_field(resp, content, COMPLETION_CONTENT_MAX);
+    if (!ok) {
+        arena_reset(scratch);
         return 0;
     }
 
@@ -275,229 +1032,1503 @@ static int llm_make_command(const char* userText, char* outCmd, int outCap) {
 
     strncpy(outCmd, s, outCap-1);
     outCmd[outCap-1] = 0;
+    arena_reset(scratch);
     return 1;
 }
 
-int main(int argc, char** argv) {
-    (void)argc; (void)argv;
+// Physics constants
+static const float kSpeed = 4.5f;
+
+// Session ids are what HELLO presents to take over a detached session, so
+// they come from the OS generator: anyone who can guess one can resume as
+// that player. The value is journaled so a replay hands out the same ids.
+// Returns 0 if the OS has no randomness to give.
+static uint64_t session_make_id(void) {
+    static uint64_t counter = 0;
+    uint64_t id = 0;
+    if (g_replay) {
+        if (!replay_expect(J_SESSION_ID)) return ++counter;
+        if (g_replay->rec.len == sizeof(id)) {
+            memcpy(&id, g_replay->data, sizeof(id));
+        } else if (g_replay->rec.len == sizeof(uint32_t)) {
+            uint32_t old;   // journals from before ids were 64-bit
+            memcpy(&old, g_replay->data, sizeof(old));
+            id = old;
+        } else {
+            return ++counter;
+        }
+        return id;
+    }
+    while (id == 0) {
+        if (!entropy_fill(&id, sizeof(id))) {
+            fprintf(stderr, "No OS randomness; refusing to make a session id\n");
+            return 0;
+        }
+    }
+    journal_append(g_tick, J_SESSION_ID, 0, &id, sizeof(id));
+    return id;
+}
 
-#ifdef _WIN32
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
-        printf("WSAStartup failed\n");
-        return 1;
+// What metrics show instead of the id, which is a resume token: 24 bits of
+// a mix of it, enough to tell sessions apart on a dashboard.
+static unsigned session_label(const Session* sess) {
+    uint64_t x = sess->id * 0x9E3779B97F4A7C15ull;
+    return (unsigned)(x >> 40);
+}
+
+static void session_destroy(Session* sess) {
+    if (!sess) return;
+    term_destroy(sess->term);
+    free(sess);
+}
+
+static Session* session_find(uint64_t id) {
+    for (int i = 0; i < g_sessionCount; i++) {
+        if (g_sessions[i]->id == id) return g_sessions[i];
     }
+    return NULL;
+}
+
+// Makes room by dropping the detached session that has been gone longest.
+static int session_evict_oldest(void) {
+    int victim = -1;
+    for (int i = 0; i < g_sessionCount; i++) {
+        if (g_sessions[i]->attached) continue;
+        if (victim < 0 || g_sessions[i]->lastSeen < g_sessions[victim]->lastSeen) victim = i;
+    }
+    if (victim < 0) return 0;
+    session_destroy(g_sessions[victim]);
+    g_sessions[victim] = g_sessions[--g_sessionCount];
+    return 1;
+}
+
+// Registers a session around term (taking ownership). id 0 picks a fresh id.
+static Session* session_add(ToyTerm* term, uint64_t id) {
+    if (!term) return NULL;
+    if (g_sessionCount == MAX_SESSIONS && !session_evict_oldest()) {
+        term_destroy(term);
+        return NULL;
+    }
+
+    Session* sess = (Session*)calloc(1, sizeof(Session));
+    if (!sess) {
+        term_destroy(term);
+        return NULL;
+    }
+
+    sess->ps.x = 0.0f;
+    sess->ps.y = 1.6f;   // "eye height"
+    sess->ps.z = 2.0f;
+    sess->ps.yaw = 0.0f;
+    sess->ps.pitch = 0.0f;
+    sess->ps.vy = 0.0f;
+    sess->ps.grounded = 1;
+    sess->term = term;
+    sess->lastSeen = time(NULL);
+
+    sess->id = id;
+    while (sess->id == 0 || session_find(sess->id)) {
+        sess->id = session_make_id();
+        if (sess->id == 0) {
+            session_destroy(sess);
+            return NULL;
+        }
+    }
+    g_sessions[g_sessionCount++] = sess;
+    return sess;
+}
+
+static Session* session_create(void) {
+    return session_add(term_create(), 0);
+}
+
+// -------------------- snapshots --------------------
+
+static volatile sig_atomic_t g_quit = 0;
+static volatile sig_atomic_t g_traceDump = 0;
+static int g_worldDirty = 0;
+
+static void on_quit_signal(int sig) {
+    (void)sig;
+    g_quit = 1;
+}
+
+#ifdef SIGUSR1
+static void on_trace_signal(int sig) {
+    (void)sig;
+    g_traceDump = 1;
+}
 #endif
 
-    SOCKET listenSock = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenSock == INVALID_SOCKET) {
+// Dumps the trace ring next to the server as trace-<tick>.json.
+static long trace_dump_now(char* path, int cap) {
+    snprintf(path, cap, "trace-%u.json", g_tick);
+    return trace_dump(path);
+}
+
+// Serializes objects and every session into the writer's idle buffer. Cheap
+// enough to run inline: the file I/O happens on the writer thread, and if it
+// is still busy with the previous snapshot this one is simply skipped.
+static int world_save(SnapWriter* w) {
+    int liveObjs = 0;
+    for (int i = 0; i < MAX_OBJS; i++) liveObjs += g_objs[i].alive ? 1 : 0;
+
+    size_t cap = sizeof(SnapHeader) + (size_t)liveObjs * sizeof(SnapObj);
+    for (int i = 0; i < g_sessionCount; i++) {
+        cap += sizeof(SnapSession) + term_snapshot_size(g_sessions[i]->term);
+    }
+
+    uint8_t* buf = (uint8_t*)snap_writer_begin(w, cap);
+    if (!buf) return 0;
+
+    SnapHeader* h = (SnapHeader*)buf;
+    memset(h, 0, sizeof(*h));
+    h->magic = SNAP_MAGIC;
+    h->version = SNAP_VERSION;
+    h->headerSize = sizeof(SnapHeader);
+    h->objCount = (uint32_t)liveObjs;
+    h->objSize = sizeof(SnapObj);
+    h->objOffset = sizeof(SnapHeader);
+    h->nextObjId = (uint32_t)g_nextObjId;
+    h->sessionCount = (uint32_t)g_sessionCount;
+
+    size_t n = h->objOffset;
+    for (int i = 0; i < MAX_OBJS; i++) {
+        if (!g_objs[i].alive) continue;
+        memcpy(buf + n, &g_objs[i], sizeof(SnapObj));
+        n += sizeof(SnapObj);
+    }
+
+    h->sessionOffset = (uint32_t)n;
+    for (int i = 0; i < g_sessionCount; i++) {
+        const Session* sess = g_sessions[i];
+        SnapSession ss;
+        ss.id = sess->id;
+        ss.x = sess->ps.x; ss.y = sess->ps.y; ss.z = sess->ps.z;
+        ss.yaw = sess->ps.yaw; ss.pitch = sess->ps.pitch;
+        ss.termBytes = (uint32_t)term_snapshot_write(sess->term, buf + n + sizeof(ss));
+        memcpy(buf + n, &ss, sizeof(ss));
+        n += sizeof(ss) + ss.termBytes;
+    }
+    h->fileSize = n;
+
+    snap_writer_commit(w, n);
+    return 1;
+}
+
+// Maps the snapshot and copies the entity block straight into g_objs. Only
+// sessions need any work, and that is a couple of memcpys each.
+static void world_load(const char* path) {
+    clock_t t0 = clock();
+    SnapMap m;
+    if (!snap_map(path, &m)) return;
+
+    const SnapHeader* h = snap_header(&m);
+    uint32_t nObjs = h->objCount < MAX_OBJS ? h->objCount : MAX_OBJS;
+    memset(g_objs, 0, sizeof(g_objs));
+    memcpy(g_objs, m.base + h->objOffset, nObjs * sizeof(SnapObj));
+    g_nextObjId = (int)h->nextObjId;
+
+    size_t off = h->sessionOffset;
+    uint32_t nSess = 0;
+    for (; nSess < h->sessionCount; nSess++) {
+        SnapSession ss;
+        if (off + sizeof(ss) > m.len) break;
+        memcpy(&ss, m.base + off, sizeof(ss));
+        off += sizeof(ss);
+        if (ss.termBytes > m.len - off) break;
+
+        Session* sess = session_add(term_snapshot_read(m.base + off, ss.termBytes), ss.id);
+        off += ss.termBytes;
+        if (!sess) continue;
+        sess->ps.x = ss.x; sess->ps.y = ss.y; sess->ps.z = ss.z;
+        sess->ps.yaw = ss.yaw; sess->ps.pitch = ss.pitch;
+    }
+
+    snap_unmap(&m);
+    printf("Loaded %s: %u objects, %u sessions in %.2f ms\n", path, nObjs, nSess,
+           (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC);
+}
+
+static void conn_open(SOCKET s) {
+    int slot = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].sock == INVALID_SOCKET) { slot = i; break; }
+    }
+    if (slot < 0) {
+        send_raw(s, "LINE Error: server full\n");
+        closesocket(s);
+        g_metrics.connsRejected++;
+        return;
+    }
+
+    // replies are tiny and latency-bound; don't let Nagle hold them back
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    set_nonblocking(s);
+
+    Conn* c = &g_conns[slot];
+    memset(c, 0, sizeof(*c));
+    c->sock = s;
+    c->sim = netsim_pipes_open(&g_simCfg, (uint32_t)time_now_ns() ^ (uint32_t)slot);
+    g_metrics.connsAccepted++;
+    journal_append(g_tick, J_OPEN, slot, NULL, 0);
+}
+
+static void conn_close(Conn* c) {
+    journal_append(g_tick, J_CLOSE, (int)(c - g_conns), NULL, 0);
+    if (!g_replay) closesocket(c->sock);
+    g_metrics.connsClosed++;
+    if (g_cmdQueue) fair_drop(g_cmdQueue, (int)(c - g_conns));
+    if (c->sess) {
+        // keep the session around for a resume; it only holds its arenas
+        c->sess->attached = 0;
+        c->sess->lastSeen = time(NULL);
+        term_shrink(c->sess->term);
+    }
+    c->sess = NULL;
+    c->sock = INVALID_SOCKET;
+    c->inLen = 0;
+    if (c->udpBound) g_udpBound--;
+    free(c->chan);
+    c->chan = NULL;
+    c->udpBound = 0;
+    c->udpStalled = 0;
+    netsim_pipes_close(c->sim);
+    c->sim = NULL;
+    if (c->shm) {
+        shmlink_close(c->shm);
+        free(c->shm);
+        c->shm = NULL;
+        g_shmLinks--;
+    }
+    c->shmStalled = 0;
+    free(c->out);
+    c->out = NULL;
+    c->outLen = c->outCap = 0;
+    c->tcpStalled = 0;
+}
+
+// HELLO                    -> new session, full history
+// HELLO <session> <nextSeq> -> resume; only history from nextSeq-1 is resent
+static void handle_hello(Conn* c, const char* args) {
+    if (c->sess) return;
+
+    uint64_t id = 0;
+    unsigned nextSeq = 0;
+    Session* sess = NULL;
+    unsigned from = 0;
+    if (num_parse_hex64(&args, &id) && num_parse_uint(&args, &nextSeq)) {
+        sess = session_find(id);
+        if (sess && sess->attached) sess = NULL;
+        if (sess) from = nextSeq ? nextSeq - 1 : 0;
+    }
+    if (!sess) sess = session_create();
+    if (!sess) {
+        send_line(c, "LINE Error: server full\n");
+        return;
+    }
+
+    sess->attached = 1;
+    c->sess = sess;
+    if (sess->modelBusy && g_cmdQueue) fair_hold(g_cmdQueue, (int)(c - g_conns), 1);
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "WELCOME " PROTO_VERSION " %016llx\n", (unsigned long long)sess->id);
+    send_line(c, buf);
+    send_history_from(c, from);
+    send_state(c, &sess->ps);
+    send_line(c, "OBJ_CLEAR\n");
+    send_all_objs(c);
+}
+
+// One client frame of movement.
+static void simulate_input(PlayerState* ps, float fwd, float right, float up,
+                           float yawD, float pitchD, float dt) {
+    // Look
+    ps->yaw   += yawD;
+    ps->pitch += pitchD;
+
+    // Clamp pitch
+    if (ps->pitch > 1.2f) ps->pitch = 1.2f;
+    if (ps->pitch < -1.2f) ps->pitch = -1.2f;
+
+    // Move in yaw plane
+    float cy = cosf(ps->yaw), sy = sinf(ps->yaw);
+
+    float fx = sy;
+    float fz = cy;
+
+    float rx = -cy;
+    float rz = sy;
+
+    ps->x += (fx * fwd + rx * right) * kSpeed * dt;
+    ps->y += up * kSpeed * dt;
+    ps->z += (fz * fwd + rz * right) * kSpeed * dt;
+}
+
+static void handle_input(Conn* c, const char* args) {
+    PlayerState* ps = &c->sess->ps;
+
+    // INPUT fwd right jump yawDelta pitchDelta dt, repeated once per
+    // batched client sample; one STATE answers the whole message
+    int samples = 0;
+    TRACE_BEGIN("simulate");
+    while (samples < PROTO_INPUT_MAX_SAMPLES) {
+        float fwd = 0.0f, right = 0.0f, up = 0.0f;
+        float yawD = 0.0f, pitchD = 0.0f, dt = 0.0f;
+        const char* q = args;
+        if (!num_parse_float(&q, &fwd) || !num_parse_float(&q, &right) || !num_parse_float(&q, &up) ||
+            !num_parse_float(&q, &yawD) || !num_parse_float(&q, &pitchD) || !num_parse_float(&q, &dt)) break;
+        args = q;
+        simulate_input(ps, fwd, right, up, yawD, pitchD, dt);
+        samples++;
+    }
+    TRACE_END("simulate");
+
+    if (samples > 0) send_state(c, ps);
+}
+
+// Shows the typed command on the prompt line, like term_run does.
+static void echo_command(ToyTerm* term, const char* cmd) {
+    char promptLine[TERM_LINE_MAX];
+    snprintf(promptLine, sizeof(promptLine), ">>> %s", cmd);
+    term_replace_last(term, promptLine);
+}
+
+// -------------------- model calls --------------------
+// Chat and "ai" never wait on llama-server in the main loop. The command
+// builds its request and hands it to the LLM worker (llm.c), and the loop
+// carries on serving everyone's INPUT while the model thinks. A session has
+// at most one call out: its later commands wait in its command queue, held
+// (fair_hold), and run in the order typed once the reply is in.
+//
+// Replies come back in the order the calls went out and are applied on the
+// main loop, journaled as J_LLM at that point, so replay needs no worker:
+// each J_LLM record answers the oldest call still waiting.
+
+enum { MODEL_CHAT, MODEL_AI };
+
+typedef struct ModelCall {
+    LlmCall llm;             // first: the worker hands back &llm
+    int kind;                // MODEL_CHAT or MODEL_AI
+    uint64_t sessId;         // the session may be gone by the reply
+    Arena mem;               // request and reply; kept for the next call
+    struct ModelCall* next;
+} ModelCall;
+
+#define MODEL_POLL_US 20000  // poll cadence for replies while calls are out
+
+static LlmWorker* g_llmWorker;
+static ModelCall* g_modelHead;             // waiting for a reply, oldest first
+static ModelCall** g_modelTail = &g_modelHead;
+static ModelCall* g_modelFree;             // finished, memory kept
+static int g_modelOut;
+
+// A call with room for a body of bodyCap and a reply of outCap bytes, or
+// NULL if out of memory. *body is where the request goes.
+static ModelCall* model_call_new(int kind, LlmEndpoint ep, int bodyCap, int outCap, char** body) {
+    ModelCall* m = g_modelFree;
+    if (m) {
+        g_modelFree = m->next;
+    } else {
+        m = (ModelCall*)calloc(1, sizeof(ModelCall));
+        if (!m) return NULL;
+    }
+    arena_reset(&m->mem);
+    *body = (char*)arena_alloc(&m->mem, (size_t)bodyCap);
+    m->llm.out = (char*)arena_alloc(&m->mem, (size_t)outCap);
+    if (!*body || !m->llm.out) {
+        m->next = g_modelFree;
+        g_modelFree = m;
+        return NULL;
+    }
+    m->kind = kind;
+    m->llm.ep = ep;
+    m->llm.body = *body;
+    m->llm.outCap = outCap;
+    return m;
+}
+
+static void model_call_drop(ModelCall* m) {
+    m->next = g_modelFree;
+    g_modelFree = m;
+}
+
+// Sends the request and holds the connection's queued commands until the
+// reply has been applied.
+static void model_call_send(Conn* c, ModelCall* m) {
+    m->sessId = c->sess->id;
+    m->next = NULL;
+    *g_modelTail = m;
+    g_modelTail = &m->next;
+    g_modelOut++;
+    c->sess->modelBusy = 1;
+    if (g_cmdQueue) fair_hold(g_cmdQueue, (int)(c - g_conns), 1);
+
+    if (g_replay) return;   // the journal has the reply
+    if (g_llmWorker) {
+        llm_worker_submit(g_llmWorker, &m->llm);
+    } else {
+        // no worker thread; fails at the top of the next tick
+        m->llm.ok = 0;
+        snprintf(m->llm.err, sizeof(m->llm.err), "LLM worker not running");
+    }
+}
+
+// -------------------- terminal commands --------------------
+// Verbs handled by the server itself. Each handler gets its arguments
+// already parsed (see command.h); the router echoes the command first and
+// ends with a fresh prompt. Anything else goes to the model as chat.
+
+static void cmd_spawn(void* ctx, const char* line, const CmdArgs* a) {
+    Conn* c = (Conn*)ctx;
+    (void)line;
+    ObjCube* o = obj_alloc();
+    if (!o) {
+        term_push_line(c->sess->term, "Error: object limit reached");
+        return;
+    }
+    o->x = a->v[0].f;
+    o->y = cmd_float(a, 1, 1.0f);
+    o->z = cmd_float(a, 2, 6.0f);
+    o->s = 1.0f;
+    o->r = 200; o->g = 200; o->b = 255;
+    broadcast_obj_add(o);
+    term_push_line(c->sess->term, "Spawned cube.");
+}
+
+static void cmd_clear(void* ctx, const char* line, const CmdArgs* a) {
+    (void)line; (void)a;
+    term_push_line(((Conn*)ctx)->sess->term, "OBJ_CLEAR");
+}
+
+// "trace": dump the event ring for chrome://tracing
+static void cmd_trace(void* ctx, const char* line, const CmdArgs* a) {
+    (void)line; (void)a;
+    char path[64];
+    long n = trace_dump_now(path, (int)sizeof(path));
+    char msg[TERM_LINE_MAX];
+    if (n >= 0) snprintf(msg, sizeof(msg), "Trace: %ld events written to %s", n, path);
+    else snprintf(msg, sizeof(msg), "Error: no trace (server built without -DKSPACE_TRACE?)");
+    term_push_line(((Conn*)ctx)->sess->term, msg);
+}
+
+static void cmd_ai(void* ctx, const char* line, const CmdArgs* a);
+
+static const CmdDef kTermCmds[] = {
+    { "spawn",  "fFF", "spawn x y z", cmd_spawn, CMD_CLASS_SPAWN },
+    { "ai",     "s",   "ai <text>",   cmd_ai,    CMD_CLASS_MODEL },
+    { "trace",  "",    "trace",       cmd_trace, CMD_CLASS_CHEAP },
+    { "/clear", "",    "/clear",      cmd_clear, CMD_CLASS_CHEAP },
+};
+
+// What the "ai" command accepts back from the model, one line. Runs when
+// the reply is applied, for the session that asked.
+static void model_spawn_cube(void* ctx, const char* line, const CmdArgs* a) {
+    Session* sess = (Session*)ctx;
+    (void)line;
+    float s = a->v[3].f;
+    int r = cmd_int(a, 4, 200), g = cmd_int(a, 5, 200), b = cmd_int(a, 6, 200);
+    if (s < 0.1f) s = 0.1f;
+    if (s > 5.0f) s = 5.0f;
+    if (r < 0) r = 0;
+    if (r > 255) r = 255;
+    if (g < 0) g = 0;
+    if (g > 255) g = 255;
+    if (b < 0) b = 0;
+    if (b > 255) b = 255;
+
+    ObjCube* o = obj_alloc();
+    if (!o) {
+        term_push_line(sess->term, "Error: object limit reached");
+        return;
+    }
+    o->x = a->v[0].f; o->y = a->v[1].f; o->z = a->v[2].f;
+    o->s = s;
+    o->r = r; o->g = g; o->b = b;
+    broadcast_obj_add(o);
+    term_push_line(sess->term, "Done.");
+}
+
+// Run inside "ai", which was already admitted under CMD_CLASS_MODEL.
+static const CmdDef kModelCmds[] = {
+    { "SPAWN_CUBE", "ffffIII", "SPAWN_CUBE x y z size r g b", model_spawn_cube, CMD_CLASS_CHEAP },
+};
+
+static CmdRouter g_termRouter, g_modelRouter;
+static int g_routersReady;
+
+static void init_routers(void) {
+    cmd_router_init(&g_termRouter, kTermCmds, (int)(sizeof(kTermCmds) / sizeof(kTermCmds[0])));
+    cmd_router_init(&g_modelRouter, kModelCmds, (int)(sizeof(kModelCmds) / sizeof(kModelCmds[0])));
+    g_routersReady = 1;
+}
+
+// "ai <text...>": the model turns text into one of kModelCmds. The reply
+// is handled by ai_finish.
+static void cmd_ai(void* ctx, const char* line, const CmdArgs* a) {
+    Conn* c = (Conn*)ctx;
+    ToyTerm* term = c->sess->term;
+    (void)line;
+
+    char* body;
+    ModelCall* m = model_call_new(MODEL_AI, LLM_COMPLETION, COMPLETION_BODY_MAX, COMPLETION_RESP_MAX, &body);
+    if (!m || !model_command_body(a->v[0].s, body)) {
+        if (m) model_call_drop(m);
+        term_push_line(term, "Error: out of memory");
+        return;
+    }
+    term_push_line(term, "(thinking...)");
+    model_call_send(c, m);
+}
+
+static void ai_finish(Session* sess, const ModelCall* m) {
+    ToyTerm* term = sess->term;
+    char outCmd[512];
+    if (!m->llm.ok || !model_command_parse(m->llm.out, outCmd, (int)sizeof(outCmd))) {
+        term_push_line(term, "Error: LLM request failed. Is llama-server running on 127.0.0.1:8080?");
+        term_push_line(term, ">>> ");
+        return;
+    }
+
+    char echo[TERM_LINE_MAX];
+    // the whole command is dispatched below; the echo only shows what fits
+    snprintf(echo, sizeof(echo), "LLM: %.*s", (int)sizeof(echo) - 6, outCmd);
+    term_push_line(term, echo);
+
+    const CmdDef* d;
+    int r = cmd_dispatch(&g_modelRouter, outCmd, sess, &d);
+    if (r == CMD_UNKNOWN) {
+        term_push_line(term, "Error: unsupported LLM command");
+    } else if (r == CMD_BAD_ARGS) {
+        char msg[TERM_LINE_MAX];
+        snprintf(msg, sizeof(msg), "Error: could not parse %s", d->verb);
+        term_push_line(term, msg);
+    }
+    term_push_line(term, ">>> ");
+}
+
+static void handle_cmd(Conn* c, const char* cmd) {
+    ToyTerm* term = c->sess->term;
+    if (!g_routersReady) init_routers();
+
+    const char* args;
+    const CmdDef* d = cmd_find(&g_termRouter, cmd, &args);
+    if (d) {
+        echo_command(term, cmd);
+        CmdArgs a;
+        if (cmd_parse(d, args, &a)) {
+            d->fn(c, cmd, &a);
+        } else {
+            char msg[TERM_LINE_MAX];
+            snprintf(msg, sizeof(msg), "Error: usage %s", d->usage);
+            term_push_line(term, msg);
+        }
+        // a model call pushes the prompt with its reply
+        if (!c->sess->modelBusy) term_push_line(term, ">>> ");
+        flush_history(c);
+        return;
+    }
+
+    // Fallback: chat with the model through the toy interpreter
+    TRACE_BEGIN("chat_begin");
+    char* body;
+    ModelCall* m = model_call_new(MODEL_CHAT, LLM_CHAT, TERM_CHAT_REQUEST_MAX, TERM_CHAT_RESPONSE_MAX, &body);
+    if (term_chat_begin(term, cmd, m ? body : NULL, m ? TERM_CHAT_REQUEST_MAX : 0)) {
+        model_call_send(c, m);
+    } else if (m) {
+        model_call_drop(m);
+    }
+    TRACE_END("chat_begin");
+    flush_history(c);
+}
+
+static Conn* session_conn(const Session* sess) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].sess == sess) return &g_conns[i];
+    }
+    return NULL;
+}
+
+// Applies the reply to the oldest call out (the worker answers in order),
+// then lets the session's held commands run.
+static void model_apply(void) {
+    ModelCall* m = g_modelHead;
+    g_modelHead = m->next;
+    if (!g_modelHead) g_modelTail = &g_modelHead;
+    g_modelOut--;
+    llm_record(m->llm.ok, m->llm.ok ? m->llm.out : m->llm.err);
+
+    Session* sess = session_find(m->sessId);
+    if (sess) {
+        TRACE_BEGIN("model_apply");
+        g_worldDirty = 1;
+        sess->modelBusy = 0;
+        if (m->kind == MODEL_CHAT) term_chat_finish(sess->term, m->llm.ok, m->llm.ok ? m->llm.out : m->llm.err);
+        else ai_finish(sess, m);
+        Conn* c = session_conn(sess);
+        if (c) {
+            if (g_cmdQueue) fair_hold(g_cmdQueue, (int)(c - g_conns), 0);
+            flush_history(c);
+        }
+        // the session sits idle until its next command; drop arena slack
+        term_shrink(sess->term);
+        TRACE_END("model_apply");
+    }
+    model_call_drop(m);
+}
+
+// Replies the worker has finished since the last tick. Live runs only;
+// replay applies the journaled ones.
+static void model_poll(void) {
+    if (!g_llmWorker) {
+        while (g_modelHead) model_apply();   // failed in model_call_send
+        return;
+    }
+    LlmCall* done;
+    while ((done = llm_worker_poll(g_llmWorker)) != NULL) {
+        hist_observe(&g_metrics.llmRtt[done->ep], done->seconds);
+        g_metrics.llmCalls[done->ep]++;
+        if (!done->ok) g_metrics.llmFailures[done->ep]++;
+        model_apply();   // done is the oldest call's
+    }
+}
+
+// -------------------- command admission --------------------
+// Cheap commands run as they arrive, unless the session has a model call
+// out; then they queue behind it. Spawns and model calls first take a
+// token from the session's bucket for their class, then wait in a queue per
+// connection that the main loop drains in deficit round-robin order,
+// CMD_TICK_BUDGET cost units per tick. A client flooding "ai" gets its
+// share of model calls and no more. Running a model call only sends it to
+// the LLM worker (see model calls above), so the loop never waits on the
+// model and everyone's INPUT keeps being handled.
+//
+// A queued command is journaled where it ran, not where it arrived, and a
+// refusal as J_REFUSED, so replay runs everything inline and still matches.
+
+#define CMD_QUANTUM      8   // cost units a connection gets per round
+#define CMD_TICK_BUDGET  8   // cost units run per tick
+#define CMD_QUEUE_DEPTH  4   // commands waiting per connection
+
+static const struct {
+    const char* name;
+    float rate, burst;   // commands per second, and how many back to back
+    int cost;            // fair-queue units per command
+} kCmdLimits[CMD_CLASSES] = {
+    { "cheap", 0.0f, 0.0f,  0 },
+    { "spawn", 4.0f, 10.0f, 1 },
+    { "model", 0.2f, 3.0f,  CMD_QUANTUM },
+};
+
+enum { REFUSE_RATE, REFUSE_QUEUE };
+
+static int cmd_class(const char* cmd) {
+    if (!g_routersReady) init_routers();
+    const char* args;
+    const CmdDef* d = cmd_find(&g_termRouter, cmd, &args);
+    if (d) return d->cls;
+    while (*cmd == ' ' || *cmd == '\t') cmd++;
+    return *cmd ? CMD_CLASS_MODEL : CMD_CLASS_CHEAP;   // chat, or an empty prompt
+}
+
+static void cmd_run_line(Conn* c, const char* line) {
+    journal_append(g_tick, J_LINE, (int)(c - g_conns), line, (uint32_t)strlen(line));
+    handle_cmd(c, line + 4);
+}
+
+static void cmd_refuse(Conn* c, int reason, int cls, const char* cmd) {
+    ToyTerm* term = c->sess->term;
+    char msg[TERM_LINE_MAX];
+    if (reason == REFUSE_RATE) {
+        snprintf(msg, sizeof(msg), "Error: too many %s commands, try again shortly", kCmdLimits[cls].name);
+    } else {
+        snprintf(msg, sizeof(msg), "Error: %d commands already waiting", CMD_QUEUE_DEPTH);
+    }
+    echo_command(term, cmd);
+    term_push_line(term, msg);
+    term_push_line(term, ">>> ");
+    flush_history(c);
+}
+
+// "CMD <text>": runs it now, queues it, or refuses it.
+static void cmd_submit(Conn* c, const char* line) {
+    const char* cmd = line + 4;
+    int cls = cmd_class(cmd);
+    if (!g_cmdQueue) g_cmdQueue = fair_create(MAX_CLIENTS, CMD_QUEUE_DEPTH, CMD_QUANTUM);
+    // behind a model call still out, even cheap commands wait their turn
+    if (g_replay || !g_cmdQueue || (cls == CMD_CLASS_CHEAP && !c->sess->modelBusy)) {
+        cmd_run_line(c, line);
+        return;
+    }
+
+    int flow = (int)(c - g_conns);
+    int reason;
+    if (fair_flow_pending(g_cmdQueue, flow) >= CMD_QUEUE_DEPTH) {
+        reason = REFUSE_QUEUE;
+    } else if (cls != CMD_CLASS_CHEAP &&
+               !rate_take(&c->sess->cmdRate[cls], time_now(), kCmdLimits[cls].rate,
+                          kCmdLimits[cls].burst, 1.0f)) {
+        reason = REFUSE_RATE;
+    } else {
+        fair_push(g_cmdQueue, flow, kCmdLimits[cls].cost, line);
+        g_metrics.cmdQueued[cls]++;
+        return;
+    }
+
+    uint8_t rec[2 + LINE_CAP];
+    uint32_t len = (uint32_t)strlen(cmd);
+    if (len > LINE_CAP) len = LINE_CAP;
+    rec[0] = (uint8_t)reason;
+    rec[1] = (uint8_t)cls;
+    memcpy(rec + 2, cmd, len);
+    journal_append(g_tick, J_REFUSED, flow, rec, len + 2);
+    g_metrics.cmdRefused[cls]++;
+    cmd_refuse(c, reason, cls, cmd);
+}
+
+// Runs queued commands in fair order until this tick's budget is spent.
+static void run_queued_commands(void) {
+    if (!g_cmdQueue) return;
+    int spent = 0, flow;
+    FairJob job;
+    while (spent < CMD_TICK_BUDGET && fair_pop(g_cmdQueue, &flow, &job)) {
+        spent += job.cost;
+        Conn* c = &g_conns[flow];
+        if (!c->sess) continue;
+        g_worldDirty = 1;
+        TRACE_BEGIN("queued_cmd");
+        cmd_run_line(c, job.line);
+        TRACE_END("queued_cmd");
+    }
+}
+
+static void handle_line(Conn* c, char* line) {
+    g_worldDirty = 1;
+
+    int kind = msg_in_kind(line);
+    uint64_t t0 = time_now_ns();
+    c->linesIn++;
+    g_tickLines++;
+    g_metrics.msgsIn[kind]++;
+    TRACE_BEGIN(kMsgInNames[kind]);
+
+    // CMD lines are journaled by cmd_submit, which may hold them back
+    if (kind != MSG_IN_OTHER && kind != MSG_IN_CMD) {
+        journal_append(g_tick, J_LINE, (int)(c - g_conns), line, (uint32_t)strlen(line));
+    }
+
+    if (kind == MSG_IN_HELLO) {
+        handle_hello(c, line + 5);
+    }
+    else if (!c->sess) {
+        // nothing but HELLO, or a transport request, until the session is bound
+        if (strcmp(line, "SHM") == 0) handle_shm_request(c);
+    }
+    else if (kind == MSG_IN_INPUT) {
+        handle_input(c, line + 6);
+    }
+    else if (kind == MSG_IN_CMD) {
+        cmd_submit(c, line);
+    }
+    else if (strcmp(line, "UDP") == 0) {
+        handle_udp_request(c);
+    }
+    else {
+        // ignore unknown
+    }
+
+    TRACE_END(kMsgInNames[kind]);
+    hist_observe(&g_metrics.handle[kind], (double)(time_now_ns() - t0) * 1e-9);
+}
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Digest of all simulation state, for checking a replay against the live run.
+static uint64_t world_hash(void) {
+    uint64_t h = 14695981039346656037ull;
+    for (int i = 0; i < MAX_OBJS; i++) {
+        if (g_objs[i].alive) h = fnv1a(h, &g_objs[i], sizeof(ObjCube));
+    }
+    h = fnv1a(h, &g_nextObjId, sizeof(g_nextObjId));
+    for (int i = 0; i < g_sessionCount; i++) {
+        const Session* sess = g_sessions[i];
+        h = fnv1a(h, &sess->id, sizeof(sess->id));
+        h = fnv1a(h, &sess->ps, sizeof(sess->ps));
+        int n = term_history_count(sess->term);
+        for (int k = 0; k < n; k++) {
+            const char* ln = term_history_line(sess->term, k);
+            h = fnv1a(h, ln, strlen(ln) + 1);
+        }
+    }
+    return h;
+}
+
+// -------------------- admin port --------------------
+
+// Local-only HTTP endpoint serving the counters above in Prometheus text
+// format. Requests are answered inline from the main loop, which is also the
+// only writer of the metrics, so a scrape never races the hot path.
+
+#define ADMIN_MAX 4
+
+static SOCKET g_admin[ADMIN_MAX];
+
+static void metrics_render(MetricsOut* o, SnapWriter* snap) {
+    char labels[128];
+
+    metrics_header(o, "kspace_messages_in_total", "counter", "Client lines received, by type.");
+    for (int i = 0; i < MSG_IN_KINDS; i++) {
+        snprintf(labels, sizeof(labels), "type=\"%s\"", kMsgInNames[i]);
+        metrics_value(o, "kspace_messages_in_total", labels, (double)g_metrics.msgsIn[i]);
+    }
+    metrics_header(o, "kspace_messages_out_total", "counter", "Server lines sent, by type.");
+    for (int i = 0; i < MSG_OUT_KINDS; i++) {
+        snprintf(labels, sizeof(labels), "type=\"%s\"", kMsgOutNames[i]);
+        metrics_value(o, "kspace_messages_out_total", labels, (double)g_metrics.msgsOut[i]);
+    }
+    metrics_header(o, "kspace_bytes_total", "counter", "Bytes over client connections.");
+    metrics_value(o, "kspace_bytes_total", "direction=\"in\"", (double)g_metrics.bytesIn);
+    metrics_value(o, "kspace_bytes_total", "direction=\"out\"", (double)g_metrics.bytesOut);
+    metrics_header(o, "kspace_send_errors_total", "counter", "Failed sends to clients.");
+    metrics_value(o, "kspace_send_errors_total", NULL, (double)g_metrics.sendErrors);
+    metrics_header(o, "kspace_udp_packets_total", "counter", "Datagrams on the UDP channel; rejected = unknown token or malformed.");
+    metrics_value(o, "kspace_udp_packets_total", "direction=\"in\"", (double)g_metrics.udpPacketsIn);
+    metrics_value(o, "kspace_udp_packets_total", "direction=\"out\"", (double)g_metrics.udpPacketsOut);
+    metrics_value(o, "kspace_udp_packets_total", "direction=\"rejected\"", (double)g_metrics.udpRejected);
+    metrics_header(o, "kspace_udp_connections", "gauge", "Connections whose traffic runs over UDP.");
+    metrics_value(o, "kspace_udp_connections", NULL, (double)g_udpBound);
+    metrics_header(o, "kspace_shm_connections", "gauge", "Same-host connections on a shared-memory link.");
+    metrics_value(o, "kspace_shm_connections", NULL, (double)g_shmLinks);
+
+    int live = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) live += (g_conns[i].sock != INVALID_SOCKET) ? 1 : 0;
+    int objs = 0;
+    for (int i = 0; i < MAX_OBJS; i++) objs += g_objs[i].alive ? 1 : 0;
+    size_t termBytes = 0;
+    for (int i = 0; i < g_sessionCount; i++) termBytes += term_memory_usage(g_sessions[i]->term);
+
+    metrics_header(o, "kspace_connections_total", "counter", "Client connections, by outcome.");
+    metrics_value(o, "kspace_connections_total", "event=\"accepted\"", (double)g_metrics.connsAccepted);
+    metrics_value(o, "kspace_connections_total", "event=\"rejected\"", (double)g_metrics.connsRejected);
+    metrics_value(o, "kspace_connections_total", "event=\"closed\"", (double)g_metrics.connsClosed);
+    metrics_header(o, "kspace_connections", "gauge", "Open client connections.");
+    metrics_value(o, "kspace_connections", NULL, (double)live);
+    metrics_header(o, "kspace_sessions", "gauge", "Sessions held, attached or not.");
+    metrics_value(o, "kspace_sessions", NULL, (double)g_sessionCount);
+    metrics_header(o, "kspace_objects", "gauge", "Live world objects.");
+    metrics_value(o, "kspace_objects", NULL, (double)objs);
+    metrics_header(o, "kspace_term_memory_bytes", "gauge", "Heap held by all session terminals.");
+    metrics_value(o, "kspace_term_memory_bytes", NULL, (double)termBytes);
+
+    // per connection: bandwidth and how much of a partial line is queued
+    metrics_header(o, "kspace_conn_bytes_total", "counter", "Bytes per open connection.");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Conn* c = &g_conns[i];
+        if (c->sock == INVALID_SOCKET) continue;
+        unsigned sid = c->sess ? session_label(c->sess) : 0;
+        snprintf(labels, sizeof(labels), "conn=\"%d\",session=\"%06x\",direction=\"in\"", i, sid);
+        metrics_value(o, "kspace_conn_bytes_total", labels, (double)c->bytesIn);
+        snprintf(labels, sizeof(labels), "conn=\"%d\",session=\"%06x\",direction=\"out\"", i, sid);
+        metrics_value(o, "kspace_conn_bytes_total", labels, (double)c->bytesOut);
+    }
+    metrics_header(o, "kspace_conn_lines_total", "counter", "Lines per open connection.");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Conn* c = &g_conns[i];
+        if (c->sock == INVALID_SOCKET) continue;
+        unsigned sid = c->sess ? session_label(c->sess) : 0;
+        snprintf(labels, sizeof(labels), "conn=\"%d\",session=\"%06x\",direction=\"in\"", i, sid);
+        metrics_value(o, "kspace_conn_lines_total", labels, (double)c->linesIn);
+        snprintf(labels, sizeof(labels), "conn=\"%d\",session=\"%06x\",direction=\"out\"", i, sid);
+        metrics_value(o, "kspace_conn_lines_total", labels, (double)c->linesOut);
+    }
+    metrics_header(o, "kspace_conn_inbuf_bytes", "gauge", "Buffered partial-line bytes per open connection.");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Conn* c = &g_conns[i];
+        if (c->sock == INVALID_SOCKET) continue;
+        snprintf(labels, sizeof(labels), "conn=\"%d\"", i);
+        metrics_value(o, "kspace_conn_inbuf_bytes", labels, (double)c->inLen);
+    }
+    metrics_header(o, "kspace_conn_outbuf_bytes", "gauge", "Queued unsent TCP bytes per open connection.");
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Conn* c = &g_conns[i];
+        if (c->sock == INVALID_SOCKET) continue;
+        snprintf(labels, sizeof(labels), "conn=\"%d\"", i);
+        metrics_value(o, "kspace_conn_outbuf_bytes", labels, (double)c->outLen);
+    }
+
+    metrics_header(o, "kspace_message_handle_seconds", "histogram", "Time to dispatch one client line.");
+    for (int i = 0; i < MSG_IN_KINDS; i++) {
+        snprintf(labels, sizeof(labels), "type=\"%s\"", kMsgInNames[i]);
+        metrics_histogram(o, "kspace_message_handle_seconds", labels, &g_metrics.handle[i]);
+    }
+
+    metrics_header(o, "kspace_llm_requests_total", "counter", "LLM requests sent, by endpoint.");
+    for (int i = 0; i < LLM_ENDPOINTS; i++) {
+        snprintf(labels, sizeof(labels), "path=\"%s\"", llm_endpoint_name((LlmEndpoint)i));
+        metrics_value(o, "kspace_llm_requests_total", labels, (double)g_metrics.llmCalls[i]);
+    }
+    metrics_header(o, "kspace_llm_failures_total", "counter", "LLM requests that failed in transport.");
+    for (int i = 0; i < LLM_ENDPOINTS; i++) {
+        snprintf(labels, sizeof(labels), "path=\"%s\"", llm_endpoint_name((LlmEndpoint)i));
+        metrics_value(o, "kspace_llm_failures_total", labels, (double)g_metrics.llmFailures[i]);
+    }
+    metrics_header(o, "kspace_llm_rtt_seconds", "histogram", "LLM request round-trip time.");
+    for (int i = 0; i < LLM_ENDPOINTS; i++) {
+        snprintf(labels, sizeof(labels), "path=\"%s\"", llm_endpoint_name((LlmEndpoint)i));
+        metrics_histogram(o, "kspace_llm_rtt_seconds", labels, &g_metrics.llmRtt[i]);
+    }
+
+    metrics_header(o, "kspace_cmd_queued_total", "counter", "Commands admitted to the fair queue, by class.");
+    for (int i = CMD_CLASS_CHEAP + 1; i < CMD_CLASSES; i++) {
+        snprintf(labels, sizeof(labels), "class=\"%s\"", kCmdLimits[i].name);
+        metrics_value(o, "kspace_cmd_queued_total", labels, (double)g_metrics.cmdQueued[i]);
+    }
+    metrics_header(o, "kspace_cmd_refused_total", "counter", "Commands refused by the rate limit or a full queue.");
+    for (int i = CMD_CLASS_CHEAP + 1; i < CMD_CLASSES; i++) {
+        snprintf(labels, sizeof(labels), "class=\"%s\"", kCmdLimits[i].name);
+        metrics_value(o, "kspace_cmd_refused_total", labels, (double)g_metrics.cmdRefused[i]);
+    }
+    metrics_header(o, "kspace_cmd_queue_depth", "gauge", "Commands waiting in the fair queue.");
+    metrics_value(o, "kspace_cmd_queue_depth", NULL, g_cmdQueue ? (double)fair_pending(g_cmdQueue) : 0.0);
+    metrics_header(o, "kspace_llm_calls_waiting", "gauge", "Model calls sent and not yet answered.");
+    metrics_value(o, "kspace_llm_calls_waiting", NULL, (double)g_modelOut);
+
+    TermStats ts;
+    term_get_stats(&ts);
+    metrics_header(o, "kspace_term_history_lines_total", "counter", "Lines appended to terminal histories.");
+    metrics_value(o, "kspace_term_history_lines_total", NULL, (double)ts.historyLines);
+    metrics_header(o, "kspace_term_llm_bad_replies_total", "counter", "LLM replies without usable content.");
+    metrics_value(o, "kspace_term_llm_bad_replies_total", NULL, (double)ts.llmBadReplies);
+    metrics_header(o, "kspace_term_llm_actions_total", "counter", "Actions applied from LLM replies.");
+    metrics_value(o, "kspace_term_llm_actions_total", NULL, (double)ts.llmActions);
+    metrics_header(o, "kspace_term_llm_bytes_total", "counter", "Chat-completion payload bytes.");
+    metrics_value(o, "kspace_term_llm_bytes_total", "direction=\"request\"", (double)ts.llmRequestBytes);
+    metrics_value(o, "kspace_term_llm_bytes_total", "direction=\"response\"", (double)ts.llmResponseBytes);
+    metrics_header(o, "kspace_llm_scratch_bytes", "gauge", "Scratch arena kept for LLM commands.");
+    metrics_value(o, "kspace_llm_scratch_bytes", NULL, (double)llm_scratch()->capacity);
+
+    metrics_header(o, "kspace_ticks_total", "counter", "Main loop iterations.");
+    metrics_value(o, "kspace_ticks_total", NULL, (double)g_metrics.ticks);
+    metrics_header(o, "kspace_tick_phase_seconds", "histogram", "Time per main-loop phase.");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "phase=\"%s\"", kPhaseNames[i]);
+        metrics_histogram(o, "kspace_tick_phase_seconds", labels, &g_metrics.phase[i]);
+    }
+    metrics_header(o, "kspace_tick_busy_seconds", "histogram", "Time per tick excluding the poll wait.");
+    metrics_histogram(o, "kspace_tick_busy_seconds", NULL, &g_metrics.tickBusy);
+    metrics_header(o, "kspace_tick_lines", "histogram", "Client lines dispatched per active tick.");
+    metrics_histogram(o, "kspace_tick_lines", NULL, &g_metrics.tickLines);
+
+    SnapWriterStats ss;
+    snap_writer_stats(snap, &ss);
+    metrics_header(o, "kspace_snapshots_total", "counter", "Snapshots, by outcome.");
+    metrics_value(o, "kspace_snapshots_total", "event=\"taken\"", (double)g_metrics.snapshotsTaken);
+    metrics_value(o, "kspace_snapshots_total", "event=\"skipped\"", (double)g_metrics.snapshotsSkipped);
+    metrics_value(o, "kspace_snapshots_total", "event=\"written\"", (double)ss.written);
+    metrics_value(o, "kspace_snapshots_total", "event=\"failed\"", (double)ss.failed);
+    metrics_header(o, "kspace_snapshot_bytes_total", "counter", "Snapshot bytes written to disk.");
+    metrics_value(o, "kspace_snapshot_bytes_total", NULL, (double)ss.bytes);
+    metrics_header(o, "kspace_snapshot_write_seconds_total", "counter", "Writer thread time spent in file I/O.");
+    metrics_value(o, "kspace_snapshot_write_seconds_total", NULL, ss.writeSeconds);
+
+    metrics_header(o, "kspace_metrics_scrapes_total", "counter", "Admin port scrapes served.");
+    metrics_value(o, "kspace_metrics_scrapes_total", NULL, (double)g_metrics.scrapes);
+}
+
+static SOCKET open_listener(uint32_t hostAddr, int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) {
         printf("socket() failed\n");
-        return 1;
+        return INVALID_SOCKET;
     }
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
-    addr.sin_port = htons(27015);
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(hostAddr);
 
     int opt = 1;
 #ifdef _WIN32
-    setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
 #else
-    setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 #endif
 
-    if (bind(listenSock, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        printf("bind() failed\n");
-        closesocket(listenSock);
-        return 1;
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        printf("bind() to port %d failed\n", port);
+        closesocket(s);
+        return INVALID_SOCKET;
     }
 
-    if (listen(listenSock, 1) == SOCKET_ERROR) {
+    if (listen(s, 16) == SOCKET_ERROR) {
         printf("listen() failed\n");
-        closesocket(listenSock);
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static SOCKET open_datagram(int port) {
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s == INVALID_SOCKET) {
+        printf("socket() failed\n");
+        return INVALID_SOCKET;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        printf("bind() to UDP port %d failed\n", port);
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+
+    // drained in a loop until empty
+    set_nonblocking(s);
+    return s;
+}
+
+static void admin_accept(SOCKET adminSock) {
+    SOCKET s = accept(adminSock, NULL, NULL);
+    if (s == INVALID_SOCKET) return;
+    for (int i = 0; i < ADMIN_MAX; i++) {
+        if (g_admin[i] == INVALID_SOCKET) {
+            g_admin[i] = s;
+            return;
+        }
+    }
+    closesocket(s);
+}
+
+// Answers one HTTP request and closes. Only GET /metrics (or /) is served.
+static void admin_serve(SOCKET* slot, SnapWriter* snap) {
+    char req[1024];
+    int r = recv(*slot, req, (int)sizeof(req) - 1, 0);
+    if (r > 0) {
+        req[r] = '\0';
+        int ok = strncmp(req, "GET /metrics", 12) == 0 || strncmp(req, "GET / ", 6) == 0;
+
+        MetricsOut body;
+        memset(&body, 0, sizeof(body));
+        if (ok) {
+            g_metrics.scrapes++;
+            metrics_render(&body, snap);
+        } else {
+            metrics_printf(&body, "not found\n");
+        }
+
+        char hdr[160];
+        int n = snprintf(hdr, sizeof(hdr),
+                         "HTTP/1.0 %s\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: %u\r\n"
+                         "Connection: close\r\n\r\n",
+                         ok ? "200 OK" : "404 Not Found", (unsigned)body.len);
+        if (send_all(*slot, hdr, n) && body.len) send_all(*slot, body.buf, (int)body.len);
+        metrics_free(&body);
+    }
+    closesocket(*slot);
+    *slot = INVALID_SOCKET;
+}
+
+// Re-runs a journal headlessly, as fast as the simulation allows.
+static int replay_run(const char* path) {
+    JournalReader r;
+    if (!journal_reader_open(&r, path)) {
+        printf("replay: cannot read journal %s\n", path);
         return 1;
     }
+    g_replay = &r;
+
+    clock_t t0 = clock();
+    uint64_t lines = 0;
+    int ok = 1, got;
+    while (ok && !g_replayFailed && (got = journal_read(&r)) != 0) {
+        g_replayRecords++;
+        if (got < 0) {
+            replay_corrupt();
+            break;
+        }
+        g_tick = r.rec.tick;
+        if (r.rec.conn >= MAX_CLIENTS) { ok = 0; break; }
+        Conn* c = &g_conns[r.rec.conn];
+
+        switch ((JournalType)r.rec.type) {
+        case J_OPEN:
+            memset(c, 0, sizeof(*c));
+            c->sock = 0;   // placeholder; send_line is a no-op while replaying
+            break;
+        case J_CLOSE:
+            if (c->sock != INVALID_SOCKET) conn_close(c);
+            break;
+        case J_LINE: {
+            // hooks below may read further records, so copy the line out first
+            char line[LINE_CAP];
+            snprintf(line, sizeof(line), "%s", (const char*)r.data);
+            if (c->sock != INVALID_SOCKET) handle_line(c, line);
+            lines++;
+            break;
+        }
+        case J_LLM: {
+            if (!g_modelHead || r.rec.len == 0) {
+                printf("replay: model reply with no call waiting at tick %u\n", g_tick);
+                ok = 0;
+                break;
+            }
+            LlmCall* call = &g_modelHead->llm;
+            call->ok = r.data[0] != 0;
+            if (call->ok) snprintf(call->out, (size_t)call->outCap, "%s", (const char*)r.data + 1);
+            else snprintf(call->err, sizeof(call->err), "%s", (const char*)r.data + 1);
+            model_apply();
+            break;
+        }
+        case J_REFUSED: {
+            char cmd[LINE_CAP];
+            uint32_t len = r.rec.len >= 2 ? r.rec.len - 2 : 0;
+            if (len >= sizeof(cmd)) len = sizeof(cmd) - 1;
+            memcpy(cmd, r.data + 2, len);
+            cmd[len] = '\0';
+            if (c->sess && len + 2 == r.rec.len && r.data[1] < CMD_CLASSES) cmd_refuse(c, r.data[0], r.data[1], cmd);
+            break;
+        }
+        default:
+            printf("replay: unexpected record type %d at tick %u\n", r.rec.type, g_tick);
+            ok = 0;
+            break;
+        }
+    }
 
-    printf("Server listening on port 27015...\n");
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("replay: %llu records (%llu lines, %u ticks) in %.3f s, %.0f lines/s\n",
+           (unsigned long long)g_replayRecords, (unsigned long long)lines, g_tick, secs,
+           secs > 0 ? (double)lines / secs : 0.0);
+    printf("world hash %016llx\n", (unsigned long long)world_hash());
+
+    journal_reader_close(&r);
+    g_replay = NULL;
+    return ok && !g_replayFailed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    const char* snapPath = "world.snap";
+    int snapEvery = 10;   // seconds; 0 disables snapshots
+    int snapGiven = 0;
+    const char* journalPath = NULL;
+    const char* replayPath = NULL;
+    int adminPort = 27016;   // 0 disables the metrics endpoint
+    double sendRate = 20.0;  // entity snapshots per second; 0 disables them
+    int udpPort = 27015;     // datagram channel; 0 keeps everyone on TCP
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapPath = argv[++i];
+            snapGiven = 1;
+        } else if (strcmp(argv[i], "--snapshot-every") == 0 && i + 1 < argc) {
+            snapEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--admin-port") == 0 && i + 1 < argc) {
+            adminPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--send-rate") == 0 && i + 1 < argc) {
+            sendRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--udp-port") == 0 && i + 1 < argc) {
+            udpPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            g_shmEnabled = atoi(argv[++i]) != 0;
+        } else if (i + 1 < argc && netsim_arg(&g_simCfg, argv[i], argv[i + 1])) {
+            i++;
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) g_conns[i].sock = INVALID_SOCKET;
+    metrics_init();
+    trace_init();
+
+    if (replayPath) {
+        // starts from an empty world unless the run's base snapshot is given
+        if (snapGiven) world_load(snapPath);
+        return replay_run(replayPath);
+    }
 
-    struct sockaddr_in clientAddr;
 #ifdef _WIN32
-    int clientLen = (int)sizeof(clientAddr);
-#else
-    socklen_t clientLen = sizeof(clientAddr);
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
+        printf("WSAStartup failed\n");
+        return 1;
+    }
 #endif
 
-    SOCKET client = accept(listenSock, (struct sockaddr*)&clientAddr, &clientLen);
-    if (client == INVALID_SOCKET) {
-        printf("accept() failed\n");
-        closesocket(listenSock);
-        return 1;
+#ifndef _WIN32
+    // a client vanishing mid-send must not take the whole server down
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    SOCKET listenSock = open_listener(INADDR_ANY, 27015);
+    if (listenSock == INVALID_SOCKET) return 1;
+
+    printf("Server listening on port 27015...\n");
+
+    if (udpPort > 0) {
+        g_udpSock = open_datagram(udpPort);
+        if (g_udpSock != INVALID_SOCKET) {
+            g_udpPort = udpPort;
+            printf("UDP channel on port %d\n", udpPort);
+        }
+    }
+    if (netsim_active(&g_simCfg)) {
+        char desc[128];
+        netsim_describe(&g_simCfg, desc, (int)sizeof(desc));
+        printf("Simulated link, each way: %s\n", desc);
+    }
+
+    SOCKET adminSock = INVALID_SOCKET;
+    for (int i = 0; i < ADMIN_MAX; i++) g_admin[i] = INVALID_SOCKET;
+    if (adminPort > 0) {
+        adminSock = open_listener(INADDR_LOOPBACK, adminPort);
+        if (adminSock != INVALID_SOCKET) {
+            printf("Metrics on http://127.0.0.1:%d/metrics\n", adminPort);
+        }
     }
 
-    printf("Client connected.\n");
+    SnapWriter* snap = NULL;
+    if (snapEvery > 0) {
+        world_load(snapPath);
+        snap = snap_writer_start(snapPath);
+    }
+    time_t nextSnap = time(NULL) + snapEvery;
 
-    ToyTerm* term = term_create();
+    g_llmWorker = llm_worker_start();
+    if (!g_llmWorker) printf("LLM worker thread failed to start; model commands will fail\n");
 
-    PlayerState ps;
-    memset(&ps, 0, sizeof(ps));
-    ps.x = 0.0f;
-    ps.y = 1.6f;   // "eye height"
-    ps.z = 2.0f;
-    ps.yaw = 0.0f;
-    ps.pitch = 0.0f;
-    ps.vy = 0.0f;
-    ps.grounded = 1;
-
-    // Welcome + initial sync
-    send_line(client, "WELCOME " PROTO_VERSION "\n");
-    send_history(client, term);
-    send_state(client, &ps);
-
-    send_all_objs(client);
-
-    char line[512];
-
-    // Physics constants
-    const float speed = 4.5f;
-    const float gravity = 18.0f;
-    const float jumpVel = 6.5f;
-    const float groundY = 1.6f;   // standing eye height above "ground"
-
-    while (recv_line(client, line, sizeof(line))) {
-        if (strncmp(line, "HELLO", 5) == 0) {
-            // no-op
-        }
-        else if (strncmp(line, "INPUT ", 6) == 0) {
-            // INPUT fwd right jump yawDelta pitchDelta dt
-            float fwd = 0.0f, right = 0.0f, up = 0.0f;
-            float yawD = 0.0f, pitchD = 0.0f, dt = 0.0f;
-
-            if (sscanf(line + 6, "%f %f %f %f %f %f", &fwd, &right, &up, &yawD, &pitchD, &dt) == 6) {
-                // Look
-                ps.yaw   += yawD;
-                ps.pitch += pitchD;
-
-                // Clamp pitch
-                if (ps.pitch > 1.2f) ps.pitch = 1.2f;
-                if (ps.pitch < -1.2f) ps.pitch = -1.2f;
-
-                // Move in yaw plane
-                float cy = cosf(ps.yaw), sy = sinf(ps.yaw);
-
-                float fx = sy;
-                float fz = cy;
-
-                float rx = -cy;
-                float rz = sy;
-
-                ps.x += (fx * fwd + rx * right) * speed * dt;
-                ps.y += up * speed * dt;
-                ps.z += (fz * fwd + rz * right) * speed * dt;
-
-                send_state(client, &ps);
-            }
+    uint64_t startNs = time_now_ns();
+    uint64_t sendEveryNs = sendRate > 0.0 ? (uint64_t)(1e9 / sendRate) : 0;
+    uint64_t nextSend = startNs;
+
+    if (journalPath && !journal_open(journalPath)) {
+        printf("cannot open journal %s\n", journalPath);
+    }
+
+    signal(SIGINT, on_quit_signal);
+    signal(SIGTERM, on_quit_signal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, on_trace_signal);
+#endif
+
+    while (!g_quit) {
+        uint64_t tickStart = time_now_ns();
+        uint64_t t = tickStart;
+        g_tick++;
+        g_metrics.ticks++;
+        g_tickLines = 0;
+        if (g_traceDump) {
+            g_traceDump = 0;
+            char path[64];
+            long n = trace_dump_now(path, (int)sizeof(path));
+            if (n >= 0) printf("trace: %ld events written to %s\n", n, path);
+            else printf("trace: nothing written (built without -DKSPACE_TRACE?)\n");
         }
-        else if (strncmp(line, "CMD ", 4) == 0) {
-            const char* cmd = line + 4;
-
-            // 1) manual spawn: "spawn x y z"
-            if (strncmp(cmd, "spawn ", 6) == 0) {
-                float x=0,y=1,z=6;
-                if (sscanf(cmd + 6, "%f %f %f", &x, &y, &z) < 1) {
-                    send_line(client, "LINE Error: usage spawn x y z\n");
-                    send_line(client, "LINE >>> \n");
-                    continue;
-                }
-
-                ObjCube* o = obj_alloc();
-                if (!o) {
-                    send_line(client, "LINE Error: object limit reached\n");
-                    send_line(client, "LINE >>> \n");
-                    continue;
-                }
-
-                o->x=x; o->y=y; o->z=z;
-                o->s=1.0f;
-                o->r=200; o->g=200; o->b=255;
-
-                send_obj_add(client, o);
-                send_line(client, "LINE Spawned cube.\n");
-                send_line(client, "LINE >>> \n");
-                continue;
-            }
 
-            // 2) ai command: "ai <text...>"
-            if (strncmp(cmd, "ai ", 3) == 0) {
-                const char* userText = cmd + 3;
-
-                send_line(client, "LINE (thinking...)\n");
-
-                char outCmd[512];
-                if (!llm_make_command(userText, outCmd, (int)sizeof(outCmd))) {
-                    send_line(client, "LINE Error: LLM request failed. Is llama-server running on 127.0.0.1:8080?\n");
-                    send_line(client, "LINE >>> \n");
-                    continue;
-                }
-
-                char echo[768];
-                snprintf(echo, sizeof(echo), "LINE LLM: %s\n", outCmd);
-                send_line(client, echo);
-
-                // Parse: SPAWN_CUBE x y z size r g b
-                if (strncmp(outCmd, "SPAWN_CUBE", 10) == 0) {
-                    float x=0,y=1,z=6,s=1;
-                    int r=200,g=200,b=200;
-                    if (sscanf(outCmd + 10, "%f %f %f %f %d %d %d", &x, &y, &z, &s, &r, &g, &b) >= 4) {
-                        if (s < 0.1f) s = 0.1f;
-                        if (s > 5.0f) s = 5.0f;
-                        if (r<0) r=0; if (r>255) r=255;
-                        if (g<0) g=0; if (g>255) g=255;
-                        if (b<0) b=0; if (b>255) b=255;
-
-                        ObjCube* o = obj_alloc();
-                        if (!o) {
-                            send_line(client, "LINE Error: object limit reached\n");
-                        } else {
-                            o->x=x; o->y=y; o->z=z;
-                            o->s=s;
-                            o->r=r; o->g=g; o->b=b;
-                            send_obj_add(client, o);
-                            send_line(client, "LINE Done.\n");
-                        }
-                    } else {
-                        send_line(client, "LINE Error: could not parse SPAWN_CUBE\n");
-                    }
-                } else {
-                    send_line(client, "LINE Error: unsupported LLM command\n");
-                }
-
-                send_line(client, "LINE >>> \n");
-                continue;
+        TRACE_BEGIN("journal_flush");
+        journal_flush();
+        TRACE_END("journal_flush");
+        udp_reap();
+        tcp_reap();
+        sim_service();   // these may close connections, so before the poll set
+        shm_service();
+        phase_mark(&t, PHASE_JOURNAL);
+
+        TRACE_BEGIN("commands");
+        model_poll();
+        run_queued_commands();
+        TRACE_END("commands");
+        phase_mark(&t, PHASE_COMMANDS);
+
+        fd_set rd, wr;
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        FD_SET(listenSock, &rd);
+        SOCKET maxSock = listenSock;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (g_conns[i].sock == INVALID_SOCKET) continue;
+            if (g_conns[i].outLen > 0) FD_SET(g_conns[i].sock, &wr);
+            if (g_conns[i].sock > maxSock) maxSock = g_conns[i].sock;
+            if (g_conns[i].sim && g_conns[i].sim->peerClosed) continue;   // EOF stays readable
+            FD_SET(g_conns[i].sock, &rd);
+        }
+        if (g_udpSock != INVALID_SOCKET) {
+            FD_SET(g_udpSock, &rd);
+            if (g_udpSock > maxSock) maxSock = g_udpSock;
+        }
+        if (adminSock != INVALID_SOCKET) {
+            FD_SET(adminSock, &rd);
+            if (adminSock > maxSock) maxSock = adminSock;
+            for (int i = 0; i < ADMIN_MAX; i++) {
+                if (g_admin[i] == INVALID_SOCKET) continue;
+                FD_SET(g_admin[i], &rd);
+                if (g_admin[i] > maxSock) maxSock = g_admin[i];
             }
+        }
 
-            // Fallback: keep existing toy interpreter
-            int before = term_history_count(term);
-            term_run(term, cmd);
-            int after = term_history_count(term);
+        if (snap && g_worldDirty && time(NULL) >= nextSnap) {
+            TRACE_BEGIN("snapshot");
+            if (world_save(snap)) {
+                g_worldDirty = 0;
+                g_metrics.snapshotsTaken++;
+            } else {
+                g_metrics.snapshotsSkipped++;
+            }
+            nextSnap = time(NULL) + snapEvery;
+            TRACE_END("snapshot");
+        }
+        phase_mark(&t, PHASE_SNAPSHOT);
+
+        // wake at least once a second for snapshots and shutdown requests,
+        // and in time for the next entity broadcast
+        struct timeval tv = { 1, 0 };
+        if (sendEveryNs) {
+            if (t >= nextSend) {
+                broadcast_entities((uint32_t)((t - startNs) / 1000000));
+                nextSend += sendEveryNs;
+                // after a stall, resume the cadence instead of catching up
+                if (nextSend <= t) nextSend = t + sendEveryNs;
+            }
+            uint64_t waitUs = (nextSend - t) / 1000;
+            if (waitUs < 1000000) {
+                tv.tv_sec = 0;
+                tv.tv_usec = (long)waitUs;
+            }
+        }
+        // datagram channels need a timer for acks and resends
+        udp_service();
+        if (g_udpBound) {
+            long ackUs = (long)(NETCHAN_ACK_DELAY * 1e6);
+            if (tv.tv_sec > 0 || tv.tv_usec > ackUs) {
+                tv.tv_sec = 0;
+                tv.tv_usec = ackUs;
+            }
+        }
+        // and simulated links when their next chunk is due
+        double simWait = sim_next_wait();
+        if (simWait >= 0.0 && (tv.tv_sec > 0 || tv.tv_usec > (long)(simWait * 1e6))) {
+            tv.tv_sec = 0;
+            tv.tv_usec = (long)(simWait * 1e6);
+        }
+        // model replies are picked up at the top of a tick
+        if (g_modelOut && (tv.tv_sec > 0 || tv.tv_usec > MODEL_POLL_US)) {
+            tv.tv_sec = 0;
+            tv.tv_usec = MODEL_POLL_US;
+        }
+        // lines already in a shared-memory ring are handled right away, and
+        // queued commands at the top of the next tick
+        if (!shm_sleep() || (g_cmdQueue && fair_ready(g_cmdQueue))) {
+            tv.tv_sec = 0;
+            tv.tv_usec = 0;
+        }
+        phase_mark(&t, PHASE_BROADCAST);
+        int ready = select((int)maxSock + 1, &rd, &wr, NULL, &tv);
+        shm_wake();
+        if (ready == SOCKET_ERROR) {
+#ifndef _WIN32
+            if (errno == EINTR) continue;
+#endif
+            printf("select() failed\n");
+            break;
+        }
+        uint64_t pollStart = t;
+        phase_mark(&t, PHASE_POLL);
+        uint64_t pollNs = t - pollStart;
+        if (ready == 0) continue;
 
-            for (int i = before; i < after; i++) {
-                const char* ln = term_history_line(term, i);
-                char buf[512];
-                snprintf(buf, sizeof(buf), "LINE %s\n", ln ? ln : "");
-                send_line(client, buf);
+        if (FD_ISSET(listenSock, &rd)) {
+            struct sockaddr_in clientAddr;
+#ifdef _WIN32
+            int clientLen = (int)sizeof(clientAddr);
+#else
+            socklen_t clientLen = sizeof(clientAddr);
+#endif
+            TRACE_BEGIN("accept");
+            SOCKET s = accept(listenSock, (struct sockaddr*)&clientAddr, &clientLen);
+            if (s != INVALID_SOCKET) {
+                printf("Client connected.\n");
+                conn_open(s);
             }
+            TRACE_END("accept");
         }
-        else {
-            // ignore unknown
+        phase_mark(&t, PHASE_ACCEPT);
+
+        TRACE_BEGIN("recv");
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            Conn* c = &g_conns[i];
+            if (c->sock != INVALID_SOCKET && c->outLen > 0 && FD_ISSET(c->sock, &wr)) conn_flush(c);
+            if (c->sock == INVALID_SOCKET || !FD_ISSET(c->sock, &rd)) continue;
+            if (!conn_read(c)) {
+                printf("Client disconnected.\n");
+                conn_close(c);
+            }
+        }
+        if (g_udpSock != INVALID_SOCKET && FD_ISSET(g_udpSock, &rd)) udp_recv();
+        // replies go out this tick, not after the next poll
+        udp_service();
+        sim_service();
+        shm_service();
+        TRACE_END("recv");
+        phase_mark(&t, PHASE_RECV);
+
+        if (adminSock != INVALID_SOCKET) {
+            TRACE_BEGIN("admin");
+            if (FD_ISSET(adminSock, &rd)) admin_accept(adminSock);
+            for (int i = 0; i < ADMIN_MAX; i++) {
+                if (g_admin[i] != INVALID_SOCKET && FD_ISSET(g_admin[i], &rd)) admin_serve(&g_admin[i], snap);
+            }
+            TRACE_END("admin");
+            phase_mark(&t, PHASE_ADMIN);
         }
-    }
 
-    printf("Client disconnected.\n");
+        hist_observe(&g_metrics.tickBusy, (double)(t - tickStart - pollNs) * 1e-9);
+        if (g_tickLines) hist_observe(&g_metrics.tickLines, (double)g_tickLines);
+    }
 
-    term_destroy(term);
-    closesocket(client);
+    // replies still out are dropped, as if the clients had left first
+    llm_worker_stop(g_llmWorker);
+    g_llmWorker = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g_conns[i].sock != INVALID_SOCKET) conn_close(&g_conns[i]);
+    }
+    if (snap) {
+        // final snapshot; stop() waits for it to hit the disk. Once the
+        // writer is idle begin() can only fail by running out of memory.
+        if (g_worldDirty) {
+            snap_writer_wait_idle(snap);
+            if (!world_save(snap)) fprintf(stderr, "Final snapshot skipped: out of memory\n");
+        }
+        snap_writer_stop(snap);
+    }
+    if (journal_is_open()) {
+        uint64_t n = journal_close();
+        printf("journal: %llu records, world hash %016llx\n",
+               (unsigned long long)n, (unsigned long long)world_hash());
+    }
+    for (int i = 0; i < g_sessionCount; i++) session_destroy(g_sessions[i]);
+    for (int i = 0; i < ADMIN_MAX; i++) {
+        if (g_admin[i] != INVALID_SOCKET) closesocket(g_admin[i]);
+    }
+    if (adminSock != INVALID_SOCKET) closesocket(adminSock);
     closesocket(listenSock);
 
 #ifdef _WIN32
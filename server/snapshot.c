@@ -0,0 +1,302 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "snapshot.h"
+#include "../common/timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+// -------------------- tiny thread shim --------------------
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION   snap_mutex_t;
+typedef CONDITION_VARIABLE snap_cond_t;
+typedef HANDLE             snap_thread_t;
+#define mutex_init(m)    InitializeCriticalSection(m)
+#define mutex_free(m)    DeleteCriticalSection(m)
+#define mutex_lock(m)    EnterCriticalSection(m)
+#define mutex_unlock(m)  LeaveCriticalSection(m)
+#define cond_init(c)     InitializeConditionVariable(c)
+#define cond_free(c)     ((void)0)
+#define cond_wait(c, m)  SleepConditionVariableCS((c), (m), INFINITE)
+#define cond_signal(c)   WakeConditionVariable(c)
+#else
+typedef pthread_mutex_t    snap_mutex_t;
+typedef pthread_cond_t     snap_cond_t;
+typedef pthread_t          snap_thread_t;
+#define mutex_init(m)    pthread_mutex_init((m), NULL)
+#define mutex_free(m)    pthread_mutex_destroy(m)
+#define mutex_lock(m)    pthread_mutex_lock(m)
+#define mutex_unlock(m)  pthread_mutex_unlock(m)
+#define cond_init(c)     pthread_cond_init((c), NULL)
+#define cond_free(c)     pthread_cond_destroy(c)
+#define cond_wait(c, m)  pthread_cond_wait((c), (m))
+#define cond_signal(c)   pthread_cond_signal(c)
+#endif
+
+// -------------------- writer --------------------
+
+struct SnapWriter {
+    char path[260];
+    char tmpPath[268];
+
+    uint8_t* buf[2];
+    size_t   cap[2];
+    size_t   len[2];
+
+    int writing;    // buffer index the thread is writing, or -1
+    int pending;    // buffer index committed but not yet picked up, or -1
+    int filling;    // buffer index handed out by begin(), or -1
+    int quit;
+
+    SnapWriterStats stats;   // guarded by mu
+
+    snap_mutex_t  mu;
+    snap_cond_t   cv;
+    snap_cond_t   idle;      // signalled when a write finishes
+    snap_thread_t thread;
+};
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static int write_file(SnapWriter* w, const uint8_t* data, size_t len) {
+    FILE* f = fopen(w->tmpPath, "wb");
+    if (!f) {
+        printf("snapshot: cannot open %s\n", w->tmpPath);
+        return 0;
+    }
+    size_t n = fwrite(data, 1, len, f);
+    int ok = (fclose(f) == 0) && n == len;
+    if (!ok || !replace_file(w->tmpPath, w->path)) {
+        printf("snapshot: write to %s failed\n", w->path);
+        remove(w->tmpPath);
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI writer_main(LPVOID arg)
+#else
+static void* writer_main(void* arg)
+#endif
+{
+    SnapWriter* w = (SnapWriter*)arg;
+
+    mutex_lock(&w->mu);
+    for (;;) {
+        while (w->pending < 0 && !w->quit) cond_wait(&w->cv, &w->mu);
+        if (w->pending < 0) break;   // quit with nothing left to write
+
+        int idx = w->pending;
+        w->pending = -1;
+        w->writing = idx;
+        mutex_unlock(&w->mu);
+
+        uint64_t t0 = time_now_ns();
+        int ok = write_file(w, w->buf[idx], w->len[idx]);
+        double took = (double)(time_now_ns() - t0) * 1e-9;
+
+        mutex_lock(&w->mu);
+        w->writing = -1;
+        if (ok) {
+            w->stats.written++;
+            w->stats.bytes += w->len[idx];
+        } else {
+            w->stats.failed++;
+        }
+        w->stats.writeSeconds += took;
+        cond_signal(&w->idle);
+    }
+    mutex_unlock(&w->mu);
+    return 0;
+}
+
+SnapWriter* snap_writer_start(const char* path) {
+    SnapWriter* w = (SnapWriter*)calloc(1, sizeof(SnapWriter));
+    if (!w) return NULL;
+
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmpPath, sizeof(w->tmpPath), "%s.tmp", path);
+    w->writing = w->pending = w->filling = -1;
+
+    mutex_init(&w->mu);
+    cond_init(&w->cv);
+    cond_init(&w->idle);
+
+#ifdef _WIN32
+    w->thread = CreateThread(NULL, 0, writer_main, w, 0, NULL);
+    if (!w->thread) {
+#else
+    if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+#endif
+        cond_free(&w->idle);
+        cond_free(&w->cv);
+        mutex_free(&w->mu);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void* snap_writer_begin(SnapWriter* w, size_t cap) {
+    if (!w) return NULL;
+
+    mutex_lock(&w->mu);
+    int idx = -1;
+    if (w->pending < 0 && w->filling < 0) {
+        idx = (w->writing == 0) ? 1 : 0;
+        w->filling = idx;
+    }
+    mutex_unlock(&w->mu);
+    if (idx < 0) return NULL;
+
+    // only this thread touches a buffer while it is being filled
+    if (w->cap[idx] < cap) {
+        uint8_t* nb = (uint8_t*)realloc(w->buf[idx], cap);
+        if (!nb) {
+            mutex_lock(&w->mu);
+            w->filling = -1;
+            mutex_unlock(&w->mu);
+            return NULL;
+        }
+        w->buf[idx] = nb;
+        w->cap[idx] = cap;
+    }
+    return w->buf[idx];
+}
+
+void snap_writer_commit(SnapWriter* w, size_t len) {
+    if (!w) return;
+
+    mutex_lock(&w->mu);
+    if (w->filling >= 0) {
+        w->len[w->filling] = len;
+        w->pending = w->filling;
+        w->filling = -1;
+        cond_signal(&w->cv);
+    }
+    mutex_unlock(&w->mu);
+}
+
+void snap_writer_stats(SnapWriter* w, SnapWriterStats* out) {
+    if (!w) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    mutex_lock(&w->mu);
+    *out = w->stats;
+    mutex_unlock(&w->mu);
+}
+
+void snap_writer_wait_idle(SnapWriter* w) {
+    if (!w) return;
+
+    mutex_lock(&w->mu);
+    while (w->pending >= 0 || w->writing >= 0) cond_wait(&w->idle, &w->mu);
+    mutex_unlock(&w->mu);
+}
+
+void snap_writer_stop(SnapWriter* w) {
+    if (!w) return;
+
+    mutex_lock(&w->mu);
+    w->quit = 1;
+    cond_signal(&w->cv);
+    mutex_unlock(&w->mu);
+
+#ifdef _WIN32
+    WaitForSingleObject(w->thread, INFINITE);
+    CloseHandle(w->thread);
+#else
+    pthread_join(w->thread, NULL);
+#endif
+
+    cond_free(&w->idle);
+    cond_free(&w->cv);
+    mutex_free(&w->mu);
+    free(w->buf[0]);
+    free(w->buf[1]);
+    free(w);
+}
+
+// -------------------- loader --------------------
+
+static int validate(const SnapMap* m) {
+    if (m->len < sizeof(SnapHeader)) return 0;
+    const SnapHeader* h = snap_header(m);
+    if (h->magic != SNAP_MAGIC || h->version != SNAP_VERSION) return 0;
+    if (h->headerSize != sizeof(SnapHeader) || h->objSize != sizeof(SnapObj)) return 0;
+    if (h->fileSize != m->len) return 0;
+
+    uint64_t objEnd = (uint64_t)h->objOffset + (uint64_t)h->objCount * sizeof(SnapObj);
+    if (h->objOffset < sizeof(SnapHeader) || objEnd > m->len) return 0;
+    if (h->sessionOffset < objEnd || h->sessionOffset > m->len) return 0;
+    return 1;
+}
+
+int snap_map(const char* path, SnapMap* m) {
+    memset(m, 0, sizeof(*m));
+
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(f, &sz) || sz.QuadPart == 0) { CloseHandle(f); return 0; }
+    HANDLE map = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(f);
+    if (!map) return 0;
+    void* base = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!base) { CloseHandle(map); return 0; }
+    m->base = (const uint8_t*)base;
+    m->len = (size_t)sz.QuadPart;
+    m->handle = map;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return 0; }
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+    m->base = (const uint8_t*)base;
+    m->len = (size_t)st.st_size;
+#endif
+
+    if (!validate(m)) {
+        printf("snapshot: %s is not a compatible snapshot, ignoring\n", path);
+        snap_unmap(m);
+        return 0;
+    }
+    return 1;
+}
+
+void snap_unmap(SnapMap* m) {
+    if (!m->base) return;
+#ifdef _WIN32
+    UnmapViewOfFile((void*)m->base);
+    CloseHandle((HANDLE)m->handle);
+#else
+    munmap((void*)m->base, m->len);
+#endif
+    memset(m, 0, sizeof(*m));
+}
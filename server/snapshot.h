@@ -0,0 +1,100 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// World snapshot file (native endianness, every section 4-byte aligned):
+//
+//   SnapHeader
+//   SnapObj[objCount]                     at objOffset
+//   per session, starting at sessionOffset:
+//     SnapSession
+//     term blob (termBytes, see term_snapshot_write)
+//
+// SnapObj is the server's in-memory entity layout, so loading the entity
+// store is a single memcpy out of the mapped file. Bump SNAP_VERSION whenever
+// any of these layouts change; older files are then ignored.
+
+#define SNAP_MAGIC   0x504E534Bu   // "KSNP"
+#define SNAP_VERSION 2u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t objCount;
+    uint32_t objSize;       // sizeof(SnapObj) at write time
+    uint32_t objOffset;
+    uint32_t nextObjId;
+    uint32_t sessionCount;
+    uint32_t sessionOffset;
+    uint32_t reserved;
+    uint64_t fileSize;
+} SnapHeader;
+
+typedef struct {
+    int32_t id;
+    float x, y, z;
+    float s;
+    int32_t r, g, b;
+    int32_t alive;
+} SnapObj;
+
+typedef struct {
+    uint64_t id;
+    float x, y, z;
+    float yaw, pitch;
+    uint32_t termBytes;
+} SnapSession;
+
+#define SNAP_ALIGN(n) (((n) + 3u) & ~(size_t)3u)
+
+// Background writer. The caller serializes into a buffer from
+// snap_writer_begin() and hands it off with snap_writer_commit(); the file is
+// written (tmp file + rename) on another thread while the next snapshot can
+// already be built into the other buffer. begin() returns NULL instead of
+// blocking when the writer is still behind.
+typedef struct SnapWriter SnapWriter;
+
+SnapWriter* snap_writer_start(const char* path);
+void*       snap_writer_begin(SnapWriter* w, size_t cap);
+void        snap_writer_commit(SnapWriter* w, size_t len);
+void        snap_writer_wait_idle(SnapWriter* w);   // blocks until nothing is queued or being written
+void        snap_writer_stop(SnapWriter* w);   // writes anything pending, joins
+
+// Totals kept by the writer thread. Reading them takes the writer's mutex,
+// so call this from reporting code, not per tick.
+typedef struct {
+    uint64_t written;
+    uint64_t failed;
+    uint64_t bytes;
+    double   writeSeconds;   // time spent in file I/O
+} SnapWriterStats;
+
+void        snap_writer_stats(SnapWriter* w, SnapWriterStats* out);
+
+// Read-only mapping of a snapshot file. snap_map() validates the header and
+// section bounds; everything else is read in place.
+typedef struct {
+    const uint8_t* base;
+    size_t len;
+    void* handle;   // platform mapping handle
+} SnapMap;
+
+int  snap_map(const char* path, SnapMap* m);
+void snap_unmap(SnapMap* m);
+
+static inline const SnapHeader* snap_header(const SnapMap* m) {
+    return (const SnapHeader*)m->base;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
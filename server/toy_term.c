@@ -1,34 +1,14 @@
 #include "toy_term.h"
+#include "llm.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#ifdef _WIN32
-  #define WIN32_LEAN_AND_MEAN
-  #include <winsock2.h>
-  #include <ws2tcpip.h>
-  #pragma comment(lib, "ws2_32.lib")
-#else
-  #include <unistd.h>
-  #include <errno.h>
-  #include <arpa/inet.h>
-  #include <sys/socket.h>
-  #include <netinet/in.h>
-  typedef int SOCKET;
-  #define INVALID_SOCKET (-1)
-  #define SOCKET_ERROR   (-1)
-  #define closesocket close
-#endif
+#include <stdint.h>
 
 // -------------------- tweakables --------------------
 
-// Your llama-server address:
-#define LLM_HOST "127.0.0.1"
-#define LLM_PORT 8080
-#define LLM_PATH "/v1/chat/completions"
-
 // Change these if your client expects different tokens:
 #define LINE_OBJ_ADD   "OBJ_ADD"
 #define LINE_OBJ_DEL   "OBJ_DEL"
@@ -36,51 +16,208 @@
 
 // How much chat memory to keep (toy):
 #define MAX_CHAT_MSGS   48
-#define MAX_ROLE_LEN    8
 #define MAX_TEXT_LEN    1024
 
+// Smallest arena a ring grows to on first use.
+#define RING_MIN_BYTES  64
+#define RING_MIN_LINES  4
+
 // ----------------------------------------------------
 
+// Growable arena of NUL-terminated lines, oldest first. Lines are packed back
+// to back in buf; dropping the oldest line only advances offs[0], and the dead
+// prefix is reclaimed the next time the arena runs out of room. An idle
+// terminal therefore costs a few dozen bytes instead of a fixed 64 KB table.
 typedef struct {
-    char role[MAX_ROLE_LEN];   // "system" | "user" | "assistant"
-    char text[MAX_TEXT_LEN];
-} ChatMsg;
+    char *buf;
+    int  *offs;     // offs[i] = start of line i in buf
+    int   used;     // bytes up to the end of the newest line
+    int   cap;
+    int   count;
+    int   offsCap;
+    int   maxLines;
+} StrRing;
+
+// Chat entries are stored in a StrRing as one role byte followed by the text.
+#define CHAT_USER      'u'
+#define CHAT_ASSISTANT 'a'
 
 struct ToyTerm {
-    char history[TERM_HISTORY_MAX][TERM_LINE_MAX];
-    int  histCount;
-
-    ChatMsg chat[MAX_CHAT_MSGS];
-    int chatCount;
+    StrRing history;
+    unsigned firstSeq;  // sequence number of history line 0
+    StrRing chat;       // empty (no allocation) until the first LLM command
 
     // auto-increment cube id if model omits id (optional)
     int nextCubeId;
 };
 
-// -------------------- history --------------------
+static TermStats g_stats;
 
-static void hist_push(ToyTerm *t, const char *line) {
-    if (!t || !line) return;
+// Chat round trip buffers, taken from llm_scratch() (reset when term_run
+// finishes) rather than malloc'd or put on the stack each time.
+#define LLM_REQUEST_MAX   TERM_CHAT_REQUEST_MAX
+#define LLM_RESPONSE_MAX  TERM_CHAT_RESPONSE_MAX
+#define LLM_CONTENT_MAX   (8 * 1024)
+#define JSON_OBJ_MAX      2048
+
+// -------------------- line arena --------------------
+
+static void ring_init(StrRing *r, int maxLines) {
+    memset(r, 0, sizeof(*r));
+    r->maxLines = maxLines;
+}
+
+static void ring_free(StrRing *r) {
+    free(r->buf);
+    free(r->offs);
+    ring_init(r, r->maxLines);
+}
+
+// Slide live lines down to offset 0, reclaiming bytes of dropped lines.
+static void ring_compact(StrRing *r) {
+    int base = r->count ? r->offs[0] : r->used;
+    if (base <= 0) return;
+    memmove(r->buf, r->buf + base, (size_t)(r->used - base));
+    for (int i = 0; i < r->count; i++) r->offs[i] -= base;
+    r->used -= base;
+}
+
+// Make room for need more bytes. After a compaction the arena is kept at
+// least half free so the memmove cost stays amortized O(1) per byte pushed.
+static int ring_reserve(StrRing *r, int need) {
+    if (r->used + need <= r->cap) return 1;
+
+    ring_compact(r);
+    if ((r->used + need) * 2 <= r->cap) return 1;
+
+    int ncap = r->cap ? r->cap : RING_MIN_BYTES;
+    while (ncap < (r->used + need) * 2) ncap *= 2;
+    char *nb = (char*)realloc(r->buf, (size_t)ncap);
+    if (!nb) return (r->used + need <= r->cap);
+    r->buf = nb;
+    r->cap = ncap;
+    return 1;
+}
+
+// Appends at most maxLen bytes of line (plus an optional leading tag byte).
+static void ring_push(StrRing *r, char tag, const char *line, int maxLen) {
+    int len = (int)strlen(line);
+    if (len > maxLen) len = maxLen;
+    int need = len + 1 + (tag ? 1 : 0);
 
-    if (t->histCount < TERM_HISTORY_MAX) {
-        strncpy(t->history[t->histCount], line, TERM_LINE_MAX - 1);
-        t->history[t->histCount][TERM_LINE_MAX - 1] = '\0';
-        t->histCount++;
+    if (r->count == r->maxLines) {
+        // drop oldest; its bytes are reclaimed on the next compaction
+        memmove(r->offs, r->offs + 1, (size_t)(r->count - 1) * sizeof(int));
+        r->count--;
+    }
+    if (r->count == r->offsCap) {
+        int ncap = r->offsCap ? r->offsCap * 2 : RING_MIN_LINES;
+        if (ncap > r->maxLines) ncap = r->maxLines;
+        int *no = (int*)realloc(r->offs, (size_t)ncap * sizeof(int));
+        if (!no) return;
+        r->offs = no;
+        r->offsCap = ncap;
+    }
+    if (!ring_reserve(r, need)) return;
+
+    char *dst = r->buf + r->used;
+    r->offs[r->count++] = r->used;
+    if (tag) *dst++ = tag;
+    memcpy(dst, line, (size_t)len);
+    dst[len] = '\0';
+    r->used += need;
+}
+
+static const char *ring_at(const StrRing *r, int idx) {
+    return r->buf + r->offs[idx];
+}
+
+static void ring_replace_last(StrRing *r, const char *line, int maxLen) {
+    if (r->count <= 0) return;
+    char *last = r->buf + r->offs[r->count - 1];
+    int len = (int)strlen(line);
+    if (len > maxLen) len = maxLen;
+    if (len <= (int)strlen(last)) {
+        memcpy(last, line, (size_t)len);
+        last[len] = '\0';
+        r->used = r->offs[r->count - 1] + len + 1;
         return;
     }
+    // newest line sits at the end of the arena: pop it and push again
+    r->count--;
+    r->used = r->offs[r->count];
+    ring_push(r, 0, line, maxLen);
+}
+
+// Give back all slack capacity; used for idle sessions.
+static void ring_shrink(StrRing *r) {
+    if (r->count == 0) { ring_free(r); return; }
+    ring_compact(r);
+    char *nb = (char*)realloc(r->buf, (size_t)r->used);
+    if (nb) { r->buf = nb; r->cap = r->used; }
+    int *no = (int*)realloc(r->offs, (size_t)r->count * sizeof(int));
+    if (no) { r->offs = no; r->offsCap = r->count; }
+}
+
+static size_t ring_bytes(const StrRing *r) {
+    return (size_t)r->cap + (size_t)r->offsCap * sizeof(int);
+}
+
+// Serialized ring: live line offsets (rebased to 0) followed by the packed
+// bytes, padded to 4. Both directions are a pair of memcpys.
+static size_t ring_blob_size(const StrRing *r) {
+    int base = r->count ? r->offs[0] : r->used;
+    size_t n = (size_t)r->count * sizeof(int32_t) + (size_t)(r->used - base);
+    return (n + 3u) & ~(size_t)3u;
+}
+
+static size_t ring_blob_write(const StrRing *r, uint8_t *dst) {
+    int base = r->count ? r->offs[0] : r->used;
+    int32_t *offs = (int32_t*)dst;
+    for (int i = 0; i < r->count; i++) offs[i] = r->offs[i] - base;
+    size_t n = (size_t)r->count * sizeof(int32_t);
+    memcpy(dst + n, r->buf + base, (size_t)(r->used - base));
+    n += (size_t)(r->used - base);
+    while (n & 3u) dst[n++] = 0;
+    return n;
+}
 
-    // shift up
-    for (int i = 1; i < TERM_HISTORY_MAX; i++) {
-        strcpy(t->history[i - 1], t->history[i]);
+static int ring_blob_read(StrRing *r, const uint8_t *src, int count, int bytes) {
+    if (count <= 0) return 1;
+    if (count > r->maxLines || bytes <= 0) return 0;
+
+    const char *text = (const char*)(src + (size_t)count * sizeof(int32_t));
+    if (text[bytes - 1] != '\0') return 0;
+
+    r->offs = (int*)malloc((size_t)count * sizeof(int));
+    r->buf = (char*)malloc((size_t)bytes);
+    if (!r->offs || !r->buf) { ring_free(r); return 0; }
+    memcpy(r->offs, src, (size_t)count * sizeof(int));
+    memcpy(r->buf, text, (size_t)bytes);
+    r->count = r->offsCap = count;
+    r->used = r->cap = bytes;
+
+    for (int i = 0; i < count; i++) {
+        if (r->offs[i] < 0 || r->offs[i] >= bytes || (i && r->offs[i] <= r->offs[i - 1])) {
+            ring_free(r);
+            return 0;
+        }
     }
-    strncpy(t->history[TERM_HISTORY_MAX - 1], line, TERM_LINE_MAX - 1);
-    t->history[TERM_HISTORY_MAX - 1][TERM_LINE_MAX - 1] = '\0';
+    return 1;
+}
+
+// -------------------- history --------------------
+
+static void hist_push(ToyTerm *t, const char *line) {
+    if (!t || !line) return;
+    if (t->history.count == t->history.maxLines) t->firstSeq++;
+    ring_push(&t->history, 0, line, TERM_LINE_MAX - 1);
+    g_stats.historyLines++;
 }
 
 static void replace_last(ToyTerm *t, const char *line) {
-    if (!t || t->histCount <= 0) return;
-    strncpy(t->history[t->histCount - 1], line, TERM_LINE_MAX - 1);
-    t->history[t->histCount - 1][TERM_LINE_MAX - 1] = '\0';
+    if (!t) return;
+    ring_replace_last(&t->history, line, TERM_LINE_MAX - 1);
 }
 
 // -------------------- tiny helpers --------------------
@@ -89,26 +226,9 @@ static void trim_ws(const char **p) {
     while (**p && isspace((unsigned char)**p)) (*p)++;
 }
 
-static void chat_push(ToyTerm *t, const char *role, const char *text) {
-    if (!t || !role || !text) return;
-
-    if (t->chatCount < MAX_CHAT_MSGS) {
-        strncpy(t->chat[t->chatCount].role, role, MAX_ROLE_LEN - 1);
-        t->chat[t->chatCount].role[MAX_ROLE_LEN - 1] = '\0';
-        strncpy(t->chat[t->chatCount].text, text, MAX_TEXT_LEN - 1);
-        t->chat[t->chatCount].text[MAX_TEXT_LEN - 1] = '\0';
-        t->chatCount++;
-        return;
-    }
-
-    // drop oldest user/assistant pair-ish: shift left by 1
-    for (int i = 1; i < MAX_CHAT_MSGS; i++) {
-        t->chat[i - 1] = t->chat[i];
-    }
-    strncpy(t->chat[MAX_CHAT_MSGS - 1].role, role, MAX_ROLE_LEN - 1);
-    t->chat[MAX_CHAT_MSGS - 1].role[MAX_ROLE_LEN - 1] = '\0';
-    strncpy(t->chat[MAX_CHAT_MSGS - 1].text, text, MAX_TEXT_LEN - 1);
-    t->chat[MAX_CHAT_MSGS - 1].text[MAX_TEXT_LEN - 1] = '\0';
+static void chat_push(ToyTerm *t, char role, const char *text) {
+    if (!t || !text) return;
+    ring_push(&t->chat, role, text, MAX_TEXT_LEN - 1);
 }
 
 static int is_printable_ascii(int c) {
@@ -173,247 +293,54 @@ static const char *find_json_key(const char *json, const char *key) {
     return strstr(json, pat);
 }
 
-// -------------------- HTTP client (minimal) --------------------
-
-static int sock_connect(const char *host, int port) {
-    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s == INVALID_SOCKET) return INVALID_SOCKET;
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons((unsigned short)port);
-
-#ifdef _WIN32
-    addr.sin_addr.s_addr = inet_addr(host);
-#else
-    inet_pton(AF_INET, host, &addr.sin_addr);
-#endif
-
-    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        closesocket(s);
-        return INVALID_SOCKET;
-    }
-    return (int)s;
-}
-
-static int sock_send_all(SOCKET s, const char *buf, int len) {
-    int sent = 0;
-    while (sent < len) {
-        int r = send(s, buf + sent, len - sent, 0);
-        if (r <= 0) return 0;
-        sent += r;
-    }
-    return 1;
-}
-
-static int sock_recv_some(SOCKET s, char *buf, int cap) {
-    int r = recv(s, buf, cap, 0);
-    return r;
-}
-
-static int parse_content_length(const char *hdrs) {
-    const char *p = strstr(hdrs, "Content-Length:");
-    if (!p) p = strstr(hdrs, "content-length:");
-    if (!p) return -1;
-    p = strchr(p, ':');
-    if (!p) return -1;
-    p++;
-    while (*p && isspace((unsigned char)*p)) p++;
-    return atoi(p);
-}
-
-static int header_is_chunked(const char *hdrs) {
-    return (strstr(hdrs, "Transfer-Encoding: chunked") ||
-            strstr(hdrs, "transfer-encoding: chunked")) ? 1 : 0;
-}
-
-// Read HTTP response body into out (cap). Returns 1 ok.
-static int http_post_json(const char *host, int port, const char *path,
-                          const char *jsonBody, char *out, int outCap,
-                          char *err, int errCap) {
-    if (err && errCap) err[0] = '\0';
-    if (out && outCap) out[0] = '\0';
-
-    SOCKET s = (SOCKET)sock_connect(host, port);
-    if (s == INVALID_SOCKET) {
-        snprintf(err, errCap, "Could not connect to llama-server at %s:%d", host, port);
-        return 0;
-    }
-
-    char req[8192];
-    int bodyLen = (int)strlen(jsonBody);
-
-    int n = snprintf(req, sizeof(req),
-        "POST %s HTTP/1.1\r\n"
-        "Host: %s:%d\r\n"
-        "Content-Type: application/json\r\n"
-        "Connection: close\r\n"
-        "Content-Length: %d\r\n"
-        "\r\n"
-        "%s",
-        path, host, port, bodyLen, jsonBody);
-
-    if (n <= 0 || n >= (int)sizeof(req)) {
-        closesocket(s);
-        snprintf(err, errCap, "Request too large");
-        return 0;
-    }
-
-    if (!sock_send_all(s, req, n)) {
-        closesocket(s);
-        snprintf(err, errCap, "Failed to send request");
-        return 0;
-    }
-
-    // read all into a temp buffer (toy)
-    char *tmp = (char*)malloc(1024 * 256);
-    int tmpCap = tmp ? (1024 * 256) : 0;
-    int tmpLen = 0;
-
-    if (!tmp) {
-        closesocket(s);
-        snprintf(err, errCap, "Out of memory");
-        return 0;
-    }
-
-    for (;;) {
-        char buf[4096];
-        int r = sock_recv_some(s, buf, (int)sizeof(buf));
-        if (r <= 0) break;
-        if (tmpLen + r >= tmpCap) break;
-        memcpy(tmp + tmpLen, buf, r);
-        tmpLen += r;
-    }
-
-    closesocket(s);
-
-    if (tmpLen <= 0) {
-        free(tmp);
-        snprintf(err, errCap, "No response");
-        return 0;
-    }
-    tmp[tmpLen] = '\0';
-
-    // split headers/body
-    char *sep = strstr(tmp, "\r\n\r\n");
-    if (!sep) {
-        free(tmp);
-        snprintf(err, errCap, "Bad HTTP response");
-        return 0;
-    }
-    *sep = '\0';
-    const char *hdrs = tmp;
-    const char *body = sep + 4;
-
-    // crude status check
-    if (!strstr(hdrs, "200")) {
-        // try to show some body
-        char preview[256];
-        strncpy(preview, body, sizeof(preview) - 1);
-        preview[sizeof(preview) - 1] = '\0';
-        snprintf(err, errCap, "HTTP error. Body: %.200s", preview);
-        free(tmp);
-        return 0;
-    }
-
-    // If chunked, decode it.
-    if (header_is_chunked(hdrs)) {
-        const char *p = body;
-        int w = 0;
-        while (*p) {
-            unsigned chunkSize = 0;
-            // read hex size
-            while (*p && *p != '\r' && *p != '\n') {
-                char c = *p++;
-                int v = 0;
-                if (c >= '0' && c <= '9') v = c - '0';
-                else if (c >= 'a' && c <= 'f') v = 10 + (c - 'a');
-                else if (c >= 'A' && c <= 'F') v = 10 + (c - 'A');
-                else { /* ignore */ }
-                chunkSize = (chunkSize << 4) | (unsigned)v;
-            }
-            // skip CRLF
-            while (*p == '\r' || *p == '\n') p++;
-            if (chunkSize == 0) break;
-
-            for (unsigned i = 0; i < chunkSize && *p; i++) {
-                if (w < outCap - 1) out[w++] = *p;
-                p++;
-            }
-            out[w] = '\0';
-            // skip trailing CRLF after chunk data
-            while (*p == '\r' || *p == '\n') p++;
-        }
-        free(tmp);
-        return 1;
-    }
-
-    // Not chunked: if content-length exists, respect it
-    int cl = parse_content_length(hdrs);
-    if (cl >= 0) {
-        int copy = cl;
-        if (copy > outCap - 1) copy = outCap - 1;
-        memcpy(out, body, copy);
-        out[copy] = '\0';
-        free(tmp);
-        return 1;
-    }
-
-    // Otherwise copy what we have
-    strncpy(out, body, outCap - 1);
-    out[outCap - 1] = '\0';
-    free(tmp);
-    return 1;
-}
-
 // -------------------- llama request/response --------------------
 
+// System prompt: force strict JSON tool-ish output. Shared by every session and
+// emitted at the head of each request rather than stored in chat memory.
+static const char *LLM_SYSTEM_PROMPT =
+    "You are the terminal brain for a tiny raylib toy. "
+    "You MUST respond with a single JSON object, no extra text. "
+    "Schema:\n"
+    "{\n"
+    "  \"say\": string,\n"
+    "  \"actions\": [\n"
+    "     {\"type\":\"spawn_cube\", \"id\": int(optional), \"x\": number, \"y\": number, \"z\": number, \"size\": number, \"r\": int, \"g\": int, \"b\": int},\n"
+    "     {\"type\":\"destroy_cube\", \"id\": int},\n"
+    "     {\"type\":\"clear_cubes\"}\n"
+    "  ]\n"
+    "}\n"
+    "If you are unsure, set say to ask a clarifying question and actions to [].";
+
 static void build_llm_request_json(ToyTerm *t, const char *userText, char *out, int outCap) {
-    // System prompt: force strict JSON tool-ish output
-    const char *sys =
-        "You are the terminal brain for a tiny raylib toy. "
-        "You MUST respond with a single JSON object, no extra text. "
-        "Schema:\n"
-        "{\n"
-        "  \"say\": string,\n"
-        "  \"actions\": [\n"
-        "     {\"type\":\"spawn_cube\", \"id\": int(optional), \"x\": number, \"y\": number, \"z\": number, \"size\": number, \"r\": int, \"g\": int, \"b\": int},\n"
-        "     {\"type\":\"destroy_cube\", \"id\": int},\n"
-        "     {\"type\":\"clear_cubes\"}\n"
-        "  ]\n"
-        "}\n"
-        "If you are unsure, set say to ask a clarifying question and actions to [].";
-
-    // ensure system is first message in chat buffer
-    if (t->chatCount == 0) {
-        chat_push(t, "system", sys);
-    }
+    // chat memory is allocated on first use
+    if (t->chat.maxLines == 0) ring_init(&t->chat, MAX_CHAT_MSGS);
 
     // push user msg into chat buffer
-    chat_push(t, "user", userText);
+    chat_push(t, CHAT_USER, userText);
 
     // build JSON
     // (manual, small, not a full JSON writer)
-    char escRole[32];
     char escText[2048];
 
     int w = 0;
+    json_escape(LLM_SYSTEM_PROMPT, escText, (int)sizeof(escText));
     w += snprintf(out + w, outCap - w,
         "{"
         "\"model\":\"gpt-3.5-turbo\","
         "\"stream\":false,"
         "\"temperature\":0.4,"
         "\"messages\":["
+        "{\"role\":\"system\",\"content\":\"%s\"}",
+        escText
     );
 
-    for (int i = 0; i < t->chatCount && w < outCap - 1; i++) {
-        json_escape(t->chat[i].role, escRole, (int)sizeof(escRole));
-        json_escape(t->chat[i].text, escText, (int)sizeof(escText));
+    for (int i = 0; i < t->chat.count && w < outCap - 1; i++) {
+        const char *msg = ring_at(&t->chat, i);
+        json_escape(msg + 1, escText, (int)sizeof(escText));
 
         w += snprintf(out + w, outCap - w,
-            "%s{\"role\":\"%s\",\"content\":\"%s\"}",
-            (i == 0) ? "" : ",", escRole, escText
+            ",{\"role\":\"%s\",\"content\":\"%s\"}",
+            (msg[0] == CHAT_USER) ? "user" : "assistant", escText
         );
     }
 
@@ -474,6 +401,12 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
     if (!p) return;
     p++;
 
+    // one copy buffer for every object in the array
+    Arena *scratch = llm_scratch();
+    ArenaMark mark = arena_mark(scratch);
+    char *obj = (char*)arena_alloc(scratch, JSON_OBJ_MAX);
+    if (!obj) return;
+
     // brute scan for objects inside array
     while (*p) {
         while (*p && *p != '{' && *p != ']') p++;
@@ -494,8 +427,7 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
         int objLen = (int)(p - objStart);
         if (objLen <= 0) break;
 
-        char obj[2048];
-        if (objLen >= (int)sizeof(obj)) objLen = (int)sizeof(obj) - 1;
+        if (objLen >= JSON_OBJ_MAX) objLen = JSON_OBJ_MAX - 1;
         memcpy(obj, objStart, objLen);
         obj[objLen] = '\0';
 
@@ -514,6 +446,7 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
         }
 
         if (strcmp(type, "clear_cubes") == 0) {
+            g_stats.llmActions++;
             hist_push(t, LINE_OBJ_CLEAR);
         }
         else if (strcmp(type, "destroy_cube") == 0) {
@@ -524,6 +457,7 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
                 if (ip) id = atoi(ip + 1);
             }
             if (id >= 0) {
+                g_stats.llmActions++;
                 char line[TERM_LINE_MAX];
                 snprintf(line, sizeof(line), "%s %d", LINE_OBJ_DEL, id);
                 hist_push(t, line);
@@ -557,6 +491,7 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
             if (g < 0) g = 0; if (g > 255) g = 255;
             if (b < 0) b = 0; if (b > 255) b = 255;
 
+            g_stats.llmActions++;
             char line[TERM_LINE_MAX];
             snprintf(line, sizeof(line),
                 "%s %d %.3f %.3f %.3f %.3f %d %d %d",
@@ -567,6 +502,7 @@ static void apply_model_json(ToyTerm *t, const char *modelJson) {
         // skip commas/space
         while (*p && *p != '{' && *p != ']') p++;
     }
+    arena_release(scratch, mark);
 }
 
 // -------------------- public API --------------------
@@ -575,8 +511,7 @@ ToyTerm* term_create(void) {
     ToyTerm *t = (ToyTerm*)calloc(1, sizeof(ToyTerm));
     if (!t) return NULL;
 
-    t->histCount = 0;
-    t->chatCount = 0;
+    ring_init(&t->history, TERM_HISTORY_MAX);
     t->nextCubeId = 1;
 
     hist_push(t, "> CONNECTED");
@@ -587,21 +522,114 @@ ToyTerm* term_create(void) {
 }
 
 void term_destroy(ToyTerm* t) {
+    if (!t) return;
+    ring_free(&t->history);
+    ring_free(&t->chat);
     free(t);
 }
 
+void term_shrink(ToyTerm* t) {
+    if (!t) return;
+    ring_shrink(&t->history);
+    ring_shrink(&t->chat);
+}
+
+size_t term_memory_usage(const ToyTerm* t) {
+    if (!t) return 0;
+    return sizeof(*t) + ring_bytes(&t->history) + ring_bytes(&t->chat);
+}
+
+void term_push_line(ToyTerm* t, const char* line) {
+    hist_push(t, line);
+}
+
+void term_replace_last(ToyTerm* t, const char* line) {
+    if (line) replace_last(t, line);
+}
+
+unsigned term_history_first_seq(const ToyTerm* t) {
+    return t ? t->firstSeq : 0;
+}
+
+unsigned term_history_next_seq(const ToyTerm* t) {
+    return t ? t->firstSeq + (unsigned)t->history.count : 0;
+}
+
+typedef struct {
+    uint32_t firstSeq;
+    int32_t  nextCubeId;
+    int32_t  histCount, histBytes;
+    int32_t  chatCount, chatBytes;
+} TermBlobHeader;
+
+static int ring_text_bytes(const StrRing *r) {
+    return r->used - (r->count ? r->offs[0] : r->used);
+}
+
+size_t term_snapshot_size(const ToyTerm* t) {
+    if (!t) return 0;
+    return sizeof(TermBlobHeader) + ring_blob_size(&t->history) + ring_blob_size(&t->chat);
+}
+
+size_t term_snapshot_write(const ToyTerm* t, void* dst) {
+    if (!t) return 0;
+    uint8_t *p = (uint8_t*)dst;
+    TermBlobHeader h;
+    h.firstSeq = t->firstSeq;
+    h.nextCubeId = t->nextCubeId;
+    h.histCount = t->history.count;
+    h.histBytes = ring_text_bytes(&t->history);
+    h.chatCount = t->chat.count;
+    h.chatBytes = ring_text_bytes(&t->chat);
+    memcpy(p, &h, sizeof(h));
+
+    size_t n = sizeof(h);
+    n += ring_blob_write(&t->history, p + n);
+    n += ring_blob_write(&t->chat, p + n);
+    return n;
+}
+
+ToyTerm* term_snapshot_read(const void* src, size_t len) {
+    const uint8_t *p = (const uint8_t*)src;
+    TermBlobHeader h;
+    if (len < sizeof(h)) return NULL;
+    memcpy(&h, p, sizeof(h));
+    if (h.histCount < 0 || h.histBytes < 0 || h.chatCount < 0 || h.chatBytes < 0) return NULL;
+
+    size_t histSize = (((size_t)h.histCount * 4u + (size_t)h.histBytes) + 3u) & ~(size_t)3u;
+    size_t chatSize = (((size_t)h.chatCount * 4u + (size_t)h.chatBytes) + 3u) & ~(size_t)3u;
+    if (sizeof(h) + histSize + chatSize > len) return NULL;
+
+    ToyTerm *t = (ToyTerm*)calloc(1, sizeof(ToyTerm));
+    if (!t) return NULL;
+    ring_init(&t->history, TERM_HISTORY_MAX);
+    if (h.chatCount > 0) ring_init(&t->chat, MAX_CHAT_MSGS);
+    t->firstSeq = h.firstSeq;
+    t->nextCubeId = h.nextCubeId;
+
+    if (!ring_blob_read(&t->history, p + sizeof(h), h.histCount, h.histBytes) ||
+        !ring_blob_read(&t->chat, p + sizeof(h) + histSize, h.chatCount, h.chatBytes)) {
+        term_destroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void term_get_stats(TermStats* out) {
+    *out = g_stats;
+}
+
 int term_history_count(const ToyTerm* t) {
-    return t ? t->histCount : 0;
+    return t ? t->history.count : 0;
 }
 
 const char* term_history_line(const ToyTerm* t, int idx) {
-    if (!t || idx < 0 || idx >= t->histCount) return NULL;
-    return t->history[idx];
+    if (!t || idx < 0 || idx >= t->history.count) return NULL;
+    return ring_at(&t->history, idx);
 }
 
-int term_run(ToyTerm* t, const char* cmdIn) {
+int term_chat_begin(ToyTerm* t, const char* cmdIn, char* req, int reqCap) {
     if (!t) return 0;
-    int before = t->histCount;
 
     char cmd[256];
     strncpy(cmd, cmdIn ? cmdIn : "", sizeof(cmd) - 1);
@@ -619,49 +647,75 @@ int term_run(ToyTerm* t, const char* cmdIn) {
     // empty line -> just new prompt
     if (*p == '\0') {
         hist_push(t, ">>> ");
-        return t->histCount - before;
+        return 0;
     }
-
-    // Optional local commands (still “chatty”, but useful)
-    // (You can delete these if you want *pure* LLM.)
-    if (strcmp(p, "/clear") == 0) {
-        hist_push(t, LINE_OBJ_CLEAR);
+    if (!req || reqCap <= 0) {
+        hist_push(t, "Error: out of memory");
         hist_push(t, ">>> ");
-        return t->histCount - before;
+        return 0;
     }
 
-    // Call llama-server
-    char reqJson[16384];
-    build_llm_request_json(t, p, reqJson, (int)sizeof(reqJson));
+    // local commands (spawn, /clear, ...) are routed by the server before
+    // anything reaches here; the rest is a message to the model
+    build_llm_request_json(t, p, req, reqCap);
+    g_stats.llmRequests++;
+    g_stats.llmRequestBytes += strlen(req);
+    return 1;
+}
 
-    char respJson[1024 * 128];
-    char err[256];
+// Everything the model said or did, pushed to history. The content buffer
+// comes from llm_scratch() and goes back before returning.
+void term_chat_finish(ToyTerm* t, int ok, const char* reply) {
+    if (!t) return;
 
-    if (!http_post_json(LLM_HOST, LLM_PORT, LLM_PATH, reqJson,
-                        respJson, (int)sizeof(respJson),
-                        err, (int)sizeof(err))) {
+    if (!ok) {
+        g_stats.llmFailures++;
         char msg[TERM_LINE_MAX];
-        snprintf(msg, sizeof(msg), "Error: %s", err);
+        snprintf(msg, sizeof(msg), "Error: %.*s", (int)sizeof(msg) - 8, reply);
         hist_push(t, msg);
         hist_push(t, ">>> ");
-        return t->histCount - before;
+        return;
     }
-
-    // extract assistant content
-    char content[8192];
-    if (!extract_oai_content(respJson, content, (int)sizeof(content))) {
+    g_stats.llmResponseBytes += strlen(reply);
+
+    Arena *scratch = llm_scratch();
+    ArenaMark mark = arena_mark(scratch);
+    char *content = (char*)arena_alloc(scratch, LLM_CONTENT_MAX);
+    if (!content) {
+        hist_push(t, "Error: out of memory");
+    } else if (!extract_oai_content(reply, content, LLM_CONTENT_MAX)) {
+        // extract assistant content
+        g_stats.llmBadReplies++;
         hist_push(t, "Error: could not parse llama-server response (missing message.content)");
-        hist_push(t, ">>> ");
-        return t->histCount - before;
-    }
-
-    // store assistant content in chat memory so convo continues
-    chat_push(t, "assistant", content);
+    } else {
+        // store assistant content in chat memory so convo continues
+        chat_push(t, CHAT_ASSISTANT, content);
 
-    // interpret assistant JSON (say + actions)
-    apply_model_json(t, content);
+        // interpret assistant JSON (say + actions)
+        apply_model_json(t, content);
+    }
+    arena_release(scratch, mark);
 
     // new prompt
     hist_push(t, ">>> ");
-    return t->histCount - before;
+}
+
+int term_run(ToyTerm* t, const char* cmdIn) {
+    if (!t) return 0;
+    unsigned before = term_history_next_seq(t);
+
+    Arena *scratch = llm_scratch();
+    char *req = (char*)arena_alloc(scratch, LLM_REQUEST_MAX);
+    if (term_chat_begin(t, cmdIn, req, req ? LLM_REQUEST_MAX : 0)) {
+        // Call llama-server
+        char *resp = (char*)arena_alloc(scratch, LLM_RESPONSE_MAX);
+        char err[LLM_ERR_MAX];
+        int ok = 0;
+        if (!resp) snprintf(err, sizeof(err), "out of memory");
+        else ok = llm_request(LLM_CHAT, req, resp, LLM_RESPONSE_MAX, err, (int)sizeof(err));
+        term_chat_finish(t, ok, ok ? resp : err);
+    }
+    arena_reset(scratch);
+
+    return (int)(term_history_next_seq(t) - before);
 }
@@ -1,6 +1,9 @@
 #ifndef TOY_TERM_H
 #define TOY_TERM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,13 +17,60 @@ ToyTerm* term_create(void);
 void     term_destroy(ToyTerm* t);
 
 // Runs a command; pushes ">>> cmd", outputs, and new prompt into history.
-// Returns number of new lines added since the call began.
+// Anything non-empty is sent to the model as the next chat message (see
+// llm.h). Returns number of new lines added since the call began.
 int      term_run(ToyTerm* t, const char* cmd);
 
+// term_run in two parts, for a caller that sends the request itself (the
+// server, without waiting on its main loop). term_chat_begin echoes cmd on
+// the prompt line. For an empty line it pushes a new prompt and returns 0;
+// otherwise it adds cmd to the chat memory, writes the chat-completions
+// body to req and returns 1. term_chat_finish then takes the reply body
+// (ok) or the error text, applies it and pushes the new prompt.
+#define TERM_CHAT_REQUEST_MAX   (16 * 1024)
+#define TERM_CHAT_RESPONSE_MAX  (128 * 1024)
+
+int      term_chat_begin(ToyTerm* t, const char* cmd, char* req, int reqCap);
+void     term_chat_finish(ToyTerm* t, int ok, const char* reply);
+
+// Append server-originated output, or overwrite the newest (prompt) line.
+void     term_push_line(ToyTerm* t, const char* line);
+void     term_replace_last(ToyTerm* t, const char* line);
+
 // Access history lines
 int      term_history_count(const ToyTerm* t);
 const char* term_history_line(const ToyTerm* t, int idx);
 
+// Every history line gets a monotonically increasing sequence number; line idx
+// has seq first_seq + idx. Only the newest line is ever modified in place.
+unsigned term_history_first_seq(const ToyTerm* t);
+unsigned term_history_next_seq(const ToyTerm* t);
+
+// Memory is arena-backed and grows with use; an idle terminal holds only its
+// few intro lines. term_shrink() returns slack capacity to the allocator.
+void     term_shrink(ToyTerm* t);
+size_t   term_memory_usage(const ToyTerm* t);
+
+// Snapshot support: the serialized form is the raw arenas (history, chat
+// memory, sequence numbers), 4-byte aligned. read() validates and copies.
+size_t   term_snapshot_size(const ToyTerm* t);
+size_t   term_snapshot_write(const ToyTerm* t, void* dst);
+ToyTerm* term_snapshot_read(const void* src, size_t len);
+
+// Process-wide counters across all terminals. Bumped without locking by
+// whichever thread runs the terminals (the server's main loop).
+typedef struct {
+    uint64_t historyLines;      // lines appended to any history
+    uint64_t llmRequests;
+    uint64_t llmFailures;       // transport errors
+    uint64_t llmBadReplies;     // reply had no usable message.content
+    uint64_t llmActions;        // actions applied from model replies
+    uint64_t llmRequestBytes;
+    uint64_t llmResponseBytes;
+} TermStats;
+
+void     term_get_stats(TermStats* out);
+
 // Clear typed buffer is client-side; server only holds history + vars.
 
 #ifdef __cplusplus
@@ -0,0 +1,77 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "trace.h"
+#include "../common/timing.h"
+
+#include <stdio.h>
+
+#ifdef KSPACE_TRACE
+
+TraceEvent g_traceRing[TRACE_EVENTS];
+uint32_t   g_traceHead = 0;
+
+static uint64_t g_clock0, g_ns0;
+
+void trace_init(void) {
+    g_clock0 = trace_clock();
+    g_ns0 = time_now_ns();
+}
+
+long trace_dump(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+
+    // event clock ticks -> microseconds, calibrated over the whole run
+    uint64_t dClock = trace_clock() - g_clock0;
+    uint64_t dNs = time_now_ns() - g_ns0;
+    double usPerTick = (dClock && dNs) ? (double)dNs / (double)dClock / 1000.0 : 0.001;
+
+    uint32_t head = g_traceHead;
+    uint32_t count = head < TRACE_EVENTS ? head : TRACE_EVENTS;
+    uint32_t first = head - count;
+    uint64_t t0 = count ? g_traceRing[first & (TRACE_EVENTS - 1)].ts : 0;
+
+    // The ring may have cut a scope in half: ends whose begin was overwritten
+    // are dropped, and scopes still open at the end are closed at the last
+    // timestamp so the viewer doesn't stretch them to infinity.
+    const char* open[64];
+    int depth = 0;
+    uint64_t last = t0;
+    long written = 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (uint32_t i = first; i != head; i++) {
+        const TraceEvent* e = &g_traceRing[i & (TRACE_EVENTS - 1)];
+        if (e->ph == 'E') {
+            if (depth == 0) continue;
+            depth--;
+        } else if (depth < (int)(sizeof(open) / sizeof(open[0]))) {
+            open[depth++] = e->name;
+        }
+        last = e->ts;
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1}",
+                written ? ",\n" : "", e->name, e->ph, (double)(e->ts - t0) * usPerTick);
+        written++;
+    }
+    while (depth > 0) {
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":1}",
+                written ? ",\n" : "", open[--depth], (double)(last - t0) * usPerTick);
+        written++;
+    }
+    fprintf(f, "\n]}\n");
+
+    if (fclose(f) != 0) return -1;
+    return written;
+}
+
+#else
+
+void trace_init(void) {
+}
+
+long trace_dump(const char* path) {
+    (void)path;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In-process event recorder for looking inside individual ticks. Scopes are
+// TRACE_BEGIN/TRACE_END pairs with string-literal names; events go into a
+// fixed ring (newest overwrite oldest) and trace_dump() writes the ring as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev).
+//
+// Compiled in only with -DKSPACE_TRACE. Without it the macros expand to
+// nothing and trace_dump() just reports that tracing is unavailable.
+// Recording is single-threaded: only the server's main loop is traced.
+
+#ifdef KSPACE_TRACE
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define trace_clock() __rdtsc()
+#elif defined(_M_X64) || defined(_M_IX86)
+  #include <intrin.h>
+  #define trace_clock() __rdtsc()
+#else
+  #include "../common/timing.h"
+  #define trace_clock() time_now_ns()
+#endif
+
+#define TRACE_EVENTS (1u << 16)   // power of two
+
+typedef struct {
+    uint64_t    ts;     // trace_clock(); TSC ticks on x86, converted at dump
+    const char* name;
+    char        ph;     // 'B' or 'E'
+} TraceEvent;
+
+extern TraceEvent g_traceRing[TRACE_EVENTS];
+extern uint32_t   g_traceHead;
+
+static inline void trace_event(const char* name, char ph) {
+    TraceEvent* e = &g_traceRing[g_traceHead++ & (TRACE_EVENTS - 1)];
+    e->ts = trace_clock();
+    e->name = name;
+    e->ph = ph;
+}
+
+#define TRACE_BEGIN(name) trace_event((name), 'B')
+#define TRACE_END(name)   trace_event((name), 'E')
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name)   ((void)0)
+
+#endif
+
+// Call once at startup; pairs the event clock with the monotonic clock so
+// dumps can convert timestamps.
+void trace_init(void);
+
+// Writes the ring to path. Returns the number of events written, or -1 if
+// the file could not be written or tracing is compiled out.
+long trace_dump(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif